@@ -0,0 +1,67 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define MAX_SAMPLE_SUBSCRIBERS 8
+
+// One completed ring block, published to every subscriber
+typedef struct {
+    const uint16_t* samples;  // 12-bit ADC counts, valid only during the callback
+    size_t count;
+    uint32_t sequence;        // Block number since the sampler started
+    int64_t timestamp_us;     // esp_timer time when the block completed
+} sample_block_t;
+
+// Runs in the sampler task for every block - must not block
+typedef void (*sample_block_callback_t)(const sample_block_t* block, void* context);
+
+// A run of ring samples frozen for zero-copy readout. The ring keeps running, so a
+// window stays valid only until the producer laps it - check adc_sampler_window_intact()
+typedef struct {
+    uint32_t first_sequence;  // Ring block holding the first sample
+    uint32_t start_offset;    // First sample's position within that block
+    uint32_t count;
+} sample_window_t;
+
+// Summary of a collected run of samples
+typedef struct {
+    uint32_t count;
+    uint16_t min_raw;
+    uint16_t max_raw;
+    float mean_raw;
+    float mean_voltage;     // DC level of the input
+    float ac_rms_voltage;   // RMS about the bias supplied to the collector
+} sample_stats_t;
+
+// Driver setup and sampling task control
+esp_err_t adc_sampler_init(void);
+esp_err_t adc_sampler_start(void);
+void adc_sampler_stop(void);
+bool adc_sampler_is_running(void);
+
+// Block subscription - the sampler task is the only owner of the ADC
+int adc_sampler_subscribe(sample_block_callback_t callback, void* context);
+void adc_sampler_unsubscribe(int subscription_id);
+
+// Blocks the caller (never the sampler) until num_samples have been summarized
+bool adc_sampler_collect_stats(uint32_t num_samples, float bias_voltage,
+                               sample_stats_t* stats, uint32_t timeout_ms);
+
+// Raw sample access (12-bit ADC counts from the ring)
+size_t adc_sampler_copy_recent(uint16_t* dest, size_t count);
+
+// Zero-copy access to the newest num_samples in the ring
+bool adc_sampler_freeze_window(uint32_t num_samples, sample_window_t* window);
+size_t adc_sampler_window_span(const sample_window_t* window, uint32_t offset,
+                               size_t max_count, const uint16_t** data);
+bool adc_sampler_window_intact(const sample_window_t* window);
+size_t adc_sampler_get_max_window_samples(void);
+
+// Diagnostics
+uint32_t adc_sampler_get_overrun_count(void);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef CALIBRATION_JOBS_H
+#define CALIBRATION_JOBS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lwip/sockets.h"
+
+// Measurement-based calibrations run on a worker task so the command receiver
+// never blocks on sample collection. Commands reply "<NAME>:QUEUED,JOB=<id>"
+// at once; the final "<NAME>:SUCCESS,...,JOB=<id>" is pushed to the requester
+// when the job finishes, and JOB_STATUS:<id> reports progress meanwhile.
+#define CAL_JOB_QUEUE_DEPTH 4
+#define CAL_JOB_HISTORY 8               // Finished jobs kept for JOB_STATUS
+#define CAL_JOB_RESULT_SIZE 96
+
+typedef enum {
+    CAL_JOB_ZERO = 0,                   // Bias voltage from a no-load measurement
+    CAL_JOB_SCALE,                      // Scale factor from a known load
+    CAL_JOB_AUTO_DETECT,                // Load measurement (feeds auto-calibration)
+    CAL_JOB_AUTO_RECOGNIZE              // Device recognition, may calibrate
+} cal_job_type_t;
+
+typedef enum {
+    CAL_JOB_QUEUED = 0,
+    CAL_JOB_RUNNING,
+    CAL_JOB_DONE,
+    CAL_JOB_FAILED
+} cal_job_state_t;
+
+// Creates the worker and registers the calibration commands
+esp_err_t calibration_jobs_init(void);
+
+// Returns the job id (never 0), or 0 when the queue is full. name is the
+// command that requested the job and prefixes every reply (static string)
+uint16_t calibration_job_submit(cal_job_type_t type, const char* name, float argument,
+                                int sock, const struct sockaddr_in* client_addr);
+
+// Progress of a queued, running or recently finished job; false if unknown
+bool calibration_job_get_status(uint16_t job_id, char* buffer, size_t buffer_size);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef COMMAND_DISPATCHER_H
+#define COMMAND_DISPATCHER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lwip/sockets.h"
+
+// Commands are "NAME" or "NAME:arg1,arg2,...". NAME is matched exactly against a
+// sorted registry (binary search), and arguments are parsed by type before the
+// handler runs. Argument spec characters:
+//   i = int32, u = uint32, f = float, s = string token
+// Characters after '?' are optional, e.g. "ii?i" takes two or three integers.
+#define MAX_COMMANDS 96
+#define CMD_MAX_ARGS 6
+#define CMD_ARG_BUFFER_SIZE 192
+
+typedef union {
+    int32_t i;
+    uint32_t u;
+    float f;
+    const char* s;
+} cmd_arg_t;
+
+typedef struct {
+    int count;
+    cmd_arg_t values[CMD_MAX_ARGS];
+    char buffer[CMD_ARG_BUFFER_SIZE];  // Backing storage for string arguments
+} cmd_args_t;
+
+// Who sent the command - for handlers that reply on their own
+typedef struct {
+    int sock;
+    struct sockaddr_in* client_addr;
+    int64_t received_us;    // esp_timer time the datagram arrived
+} cmd_context_t;
+
+// Writes the reply into response and returns its length; 0 means the handler
+// already replied itself (or there is nothing to send)
+typedef size_t (*cmd_handler_t)(const cmd_args_t* args, const cmd_context_t* ctx,
+                                char* response, size_t response_size);
+
+// Declares a handler with the standard signature
+#define CMD_HANDLER(fn) \
+    static size_t fn(const cmd_args_t* args, const cmd_context_t* ctx, \
+                     char* response, size_t response_size)
+
+typedef struct {
+    const char* name;
+    const char* arg_spec;   // NULL or "" for no arguments
+    cmd_handler_t handler;
+} command_def_t;
+
+// Tables must stay valid for the lifetime of the program (static const)
+esp_err_t command_register_table(const command_def_t* commands, size_t count);
+
+// Parses and runs one command; returns the response length written
+size_t command_dispatch(const char* command, const cmd_context_t* ctx,
+                        char* response, size_t response_size);
+
+// Same, restricted to one table (linear search) - for dedicated channels that
+// must not run anything else
+size_t command_dispatch_table(const command_def_t* commands, size_t count,
+                              const char* command, const cmd_context_t* ctx,
+                              char* response, size_t response_size);
+
+// Comma-separated list of registered command names
+size_t command_list(char* buffer, size_t buffer_size);
+
+// Helper for handlers: snprintf clamped to the buffer, returning the length written
+size_t cmd_reply(char* response, size_t response_size, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef DEVICE_LIBRARY_H
+#define DEVICE_LIBRARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "hardware_config.h"
+#include "device_signature.h"
+
+// Library of device signatures (device_signature.h) measured on this plug, recognised
+// by nearest match rather than by current range. Profiles live in RAM in their
+// compact stored form, indexed by steady current: a match is a binary search plus a
+// scan of the profiles within DEVLIB_INDEX_SCALES match scales. They persist in NVS,
+// DEVLIB_PAGE_PROFILES to a blob, so an edit rewrites only its own page.
+//   SIGNATURE_LEARN:<name>                            add (or refine) from the present load
+//   SIGNATURE_ADD:<name>,<amps>[,<inrush>[,<duty>]]   add from known values
+//   SIGNATURE_REMOVE:<id>
+//   SIGNATURES[:<first_id>]                           list, by id
+//   SIGNATURE_MATCH                                   present signature and its best match
+typedef struct {
+    uint16_t id;
+    char name[DEVLIB_NAME_LEN];
+    float steady_amps;          // The profile's
+    float confidence;           // exp(-d^2 / 2), d the RMS of the scaled feature differences
+} device_match_t;
+
+// Loads the stored profiles and registers the commands; call after nvs_flash_init
+esp_err_t device_library_init(void);
+
+// Signature of the present load. Harmonics come from an analysis of the steady
+// period, waiting up to wait_ms for one (0 = only if there already is one); false
+// with no load detector reading yet
+bool device_library_capture(device_signature_t* signature, uint32_t wait_ms);
+
+// Best match by confidence; false when no profile is within the index window
+bool device_library_match(const device_signature_t* signature, device_match_t* match);
+
+// Adds a profile - or, for a name already in the library, merges the observation
+// into it. Returns the id, or 0 when invalid or full
+uint16_t device_library_learn(const char* name, const device_signature_t* signature);
+bool device_library_remove(uint16_t id);
+int device_library_count(void);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef DEVICE_SIGNATURE_H
+#define DEVICE_SIGNATURE_H
+
+#include <math.h>
+#include "hardware_config.h"
+
+// A device signature and how far apart two are - the scoring behind the signature
+// library (device_library.h). A signature is the settled current, the inrush ratio,
+// the 3rd/5th/7th harmonic relative to the fundamental and the duty cycle of the last
+// on/off period. Unknown features are NAN and are left out of the distance.
+#define DEVLIB_HARMONIC_FEATURES 3      // 3rd, 5th and 7th
+
+typedef struct {
+    float steady_amps;
+    float inrush_ratio;         // Peak cycle RMS over steady, from the rise that reached it
+    float harmonic_ratio[DEVLIB_HARMONIC_FEATURES];  // Relative to the fundamental
+    float duty_cycle;           // 0-1
+} device_signature_t;
+
+// All features unknown but the steady current
+void device_signature_init(device_signature_t* signature, float steady_amps);
+
+// Mean squared difference over the features both signatures have, each in units of
+// its DEVLIB_*_SCALE; steady_scale is the steady-current difference that counts as one
+float device_signature_distance(const device_signature_t* a, const device_signature_t* b,
+                                float steady_scale);
+
+// exp(-d^2 / 2), d the RMS of the scaled feature differences
+static inline float device_signature_confidence(float distance) {
+    return expf(-0.5f * distance);
+}
+
+#endif
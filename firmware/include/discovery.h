@@ -0,0 +1,22 @@
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <stddef.h>
+#include "esp_err.h"
+
+// Device identity for dashboards managing many plugs. The announce line is
+//   ANNOUNCE:ID=<mac>,FW=<version>,PROTO=<telemetry version>,CAPS=<a|b|...>,
+//            IP=<address>,CMD_PORT=<n>,RELAY_PORT=<n>,UPTIME_S=<n>
+// where ID is the station MAC in hex - stable across reboots and DHCP changes.
+// The sender broadcasts it as the discovery beacon, and DISCOVER answers it
+// directly to the asking host.
+
+// Reads the MAC and registers DISCOVER; call before the sender and receiver start
+esp_err_t discovery_init(void);
+
+const char* discovery_device_id(void);
+
+// Writes the announce line; returns its length
+size_t discovery_format_announce(char* buffer, size_t buffer_size);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Energy is integrated from every mains cycle's RMS current (at LINE_VOLTAGE_RMS)
+// into micro-watt-hour counters, so no cycle between telemetry packets is missed.
+// Hourly and daily buckets are indexed by accumulated on-time, which survives
+// reboots with the counters; there is no wall clock on the device.
+//   ENERGY_STATS          totals, current hour/day and the bucket history
+//   ENERGY_RESET[:ALL]    clears the since-reset counter and buckets (ALL: lifetime too)
+// The state is checkpointed to NVS at most every ENERGY_CHECKPOINT_MIN_S, and only
+// once ENERGY_CHECKPOINT_MIN_WH has accumulated (or ENERGY_CHECKPOINT_MAX_S passed).
+
+// Restores the NVS checkpoint and subscribes to the RMS cycle stream; call after
+// rms_engine_init and nvs_flash_init
+esp_err_t energy_init(void);
+
+// Writes the checkpoint now if anything changed (e.g. before a restart)
+void energy_checkpoint(void);
+
+double energy_get_total_wh(void);
+void energy_get_stats(char* buffer, size_t buffer_size);
+
+#endif
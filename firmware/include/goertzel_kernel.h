@@ -0,0 +1,36 @@
+#ifndef GOERTZEL_KERNEL_H
+#define GOERTZEL_KERNEL_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Fixed-point Goertzel filter bank on AC samples in scaled counts (rms_kernel.h).
+// Coefficients are 2*cos(w) in Q20, which keeps a mains-frequency filter within
+// ~0.01 Hz of its target; the states stay in 32 bits for PQ_MAX_WINDOW_CYCLES and
+// the products in 64.
+#define GOERTZEL_COEFF_BITS 20
+
+static inline int32_t goertzel_coefficient(float w) {
+    return (int32_t)lrintf(2.0f * cosf(w) * (1 << GOERTZEL_COEFF_BITS));
+}
+
+// One sample into every filter of the bank
+static inline void goertzel_bank_step(int32_t *s1, int32_t *s2, const int32_t *coefficients,
+                                      int count, int32_t x) {
+    for (int h = 0; h < count; h++) {
+        int32_t s0 = x + (int32_t)(((int64_t)coefficients[h] * s1[h]) >> GOERTZEL_COEFF_BITS) - s2[h];
+        s2[h] = s1[h];
+        s1[h] = s0;
+    }
+}
+
+// |X|^2 = s1^2 + s2^2 - coeff*s1*s2, exact in 64 bits
+static inline int64_t goertzel_power(int32_t coefficient, int32_t s1, int32_t s2) {
+    int64_t a = s1;
+    int64_t b = s2;
+    int64_t cross = (((int64_t)coefficient * a) >> GOERTZEL_COEFF_BITS) * b;
+    int64_t power = a * a + b * b - cross;
+    return power > 0 ? power : 0;
+}
+
+#endif
@@ -1,15 +1,135 @@
 #ifndef HARDWARE_CONFIG_H
 #define HARDWARE_CONFIG_H
 
+#ifndef NATIVE_BUILD                      // Host builds of the pure stages (env:native)
 #include "driver/gpio.h"
 #include "esp_adc/adc_oneshot.h"
+#endif
 
+#define FIRMWARE_VERSION "3.1"
 #define RELAY_GPIO GPIO_NUM_27
 #define UDP_SEND_PORT 3333
 #define UDP_RECV_PORT 3334
+#define UDP_RELAY_PORT 3335                   // Relay-only control channel
 #define WIFI_CREDENTIALS_PORT 4567
 
+// Telemetry settings
+#define TELEMETRY_DEFAULT_INTERVAL_MS 2000
+#define TELEMETRY_MIN_INTERVAL_MS 100         // At least one RMS window
+#define TELEMETRY_MAX_SUBSCRIBERS 4           // Unicast destinations (SUBSCRIBE)
+#define TELEMETRY_LEASE_DEFAULT_S 60          // Subscribers renew before this runs out
+#define TELEMETRY_LEASE_MAX_S 3600
+#define TELEMETRY_DISCOVERY_ADDR "255.255.255.255"
+#define TELEMETRY_DISCOVERY_INTERVAL_MS 10000 // Broadcast beacon while nobody is subscribed
+#define TELEMETRY_ANNOUNCE_INTERVAL_MS 60000  // ...and while subscribed, for dashboards joining later
+#define TELEMETRY_STATUS_LOAD_DEADBAND_AMPS 0.05f  // Detected-load moves that resend the calibration frame
+#define LINE_VOLTAGE_RMS 120.0f               // Assumed mains voltage for power calculation
+
+// Overcurrent protection (runs in the sampler task, opens the relay without the network)
+#define PROTECTION_PEAK_AMPS MAX_CURRENT_AMPS         // Instantaneous trip level
+#define PROTECTION_PEAK_CONFIRM_SAMPLES 2             // Consecutive samples over the peak (~330 us)
+#define PROTECTION_RATED_AMPS 15.0f                   // Continuous rating; I2t builds above this
+#define PROTECTION_I2T_LIMIT_A2S 6750.0f              // Trips in 10 s at twice rated: (30^2 - 15^2) * 10
+#define PROTECTION_DEVICE_MARGIN 1.25f                // Device profile max current -> rated current
+#define PROTECTION_TRIP_HISTORY 4
+
+// Energy accounting (integrated per mains cycle, checkpointed to NVS)
+#define ENERGY_NOISE_FLOOR_AMPS 0.05f                 // Cycles below this add no energy
+#define ENERGY_HOURLY_BUCKETS 24
+#define ENERGY_DAILY_BUCKETS 7
+#define ENERGY_CHECKPOINT_MIN_WH 5.0f                 // Change that warrants a flash write...
+#define ENERGY_CHECKPOINT_MIN_S (5 * 60)              // ...but no more often than this
+#define ENERGY_CHECKPOINT_MAX_S (60 * 60)             // Smaller changes are written this often
+
+// On-device history (RAM rings of min/max/avg current per bucket)
+#define HISTORY_SECONDS 3600                          // Last hour at 1 s
+#define HISTORY_MINUTES 1440                          // Last day at 1 min
+
+// Load change events (CUSUM on the per-cycle RMS current, run in the sampler task)
+#define LOAD_EVENT_MIN_STEP_AMPS 0.1f                 // Smallest change reported...
+#define LOAD_EVENT_RELATIVE_STEP 0.05f                // ...plus this fraction of the present level
+#define LOAD_EVENT_CUSUM_LIMIT 0.5f                   // Accumulated excess (A x cycles) declaring a change
+#define LOAD_EVENT_BASELINE_ALPHA 0.02f               // Per-cycle EMA of the steady level
+#define LOAD_EVENT_SETTLE_CYCLES 30                   // Inrush window after a change (0.5 s at 60 Hz)...
+#define LOAD_EVENT_LEVEL_CYCLES 10                    // ...whose last cycles give the new level
+#define LOAD_EVENT_OFF_AMPS ENERGY_NOISE_FLOOR_AMPS   // Below this the outlet counts as off
+#define LOAD_EVENT_HISTORY 8
+
+// Power-aware scheduling (power_scheduler.h) - idle plugs report less and let WiFi sleep
+#define POWER_IDLE_AMPS AUTO_CAL_ZERO_THRESHOLD       // Cycles below this are idle...
+#define POWER_IDLE_HOLD_MS 30000                      // ...once they have been for this long (relay open: at once)
+#define TELEMETRY_IDLE_INTERVAL_MS 30000              // Heartbeat cadence of every subscriber while idle
+#define POWER_IDLE_CPU_MHZ 80                         // Lowest clock while idle, with CONFIG_PM_ENABLE
+
+// Task topology - the measurement path and relay actuation own APP_CPU, everything
+// that touches the network, flash or a client request (the relay channel included)
+// runs on PRO_CPU next to WiFi/lwIP. Data moves between the cores through queues,
+// not shared globals.
+#if CONFIG_FREERTOS_UNICORE
+#define SAMPLING_CORE 0
+#else
+#define SAMPLING_CORE 1                       // APP_CPU: sampler, RMS engine, protection, relay actuator
+#endif
+#define NETWORK_CORE 0                        // PRO_CPU: sockets, commands, calibration workers
+#define RELAY_TASK_PRIORITY 10                // Actuator only: above the sampler (8), short and rare
+#define RELAY_TASK_CORE SAMPLING_CORE         // Away from the WiFi/lwIP load on PRO_CPU
+#define SAMPLER_TASK_PRIORITY 8               // Above every network task so DMA frames drain promptly
+#define PROTECT_REPORT_TASK_PRIORITY 6
+#define POWER_SCHED_TASK_PRIORITY 6           // Ahead of the sender, so a wake applies before it reports
+#define RELAY_CHANNEL_TASK_PRIORITY 5         // relay_rx/relay_tx, NETWORK_CORE
+#define UDP_SENDER_TASK_PRIORITY 5
+#define UDP_STREAM_TASK_PRIORITY 5
+#define WIFI_CREDENTIALS_TASK_PRIORITY 5
+#define UDP_RECEIVER_TASK_PRIORITY 4
+#define STARTUP_CAL_TASK_PRIORITY 4
+#define CAL_JOBS_TASK_PRIORITY 3
+#define AUTO_CAL_TASK_PRIORITY 3
+#define LOAD_EVENT_TASK_PRIORITY 3
+#define CAL_STORE_TASK_PRIORITY 2
+#define ENERGY_TASK_PRIORITY 2
+#define AUTO_CAL_QUEUE_DEPTH 16               // Load changes buffered for the auto-calibration task
+
+// Stacks of the long-lived (statically allocated) tasks, in bytes. Retune against the
+// high-water marks MEM_STATS reports, keeping ~1 KB of headroom for logging paths
+#define SAMPLER_TASK_STACK 4096
+#define UDP_RECEIVER_TASK_STACK 5120          // Replies and the receive buffer live off the stack
+#define UDP_SENDER_TASK_STACK 4096
+#define UDP_STREAM_TASK_STACK 3072
+#define CAL_JOBS_TASK_STACK 4096
+#define AUTO_CAL_TASK_STACK 4096              // Heap-allocated: ends when disabled, restarted on enable
+#define CAL_STORE_TASK_STACK 3072             // NVS writes
+#define LOAD_EVENT_TASK_STACK 3072
+#define ENERGY_TASK_STACK 3072
+#define PQ_TASK_STACK 3072
+#define PROTECT_REPORT_TASK_STACK 3072
+#define RELAY_TASK_STACK 3072
+#define RELAY_CHANNEL_TASK_STACK 3072
+#define TEMP_COMP_TASK_STACK 3072
+#define POWER_SCHED_TASK_STACK 3072
+
+// Shared network buffers (net_buffers.h) - command replies and telemetry datagrams
+#define NET_BUFFER_COUNT 4
+#define NET_BUFFER_SIZE 1024
+#define NET_BUFFER_WAIT_MS 50                 // A sender gives up on the datagram after this
+
+// Power quality (Goertzel bank over the sample ring)
+#define PQ_HARMONICS 15                       // Fundamental through the 15th
+#define PQ_WINDOW_CYCLES 10                   // Default analysis window
+#define PQ_MAX_WINDOW_CYCLES 30
+#define PQ_DEFAULT_INTERVAL_MS 5000           // Analysis and publish cadence
+#define PQ_MIN_INTERVAL_MS 200
+#define PQ_MIN_FUNDAMENTAL_AMPS 0.05f         // THD is reported as 0 below this
+#define PQ_TASK_PRIORITY 2
+#define PQ_REFRESH_POLL_MS 20                 // Result poll while waiting for a requested analysis
+
+// Relay control path
+#define RELAY_QUEUE_DEPTH 8
+#define RELAY_REPLY_QUEUE_DEPTH 16            // A request can owe two replies: its own and a cancelled RELAY_TIMED
+#define RELAY_TIMED_MAX_MS (24UL * 60 * 60 * 1000)
+#define RELAY_CONDITION_POLL_MS 20            // Current check period for conditional timed switching
+
 #define ENABLE_LOGGING 1
+#define ENABLE_PERF_MONITOR 1                 // Hot-path timing probes and PERF_STATS (0 compiles them out)
 #define USE_CUSTOM_CALIBRATION 0
 
 #if USE_CUSTOM_CALIBRATION
@@ -25,6 +145,21 @@
 #define ADC_BIAS_VOLTAGE 1.65f                // Half of 3.3V for AC coupling
 #define MAX_CURRENT_AMPS 100.0f
 
+// Continuous (DMA) sampling settings
+#define ADC_SAMPLE_RATE_HZ 24000              // Raw conversion rate (ESP32 minimum is 20 kHz)
+#define ADC_DECIMATION 4                      // Raw conversions averaged into one output sample
+#define ADC_OUTPUT_RATE_HZ (ADC_SAMPLE_RATE_HZ / ADC_DECIMATION)  // 6 kHz
+#define ADC_BLOCK_SAMPLES 120                 // Output samples per ring block (20 ms)
+#define ADC_RING_BLOCKS 64                    // Blocks kept in the sample ring (~1.3 s)
+#define MAINS_FREQUENCY_HZ 60                 // Nominal line frequency
+#define SAMPLES_PER_CYCLE (ADC_OUTPUT_RATE_HZ / MAINS_FREQUENCY_HZ)
+#define RMS_WINDOW_CYCLES 3                   // Whole cycles per published RMS window (50 ms at 60 Hz)
+
+// Zero-crossing synchronization of RMS cycles
+#define ZC_HYSTERESIS_COUNTS 12               // AC must swing below -this before a crossing arms
+#define ZC_MIN_LINE_HZ 40                     // Accepted line frequency range (covers 50/60 Hz)
+#define ZC_MAX_LINE_HZ 70
+
 // SCT-013-000 Sensor Configuration
 #define SCT_013_BURDEN_RESISTOR 10.0f         // Your 10Ω burden resistor
 #define SCT_013_MAX_SECONDARY_CURRENT 0.05f   // 50mA maximum
@@ -35,22 +170,61 @@
 // Auto-calibration settings
 #define AUTO_CAL_ENABLED 1
 #define AUTO_CAL_ZERO_INTERVAL_MS (30 * 60 * 1000)  // 30 minutes
-#define AUTO_CAL_MIN_STABLE_READINGS 100             // ~3 minutes at 2s intervals
-#define AUTO_CAL_VARIANCE_THRESHOLD 0.1f             // Current stability threshold
 #define AUTO_CAL_MIN_CURRENT 0.5f                    // Minimum current for scale calibration
 #define AUTO_CAL_MAX_CURRENT 15.0f                   // Maximum current for scale calibration
 #define AUTO_CAL_ZERO_THRESHOLD 0.05f                // Below this = zero current
-#define AUTO_CAL_CONSECUTIVE_ZERO_COUNT 150          // Readings before zero recalibration
+#define AUTO_CAL_ZERO_HOLD_MS (5 * 60 * 1000)        // No load and no change this long before zero recalibration
+#define AUTO_CAL_ZERO_MIN_DRIFT_V 0.001f             // Tracked DC this far from the bias before zero recalibration
+#define AUTO_CAL_CHECK_INTERVAL_MS 60000             // Periodic checks between load events
 
 // Learning parameters
 #define ENABLE_CALIBRATION_LEARNING 1
-#define MAX_LEARNING_POINTS 50
-#define LEARNING_CONFIDENCE_DECAY 0.95f              // Older points become less important
+#define LEARNING_CONFIDENCE_DECAY 0.95f              // Daily forgetting on top of the learning rate's
 #define MIN_LEARNING_POINTS 3                        // Minimum points before learning kicks in
+#define LEARNING_GAIN_PRIOR_RSD 0.5f                 // Prior scale uncertainty, relative to the starting scale
+#define LEARNING_OFFSET_PRIOR_AMPS 0.1f              // Prior offset uncertainty - identifies the scale from one level
+#define LEARNING_NOISE_AMPS 0.05f                    // Uncertainty of a full-confidence calibration point
+#define LEARNING_MAX_GAIN_RSD 0.05f                  // The learned scale is applied once this certain
+
+// Calibration persistence (NVS)
+#define CAL_SAVE_SETTLE_MS 2000                      // Coalesce a burst of changes into one write
+#define CAL_SAVE_MIN_INTERVAL_MS (60 * 1000)         // At most one calibration write per minute
+#define CAL_SAVE_MIN_BIAS_DELTA_V 0.0005f            // Smaller calibration drift is not rewritten
+#define CAL_SAVE_MIN_SCALE_DELTA 0.001f              // Relative scale change worth a write
+
+// Temperature compensation - learned bias and scale per temperature bin
+#define ENABLE_TEMP_COMPENSATION 1
+#define TEMP_COMP_SAMPLE_MS 10000                    // Sensor read and correction interval
+#define TEMP_COMP_MIN_C -10.0f                       // Lower edge of the first bin
+#define TEMP_COMP_BIN_C 5.0f
+#define TEMP_COMP_BINS 20                            // -10 to 90 C
+#define TEMP_COMP_ALPHA 0.1f                         // EMA weight of an observation in its bin
+#define TEMP_COMP_MIN_OBSERVATIONS 3                 // Before a bin is used for correction
+#define TEMP_COMP_BIAS_SETTLE_MS 60000               // Steady load this long before the DC level is learned
+#define TEMP_COMP_BIAS_MAX_AMPS 5.0f                 // Learn the DC level only well inside the ADC range
+#define TEMP_COMP_MIN_BIAS_STEP_V 0.001f             // Smaller corrections are not published
+#define TEMP_COMP_MIN_SCALE_STEP 0.002f              // Relative
+#define TEMP_COMP_EXTERNAL_TIMEOUT_MS (5 * 60 * 1000)  // An external reading replaces the on-chip one this long
+#define TEMP_COMP_SAVE_INTERVAL_MS (30 * 60 * 1000)  // Learned table writes at most this often
+#define TEMP_COMP_TASK_PRIORITY 1
 
 // Device recognition thresholds
 #define ENABLE_DEVICE_RECOGNITION 1
+#define MAX_CUSTOM_DEVICES 8
+#define CUSTOM_DEVICE_NAME_LEN 24
 #define DEVICE_RECOGNITION_CONFIDENCE 0.9f           // How certain we need to be
-#define DEVICE_STABLE_TIME_MS (3 * 60 * 1000)       // 3 minutes of stable operation
+#define DEVICE_STABLE_TIME_MS (3 * 60 * 1000)       // 3 minutes without a load change
+
+// Device signature library (profiles measured on this plug, kept in NVS)
+#define DEVLIB_MAX_PROFILES 256
+#define DEVLIB_PAGE_PROFILES 16                      // Profiles per NVS blob - one small rewrite per edit
+#define DEVLIB_NAME_LEN 16
+#define DEVLIB_MIN_SPREAD_AMPS 0.05f                 // Steady-current match scale: at least this...
+#define DEVLIB_RELATIVE_SPREAD 0.05f                 // ...and this fraction of the current
+#define DEVLIB_INRUSH_SCALE 0.5f                     // Feature differences that count as one unit
+#define DEVLIB_HARMONIC_SCALE 0.05f
+#define DEVLIB_DUTY_SCALE 0.1f
+#define DEVLIB_INDEX_SCALES 3.0f                     // Candidates within this many steady-current scales
+#define DEVLIB_HARMONIC_WAIT_MS 500                  // Wait for a fresh harmonic analysis on a load change
 
 #endif
\ No newline at end of file
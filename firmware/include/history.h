@@ -0,0 +1,19 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// On-device time series of the per-cycle current, so a dashboard that was away can
+// backfill instead of depending on uninterrupted streaming. Two fixed RAM rings keep
+// min/max/avg per bucket: HISTORY_SECONDS at 1 s and HISTORY_MINUTES at 1 min.
+//   HISTORY:<from_ms>,<to_ms>[,<resolution_s>]
+// Times are device uptime (the telemetry header clock); to_ms = 0 means now.
+// resolution_s is 1-59 (from the 1 s ring) or a multiple of 60 up to the 1 min ring's
+// span (HISTORY_MINUTES * 60); 0 or omitted picks 1 s when the range is still in the
+// 1 s ring. The reply is HISTORY:START, TELEMETRY_FRAME_HISTORY frames, then HISTORY:COMPLETE.
+
+// Subscribes to the RMS cycle stream and registers HISTORY; call after rms_engine_init
+esp_err_t history_init(void);
+
+#endif
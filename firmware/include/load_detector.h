@@ -0,0 +1,78 @@
+#ifndef LOAD_DETECTOR_H
+#define LOAD_DETECTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The load change detector itself, free of RTOS and driver dependencies: fed one
+// per-cycle RMS current at a time, it reports the steady level and settled changes.
+// Two one-sided CUSUM sums run against an EMA of the steady level; when one crosses
+// the limit the change is dated to the cycle its sum left zero, and the next
+// LOAD_EVENT_SETTLE_CYCLES give the peak and the new level. load_events.c runs it in
+// the sampler task.
+typedef enum {
+    LOAD_EVENT_ON = 1,      // From below LOAD_EVENT_OFF_AMPS
+    LOAD_EVENT_OFF,         // To below LOAD_EVENT_OFF_AMPS
+    LOAD_EVENT_STEP         // Between two running levels
+} load_event_type_t;
+
+typedef enum {
+    LOAD_DETECT_NONE = 0,
+    LOAD_DETECT_SEEDED,     // First cycle after a restart - a new level, steady from now
+    LOAD_DETECT_REJECTED,   // Settled back within the step - a new level, steady period continues
+    LOAD_DETECT_CHANGE      // A change settled; steady from its onset
+} load_detect_result_t;
+
+typedef struct {
+    load_event_type_t type;
+    float before_amps;
+    float after_amps;
+    float peak_amps;
+    float inrush_ratio;     // Peak over the new level for a rise, NAN for a fall
+    int64_t onset_us;
+    uint16_t detect_cycles; // Onset to the limit crossing
+} load_change_t;
+
+typedef enum {
+    LOAD_DETECTOR_SEEDING = 0,  // No cycle since the last restart
+    LOAD_DETECTOR_STEADY,       // CUSUM against the baseline
+    LOAD_DETECTOR_SETTLING      // Change declared, measuring the new level
+} load_detector_state_t;
+
+typedef struct {
+    // Configuration - may change between cycles
+    float min_step_amps;
+    float cusum_limit;
+
+    load_detector_state_t state;
+    float baseline;
+    float sum_up;
+    float sum_down;
+    uint32_t up_onset_index, down_onset_index;
+    int64_t up_onset_us, down_onset_us;
+    float up_peak, down_peak;
+
+    // Change being settled
+    float settle_before;
+    float settle_peak;
+    float settle_sum;
+    uint32_t settle_cycles;
+    int64_t settle_onset_us;
+    uint16_t settle_detect_cycles;
+
+    uint32_t false_alarms;
+} load_detector_t;
+
+void load_detector_init(load_detector_t *detector, float min_step_amps, float cusum_limit);
+
+// The next cycle seeds a new level (e.g. after a calibration rescaled every reading)
+void load_detector_restart(load_detector_t *detector);
+
+// change is written for LOAD_DETECT_CHANGE only
+load_detect_result_t load_detector_feed(load_detector_t *detector, float amps, uint32_t cycle_index,
+                                        int64_t timestamp_us, load_change_t *change);
+
+// Smallest change worth reporting at a given level - larger loads fluctuate more
+float load_detector_step_threshold(const load_detector_t *detector, float level);
+
+#endif
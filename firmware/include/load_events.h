@@ -0,0 +1,38 @@
+#ifndef LOAD_EVENTS_H
+#define LOAD_EVENTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "load_detector.h"
+
+// Load change detection on the per-cycle RMS current. The detector (load_detector.h)
+// runs in the sampler task; each settled change goes to auto-calibration and the
+// telemetry subscribers (TELEMETRY_FRAME_LOAD_EVENT or a LOAD_EVENT: text line).
+//   LOAD_EVENTS                                detector state and recent events, newest first
+//   LOAD_EVENT_CONFIG:<min_step_amps>[,<limit>] smallest reported change, CUSUM limit (A x cycles)
+// A calibration change rescales every reading, so it restarts the detector instead.
+
+// The present steady level and what is known about how it was reached
+typedef struct {
+    float amps;
+    uint32_t steady_ms;     // Since the last event or detector restart
+    float inrush_ratio;     // Peak cycle RMS over the level for the rise that reached it,
+                            // NAN after a fall or when no event led here. Kept across a
+                            // calibration restart - a ratio does not rescale
+    float duty_cycle;       // On share of the last complete on/off period, NAN before one
+} load_state_t;
+
+// Subscribes to the RMS cycle stream and starts the reporter; call after rms_engine_init
+esp_err_t load_events_init(void);
+
+// Steady level and how long it has held (since the last event or detector restart);
+// false until the detector has seen a cycle
+bool load_events_get_level(float* amps, uint32_t* steady_ms);
+bool load_events_get_state(load_state_t* state);
+
+bool load_events_configure(float min_step_amps, float cusum_limit);
+void load_events_get_status(char* buffer, size_t buffer_size);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef NET_BUFFERS_H
+#define NET_BUFFERS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "hardware_config.h"
+
+// Preallocated buffers for building command replies and telemetry datagrams, shared
+// by the network tasks instead of a kilobyte on each task's stack. A buffer is held
+// for one datagram; acquire waits up to the given ticks for one to come back.
+typedef struct {
+    unsigned count;
+    unsigned in_use;
+    unsigned peak_in_use;
+    uint32_t misses;        // Acquires that timed out
+} net_buffer_stats_t;
+
+// Call before any network task starts
+esp_err_t net_buffers_init(void);
+
+// NET_BUFFER_SIZE bytes, or NULL if none was free in time
+char* net_buffer_acquire(TickType_t wait);
+void net_buffer_release(char* buffer);
+
+void net_buffers_get_stats(net_buffer_stats_t* stats);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef PERF_MONITOR_H
+#define PERF_MONITOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hardware_config.h"
+
+// Named timing probes - keep perf_probe_names[] in perf_monitor.c in the same order
+typedef enum {
+    PERF_PROBE_MEASURE_RMS = 0,     // measure_rms_current, excluding the wait for a window
+    PERF_PROBE_UDP_COMMAND,         // process_udp_command
+    PERF_PROBE_AUTO_CAL,            // Auto-calibration work for one load change
+    PERF_PROBE_TELEMETRY_SEND,      // sendto of telemetry and stream frames
+    PERF_PROBE_BLOCK_DISPATCH,      // All subscribers for one sample block
+    PERF_PROBE_BLOCK_JITTER,        // |block interval - nominal|, recorded in microseconds
+    PERF_PROBE_RELAY_LATENCY,       // Relay command arrival to pin write, in microseconds
+    PERF_PROBE_POWER_QUALITY,       // Goertzel bank over one analysis window
+    PERF_PROBE_COUNT
+} perf_probe_id_t;
+
+#define PERF_MAX_TASKS 16
+
+#if ENABLE_PERF_MONITOR
+
+#include "esp_timer.h"
+
+void perf_monitor_init(void);
+void perf_monitor_record_us(perf_probe_id_t probe, uint32_t microseconds);
+void perf_monitor_register_current_task(void);
+void perf_monitor_reset(void);
+void perf_monitor_format(char* buffer, size_t buffer_size);
+
+// esp_timer timing, which frequency scaling does not skew (and which holds across
+// cores, unlike the cycle counter); a probe's BEGIN and END must sit in the same scope
+#define PERF_BEGIN(probe) int64_t perf_start_##probe = esp_timer_get_time()
+#define PERF_END(probe) \
+    perf_monitor_record_us(probe, (uint32_t)(esp_timer_get_time() - perf_start_##probe))
+#define PERF_RECORD_US(probe, us) perf_monitor_record_us(probe, us)
+#define PERF_REGISTER_TASK() perf_monitor_register_current_task()
+
+#else
+
+#define perf_monitor_init() do { } while (0)
+#define PERF_BEGIN(probe) do { } while (0)
+#define PERF_END(probe) do { } while (0)
+#define PERF_RECORD_US(probe, us) do { } while (0)
+#define PERF_REGISTER_TASK() do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef POWER_QUALITY_H
+#define POWER_QUALITY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "hardware_config.h"
+
+// Harmonic analysis of the load current: a bank of fixed-point Goertzel filters, one
+// per harmonic of the measured line frequency, run over a whole number of cycles
+// read zero-copy from the sampler ring - the sampler itself does no extra work.
+// Results go to the telemetry subscribers every interval as TELEMETRY_FRAME_HARMONICS
+// (or a HARMONICS: text line).
+//   PQ_STATUS                          latest analysis, with its CPU cost
+//   PQ_CONFIG:<interval_ms>[,<cycles>] cadence (0 = off) and window length
+
+typedef struct {
+    uint32_t sequence;              // Analyses since boot
+    uint32_t timestamp_ms;          // Uptime when the window ended
+    float fundamental_hz;
+    float rms_amps;                 // Over the same window, all frequencies
+    float thd_percent;              // 0 when the fundamental is below PQ_MIN_FUNDAMENTAL_AMPS
+    uint16_t window_samples;
+    uint8_t harmonic_count;
+    float harmonic_amps[PQ_HARMONICS];  // RMS of harmonic 1..harmonic_count
+    uint32_t analysis_us;
+} pq_result_t;
+
+// Starts the analysis task and registers the PQ commands; call after the sampler runs
+esp_err_t power_quality_init(void);
+
+bool power_quality_get_latest(pq_result_t* result);
+
+// Latest result if it ends at or after newer_than_ms (uptime); otherwise asks for an
+// analysis now and waits up to timeout_ms for it. Blocks - not for the sampler task
+bool power_quality_refresh(uint32_t newer_than_ms, pq_result_t* result, uint32_t timeout_ms);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef POWER_SCHEDULER_H
+#define POWER_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Power-aware scheduling. While the relay is open, or every cycle has stayed below
+// POWER_IDLE_AMPS for POWER_IDLE_HOLD_MS, the plug is idle: telemetry drops to the
+// TELEMETRY_IDLE_INTERVAL_MS heartbeat, periodic power quality analysis pauses, WiFi
+// uses modem sleep and, with CONFIG_PM_ENABLE, the CPU clock may fall to
+// POWER_IDLE_CPU_MHZ. Sampling itself keeps its rate - the continuous ADC does not
+// run below 20 kHz, and protection and the load detector need every cycle - so the
+// first cycle over the threshold, or the relay closing, wakes the plug at once.
+//   POWER_STATUS       mode, idle time, wake count and latency
+//   POWER_SAVE:<0|1>   adaptive scheduling, or always active
+
+// Subscribes to the RMS cycle stream and starts the scheduler task; call after rms_engine_init
+esp_err_t power_scheduler_init(void);
+
+// True while the idle settings are in effect
+bool power_scheduler_is_idle(void);
+
+// Disabled keeps the plug active whatever the load
+void power_scheduler_set_enabled(bool enabled);
+void power_scheduler_get_status(char* buffer, size_t buffer_size);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef PROTECTION_H
+#define PROTECTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Overcurrent protection on the continuous sample stream. Both curves are evaluated
+// in the sampler task and open the relay there, without the network:
+//   peak - |instantaneous current| above peak_amps for PROTECTION_PEAK_CONFIRM_SAMPLES
+//          consecutive samples (checked for every ring block)
+//   I2t  - per-cycle RMS current heats an accumulator above rated_amps and cools it
+//          below; the relay opens when the accumulator reaches i2t_limit_a2s
+// A trip latches the relay open until PROTECT_RESET, and its record is broadcast.
+typedef enum {
+    PROTECTION_TRIP_NONE = 0,
+    PROTECTION_TRIP_PEAK,
+    PROTECTION_TRIP_I2T
+} protection_trip_cause_t;
+
+typedef struct {
+    float peak_amps;        // 0 disables the instantaneous curve
+    float rated_amps;       // Continuous rating
+    float i2t_limit_a2s;    // 0 disables the I2t curve
+} protection_limits_t;
+
+// Subscribes to the sampler and RMS engine; call after rms_engine_init
+esp_err_t protection_init(void);
+
+bool protection_set_limits(const protection_limits_t* limits);
+void protection_get_limits(protection_limits_t* limits);
+bool protection_is_tripped(void);
+void protection_reset(void);  // Re-arms and clears the relay lockout (relay stays open)
+
+void protection_get_status(char* buffer, size_t buffer_size);
+
+#endif
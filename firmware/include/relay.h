@@ -6,6 +6,11 @@
 void relay_init(void);
 void relay_toggle(void);
 bool relay_get_state(void);
-void relay_set_state(bool state);
+bool relay_set_state(bool state);  // false if not initialized or closing while locked out
+
+// Protection lockout - after relay_trip() the relay can only open until cleared
+void relay_trip(void);
+void relay_clear_lockout(void);
+bool relay_is_locked_out(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef RELAY_CONTROL_H
+#define RELAY_CONTROL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "command_dispatcher.h"
+
+// Relay commands are executed by one high-priority task pinned to RELAY_TASK_CORE,
+// so switching never waits behind diagnostics. They arrive on the shared command
+// port or on the relay-only UDP_RELAY_PORT, which nothing else can delay. Receiving,
+// parsing and replying run on NETWORK_CORE below the sampler, so datagrams reach the
+// actuator through a queue and replies leave through another.
+//   RELAY_ON, RELAY_OFF, RELAY_TOGGLE
+//   RELAY_TIMED:<state>,<duration_ms>[,<max_amps>]  switch, then revert after the
+//       duration; with max_amps the relay opens early if the load exceeds it.
+//       The requester gets RELAY_TIMED:COMPLETE,REASON=EXPIRED|OVERCURRENT|CANCELLED|TRIPPED
+//   RELAY_STATS  actuation latency (datagram arrival to pin write)
+typedef enum {
+    RELAY_CMD_ON = 0,
+    RELAY_CMD_OFF,
+    RELAY_CMD_TOGGLE,
+    RELAY_CMD_TIMED
+} relay_command_t;
+
+// Starts the relay task and channel, and registers the relay commands
+esp_err_t relay_control_start(void);
+
+// Queues a command for the relay task, whose reply goes to ctx once it has switched
+bool relay_control_request(relay_command_t command, bool state, uint32_t duration_ms,
+                           float max_amps, const cmd_context_t* ctx);
+
+void relay_control_get_stats(char* buffer, size_t buffer_size);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef RLS_ESTIMATOR_H
+#define RLS_ESTIMATOR_H
+
+#include <stdint.h>
+
+// Recursive weighted least squares for y = gain * x + offset with exponential
+// forgetting: O(1) per observation and constant memory. The state is the two
+// parameters and their 2x2 covariance, in the units of the parameters (the update is
+// a Kalman step with the parameter uncertainty inflated by 1/forgetting). Forgetting
+// only inflates directions the data keeps informing; the covariance diagonal is capped
+// at the prior, so a direction the observations never separate (every point at the
+// same x) does not wind up while it goes unobserved.
+typedef struct {
+    float gain;
+    float offset;
+    float p_gain;           // var(gain)
+    float p_cross;          // cov(gain, offset)
+    float p_offset;         // var(offset)
+    float p_gain_max;       // Prior variances - the cap
+    float p_offset_max;
+    float weight;           // Forgotten observation count (effective points)
+    uint32_t updates;
+} rls_estimator_t;
+
+void rls_init(rls_estimator_t *rls, float gain, float gain_sd, float offset, float offset_sd);
+
+// noise_variance is the variance of y for this observation; forgetting (0-1] discounts
+// everything learned before it
+void rls_update(rls_estimator_t *rls, float x, float y, float noise_variance, float forgetting);
+
+float rls_gain_sd(const rls_estimator_t *rls);
+float rls_offset_sd(const rls_estimator_t *rls);
+float rls_correlation(const rls_estimator_t *rls);  // Of the gain and offset errors
+
+#endif
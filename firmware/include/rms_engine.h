@@ -0,0 +1,54 @@
+#ifndef RMS_ENGINE_H
+#define RMS_ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// RMS result over a whole number of mains cycles
+typedef struct {
+    float vrms;             // AC RMS voltage (bias removed)
+    float last_cycle_vrms;  // RMS of the most recent single cycle
+    uint32_t cycles;        // Mains cycles covered by the window
+    uint32_t samples;       // Output samples covered by the window
+    uint32_t sequence;      // Increments for every published window
+    int64_t timestamp_us;   // esp_timer time at the end of the window
+    float amps_per_volt;    // Scale from the same calibration generation as the bias
+    uint32_t calibration_version;
+    float line_frequency_hz;  // From zero-crossing periods, 0 when no cycle was synced
+    uint32_t synced_cycles;   // Cycles bounded by two zero crossings
+} rms_window_t;
+
+// RMS of a single mains cycle, bounded by rising zero crossings of the AC component
+typedef struct {
+    float vrms;             // AC RMS voltage of the cycle
+    uint32_t samples;       // Output samples in the cycle
+    uint32_t index;         // Cycle number since sampling started
+    int64_t timestamp_us;   // Time of the last sample of the cycle
+    float amps_per_volt;    // Scale from the same calibration generation as the bias
+    uint32_t calibration_version;
+    float period_samples;   // Crossing-to-crossing period with sub-sample precision
+    bool synced;            // False when no crossing was found (low signal) and the
+                            // cycle was closed at the nominal length instead
+} rms_cycle_t;
+
+#define MAX_CYCLE_SUBSCRIBERS 8
+
+// Runs in the sampler task once per cycle - must not block
+typedef void (*rms_cycle_callback_t)(const rms_cycle_t* cycle, void* context);
+
+// Subscribes the RMS stage to the ADC sampler
+esp_err_t rms_engine_init(void);
+
+// RMS windows
+bool rms_engine_wait_window(rms_window_t* window, uint32_t timeout_ms);
+bool rms_engine_get_latest_window(rms_window_t* window);
+float rms_engine_get_last_cycle_vrms(void);
+float rms_engine_get_last_cycle_current(void);
+uint32_t rms_engine_get_cycle_count(void);
+float rms_engine_get_line_frequency(void);
+
+// Per-cycle listeners (registered once at init, never removed)
+int rms_engine_subscribe_cycles(rms_cycle_callback_t callback, void* context);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef RMS_KERNEL_H
+#define RMS_KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "hardware_config.h"
+
+// Integer RMS accumulation on raw ADC counts. The bias is subtracted in counts with
+// RMS_KERNEL_FRAC_BITS of fraction so sub-count calibration is not lost, squares go
+// into a 64-bit sum, and conversion to volts happens once per result.
+#define RMS_KERNEL_FRAC_BITS 4
+#define RMS_KERNEL_ONE (1 << RMS_KERNEL_FRAC_BITS)
+
+typedef struct {
+    uint64_t sum_squared;   // Sum of (sample - bias)^2 in scaled counts
+    uint32_t count;
+} rms_accumulator_t;
+
+// Constant-expression form for static initializers
+#define RMS_KERNEL_BIAS_COUNTS(volts) \
+    ((int32_t)((volts) * (ADC_RESOLUTION / ADC_VOLTAGE_RANGE) * RMS_KERNEL_ONE + 0.5f))
+
+static inline int32_t rms_kernel_bias_counts(float bias_voltage) {
+    return (int32_t)lrintf(bias_voltage * (ADC_RESOLUTION / ADC_VOLTAGE_RANGE) * RMS_KERNEL_ONE);
+}
+
+static inline void rms_kernel_reset(rms_accumulator_t *acc) {
+    acc->sum_squared = 0;
+    acc->count = 0;
+}
+
+// AC component of one sample in scaled counts
+static inline int32_t rms_kernel_ac(uint16_t sample, int32_t bias_counts) {
+    return ((int32_t)sample << RMS_KERNEL_FRAC_BITS) - bias_counts;
+}
+
+static inline void rms_kernel_add(rms_accumulator_t *acc, int32_t ac) {
+    acc->sum_squared += (uint64_t)((int64_t)ac * ac);
+    acc->count++;
+}
+
+static inline void rms_kernel_accumulate(rms_accumulator_t *acc, const uint16_t *samples,
+                                         size_t count, int32_t bias_counts) {
+    uint64_t sum = acc->sum_squared;
+    for (size_t i = 0; i < count; i++) {
+        int32_t ac = rms_kernel_ac(samples[i], bias_counts);
+        sum += (uint64_t)((int64_t)ac * ac);
+    }
+    acc->sum_squared = sum;
+    acc->count += count;
+}
+
+static inline void rms_kernel_merge(rms_accumulator_t *into, const rms_accumulator_t *from) {
+    into->sum_squared += from->sum_squared;
+    into->count += from->count;
+}
+
+// One divide and one square root per result
+static inline float rms_kernel_vrms(const rms_accumulator_t *acc) {
+    if (acc->count == 0) {
+        return 0.0f;
+    }
+    const float volts_per_scaled_count = ADC_VOLTAGE_RANGE / (ADC_RESOLUTION * RMS_KERNEL_ONE);
+    return sqrtf((float)acc->sum_squared / (float)acc->count) * volts_per_scaled_count;
+}
+
+#endif
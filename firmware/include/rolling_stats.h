@@ -0,0 +1,39 @@
+#ifndef ROLLING_STATS_H
+#define ROLLING_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Welford mean/variance with O(1) add and removal. With storage the statistics
+// cover the last `capacity` values (oldest value leaves as a new one arrives);
+// with no storage they accumulate every value since the last reset. There is no
+// locking, and min/max may rescan the window: share one across tasks only under the
+// owner's lock, and read from a copy.
+typedef struct {
+    float *values;          // Window storage (NULL for cumulative)
+    uint16_t capacity;
+    uint16_t head;          // Next slot to write
+    uint32_t count;
+    uint32_t updates;       // Since the last resync of the windowed sums
+    float mean;
+    float m2;               // Sum of squared deviations from the mean
+    float min;
+    float max;
+    bool extremes_stale;    // The window min/max left and must be rescanned
+} rolling_stats_t;
+
+void rolling_stats_init(rolling_stats_t *stats, float *storage, uint16_t capacity);
+void rolling_stats_reset(rolling_stats_t *stats);
+void rolling_stats_add(rolling_stats_t *stats, float value);
+
+uint32_t rolling_stats_count(const rolling_stats_t *stats);
+bool rolling_stats_full(const rolling_stats_t *stats);
+float rolling_stats_mean(const rolling_stats_t *stats);
+float rolling_stats_variance(const rolling_stats_t *stats);  // Population variance
+float rolling_stats_stddev(const rolling_stats_t *stats);
+float rolling_stats_rms(const rolling_stats_t *stats);
+float rolling_stats_min(rolling_stats_t *stats);
+float rolling_stats_max(rolling_stats_t *stats);
+
+#endif
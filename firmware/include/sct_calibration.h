@@ -2,7 +2,14 @@
 #define SCT_CALIBRATION_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "lwip/sockets.h"
+#include "hardware_config.h"
+
+// Sample counts for the shared-pipeline collectors
+#define AUTO_DETECT_SAMPLES (SAMPLES_PER_CYCLE * 10)
+#define CALIBRATION_SAMPLES (SAMPLES_PER_CYCLE * 30)
+#define BIAS_CAL_SAMPLES (SAMPLES_PER_CYCLE * 60)
 
 // Device profile structure for automatic recognition
 typedef struct {
@@ -13,17 +20,49 @@ typedef struct {
     float confidence_boost;  // How much to boost confidence for this device
 } device_profile_t;
 
-// Learning point structure for adaptive calibration
+// Learned fit of current = scale * volts + offset over the calibration points:
+// recursive least squares with forgetting, so O(1) per point and no point history
+typedef struct {
+    uint32_t updates;
+    float scale;              // A/V
+    float scale_sd;
+    float offset_amps;
+    float offset_sd;
+    float correlation;        // Of the scale and offset errors
+    float effective_points;   // What the forgotten weights add up to
+} learning_estimate_t;
+
+// Auto-calibration counters (structured form of get_auto_cal_statistics)
 typedef struct {
-    float expected_current;
-    float measured_voltage;
-    uint32_t timestamp;
-    float confidence;
-    bool auto_generated;  // true if from auto-recognition, false if manual
-} calibration_point_t;
-
-// Initialize calibration system
+    uint32_t auto_cal_count;
+    uint32_t successful_recognitions;
+    uint32_t failed_recognitions;
+    int learning_points;
+    bool enabled;
+    float sensitivity;
+} auto_cal_counters_t;
+
+// Immutable calibration generation - bias and scale always belong together
+typedef struct {
+    float bias_voltage;
+    float amps_per_volt;
+    int32_t bias_counts;    // Bias in rms_kernel scaled ADC counts
+    uint32_t version;       // Increments with every published change
+} calibration_snapshot_t;
+
+// Initialize calibration system (fast - safe to call before the network is up).
+// A valid NVS record (bias, scale, learned fit, custom devices, settings)
+// makes it a warm start, with the bias only refined in the background when the
+// input shows no load.
 void sct_calibration_init(void);
+bool sct_calibration_warm_start(void);
+
+// Cold start bias measurement (blocks ~2 s), then starts auto-calibration
+void sct_calibration_startup(void);
+
+// Changes are saved by a background task, settled and rate limited against flash wear
+bool sct_calibration_forget(void);  // Erases the record; the next boot is cold
+void get_calibration_store_status(char* buffer, size_t buffer_size);
 
 // Auto-detection and auto-calibration controls
 void set_auto_calibration(bool enabled);
@@ -33,20 +72,23 @@ bool get_auto_detection_enabled(void);
 
 // Load detection functions
 float get_detected_load_amps(void);
-void auto_detect_load_current(void);
+bool auto_detect_load_current(void);
 
-// Calibration functions
-void calibrate_with_known_load(float known_amps);
+// Calibration functions (block while samples are collected - false on failure)
+bool calibrate_with_known_load(float known_amps);
 void print_sct_013_info(void);
 
 // Advanced calibration functions (for UDP commands)
-void perform_zero_calibration(int sock, struct sockaddr_in *client_addr);
-void perform_scale_calibration(float known_current, int sock, struct sockaddr_in *client_addr);
 void reset_calibration(int sock, struct sockaddr_in *client_addr);
 
 // SCT-013 calculations
 float calculate_theoretical_scale_factor(void);
 
+// Lock-free snapshot for the sampling path (safe before sct_calibration_init)
+void get_calibration_snapshot(calibration_snapshot_t* snapshot);
+uint32_t get_calibration_version(void);
+void set_calibration(float bias_v, float scale);  // Publishes both in one generation
+
 // Parameter getters and setters (thread-safe)
 void set_bias_voltage(float bias_v);
 float get_bias_voltage(void);
@@ -58,30 +100,38 @@ void get_calibration_status(char* status_buffer, size_t buffer_size);
 
 // Debug functions
 void debug_adc_readings(void);
-void auto_calibrate_bias_voltage(void);
+float get_tracked_dc_voltage(void);
+bool auto_calibrate_bias_voltage(void);
 
 // AUTO-CALIBRATION FUNCTIONS (Fixed signatures)
 void auto_calibration_task(void *parameters);  // FIXED: Now takes void* parameter
 bool should_auto_calibrate_zero(void);
 bool should_auto_calibrate_scale(float current_reading);
-void process_current_for_auto_calibration(float current_amps);
+void process_current_for_auto_calibration(float current_amps);     // Detected load only
+void process_load_change_for_auto_calibration(float level_amps);   // Settled level after a load change
 void auto_recognize_and_calibrate(float measured_current);
 
 // LEARNING SYSTEM FUNCTIONS
-void learn_from_calibration(float expected_current, float measured_voltage, bool manual);
+void learn_from_calibration(float expected_current, float measured_voltage, bool manual);  // Applies when certain
 void apply_learned_calibration(void);
 void reset_learning_data(void);
-int get_learning_point_count(void);
-
-// DEVICE RECOGNITION FUNCTIONS
-const device_profile_t* recognize_device(float current_amps);
-void add_custom_device_profile(float min_current, float max_current, 
-                              float typical_current, const char* name);
+int get_learning_point_count(void);             // Updates since the last reset
+void get_learning_estimate(learning_estimate_t* estimate);
+
+// DEVICE RECOGNITION FUNCTIONS (range profiles; auto-recognition tries the
+// signature library in device_library.h first)
+const device_profile_t* recognize_device(float current_amps);  // Best fit among overlapping ranges
+bool add_custom_device_profile(float min_current, float max_current, 
+                               float typical_current, const char* name);  // Persisted; false if full/invalid
+bool clear_custom_device_profiles(void);  // False if the table was busy
 void list_known_devices(char* buffer, size_t buffer_size);
+const device_profile_t* get_known_device(int index);  // In list_known_devices order, NULL past the end
 
 // ADVANCED AUTO-CALIBRATION
-void continuous_auto_calibration(float current_reading);
-void temperature_compensation(float temperature_c);  // If temperature sensor available
+void temperature_compensation(float temperature_c);  // External reading; see temp_compensation.h
+// Publishes a correction (NAN keeps a field) only over calibration base_version, and
+// without a flash write. Returns the new version, 0 if the calibration changed first
+uint32_t apply_calibration_correction(uint32_t base_version, float bias_v, float scale);
 void adaptive_threshold_adjustment(void);
 
 // CONFIGURATION FUNCTIONS
@@ -92,6 +142,7 @@ float get_learning_rate(void);
 
 // STATISTICS AND MONITORING
 void get_auto_cal_statistics(char* buffer, size_t buffer_size);
+void get_auto_cal_counters(auto_cal_counters_t* counters);
 uint32_t get_last_auto_cal_time(void);
 uint32_t get_auto_cal_count(void);
 void reset_auto_cal_statistics(void);
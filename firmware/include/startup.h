@@ -0,0 +1,32 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+// Startup dependency graph. Each stage sets its bit when ready, and consumers wait
+// only for the bits they need - the network and command receiver come up alongside
+// calibration, and only telemetry and calibration jobs wait for CALIBRATION.
+#define STARTUP_NVS          BIT0   // NVS flash initialized
+#define STARTUP_SAMPLING     BIT1   // Sampler, RMS engine and stream subscribers running
+#define STARTUP_RELAY        BIT2   // Relay GPIO configured
+#define STARTUP_NETWORK      BIT3   // WiFi framework and fallback AP up
+#define STARTUP_COMMANDS     BIT4   // Command receiver bound to UDP_RECV_PORT
+#define STARTUP_CALIBRATION  BIT5   // Bias and scale trusted (stored or measured)
+#define STARTUP_STAGE_COUNT  6
+
+// Creates the group and registers STARTUP_STATUS; first thing in app_main
+void startup_init(void);
+
+void startup_signal(EventBits_t stages);
+bool startup_wait(EventBits_t stages, uint32_t timeout_ms);  // All of stages
+
+// Lock-free check, safe in the sampler task
+bool startup_is_ready(EventBits_t stages);
+
+void startup_get_status(char* buffer, size_t buffer_size);
+
+#endif
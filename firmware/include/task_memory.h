@@ -0,0 +1,37 @@
+#ifndef TASK_MEMORY_H
+#define TASK_MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Long-lived tasks run on stacks and control blocks declared next to the task
+// (STATIC_TASK), so they never compete with the heap and MEM_STATS can report each
+// one's headroom. A static task is started once; if it ends, its storage stays unused.
+//   MEM_STATS    heap, largest free block, network buffers and per-task stack use
+#define TASK_MEMORY_MAX_TASKS 24
+
+typedef struct {
+    StackType_t* stack;
+    uint32_t stack_bytes;
+    StaticTask_t tcb;
+    TaskHandle_t handle;    // NULL until started
+} static_task_t;
+
+// Storage for one task with a stack_size-byte stack
+#define STATIC_TASK(name, stack_size) \
+    static StackType_t name##_stack[(stack_size) / sizeof(StackType_t)]; \
+    static static_task_t name = { .stack = name##_stack, .stack_bytes = sizeof(name##_stack) }
+
+// Creates the task in its storage and lists it in MEM_STATS; NULL if it was already started
+TaskHandle_t static_task_start(static_task_t* task, TaskFunction_t function, const char* name,
+                               void* parameters, UBaseType_t priority, BaseType_t core);
+
+// Registers MEM_STATS
+esp_err_t task_memory_init(void);
+
+void task_memory_format(char* buffer, size_t buffer_size);
+
+#endif
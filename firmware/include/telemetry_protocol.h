@@ -0,0 +1,175 @@
+#ifndef TELEMETRY_PROTOCOL_H
+#define TELEMETRY_PROTOCOL_H
+
+#include <stdint.h>
+
+// Binary telemetry frames on UDP_SEND_PORT. All fields are little-endian and packed.
+// The first magic byte (0xA5) can never start a text packet, so both formats can
+// share the port and receivers tell them apart from the first two bytes.
+#define TELEMETRY_MAGIC 0x5AA5
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_MAX_FRAME_SIZE 256
+
+typedef enum {
+    TELEMETRY_FORMAT_TEXT = 0,
+    TELEMETRY_FORMAT_BINARY = 1
+} telemetry_format_t;
+
+typedef enum {
+    TELEMETRY_FRAME_MEASUREMENT = 1,
+    TELEMETRY_FRAME_CALIBRATION = 2,
+    TELEMETRY_FRAME_AUTO_CAL = 3,
+    TELEMETRY_FRAME_BATCH = 4,
+    TELEMETRY_FRAME_WAVEFORM = 5,
+    TELEMETRY_FRAME_TRIP = 6,
+    TELEMETRY_FRAME_HISTORY = 7,
+    TELEMETRY_FRAME_HARMONICS = 8,
+    TELEMETRY_FRAME_LOAD_EVENT = 9
+} telemetry_frame_type_t;
+
+// Measurement flags
+#define TELEMETRY_FLAG_AUTO_CAL    0x01
+#define TELEMETRY_FLAG_AUTO_DETECT 0x02
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;           // telemetry_frame_type_t
+    uint16_t length;        // Payload bytes after the header
+    uint32_t sequence;      // Increments for every binary frame sent
+    uint32_t timestamp_ms;  // Device uptime
+} telemetry_header_t;
+
+typedef struct __attribute__((packed)) {
+    float current_amps;
+    float voltage_rms;
+    float power_watts;
+    uint8_t flags;
+} telemetry_measurement_t;
+
+// Sent only when the values change (or after format negotiation)
+typedef struct __attribute__((packed)) {
+    float bias_voltage;
+    float amps_per_volt;
+    float detected_load_amps;
+    uint16_t learning_points;
+    uint8_t auto_cal_enabled;
+    uint8_t auto_detect_enabled;
+} telemetry_calibration_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t auto_cal_count;
+    uint32_t successful_recognitions;
+    uint32_t failed_recognitions;
+    uint16_t learning_points;
+    uint8_t enabled;
+    uint8_t reserved;
+    float sensitivity;
+} telemetry_auto_cal_t;
+
+// Streaming batch: one batch header followed by record_count records
+#define TELEMETRY_MAX_BATCH_RECORDS 120
+
+typedef struct __attribute__((packed)) {
+    uint32_t base_timestamp_ms;  // Uptime of the first record
+    uint32_t first_cycle;        // Cycle index of the first record
+    uint16_t record_count;
+    uint8_t cycles_per_record;   // 1 = per-cycle readings
+    uint8_t reserved;
+} telemetry_batch_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t offset_ms;          // Relative to base_timestamp_ms
+    float current_amps;
+} telemetry_batch_record_t;
+
+// Raw waveform capture chunk, followed by sample_count little-endian 12-bit samples.
+// Sent to the requester only; header.sequence is the chunk index within the capture.
+#define TELEMETRY_WAVEFORM_CHUNK_SAMPLES 600
+
+typedef struct __attribute__((packed)) {
+    uint16_t capture_id;
+    uint16_t chunk_index;
+    uint16_t chunk_count;
+    uint16_t sample_rate_hz;
+    uint32_t first_sample;       // Offset of this chunk's first sample in the capture
+    uint32_t total_samples;
+    uint32_t block_sequence;     // Sampler ring block holding the capture's first sample
+    uint16_t sample_count;
+    uint16_t reserved;
+} telemetry_waveform_chunk_t;
+
+// Protection trip record, broadcast once when the relay is opened by a trip
+typedef struct __attribute__((packed)) {
+    uint32_t trip_count;         // Trips since boot, including this one
+    uint8_t cause;               // protection_trip_cause_t
+    uint8_t relay_was_on;
+    uint16_t reserved;
+    float current_amps;          // Instantaneous peak (PEAK) or cycle RMS (I2T)
+    float limit_amps;            // The level that was exceeded
+    float i2t_a2s;               // Thermal accumulator at the trip
+    uint32_t detect_latency_us;  // Offending sample to trip decision
+    uint32_t open_latency_us;    // Trip decision to relay pin write
+    uint32_t trip_time_ms;       // Device uptime at the trip
+} telemetry_trip_t;
+
+// History range reply, followed by record_count records. Sent to the requester only;
+// header.sequence is the frame index. Record i covers
+// first_time_ms + i * resolution_s * 1000 (device uptime, same clock as the header).
+#define TELEMETRY_HISTORY_FRAME_RECORDS 200
+#define TELEMETRY_HISTORY_EMPTY 0xFFFF    // No samples in the bucket
+
+typedef struct __attribute__((packed)) {
+    uint16_t request_id;
+    uint16_t frame_index;
+    uint16_t frame_count;
+    uint16_t record_count;
+    uint32_t first_time_ms;
+    uint16_t resolution_s;
+    uint16_t reserved;
+} telemetry_history_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t min_centiamps;
+    uint16_t max_centiamps;
+    uint16_t avg_centiamps;
+} telemetry_history_record_t;
+
+// Harmonic analysis, sent at the PQ_CONFIG cadence to the subscribers. Entries past
+// harmonic_count (above Nyquist) are zero
+#define TELEMETRY_MAX_HARMONICS 15
+
+typedef struct __attribute__((packed)) {
+    float fundamental_hz;
+    float rms_amps;              // Total RMS over the analysis window
+    float thd_percent;           // Harmonics 2..n relative to the fundamental; 0 at no load
+    uint16_t window_samples;
+    uint8_t harmonic_count;
+    uint8_t reserved;
+    float harmonic_amps[TELEMETRY_MAX_HARMONICS];  // RMS of harmonic 1..n
+} telemetry_harmonics_t;
+
+// Load change, sent to the subscribers once the new level has settled
+typedef struct __attribute__((packed)) {
+    uint32_t event_count;        // Events since boot, including this one
+    uint8_t type;                // load_event_type_t
+    uint8_t reserved;
+    uint16_t detect_cycles;      // First changed cycle to detection
+    float before_amps;           // Steady level before the change
+    float after_amps;            // Mean of the last LOAD_EVENT_LEVEL_CYCLES settle cycles
+    float peak_amps;             // Highest cycle RMS from the change through settling (inrush)
+    uint32_t onset_ms;           // Device uptime of the first changed cycle
+} telemetry_load_event_t;
+
+_Static_assert(sizeof(telemetry_header_t) == 14, "telemetry header layout changed");
+_Static_assert(sizeof(telemetry_measurement_t) == 13, "measurement payload layout changed");
+_Static_assert(sizeof(telemetry_batch_header_t) == 12, "batch header layout changed");
+_Static_assert(sizeof(telemetry_batch_record_t) == 6, "batch record layout changed");
+_Static_assert(sizeof(telemetry_waveform_chunk_t) == 24, "waveform chunk layout changed");
+_Static_assert(sizeof(telemetry_trip_t) == 32, "trip record layout changed");
+_Static_assert(sizeof(telemetry_history_header_t) == 16, "history header layout changed");
+_Static_assert(sizeof(telemetry_history_record_t) == 6, "history record layout changed");
+_Static_assert(sizeof(telemetry_harmonics_t) == 76, "harmonics layout changed");
+_Static_assert(sizeof(telemetry_load_event_t) == 24, "load event layout changed");
+
+#endif
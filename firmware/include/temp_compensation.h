@@ -0,0 +1,30 @@
+#ifndef TEMP_COMPENSATION_H
+#define TEMP_COMPENSATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Temperature compensation of the calibration. Every TEMP_COMP_SAMPLE_MS the task
+// reads the temperature - an external reading fed through temperature_compensation()
+// while it is fresh, otherwise the on-chip sensor where the chip has one - and learns,
+// per TEMP_COMP_BIN_C bin:
+//   bias   the DC tracker's level while the load is steady and small
+//   scale  the scale of each calibration made at that temperature
+// The correction is interpolated between learned bins and published through the
+// calibration snapshot: the learned bias, and the last calibration's scale moved by the
+// scale ratio between its temperature and the present one. A calibration always wins
+// over a correction computed before it. The table persists in NVS.
+//   TEMPERATURE:<celsius>          reading from an external sensor
+//   TEMP_COMP                      state and the learned bins
+//   TEMP_COMP_ON / TEMP_COMP_OFF
+//   TEMP_COMP_RESET                forget the learned table
+
+// Loads the table, starts the task and registers the commands; call after sct_calibration_init
+esp_err_t temp_compensation_init(void);
+
+void temp_compensation_enable(bool enable);
+void temp_compensation_reset(void);
+void temp_compensation_get_status(char* buffer, size_t buffer_size);
+
+#endif
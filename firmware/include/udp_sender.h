@@ -3,22 +3,51 @@
 
 #include <stdbool.h>
 #include <stddef.h>
-#include "esp_adc/adc_oneshot.h"
+#include <stdint.h>
+#include "telemetry_protocol.h"
 
-// Global ADC handle - declared as extern, defined in main.c
-extern adc_oneshot_unit_handle_t adc1_handle;
+// Telemetry goes to the unicast subscribers registered with SUBSCRIBE, each at its
+// own interval and format, for as long as the lease is renewed. Only the announce
+// beacon (discovery.h) is broadcast: every TELEMETRY_DISCOVERY_INTERVAL_MS while
+// nobody is subscribed, every TELEMETRY_ANNOUNCE_INTERVAL_MS otherwise.
+//   SUBSCRIBE:<port>,<interval_ms>,<format>[,<lease_s>]   port/interval 0 = defaults
+//   UNSUBSCRIBE[:<port>]    SUBSCRIBERS
 
-// Initialize UDP sender
-void udp_sender_init(const char* target_ip);
+// Initialize UDP sender; discovery_ip is where the beacon goes (broadcast)
+void udp_sender_init(const char* discovery_ip);
 
 // Main sending function (runs as task)
 void udp_sender_task(void *parameters);
 
 // Control functions
-void start_udp_sender(const char* target_ip);
+void start_udp_sender(const char* discovery_ip);
 void stop_udp_sender(void);
 bool is_udp_sender_running(void);
 
+// Default telemetry format and cadence (beacon, events with no subscriber)
+void set_telemetry_format(telemetry_format_t format);
+telemetry_format_t get_telemetry_format(void);
+bool set_telemetry_interval(uint32_t interval_ms);
+uint32_t get_telemetry_interval(void);
+
+// While idle every subscriber gets the TELEMETRY_IDLE_INTERVAL_MS heartbeat at most;
+// leaving idle makes them all due at once
+void udp_sender_set_idle(bool idle);
+
+// One-off events (e.g. protection trips) to every subscriber in its format: a binary
+// frame of frame_type, or the text line; broadcast when nobody is subscribed.
+// Safe from any task except the sampler
+bool send_telemetry_event(uint8_t frame_type, const void* payload, uint16_t length,
+                          const char* text);
+
+// Streaming mode - per-cycle readings batched into binary frames
+bool start_streaming(uint16_t batch_size, uint32_t flush_ms, uint8_t cycles_per_record);
+void stop_streaming(void);
+bool is_streaming_enabled(void);
+void get_streaming_status(char* buffer, size_t buffer_size);
+size_t get_subscriber_list(char* buffer, size_t buffer_size);
+int udp_sender_subscriber_count(void);
+
 // Measurement functions
 float measure_rms_current(void);
 float get_last_measured_vrms(void);
@@ -28,6 +57,5 @@ float get_instant_current_reading(void);
 void get_measurement_statistics(char* buffer, size_t buffer_size);
 void reset_measurement_statistics(void);
 void analyze_voltage_buffer(char* buffer, size_t buffer_size);
-void trigger_auto_calibration_check(void);
 
 #endif
\ No newline at end of file
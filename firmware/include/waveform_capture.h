@@ -0,0 +1,15 @@
+#ifndef WAVEFORM_CAPTURE_H
+#define WAVEFORM_CAPTURE_H
+
+#include <stdint.h>
+#include "lwip/sockets.h"
+
+#define WAVEFORM_MAX_CYCLES 60
+
+// Freezes the newest cycles of raw samples and streams them to the requester
+void perform_waveform_capture(uint32_t cycles, int sock, struct sockaddr_in *client_addr);
+
+// Adds CAPTURE_WAVEFORM:<cycles> to the command table
+void waveform_capture_register_commands(void);
+
+#endif
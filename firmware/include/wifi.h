@@ -8,4 +8,7 @@ void start_fallback_ap(void);
 void stop_fallback_ap(void);
 bool connect_to_wifi(const char *ssid, const char *password);
 
+// Modem sleep on the station link; applied on (re)connection, never while the fallback AP runs
+void wifi_set_power_save(bool enabled);
+
 #endif
\ No newline at end of file
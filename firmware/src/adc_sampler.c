@@ -0,0 +1,472 @@
+#include "adc_sampler.h"
+#include "rms_kernel.h"
+#include "perf_monitor.h"
+#include "hardware_config.h"
+#include "task_memory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_adc/adc_continuous.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "ADC_SAMPLER";
+
+// One DMA frame carries exactly one ring block worth of raw conversions
+#define ADC_FRAME_BYTES (ADC_BLOCK_SAMPLES * ADC_DECIMATION * SOC_ADC_DIGI_RESULT_BYTES)
+#define ADC_STORE_BUF_BYTES (ADC_FRAME_BYTES * 4)
+
+// Readers stay two blocks behind the producer so a block is never read while rewritten
+#define ADC_MAX_READ_BLOCKS (ADC_RING_BLOCKS - 2)
+
+static adc_continuous_handle_t adc_handle = NULL;
+static TaskHandle_t sampler_task_handle = NULL;
+STATIC_TASK(sampler_task, SAMPLER_TASK_STACK);
+static bool sampler_running = false;
+static volatile uint32_t overrun_count = 0;
+
+// Sample ring - the block being filled is never visible to readers
+static uint16_t sample_ring[ADC_RING_BLOCKS][ADC_BLOCK_SAMPLES];
+static uint32_t write_block = 0;
+static uint32_t write_pos = 0;
+static uint32_t completed_blocks = 0;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Decimation state carried across DMA frames
+static uint32_t decimation_sum = 0;
+static uint32_t decimation_count = 0;
+
+// Block subscribers - callbacks run in the sampler task and must not block
+typedef struct {
+    sample_block_callback_t callback;
+    void *context;
+} sample_subscriber_t;
+
+static sample_subscriber_t subscribers[MAX_SAMPLE_SUBSCRIBERS];
+static SemaphoreHandle_t subscriber_mutex = NULL;
+
+// Blocking statistics collection (used by calibration and diagnostics)
+typedef struct {
+    uint32_t target;
+    uint32_t count;
+    uint64_t raw_sum;
+    int32_t bias_counts;
+    rms_accumulator_t acc;
+    uint16_t min_raw;
+    uint16_t max_raw;
+    SemaphoreHandle_t done_sem;
+} stats_collector_t;
+
+static bool IRAM_ATTR on_conv_done(adc_continuous_handle_t handle,
+                                   const adc_continuous_evt_data_t *edata, void *user_data) {
+    BaseType_t must_yield = pdFALSE;
+    vTaskNotifyGiveFromISR(sampler_task_handle, &must_yield);
+    return (must_yield == pdTRUE);
+}
+
+static bool IRAM_ATTR on_pool_ovf(adc_continuous_handle_t handle,
+                                  const adc_continuous_evt_data_t *edata, void *user_data) {
+    overrun_count++;
+    return false;
+}
+
+static void dispatch_block(const uint16_t *samples, uint32_t sequence) {
+    sample_block_t block = {
+        .samples = samples,
+        .count = ADC_BLOCK_SAMPLES,
+        .sequence = sequence,
+        .timestamp_us = esp_timer_get_time()
+    };
+
+#if ENABLE_PERF_MONITOR
+    // Sample timing jitter: deviation of the block interval from nominal
+    static int64_t last_block_us = 0;
+    if (last_block_us != 0) {
+        int64_t deviation = (block.timestamp_us - last_block_us) -
+                            (int64_t)ADC_BLOCK_SAMPLES * 1000000 / ADC_OUTPUT_RATE_HZ;
+        PERF_RECORD_US(PERF_PROBE_BLOCK_JITTER, (uint32_t)(deviation < 0 ? -deviation : deviation));
+    }
+    last_block_us = block.timestamp_us;
+#endif
+    PERF_BEGIN(PERF_PROBE_BLOCK_DISPATCH);
+
+    // Held for the whole dispatch so unsubscribe never races a running callback
+    xSemaphoreTake(subscriber_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_SAMPLE_SUBSCRIBERS; i++) {
+        if (subscribers[i].callback) {
+            subscribers[i].callback(&block, subscribers[i].context);
+        }
+    }
+    xSemaphoreGive(subscriber_mutex);
+    PERF_END(PERF_PROBE_BLOCK_DISPATCH);
+}
+
+static void push_sample(uint16_t sample) {
+    sample_ring[write_block][write_pos++] = sample;
+    if (write_pos < ADC_BLOCK_SAMPLES) {
+        return;
+    }
+
+    uint32_t done_block = write_block;
+
+    portENTER_CRITICAL(&ring_lock);
+    write_block = (write_block + 1) % ADC_RING_BLOCKS;
+    write_pos = 0;
+    uint32_t sequence = completed_blocks++;
+    portEXIT_CRITICAL(&ring_lock);
+
+    // The completed block stays untouched while the producer fills the next one
+    dispatch_block(sample_ring[done_block], sequence);
+}
+
+static void ingest_frame(const uint8_t *frame, uint32_t length) {
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        const adc_digi_output_data_t *result = (const adc_digi_output_data_t *)&frame[i];
+        if (result->type1.channel != ADC_CHANNEL) {
+            continue;
+        }
+
+        decimation_sum += result->type1.data;
+        if (++decimation_count < ADC_DECIMATION) {
+            continue;
+        }
+
+        push_sample((uint16_t)(decimation_sum / ADC_DECIMATION));
+        decimation_sum = 0;
+        decimation_count = 0;
+    }
+}
+
+static void adc_sampler_task(void *parameters) {
+    static uint8_t frame[ADC_FRAME_BYTES];
+    PERF_REGISTER_TASK();
+
+    ESP_LOGI(TAG, "ADC sampler task started: %d Hz raw, %d Hz output, %d samples/cycle",
+             ADC_SAMPLE_RATE_HZ, ADC_OUTPUT_RATE_HZ, SAMPLES_PER_CYCLE);
+
+    while (sampler_running) {
+        // Woken by the DMA conversion-done callback
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        // Drain everything the driver has buffered
+        while (sampler_running) {
+            uint32_t length = 0;
+            esp_err_t ret = adc_continuous_read(adc_handle, frame, sizeof(frame), &length, 0);
+            if (ret != ESP_OK) {
+                break;  // ESP_ERR_TIMEOUT means the pool is empty
+            }
+            ingest_frame(frame, length);
+        }
+    }
+
+    ESP_LOGI(TAG, "ADC sampler task ended");
+    sampler_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t adc_sampler_init(void) {
+    if (adc_handle != NULL) {
+        ESP_LOGW(TAG, "ADC sampler already initialized");
+        return ESP_OK;
+    }
+
+    subscriber_mutex = xSemaphoreCreateMutex();
+    if (subscriber_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create subscriber mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = ADC_STORE_BUF_BYTES,
+        .conv_frame_size = ADC_FRAME_BYTES,
+    };
+
+    esp_err_t ret = adc_continuous_new_handle(&handle_cfg, &adc_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create continuous ADC handle: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    adc_digi_pattern_config_t pattern = {
+        .atten = ADC_ATTEN_DB_11,  // 0-3.3V range
+        .channel = ADC_CHANNEL,
+        .unit = ADC_UNIT_1,
+        .bit_width = ADC_BITWIDTH_12,
+    };
+
+    adc_continuous_config_t adc_cfg = {
+        .pattern_num = 1,
+        .adc_pattern = &pattern,
+        .sample_freq_hz = ADC_SAMPLE_RATE_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+
+    ret = adc_continuous_config(adc_handle, &adc_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure continuous ADC: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    adc_continuous_evt_cbs_t callbacks = {
+        .on_conv_done = on_conv_done,
+        .on_pool_ovf = on_pool_ovf,
+    };
+
+    ret = adc_continuous_register_event_callbacks(adc_handle, &callbacks, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register ADC callbacks: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Continuous ADC initialized - Channel: %d, GPIO: %d, frame: %d bytes",
+             ADC_CHANNEL, ADC_GPIO_PIN, ADC_FRAME_BYTES);
+    return ESP_OK;
+}
+
+esp_err_t adc_sampler_start(void) {
+    if (adc_handle == NULL) {
+        ESP_LOGE(TAG, "ADC sampler not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (sampler_running) {
+        ESP_LOGW(TAG, "ADC sampler already running");
+        return ESP_OK;
+    }
+
+    sampler_running = true;
+
+    // Task must exist before the first conversion-done callback fires
+    // Block subscribers (RMS engine, protection) run on this task too
+    sampler_task_handle = static_task_start(&sampler_task, adc_sampler_task, "adc_sampler", NULL,
+                                            SAMPLER_TASK_PRIORITY, SAMPLING_CORE);
+    if (!sampler_task_handle) {
+        ESP_LOGE(TAG, "Failed to create ADC sampler task");
+        sampler_running = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = adc_continuous_start(adc_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start continuous ADC: %s", esp_err_to_name(ret));
+        sampler_running = false;
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "ADC sampler started");
+    return ESP_OK;
+}
+
+void adc_sampler_stop(void) {
+    if (!sampler_running) {
+        return;
+    }
+
+    sampler_running = false;
+    adc_continuous_stop(adc_handle);
+    ESP_LOGI(TAG, "ADC sampler stopped");
+}
+
+bool adc_sampler_is_running(void) {
+    return sampler_running;
+}
+
+int adc_sampler_subscribe(sample_block_callback_t callback, void *context) {
+    if (!callback || subscriber_mutex == NULL) {
+        return -1;
+    }
+
+    int id = -1;
+    xSemaphoreTake(subscriber_mutex, portMAX_DELAY);
+    for (int i = 0; i < MAX_SAMPLE_SUBSCRIBERS; i++) {
+        if (subscribers[i].callback == NULL) {
+            subscribers[i].callback = callback;
+            subscribers[i].context = context;
+            id = i;
+            break;
+        }
+    }
+    xSemaphoreGive(subscriber_mutex);
+
+    if (id < 0) {
+        ESP_LOGE(TAG, "No free sample subscriber slots");
+    }
+    return id;
+}
+
+void adc_sampler_unsubscribe(int subscription_id) {
+    if (subscription_id < 0 || subscription_id >= MAX_SAMPLE_SUBSCRIBERS || subscriber_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(subscriber_mutex, portMAX_DELAY);
+    subscribers[subscription_id].callback = NULL;
+    subscribers[subscription_id].context = NULL;
+    xSemaphoreGive(subscriber_mutex);
+}
+
+static void stats_collector_callback(const sample_block_t *block, void *context) {
+    stats_collector_t *collector = (stats_collector_t *)context;
+    if (collector->count >= collector->target) {
+        return;
+    }
+
+    size_t take = collector->target - collector->count;
+    if (take > block->count) {
+        take = block->count;
+    }
+
+    for (size_t i = 0; i < take; i++) {
+        uint16_t raw = block->samples[i];
+        collector->raw_sum += raw;
+        if (raw < collector->min_raw) collector->min_raw = raw;
+        if (raw > collector->max_raw) collector->max_raw = raw;
+    }
+    rms_kernel_accumulate(&collector->acc, block->samples, take, collector->bias_counts);
+    collector->count += take;
+
+    if (collector->count >= collector->target) {
+        xSemaphoreGive(collector->done_sem);
+    }
+}
+
+bool adc_sampler_collect_stats(uint32_t num_samples, float bias_voltage,
+                               sample_stats_t *stats, uint32_t timeout_ms) {
+    if (!stats || num_samples == 0 || !sampler_running) {
+        return false;
+    }
+
+    stats_collector_t collector = {
+        .target = num_samples,
+        .bias_counts = rms_kernel_bias_counts(bias_voltage),
+        .min_raw = UINT16_MAX,
+        .max_raw = 0,
+        .done_sem = xSemaphoreCreateBinary()
+    };
+
+    if (collector.done_sem == NULL) {
+        ESP_LOGE(TAG, "Failed to create collector semaphore");
+        return false;
+    }
+
+    int id = adc_sampler_subscribe(stats_collector_callback, &collector);
+    if (id < 0) {
+        vSemaphoreDelete(collector.done_sem);
+        return false;
+    }
+
+    bool complete = (xSemaphoreTake(collector.done_sem, pdMS_TO_TICKS(timeout_ms)) == pdTRUE);
+    adc_sampler_unsubscribe(id);
+    vSemaphoreDelete(collector.done_sem);
+
+    if (!complete || collector.count == 0) {
+        ESP_LOGW(TAG, "Sample collection timed out (%lu/%lu samples)", collector.count, num_samples);
+        return false;
+    }
+
+    float mean_raw = (float)collector.raw_sum / collector.count;
+    stats->count = collector.count;
+    stats->min_raw = collector.min_raw;
+    stats->max_raw = collector.max_raw;
+    stats->mean_raw = mean_raw;
+    stats->mean_voltage = (mean_raw / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
+    stats->ac_rms_voltage = rms_kernel_vrms(&collector.acc);
+    return true;
+}
+
+size_t adc_sampler_copy_recent(uint16_t *dest, size_t count) {
+    if (!dest || count == 0) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&ring_lock);
+    uint32_t block = write_block;
+    uint32_t available_blocks = completed_blocks;
+    portEXIT_CRITICAL(&ring_lock);
+
+    if (available_blocks > ADC_MAX_READ_BLOCKS) {
+        available_blocks = ADC_MAX_READ_BLOCKS;
+    }
+
+    size_t available = (size_t)available_blocks * ADC_BLOCK_SAMPLES;
+    if (count > available) {
+        count = available;
+    }
+
+    // Walk backwards from the newest completed block, filling dest from the end
+    size_t remaining = count;
+    while (remaining > 0) {
+        block = (block + ADC_RING_BLOCKS - 1) % ADC_RING_BLOCKS;
+        size_t take = (remaining < ADC_BLOCK_SAMPLES) ? remaining : ADC_BLOCK_SAMPLES;
+        memcpy(dest + remaining - take, &sample_ring[block][ADC_BLOCK_SAMPLES - take],
+               take * sizeof(uint16_t));
+        remaining -= take;
+    }
+
+    return count;
+}
+
+bool adc_sampler_freeze_window(uint32_t num_samples, sample_window_t *window) {
+    if (!window || num_samples == 0 || num_samples > adc_sampler_get_max_window_samples()) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&ring_lock);
+    uint32_t completed = completed_blocks;
+    portEXIT_CRITICAL(&ring_lock);
+
+    uint32_t needed_blocks = (num_samples + ADC_BLOCK_SAMPLES - 1) / ADC_BLOCK_SAMPLES;
+    if (needed_blocks > completed) {
+        return false;  // Sampler has not run long enough yet
+    }
+
+    // Block sequence s always lives in ring slot s % ADC_RING_BLOCKS
+    window->first_sequence = completed - needed_blocks;
+    window->start_offset = needed_blocks * ADC_BLOCK_SAMPLES - num_samples;
+    window->count = num_samples;
+    return true;
+}
+
+size_t adc_sampler_window_span(const sample_window_t *window, uint32_t offset,
+                               size_t max_count, const uint16_t **data) {
+    if (!window || !data || offset >= window->count) {
+        return 0;
+    }
+
+    uint32_t position = window->start_offset + offset;
+    uint32_t slot = (window->first_sequence + position / ADC_BLOCK_SAMPLES) % ADC_RING_BLOCKS;
+    uint32_t index = position % ADC_BLOCK_SAMPLES;
+
+    // The ring is one contiguous array, so a span only breaks where it wraps
+    size_t contiguous = (size_t)(ADC_RING_BLOCKS - slot) * ADC_BLOCK_SAMPLES - index;
+    size_t remaining = window->count - offset;
+    if (contiguous > remaining) contiguous = remaining;
+    if (contiguous > max_count) contiguous = max_count;
+
+    *data = &sample_ring[slot][index];
+    return contiguous;
+}
+
+bool adc_sampler_window_intact(const sample_window_t *window) {
+    if (!window) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&ring_lock);
+    uint32_t writing_sequence = completed_blocks;
+    portEXIT_CRITICAL(&ring_lock);
+
+    // The producer reuses the first block's slot once it is a full ring ahead
+    return (writing_sequence - window->first_sequence) < ADC_RING_BLOCKS;
+}
+
+size_t adc_sampler_get_max_window_samples(void) {
+    return (size_t)ADC_MAX_READ_BLOCKS * ADC_BLOCK_SAMPLES;
+}
+
+uint32_t adc_sampler_get_overrun_count(void) {
+    return overrun_count;
+}
@@ -0,0 +1,330 @@
+#include "calibration_jobs.h"
+#include "hardware_config.h"
+#include "sct_calibration.h"
+#include "command_dispatcher.h"
+#include "perf_monitor.h"
+#include "startup.h"
+#include "task_memory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "CAL_JOBS";
+
+typedef struct {
+    uint16_t id;                        // 0 = slot unused
+    cal_job_type_t type;
+    cal_job_state_t state;
+    const char* name;                   // Requesting command, prefixes replies
+    float argument;
+    int sock;
+    struct sockaddr_in client_addr;
+    uint32_t queued_ms;
+    uint32_t started_ms;
+    uint32_t finished_ms;
+    uint32_t expected_ms;               // Sample collection time, for progress
+    char result[CAL_JOB_RESULT_SIZE];   // Completion reply, kept for JOB_STATUS
+} cal_job_t;
+
+// Job id N lives in slot N % CAL_JOB_HISTORY, so the last few finished jobs stay
+// queryable. Submission refuses a slot that still holds an active job, and only
+// takes the slot over once the job is in the queue
+static cal_job_t jobs[CAL_JOB_HISTORY];
+static uint16_t next_job_id = 1;
+static portMUX_TYPE jobs_lock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t job_queue = NULL;  // Jobs by value, oldest first
+STATIC_TASK(job_task, CAL_JOBS_TASK_STACK);
+
+_Static_assert(CAL_JOB_HISTORY > CAL_JOB_QUEUE_DEPTH + 1, "job history shorter than the queue");
+
+static uint32_t now_ms(void) {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static uint32_t expected_duration_ms(cal_job_type_t type) {
+    uint32_t samples;
+    switch (type) {
+        case CAL_JOB_ZERO:        samples = BIAS_CAL_SAMPLES; break;
+        case CAL_JOB_AUTO_DETECT: samples = AUTO_DETECT_SAMPLES; break;
+        default:                  samples = CALIBRATION_SAMPLES; break;
+    }
+    return samples * 1000 / ADC_OUTPUT_RATE_HZ;
+}
+
+static const char* state_name(cal_job_state_t state) {
+    switch (state) {
+        case CAL_JOB_QUEUED:  return "QUEUED";
+        case CAL_JOB_RUNNING: return "RUNNING";
+        case CAL_JOB_DONE:    return "DONE";
+        default:              return "FAILED";
+    }
+}
+
+// Runs the measurement and formats the completion reply
+static bool run_job(const cal_job_t* job, char* result, size_t result_size) {
+    bool ok = false;
+
+    switch (job->type) {
+        case CAL_JOB_ZERO:
+            ok = auto_calibrate_bias_voltage();
+            if (ok) {
+                snprintf(result, result_size, "%s:SUCCESS,BIAS=%.4f,JOB=%u",
+                         job->name, get_bias_voltage(), job->id);
+            }
+            break;
+
+        case CAL_JOB_SCALE:
+            ok = calibrate_with_known_load(job->argument);
+            if (ok) {
+                snprintf(result, result_size, "%s:SUCCESS,SCALE=%.2f,JOB=%u",
+                         job->name, get_amps_per_volt(), job->id);
+            }
+            break;
+
+        case CAL_JOB_AUTO_DETECT:
+            ok = auto_detect_load_current();
+            if (ok) {
+                snprintf(result, result_size, "%s:SUCCESS,CURRENT=%.3fA,JOB=%u",
+                         job->name, get_detected_load_amps(), job->id);
+            }
+            break;
+
+        case CAL_JOB_AUTO_RECOGNIZE: {
+#if ENABLE_DEVICE_RECOGNITION
+            float current = get_detected_load_amps();
+            auto_recognize_and_calibrate(current);
+            snprintf(result, result_size, "%s:PROCESSED,CURRENT=%.3fA,JOB=%u",
+                     job->name, current, job->id);
+            ok = true;
+#endif
+            break;
+        }
+    }
+
+    if (!ok) {
+        snprintf(result, result_size, "%s:ERROR,NO_SIGNAL,JOB=%u", job->name, job->id);
+    }
+    return ok;
+}
+
+static void calibration_job_task(void *parameters) {
+    PERF_REGISTER_TASK();
+    ESP_LOGI(TAG, "Calibration job worker running");
+
+    // Jobs submitted during startup stay queued until the startup calibration is done
+    startup_wait(STARTUP_CALIBRATION, UINT32_MAX);
+
+    cal_job_t job;
+    while (1) {
+        if (xQueueReceive(job_queue, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        // The submitter may not have recorded it in its slot yet
+        uint8_t slot = job.id % CAL_JOB_HISTORY;
+        portENTER_CRITICAL(&jobs_lock);
+        if (jobs[slot].id != job.id) {
+            jobs[slot] = job;
+        }
+        jobs[slot].state = CAL_JOB_RUNNING;
+        jobs[slot].started_ms = now_ms();
+        portEXIT_CRITICAL(&jobs_lock);
+
+        ESP_LOGI(TAG, "Job %u (%s) started", job.id, job.name);
+
+        char result[CAL_JOB_RESULT_SIZE];
+        bool ok = run_job(&job, result, sizeof(result));
+
+        portENTER_CRITICAL(&jobs_lock);
+        memcpy(jobs[slot].result, result, sizeof(result));
+        jobs[slot].state = ok ? CAL_JOB_DONE : CAL_JOB_FAILED;
+        jobs[slot].finished_ms = now_ms();
+        portEXIT_CRITICAL(&jobs_lock);
+
+        // Push the completion to whoever asked for it
+        int sent = sendto(job.sock, result, strlen(result), 0,
+                          (struct sockaddr*)&job.client_addr, sizeof(job.client_addr));
+        if (sent < 0) {
+            ESP_LOGW(TAG, "Failed to send result of job %u", job.id);
+        }
+        ESP_LOGI(TAG, "Job %u finished: %s", job.id, result);
+    }
+}
+
+uint16_t calibration_job_submit(cal_job_type_t type, const char* name, float argument,
+                                int sock, const struct sockaddr_in* client_addr) {
+    if (!job_queue || !name || !client_addr) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&jobs_lock);
+    uint16_t id = next_job_id;
+    uint8_t slot = id % CAL_JOB_HISTORY;
+    if (jobs[slot].id != 0 &&
+        (jobs[slot].state == CAL_JOB_QUEUED || jobs[slot].state == CAL_JOB_RUNNING)) {
+        portEXIT_CRITICAL(&jobs_lock);
+        return 0;  // Still running from CAL_JOB_HISTORY ids ago; next_job_id stays put
+    }
+    next_job_id = (id == UINT16_MAX) ? 1 : id + 1;
+    portEXIT_CRITICAL(&jobs_lock);
+
+    cal_job_t job = {
+        .id = id,
+        .type = type,
+        .state = CAL_JOB_QUEUED,
+        .name = name,
+        .argument = argument,
+        .sock = sock,
+        .client_addr = *client_addr,
+        .queued_ms = now_ms(),
+        .expected_ms = expected_duration_ms(type)
+    };
+    if (xQueueSend(job_queue, &job, 0) != pdTRUE) {
+        // The slot keeps its earlier job; this id goes unused
+        ESP_LOGW(TAG, "Job queue full - %s rejected", name);
+        return 0;
+    }
+
+    portENTER_CRITICAL(&jobs_lock);
+    if (jobs[slot].id != id) {
+        jobs[slot] = job;  // Unless the worker has already picked it up
+    }
+    portEXIT_CRITICAL(&jobs_lock);
+    return id;
+}
+
+bool calibration_job_get_status(uint16_t job_id, char* buffer, size_t buffer_size) {
+    if (job_id == 0 || !buffer || buffer_size == 0) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&jobs_lock);
+    cal_job_t job = jobs[job_id % CAL_JOB_HISTORY];
+    portEXIT_CRITICAL(&jobs_lock);
+
+    if (job.id != job_id) {
+        return false;
+    }
+
+    uint32_t now = now_ms();
+    uint32_t progress = 0;
+    uint32_t elapsed = 0;
+    if (job.state == CAL_JOB_RUNNING) {
+        elapsed = now - job.started_ms;
+        progress = job.expected_ms ? elapsed * 100 / job.expected_ms : 0;
+        if (progress > 99) progress = 99;  // Collection can run past the estimate
+    } else if (job.state != CAL_JOB_QUEUED) {
+        elapsed = job.finished_ms - job.started_ms;
+        progress = 100;
+    }
+
+    int length = snprintf(buffer, buffer_size,
+                          "ID=%u,COMMAND=%s,STATE=%s,PROGRESS=%lu,ELAPSED_MS=%lu,AGE_MS=%lu",
+                          job.id, job.name, state_name(job.state), progress, elapsed,
+                          now - job.queued_ms);
+    if (job.result[0] && length > 0 && (size_t)length < buffer_size) {
+        snprintf(buffer + length, buffer_size - length, ",RESULT=%s", job.result);
+    }
+    return true;
+}
+
+// === CALIBRATION JOB COMMANDS ===
+static size_t queue_job(cal_job_type_t type, const char* name, float argument,
+                        const cmd_context_t* ctx, char* response, size_t response_size) {
+    uint16_t id = calibration_job_submit(type, name, argument, ctx->sock, ctx->client_addr);
+    if (id == 0) {
+        return cmd_reply(response, response_size, "%s:ERROR,BUSY", name);
+    }
+    return cmd_reply(response, response_size, "%s:QUEUED,JOB=%u", name, id);
+}
+
+static size_t queue_scale_job(const char* name, float known_current,
+                              const cmd_context_t* ctx, char* response, size_t response_size) {
+    if (known_current <= 0.0f || known_current > MAX_CURRENT_AMPS) {
+        return cmd_reply(response, response_size, "%s:ERROR,INVALID_RANGE", name);
+    }
+    return queue_job(CAL_JOB_SCALE, name, known_current, ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_zero_cal) {
+    return queue_job(CAL_JOB_ZERO, "ZERO_CAL", 0.0f, ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_recalibrate_bias) {
+    return queue_job(CAL_JOB_ZERO, "RECALIBRATE_BIAS", 0.0f, ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_scale_cal) {
+    return queue_scale_job("SCALE_CAL", args->values[0].f, ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_calibrate) {
+    return queue_scale_job("CALIBRATE", args->values[0].f, ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_cal_known) {
+    return queue_scale_job("CAL_KNOWN", args->values[0].f, ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_auto_detect) {
+    if (!get_auto_detection_enabled()) {
+        return cmd_reply(response, response_size, "AUTO_DETECT:ERROR,DISABLED");
+    }
+    return queue_job(CAL_JOB_AUTO_DETECT, "AUTO_DETECT", 0.0f, ctx, response, response_size);
+}
+
+#if ENABLE_DEVICE_RECOGNITION
+CMD_HANDLER(cmd_auto_recognize) {
+    return queue_job(CAL_JOB_AUTO_RECOGNIZE, "AUTO_RECOGNIZE", 0.0f, ctx, response, response_size);
+}
+#endif
+
+CMD_HANDLER(cmd_job_status) {
+    size_t length = cmd_reply(response, response_size, "JOB_STATUS:");
+    if (args->values[0].u > UINT16_MAX ||
+        !calibration_job_get_status(args->values[0].u, response + length, response_size - length)) {
+        return cmd_reply(response, response_size, "JOB_STATUS:ERROR,UNKNOWN_JOB");
+    }
+    return length + strlen(response + length);
+}
+
+static const command_def_t job_commands[] = {
+    { "ZERO_CAL",         NULL, cmd_zero_cal },
+    { "RECALIBRATE_BIAS", NULL, cmd_recalibrate_bias },
+    { "SCALE_CAL",        "f",  cmd_scale_cal },
+    { "CALIBRATE",        "f",  cmd_calibrate },
+    { "CAL_KNOWN",        "f",  cmd_cal_known },
+    { "AUTO_DETECT",      NULL, cmd_auto_detect },
+#if ENABLE_DEVICE_RECOGNITION
+    { "AUTO_RECOGNIZE",   NULL, cmd_auto_recognize },
+#endif
+    { "JOB_STATUS",       "u",  cmd_job_status },
+};
+
+esp_err_t calibration_jobs_init(void) {
+    if (job_queue) {
+        return ESP_OK;
+    }
+
+    job_queue = xQueueCreate(CAL_JOB_QUEUE_DEPTH, sizeof(cal_job_t));
+    if (!job_queue) {
+        ESP_LOGE(TAG, "Failed to create job queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Below the command receiver so a running job never delays command handling
+    if (!static_task_start(&job_task, calibration_job_task, "cal_jobs", NULL,
+                           CAL_JOBS_TASK_PRIORITY, NETWORK_CORE)) {
+        ESP_LOGE(TAG, "Failed to create calibration job worker");
+        vQueueDelete(job_queue);
+        job_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    command_register_table(job_commands, sizeof(job_commands) / sizeof(job_commands[0]));
+    ESP_LOGI(TAG, "Calibration jobs ready (queue depth %d)", CAL_JOB_QUEUE_DEPTH);
+    return ESP_OK;
+}
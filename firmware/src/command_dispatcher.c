@@ -0,0 +1,298 @@
+#include "command_dispatcher.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CMD";
+
+#define CMD_MAX_NAME_LENGTH 32
+
+// Sorted by name; filled at init time, read by the receiver task
+static const command_def_t *registry[MAX_COMMANDS];
+static size_t registry_count = 0;
+static portMUX_TYPE registry_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t command_register_table(const command_def_t *commands, size_t count) {
+    esp_err_t result = ESP_OK;
+
+    portENTER_CRITICAL(&registry_lock);
+    for (size_t c = 0; c < count; c++) {
+        const command_def_t *command = &commands[c];
+        if (registry_count >= MAX_COMMANDS) {
+            result = ESP_ERR_NO_MEM;
+            break;
+        }
+
+        // Insertion keeps the registry sorted for binary search
+        size_t pos = registry_count;
+        while (pos > 0 && strcmp(registry[pos - 1]->name, command->name) > 0) {
+            pos--;
+        }
+        if (pos > 0 && strcmp(registry[pos - 1]->name, command->name) == 0) {
+            if (registry[pos - 1] != command) {
+                result = ESP_ERR_INVALID_STATE;  // Duplicate name, first one wins
+            }
+            continue;  // Re-registering the same table (module restart) is a no-op
+        }
+        memmove(&registry[pos + 1], &registry[pos], (registry_count - pos) * sizeof(registry[0]));
+        registry[pos] = command;
+        registry_count++;
+    }
+    portEXIT_CRITICAL(&registry_lock);
+
+    if (result == ESP_ERR_NO_MEM) {
+        ESP_LOGE(TAG, "Command registry full (%d)", MAX_COMMANDS);
+    } else if (result == ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(TAG, "Duplicate command name ignored");
+    }
+    return result;
+}
+
+static const command_def_t *find_command(const char *name) {
+    const command_def_t *found = NULL;
+
+    portENTER_CRITICAL(&registry_lock);
+    size_t low = 0, high = registry_count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        int cmp = strcmp(registry[mid]->name, name);
+        if (cmp == 0) {
+            found = registry[mid];
+            break;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    portEXIT_CRITICAL(&registry_lock);
+
+    return found;
+}
+
+static bool parse_args(const char *spec, const char *text, cmd_args_t *args) {
+    args->count = 0;
+    if (!spec) spec = "";
+
+    // Copy so tokens can be terminated in place; the command itself stays const
+    size_t length = text ? strlen(text) : 0;
+    if (length >= sizeof(args->buffer)) {
+        return false;
+    }
+    memcpy(args->buffer, text ? text : "", length + 1);
+
+    char *cursor = (length > 0) ? args->buffer : NULL;
+    bool optional = false;
+
+    for (const char *type = spec; *type; type++) {
+        if (*type == '?') {
+            optional = true;
+            continue;
+        }
+        if (!cursor) {
+            return optional;  // Ran out of input: fine only for optional arguments
+        }
+        if (args->count >= CMD_MAX_ARGS) {
+            return false;
+        }
+
+        char *token = cursor;
+        char *comma = strchr(cursor, ',');
+        if (comma) {
+            *comma = '\0';
+            cursor = comma + 1;
+        } else {
+            cursor = NULL;
+        }
+
+        char *end = NULL;
+        cmd_arg_t *value = &args->values[args->count];
+        switch (*type) {
+            // Out of range is an error, not a saturated value (long is 32 bits here)
+            case 'i': {
+                errno = 0;
+                long parsed = strtol(token, &end, 10);
+                if (errno == ERANGE) return false;
+                value->i = (int32_t)parsed;
+                break;
+            }
+            case 'u': {
+                if (*token == '-') return false;
+                errno = 0;
+                unsigned long parsed = strtoul(token, &end, 10);
+                if (errno == ERANGE) return false;
+                value->u = (uint32_t)parsed;
+                break;
+            }
+            case 'f':
+                errno = 0;
+                value->f = strtof(token, &end);
+                if (errno == ERANGE || !isfinite(value->f)) return false;  // Also "nan", "inf"
+                break;
+            case 's':
+                value->s = token;
+                end = token + strlen(token);
+                if (end == token) return false;
+                break;
+            default:
+                return false;
+        }
+
+        // The whole token must be consumed - "12abc" is not an integer
+        if (end == token || *end != '\0') {
+            return false;
+        }
+        args->count++;
+    }
+
+    return cursor == NULL;  // Trailing, unexpected arguments are an error
+}
+
+// Splits NAME from the argument text; returns false if NAME cannot be a command.
+// stray is set when text follows NAME without the ':' that starts arguments
+static bool split_command(const char *command, char *name, size_t name_size, const char **arg_text,
+                          bool *stray) {
+    // Exact token match: NAME ends at ':' or at trailing whitespace
+    size_t n = 0;
+    while (command[n] && command[n] != ':' && command[n] != '\r' && command[n] != '\n' &&
+           command[n] != ' ' && n < name_size - 1) {
+        name[n] = command[n];
+        n++;
+    }
+    name[n] = '\0';
+
+    *arg_text = NULL;
+    *stray = false;
+    if (command[n] == ':') {
+        *arg_text = command + n + 1;
+    } else if (command[n] != '\0' && command[n] != '\r' && command[n] != '\n' && command[n] != ' ') {
+        return false;  // Name too long to be a command
+    } else {
+        for (const char *rest = command + n; *rest; rest++) {
+            if (*rest != '\r' && *rest != '\n' && *rest != ' ') {
+                *stray = true;  // "RELAY_ON garbage"
+            }
+        }
+    }
+    return n > 0;
+}
+
+static size_t run_command(const command_def_t *def, const char *command, const char *arg_text,
+                          bool stray, const cmd_context_t *ctx, char *response, size_t response_size) {
+    if (!def) {
+        ESP_LOGW(TAG, "Unknown command: %s", command);
+        return cmd_reply(response, response_size, "ERROR:UNKNOWN_COMMAND:%s", command);
+    }
+
+    if (stray) {
+        return cmd_reply(response, response_size, "%s:ERROR,INVALID_ARGUMENTS", def->name);
+    }
+
+    // Strip the line ending some clients append
+    cmd_args_t args;
+    char trimmed[CMD_ARG_BUFFER_SIZE];
+    if (arg_text) {
+        // Too long to hold is refused rather than cut short
+        size_t length = strnlen(arg_text, sizeof(trimmed));
+        if (length >= sizeof(trimmed)) {
+            return cmd_reply(response, response_size, "%s:ERROR,INVALID_ARGUMENTS", def->name);
+        }
+        memcpy(trimmed, arg_text, length);
+        while (length > 0 && (trimmed[length - 1] == '\r' || trimmed[length - 1] == '\n' ||
+                              trimmed[length - 1] == ' ')) {
+            length--;
+        }
+        trimmed[length] = '\0';
+        arg_text = trimmed;
+    }
+
+    if (!parse_args(def->arg_spec, arg_text, &args)) {
+        return cmd_reply(response, response_size, "%s:ERROR,INVALID_ARGUMENTS", def->name);
+    }
+
+    ESP_LOGI(TAG, "Command: %s", command);
+    return def->handler(&args, ctx, response, response_size);
+}
+
+size_t command_dispatch(const char *command, const cmd_context_t *ctx,
+                        char *response, size_t response_size) {
+    if (!command || !response || response_size == 0) {
+        return 0;
+    }
+    response[0] = '\0';
+
+    char name[CMD_MAX_NAME_LENGTH];
+    const char *arg_text;
+    bool stray;
+    const command_def_t *def = NULL;
+    if (split_command(command, name, sizeof(name), &arg_text, &stray)) {
+        def = find_command(name);
+    }
+    return run_command(def, command, arg_text, stray, ctx, response, response_size);
+}
+
+size_t command_dispatch_table(const command_def_t *commands, size_t count,
+                              const char *command, const cmd_context_t *ctx,
+                              char *response, size_t response_size) {
+    if (!commands || !command || !response || response_size == 0) {
+        return 0;
+    }
+    response[0] = '\0';
+
+    char name[CMD_MAX_NAME_LENGTH];
+    const char *arg_text;
+    bool stray;
+    const command_def_t *def = NULL;
+    if (split_command(command, name, sizeof(name), &arg_text, &stray)) {
+        for (size_t i = 0; i < count && !def; i++) {
+            if (strcmp(commands[i].name, name) == 0) {
+                def = &commands[i];
+            }
+        }
+    }
+    return run_command(def, command, arg_text, stray, ctx, response, response_size);
+}
+
+size_t command_list(char *buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return 0;
+
+    size_t used = 0;
+
+    portENTER_CRITICAL(&registry_lock);
+    for (size_t i = 0; i < registry_count; i++) {
+        size_t length = strlen(registry[i]->name);
+        size_t separator = (i > 0) ? 2 : 0;
+        if (used + separator + length >= buffer_size) {
+            break;
+        }
+        if (separator) {
+            memcpy(buffer + used, ", ", separator);
+            used += separator;
+        }
+        memcpy(buffer + used, registry[i]->name, length);
+        used += length;
+    }
+    portEXIT_CRITICAL(&registry_lock);
+
+    buffer[used] = '\0';
+    return used;
+}
+
+size_t cmd_reply(char *response, size_t response_size, const char *format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    int length = vsnprintf(response, response_size, format, ap);
+    va_end(ap);
+
+    if (length < 0) {
+        response[0] = '\0';
+        return 0;
+    }
+    return ((size_t)length < response_size) ? (size_t)length : response_size - 1;
+}
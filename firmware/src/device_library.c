@@ -0,0 +1,519 @@
+#include "device_library.h"
+#include "load_events.h"
+#include "power_quality.h"
+#include "command_dispatcher.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "DEVICE_LIBRARY";
+
+#define DEVLIB_NVS_NAMESPACE "devlib"
+#define DEVLIB_RECORD_VERSION 1
+#define DEVLIB_PAGES (DEVLIB_MAX_PROFILES / DEVLIB_PAGE_PROFILES)
+#define DEVLIB_UNKNOWN 0xFF
+#define DEVLIB_LIST_ENTRIES 10          // Profiles per SIGNATURES reply
+
+// Harmonic analysis window must start after the change has settled
+#define DEVLIB_SETTLE_MS (LOAD_EVENT_SETTLE_CYCLES * 1000 / MAINS_FREQUENCY_HZ)
+
+// Harmonic orders of the fingerprint, as indices into pq_result_t.harmonic_amps
+static const int harmonic_index[DEVLIB_HARMONIC_FEATURES] = { 2, 4, 6 };
+
+// Stored form, also the RAM form - 30 bytes, so hundreds fit in the NVS partition
+typedef struct __attribute__((packed)) {
+    uint16_t id;                    // Slot + 1; 0 = free
+    uint16_t samples;               // Observations merged in
+    char name[DEVLIB_NAME_LEN];
+    uint16_t steady_centiamps;
+    uint16_t spread_centiamps;      // Standard deviation of the observed steady current
+    uint8_t inrush_tenths;          // 0 = unknown (a ratio is at least 1)
+    uint8_t harmonic_half_percent[DEVLIB_HARMONIC_FEATURES];  // DEVLIB_UNKNOWN = unknown
+    uint8_t duty_254;               // DEVLIB_UNKNOWN = unknown
+    uint8_t reserved;
+} stored_profile_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t version;
+    uint16_t size;
+    stored_profile_t profiles[DEVLIB_PAGE_PROFILES];
+} profile_page_t;
+
+_Static_assert(sizeof(stored_profile_t) == 30, "stored profile layout changed");
+_Static_assert(DEVLIB_MAX_PROFILES % DEVLIB_PAGE_PROFILES == 0, "partial profile page");
+
+static stored_profile_t profiles[DEVLIB_MAX_PROFILES];
+static uint16_t index_order[DEVLIB_MAX_PROFILES];  // Slots by ascending steady current
+static int profile_count = 0;
+static uint16_t widest_spread_centiamps = 0;
+static SemaphoreHandle_t library_mutex = NULL;
+
+// === ENCODING ===
+static uint8_t encode_unit(float value, float per_unit, uint8_t max_value) {
+    if (isnan(value)) {
+        return DEVLIB_UNKNOWN;
+    }
+    float scaled = roundf(value * per_unit);
+    return (uint8_t)(scaled < 0.0f ? 0.0f : (scaled > max_value ? max_value : scaled));
+}
+
+static float decode_unit(uint8_t value, float per_unit) {
+    return (value == DEVLIB_UNKNOWN) ? NAN : value / per_unit;
+}
+
+static uint16_t encode_centiamps(float amps) {
+    float centiamps = roundf(amps * 100.0f);
+    return (uint16_t)(centiamps < 0.0f ? 0.0f : (centiamps > UINT16_MAX ? UINT16_MAX : centiamps));
+}
+
+static void encode_signature(stored_profile_t* profile, const device_signature_t* signature) {
+    profile->steady_centiamps = encode_centiamps(signature->steady_amps);
+    profile->inrush_tenths = isnan(signature->inrush_ratio) ? 0 :
+                             encode_unit(fmaxf(signature->inrush_ratio, 1.0f), 10.0f, DEVLIB_UNKNOWN - 1);
+    for (int k = 0; k < DEVLIB_HARMONIC_FEATURES; k++) {
+        profile->harmonic_half_percent[k] = encode_unit(signature->harmonic_ratio[k], 200.0f,
+                                                        DEVLIB_UNKNOWN - 1);
+    }
+    profile->duty_254 = encode_unit(signature->duty_cycle, 254.0f, 254);
+}
+
+static void decode_signature(const stored_profile_t* profile, device_signature_t* signature) {
+    signature->steady_amps = profile->steady_centiamps / 100.0f;
+    signature->inrush_ratio = profile->inrush_tenths ? profile->inrush_tenths / 10.0f : NAN;
+    for (int k = 0; k < DEVLIB_HARMONIC_FEATURES; k++) {
+        signature->harmonic_ratio[k] = decode_unit(profile->harmonic_half_percent[k], 200.0f);
+    }
+    signature->duty_cycle = decode_unit(profile->duty_254, 254.0f);
+}
+
+// === INDEX ===
+// Steady-current distance that counts as one unit for this profile
+static float steady_scale(const stored_profile_t* profile) {
+    float steady = profile->steady_centiamps / 100.0f;
+    float scale = fmaxf(DEVLIB_MIN_SPREAD_AMPS, DEVLIB_RELATIVE_SPREAD * steady);
+    return fmaxf(scale, profile->spread_centiamps / 100.0f);
+}
+
+// First index_order position with steady current >= centiamps
+static int index_lower_bound(uint16_t centiamps) {
+    int low = 0;
+    int high = profile_count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (profiles[index_order[mid]].steady_centiamps < centiamps) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static void index_insert(uint16_t slot) {
+    int position = index_lower_bound(profiles[slot].steady_centiamps);
+    memmove(&index_order[position + 1], &index_order[position],
+            (profile_count - position) * sizeof(index_order[0]));
+    index_order[position] = slot;
+    profile_count++;
+    if (profiles[slot].spread_centiamps > widest_spread_centiamps) {
+        widest_spread_centiamps = profiles[slot].spread_centiamps;
+    }
+}
+
+static void index_remove(uint16_t slot) {
+    int position = 0;
+    while (position < profile_count && index_order[position] != slot) {
+        position++;
+    }
+    if (position == profile_count) {
+        return;
+    }
+    profile_count--;
+    memmove(&index_order[position], &index_order[position + 1],
+            (profile_count - position) * sizeof(index_order[0]));
+
+    widest_spread_centiamps = 0;
+    for (int i = 0; i < profile_count; i++) {
+        uint16_t spread = profiles[index_order[i]].spread_centiamps;
+        if (spread > widest_spread_centiamps) {
+            widest_spread_centiamps = spread;
+        }
+    }
+}
+
+static float feature_distance(const device_signature_t* a, const stored_profile_t* profile) {
+    device_signature_t b;
+    decode_signature(profile, &b);
+    return device_signature_distance(a, &b, steady_scale(profile));
+}
+
+// === PERSISTENCE ===
+// Caller holds library_mutex
+static bool write_page(int page) {
+    static profile_page_t record;
+    record.version = DEVLIB_RECORD_VERSION;
+    record.size = sizeof(record);
+    memcpy(record.profiles, &profiles[page * DEVLIB_PAGE_PROFILES], sizeof(record.profiles));
+
+    bool empty = true;
+    for (int i = 0; i < DEVLIB_PAGE_PROFILES && empty; i++) {
+        empty = record.profiles[i].id == 0;
+    }
+
+    char key[8];
+    snprintf(key, sizeof(key), "page%02d", page);
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(DEVLIB_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret == ESP_OK) {
+        if (empty) {
+            ret = nvs_erase_key(handle, key);
+            if (ret == ESP_ERR_NVS_NOT_FOUND) {
+                ret = ESP_OK;
+            }
+        } else {
+            ret = nvs_set_blob(handle, key, &record, sizeof(record));
+        }
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Profile page %d not saved: %s", page, esp_err_to_name(ret));
+        return false;
+    }
+    return true;
+}
+
+static void load_pages(void) {
+    nvs_handle_t handle;
+    if (nvs_open(DEVLIB_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+
+    static profile_page_t record;
+    for (int page = 0; page < DEVLIB_PAGES; page++) {
+        char key[8];
+        snprintf(key, sizeof(key), "page%02d", page);
+        size_t size = sizeof(record);
+        if (nvs_get_blob(handle, key, &record, &size) != ESP_OK || size != sizeof(record) ||
+            record.version != DEVLIB_RECORD_VERSION || record.size != sizeof(record)) {
+            continue;
+        }
+        for (int i = 0; i < DEVLIB_PAGE_PROFILES; i++) {
+            uint16_t slot = page * DEVLIB_PAGE_PROFILES + i;
+            if (record.profiles[i].id != slot + 1) {
+                continue;
+            }
+            profiles[slot] = record.profiles[i];
+            profiles[slot].name[DEVLIB_NAME_LEN - 1] = '\0';
+            index_insert(slot);
+        }
+    }
+    nvs_close(handle);
+}
+
+// === CAPTURE AND MATCH ===
+bool device_library_capture(device_signature_t* signature, uint32_t wait_ms) {
+    load_state_t state;
+    if (!load_events_get_state(&state)) {
+        device_signature_init(signature, 0.0f);
+        return false;
+    }
+    device_signature_init(signature, state.amps);
+    signature->inrush_ratio = state.inrush_ratio;
+    signature->duty_cycle = state.duty_cycle;
+
+    // Only an analysis of the settled level describes this load
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uint32_t settled_ms = now_ms - state.steady_ms + DEVLIB_SETTLE_MS;
+    pq_result_t result;
+    if (state.amps >= LOAD_EVENT_OFF_AMPS &&
+        power_quality_refresh(settled_ms, &result, wait_ms) &&
+        result.harmonic_amps[0] >= PQ_MIN_FUNDAMENTAL_AMPS) {
+        for (int k = 0; k < DEVLIB_HARMONIC_FEATURES; k++) {
+            if (harmonic_index[k] < result.harmonic_count) {
+                signature->harmonic_ratio[k] = result.harmonic_amps[harmonic_index[k]] /
+                                               result.harmonic_amps[0];
+            }
+        }
+    }
+    return true;
+}
+
+bool device_library_match(const device_signature_t* signature, device_match_t* match) {
+    if (!library_mutex || !signature || !match) {
+        return false;
+    }
+
+    // Every profile whose own scale could reach the query lies inside this window;
+    // the widest spread changes with every edit, so it is read under the lock
+    xSemaphoreTake(library_mutex, portMAX_DELAY);
+    float x = signature->steady_amps;
+    float widest = fmaxf(DEVLIB_MIN_SPREAD_AMPS, widest_spread_centiamps / 100.0f);
+    float low = fminf(x - DEVLIB_INDEX_SCALES * widest,
+                      x / (1.0f + DEVLIB_INDEX_SCALES * DEVLIB_RELATIVE_SPREAD));
+    float high = fmaxf(x + DEVLIB_INDEX_SCALES * widest,
+                       x / (1.0f - DEVLIB_INDEX_SCALES * DEVLIB_RELATIVE_SPREAD));
+    uint16_t high_centiamps = encode_centiamps(high);
+
+    float best = INFINITY;
+    int best_slot = -1;
+    for (int i = index_lower_bound(encode_centiamps(low)); i < profile_count; i++) {
+        const stored_profile_t* profile = &profiles[index_order[i]];
+        if (profile->steady_centiamps > high_centiamps) {
+            break;
+        }
+        float steady_units = fabsf(x - profile->steady_centiamps / 100.0f) / steady_scale(profile);
+        if (steady_units > DEVLIB_INDEX_SCALES) {
+            continue;
+        }
+        float distance = feature_distance(signature, profile);
+        if (distance < best) {
+            best = distance;
+            best_slot = index_order[i];
+        }
+    }
+    if (best_slot >= 0) {
+        match->id = profiles[best_slot].id;
+        memcpy(match->name, profiles[best_slot].name, DEVLIB_NAME_LEN);
+        match->steady_amps = profiles[best_slot].steady_centiamps / 100.0f;
+        match->confidence = device_signature_confidence(best);
+    }
+    xSemaphoreGive(library_mutex);
+    return best_slot >= 0;
+}
+
+// === EDITING ===
+// Running mean; an unknown side takes the other's value
+static float merge_feature(float mean, float value, uint16_t samples) {
+    if (isnan(value)) return mean;
+    if (isnan(mean)) return value;
+    return mean + (value - mean) / (samples + 1);
+}
+
+uint16_t device_library_learn(const char* name, const device_signature_t* signature) {
+    if (!library_mutex || !name || name[0] == '\0' || !signature ||
+        isnan(signature->steady_amps) || signature->steady_amps < LOAD_EVENT_OFF_AMPS ||
+        signature->steady_amps > MAX_CURRENT_AMPS) {
+        return 0;
+    }
+
+    xSemaphoreTake(library_mutex, portMAX_DELAY);
+    int slot = -1;
+    int free_slot = -1;
+    for (int i = 0; i < DEVLIB_MAX_PROFILES && slot < 0; i++) {
+        if (profiles[i].id == 0) {
+            if (free_slot < 0) free_slot = i;
+        } else if (strncmp(profiles[i].name, name, DEVLIB_NAME_LEN - 1) == 0) {
+            slot = i;
+        }
+    }
+
+    stored_profile_t profile;
+    if (slot >= 0) {
+        // Same device again - fold the observation into the profile
+        device_signature_t mean;
+        decode_signature(&profiles[slot], &mean);
+        uint16_t n = profiles[slot].samples;
+        float spread = profiles[slot].spread_centiamps / 100.0f;
+        float old_mean = mean.steady_amps;
+        mean.steady_amps = merge_feature(old_mean, signature->steady_amps, n);
+        float variance = (n * spread * spread +
+                          (signature->steady_amps - old_mean) * (signature->steady_amps - mean.steady_amps)) /
+                         (n + 1);
+        mean.inrush_ratio = merge_feature(mean.inrush_ratio, signature->inrush_ratio, n);
+        for (int k = 0; k < DEVLIB_HARMONIC_FEATURES; k++) {
+            mean.harmonic_ratio[k] = merge_feature(mean.harmonic_ratio[k], signature->harmonic_ratio[k], n);
+        }
+        mean.duty_cycle = merge_feature(mean.duty_cycle, signature->duty_cycle, n);
+
+        profile = profiles[slot];
+        encode_signature(&profile, &mean);
+        profile.spread_centiamps = encode_centiamps(sqrtf(variance > 0.0f ? variance : 0.0f));
+        if (profile.samples < UINT16_MAX) profile.samples++;
+        index_remove(slot);
+    } else if (free_slot >= 0) {
+        slot = free_slot;
+        memset(&profile, 0, sizeof(profile));
+        profile.id = slot + 1;
+        profile.samples = 1;
+        strncpy(profile.name, name, DEVLIB_NAME_LEN - 1);
+        encode_signature(&profile, signature);
+    } else {
+        xSemaphoreGive(library_mutex);
+        return 0;
+    }
+
+    profiles[slot] = profile;
+    index_insert(slot);
+    write_page(slot / DEVLIB_PAGE_PROFILES);
+    xSemaphoreGive(library_mutex);
+
+    ESP_LOGI(TAG, "Profile #%u %s: %.2f A (%u samples)", profile.id, profile.name,
+             profile.steady_centiamps / 100.0f, profile.samples);
+    return profile.id;
+}
+
+bool device_library_remove(uint16_t id) {
+    if (!library_mutex || id == 0 || id > DEVLIB_MAX_PROFILES) {
+        return false;
+    }
+
+    xSemaphoreTake(library_mutex, portMAX_DELAY);
+    uint16_t slot = id - 1;
+    bool found = profiles[slot].id == id;
+    if (found) {
+        index_remove(slot);
+        memset(&profiles[slot], 0, sizeof(profiles[slot]));
+        write_page(slot / DEVLIB_PAGE_PROFILES);
+    }
+    xSemaphoreGive(library_mutex);
+    return found;
+}
+
+int device_library_count(void) {
+    return profile_count;
+}
+
+// === COMMANDS ===
+static size_t format_signature(char* buffer, size_t buffer_size, const device_signature_t* signature) {
+    size_t length = cmd_reply(buffer, buffer_size, "AMPS=%.2f", signature->steady_amps);
+    if (!isnan(signature->inrush_ratio)) {
+        length += cmd_reply(buffer + length, buffer_size - length, ",INRUSH=%.1f", signature->inrush_ratio);
+    }
+    if (!isnan(signature->harmonic_ratio[0])) {
+        length += cmd_reply(buffer + length, buffer_size - length, ",H=");
+        for (int k = 0; k < DEVLIB_HARMONIC_FEATURES; k++) {
+            length += cmd_reply(buffer + length, buffer_size - length, "%s%.1f",
+                                k ? "|" : "", signature->harmonic_ratio[k] * 100.0f);
+        }
+    }
+    if (!isnan(signature->duty_cycle)) {
+        length += cmd_reply(buffer + length, buffer_size - length, ",DUTY=%.2f", signature->duty_cycle);
+    }
+    return length;
+}
+
+// SIGNATURE_LEARN:name - the present load, with a fresh harmonic analysis
+CMD_HANDLER(cmd_signature_learn) {
+    device_signature_t signature;
+    if (!device_library_capture(&signature, DEVLIB_HARMONIC_WAIT_MS) ||
+        signature.steady_amps < LOAD_EVENT_OFF_AMPS) {
+        return cmd_reply(response, response_size, "SIGNATURE_LEARN:ERROR,NO_LOAD");
+    }
+    uint16_t id = device_library_learn(args->values[0].s, &signature);
+    if (id == 0) {
+        return cmd_reply(response, response_size, "SIGNATURE_LEARN:ERROR,INVALID_OR_FULL,MAX=%d",
+                         DEVLIB_MAX_PROFILES);
+    }
+    size_t length = cmd_reply(response, response_size, "SIGNATURE_LEARN:SUCCESS,ID=%u,", id);
+    return length + format_signature(response + length, response_size - length, &signature);
+}
+
+// SIGNATURE_ADD:name,amps[,inrush_ratio[,duty_cycle]]
+CMD_HANDLER(cmd_signature_add) {
+    device_signature_t signature;
+    device_signature_init(&signature, args->values[1].f);
+    if (args->count > 2) signature.inrush_ratio = args->values[2].f;
+    if (args->count > 3) signature.duty_cycle = args->values[3].f;
+
+    if ((!isnan(signature.inrush_ratio) && signature.inrush_ratio < 1.0f) ||
+        (!isnan(signature.duty_cycle) && (signature.duty_cycle < 0.0f || signature.duty_cycle > 1.0f))) {
+        return cmd_reply(response, response_size, "SIGNATURE_ADD:ERROR,INVALID_RANGE");
+    }
+    uint16_t id = device_library_learn(args->values[0].s, &signature);
+    if (id == 0) {
+        return cmd_reply(response, response_size, "SIGNATURE_ADD:ERROR,INVALID_OR_FULL,MAX=%d",
+                         DEVLIB_MAX_PROFILES);
+    }
+    return cmd_reply(response, response_size, "SIGNATURE_ADD:SUCCESS,ID=%u,NAME=%s", id, args->values[0].s);
+}
+
+CMD_HANDLER(cmd_signature_remove) {
+    if (!device_library_remove((uint16_t)args->values[0].u)) {
+        return cmd_reply(response, response_size, "SIGNATURE_REMOVE:ERROR,UNKNOWN_ID");
+    }
+    return cmd_reply(response, response_size, "SIGNATURE_REMOVE:SUCCESS,ID=%lu", args->values[0].u);
+}
+
+// SIGNATURES[:first_id] - a page at a time; NEXT is the id to continue from
+CMD_HANDLER(cmd_signatures) {
+    uint32_t first = (args->count > 0 && args->values[0].u > 0) ? args->values[0].u : 1;
+    size_t length = cmd_reply(response, response_size, "SIGNATURES:COUNT=%d,MAX=%d",
+                              profile_count, DEVLIB_MAX_PROFILES);
+
+    int shown = 0;
+    uint32_t next = 0;
+    xSemaphoreTake(library_mutex, portMAX_DELAY);
+    for (uint32_t slot = first - 1; slot < DEVLIB_MAX_PROFILES; slot++) {
+        const stored_profile_t* profile = &profiles[slot];
+        if (profile->id == 0) {
+            continue;
+        }
+        if (shown == DEVLIB_LIST_ENTRIES) {
+            next = profile->id;
+            break;
+        }
+        device_signature_t signature;
+        decode_signature(profile, &signature);
+        length += cmd_reply(response + length, response_size - length, ";#%u,%s,N=%u,",
+                            profile->id, profile->name, profile->samples);
+        length += format_signature(response + length, response_size - length, &signature);
+        shown++;
+    }
+    xSemaphoreGive(library_mutex);
+
+    if (next) {
+        length += cmd_reply(response + length, response_size - length, ";NEXT=%lu", next);
+    }
+    return length;
+}
+
+CMD_HANDLER(cmd_signature_match) {
+    device_signature_t signature;
+    if (!device_library_capture(&signature, 0)) {
+        return cmd_reply(response, response_size, "SIGNATURE_MATCH:NOT_READY");
+    }
+    size_t length = cmd_reply(response, response_size, "SIGNATURE_MATCH:");
+    length += format_signature(response + length, response_size - length, &signature);
+
+    device_match_t match;
+    if (!device_library_match(&signature, &match)) {
+        return length + cmd_reply(response + length, response_size - length, ";MATCH=NONE");
+    }
+    return length + cmd_reply(response + length, response_size - length,
+                              ";MATCH=#%u,%s,PROFILE_AMPS=%.2f,CONFIDENCE=%.2f",
+                              match.id, match.name, match.steady_amps, match.confidence);
+}
+
+static const command_def_t device_library_commands[] = {
+    { "SIGNATURE_LEARN",  "s",     cmd_signature_learn },
+    { "SIGNATURE_ADD",    "sf?ff", cmd_signature_add },
+    { "SIGNATURE_REMOVE", "u",     cmd_signature_remove },
+    { "SIGNATURES",       "?u",    cmd_signatures },
+    { "SIGNATURE_MATCH",  NULL,    cmd_signature_match },
+};
+
+esp_err_t device_library_init(void) {
+    if (library_mutex) {
+        return ESP_OK;
+    }
+    library_mutex = xSemaphoreCreateMutex();
+    if (!library_mutex) {
+        ESP_LOGE(TAG, "Failed to create library mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    load_pages();
+    command_register_table(device_library_commands,
+                           sizeof(device_library_commands) / sizeof(device_library_commands[0]));
+    ESP_LOGI(TAG, "Device library: %d of %d profiles", profile_count, DEVLIB_MAX_PROFILES);
+    return ESP_OK;
+}
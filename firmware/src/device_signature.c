@@ -0,0 +1,36 @@
+#include "device_signature.h"
+
+void device_signature_init(device_signature_t* signature, float steady_amps) {
+    signature->steady_amps = steady_amps;
+    signature->inrush_ratio = NAN;
+    for (int k = 0; k < DEVLIB_HARMONIC_FEATURES; k++) {
+        signature->harmonic_ratio[k] = NAN;
+    }
+    signature->duty_cycle = NAN;
+}
+
+float device_signature_distance(const device_signature_t* a, const device_signature_t* b,
+                                float steady_scale) {
+    float d = (a->steady_amps - b->steady_amps) / steady_scale;
+    float sum = d * d;
+    int features = 1;
+
+    if (!isnan(a->inrush_ratio) && !isnan(b->inrush_ratio)) {
+        d = (a->inrush_ratio - b->inrush_ratio) / DEVLIB_INRUSH_SCALE;
+        sum += d * d;
+        features++;
+    }
+    for (int k = 0; k < DEVLIB_HARMONIC_FEATURES; k++) {
+        if (!isnan(a->harmonic_ratio[k]) && !isnan(b->harmonic_ratio[k])) {
+            d = (a->harmonic_ratio[k] - b->harmonic_ratio[k]) / DEVLIB_HARMONIC_SCALE;
+            sum += d * d;
+            features++;
+        }
+    }
+    if (!isnan(a->duty_cycle) && !isnan(b->duty_cycle)) {
+        d = (a->duty_cycle - b->duty_cycle) / DEVLIB_DUTY_SCALE;
+        sum += d * d;
+        features++;
+    }
+    return sum / features;
+}
@@ -0,0 +1,71 @@
+#include "discovery.h"
+#include "hardware_config.h"
+#include "command_dispatcher.h"
+#include "telemetry_protocol.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "DISCOVERY";
+
+// What this firmware can be asked for - CAPS in the announce line
+#define DISCOVERY_CAPABILITIES "BINARY|STREAM|WAVEFORM|HISTORY|ENERGY|PROTECTION|LOAD_EVENTS|SIGNATURES|TEMP_COMP|SUBSCRIBE|RELAY_CHANNEL"
+
+static char device_id[13] = "000000000000";
+
+// Station address when connected, otherwise the fallback AP's
+static void current_ip(char* buffer, size_t buffer_size) {
+    static const char* const interfaces[] = { "WIFI_STA_DEF", "WIFI_AP_DEF" };
+    for (size_t i = 0; i < sizeof(interfaces) / sizeof(interfaces[0]); i++) {
+        esp_netif_t* netif = esp_netif_get_handle_from_ifkey(interfaces[i]);
+        esp_netif_ip_info_t info;
+        if (netif && esp_netif_get_ip_info(netif, &info) == ESP_OK && info.ip.addr != 0) {
+            struct in_addr addr = { .s_addr = info.ip.addr };
+            inet_ntoa_r(addr, buffer, buffer_size);
+            return;
+        }
+    }
+    snprintf(buffer, buffer_size, "0.0.0.0");
+}
+
+const char* discovery_device_id(void) {
+    return device_id;
+}
+
+size_t discovery_format_announce(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return 0;
+
+    char ip[16];
+    current_ip(ip, sizeof(ip));
+    return cmd_reply(buffer, buffer_size,
+                     "ANNOUNCE:ID=%s,FW=%s,PROTO=%d,CAPS=%s,IP=%s,CMD_PORT=%d,RELAY_PORT=%d,UPTIME_S=%lu",
+                     device_id, FIRMWARE_VERSION, TELEMETRY_VERSION, DISCOVERY_CAPABILITIES, ip,
+                     UDP_RECV_PORT, UDP_RELAY_PORT, (uint32_t)(esp_timer_get_time() / 1000000));
+}
+
+// === COMMANDS ===
+CMD_HANDLER(cmd_discover) {
+    return discovery_format_announce(response, response_size);
+}
+
+static const command_def_t discovery_commands[] = {
+    { "DISCOVER", NULL, cmd_discover },
+};
+
+esp_err_t discovery_init(void) {
+    uint8_t mac[6];
+    esp_err_t ret = esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    if (ret == ESP_OK) {
+        snprintf(device_id, sizeof(device_id), "%02X%02X%02X%02X%02X%02X",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    } else {
+        ESP_LOGW(TAG, "MAC unavailable (%s) - device ID not unique", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Device ID %s, firmware %s", device_id, FIRMWARE_VERSION);
+    return command_register_table(discovery_commands, sizeof(discovery_commands) / sizeof(discovery_commands[0]));
+}
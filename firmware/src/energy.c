@@ -0,0 +1,309 @@
+#include "energy.h"
+#include "hardware_config.h"
+#include "rms_engine.h"
+#include "command_dispatcher.h"
+#include "perf_monitor.h"
+#include "task_memory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "ENERGY";
+
+#define ENERGY_NVS_NAMESPACE "energy"
+#define ENERGY_NVS_KEY "state"
+#define ENERGY_RECORD_VERSION 1
+
+#define UWH_PER_WH 1000000.0
+#define SECONDS_PER_HOUR 3600
+#define SECONDS_PER_DAY (24 * SECONDS_PER_HOUR)
+
+// uWh contributed by one output sample at 1 W
+#define UWH_PER_WATT_SAMPLE (1000000.0f / (ADC_OUTPUT_RATE_HZ * (float)SECONDS_PER_HOUR))
+
+// Persisted state - one NVS blob, rejected on version or size mismatch
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    uint32_t resets;
+    uint64_t total_uwh;                          // Lifetime, cleared only by ENERGY_RESET:ALL
+    uint64_t since_reset_uwh;
+    uint64_t on_time_s;                          // Clock the buckets are indexed by
+    uint64_t hour;                               // on_time_s / SECONDS_PER_HOUR of hourly[]'s head
+    uint64_t day;
+    uint64_t hourly_uwh[ENERGY_HOURLY_BUCKETS];  // [hour % N] is the hour in progress
+    uint64_t daily_uwh[ENERGY_DAILY_BUCKETS];
+} energy_record_t;
+
+static energy_record_t state;
+static SemaphoreHandle_t state_mutex = NULL;
+
+// Sampler task -> energy task hand-off, drained once per second
+static uint64_t pending_uwh = 0;
+static float pending_residual_uwh = 0.0f;    // Sampler task only
+static portMUX_TYPE pending_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint64_t on_time_base_s = 0;          // Restored on_time_s at boot
+static float average_power_w = 0.0f;
+static uint64_t checkpoint_total_uwh = 0;
+static int64_t checkpoint_time_us = 0;
+static uint32_t checkpoint_count = 0;
+STATIC_TASK(checkpoint_task, ENERGY_TASK_STACK);
+
+// Runs in the sampler task once per cycle
+static void energy_cycle_callback(const rms_cycle_t* cycle, void* context) {
+    float amps = cycle->vrms * cycle->amps_per_volt;
+    if (amps < ENERGY_NOISE_FLOOR_AMPS) {
+        return;  // Idle noise would otherwise integrate into phantom watt-hours
+    }
+
+    float uwh = amps * LINE_VOLTAGE_RMS * cycle->samples * UWH_PER_WATT_SAMPLE + pending_residual_uwh;
+    uint32_t whole = (uint32_t)uwh;
+    pending_residual_uwh = uwh - whole;
+
+    portENTER_CRITICAL(&pending_lock);
+    pending_uwh += whole;
+    portEXIT_CRITICAL(&pending_lock);
+}
+
+// Clears buckets that were skipped, then moves the heads to the current hour/day
+static void advance_buckets(void) {
+    uint64_t hour = state.on_time_s / SECONDS_PER_HOUR;
+    for (uint64_t h = state.hour + 1; h <= hour && h <= state.hour + ENERGY_HOURLY_BUCKETS; h++) {
+        state.hourly_uwh[h % ENERGY_HOURLY_BUCKETS] = 0;
+    }
+    state.hour = hour;
+
+    uint64_t day = state.on_time_s / SECONDS_PER_DAY;
+    for (uint64_t d = state.day + 1; d <= day && d <= state.day + ENERGY_DAILY_BUCKETS; d++) {
+        state.daily_uwh[d % ENERGY_DAILY_BUCKETS] = 0;
+    }
+    state.day = day;
+}
+
+static bool load_checkpoint(void) {
+    nvs_handle_t handle;
+    if (nvs_open(ENERGY_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+
+    energy_record_t record;
+    size_t size = sizeof(record);
+    esp_err_t ret = nvs_get_blob(handle, ENERGY_NVS_KEY, &record, &size);
+    nvs_close(handle);
+
+    if (ret != ESP_OK || size != sizeof(record) ||
+        record.version != ENERGY_RECORD_VERSION || record.size != sizeof(record)) {
+        return false;
+    }
+    state = record;
+    return true;
+}
+
+// Caller holds state_mutex
+static bool write_checkpoint(void) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(ENERGY_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(handle, ENERGY_NVS_KEY, &state, sizeof(state));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    checkpoint_time_us = esp_timer_get_time();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Checkpoint failed: %s", esp_err_to_name(ret));
+        return false;
+    }
+    checkpoint_total_uwh = state.total_uwh;
+    checkpoint_count++;
+    return true;
+}
+
+// Wear-aware policy: batch small changes, never write more often than MIN_S
+static bool checkpoint_due(int64_t now_us) {
+    uint64_t delta_uwh = state.total_uwh - checkpoint_total_uwh;
+    int64_t since_s = (now_us - checkpoint_time_us) / 1000000;
+
+    if (delta_uwh >= (uint64_t)(ENERGY_CHECKPOINT_MIN_WH * UWH_PER_WH)) {
+        return since_s >= ENERGY_CHECKPOINT_MIN_S;
+    }
+    return delta_uwh > 0 && since_s >= ENERGY_CHECKPOINT_MAX_S;
+}
+
+static void energy_task(void *parameters) {
+    PERF_REGISTER_TASK();
+
+    TickType_t last_wake = xTaskGetTickCount();
+    int64_t last_us = esp_timer_get_time();
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(1000));
+
+        portENTER_CRITICAL(&pending_lock);
+        uint64_t drained = pending_uwh;
+        pending_uwh = 0;
+        portEXIT_CRITICAL(&pending_lock);
+
+        int64_t now_us = esp_timer_get_time();
+        float elapsed_s = (now_us - last_us) / 1000000.0f;
+        last_us = now_us;
+        if (elapsed_s > 0.0f) {
+            average_power_w = drained * (SECONDS_PER_HOUR / 1000000.0f) / elapsed_s;
+        }
+
+        xSemaphoreTake(state_mutex, portMAX_DELAY);
+        state.on_time_s = on_time_base_s + (uint64_t)(now_us / 1000000);
+        advance_buckets();
+        state.total_uwh += drained;
+        state.since_reset_uwh += drained;
+        state.hourly_uwh[state.hour % ENERGY_HOURLY_BUCKETS] += drained;
+        state.daily_uwh[state.day % ENERGY_DAILY_BUCKETS] += drained;
+
+        if (checkpoint_due(now_us)) {
+            write_checkpoint();
+        }
+        xSemaphoreGive(state_mutex);
+    }
+}
+
+void energy_checkpoint(void) {
+    if (!state_mutex) return;
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    if (state.total_uwh != checkpoint_total_uwh) {
+        write_checkpoint();
+    }
+    xSemaphoreGive(state_mutex);
+}
+
+double energy_get_total_wh(void) {
+    if (!state_mutex) return 0.0;
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    uint64_t total = state.total_uwh;
+    xSemaphoreGive(state_mutex);
+    return total / UWH_PER_WH;
+}
+
+// Completed buckets oldest first, separated by '|'
+static size_t format_buckets(char* buffer, size_t buffer_size, const uint64_t* buckets,
+                             size_t count, uint64_t head) {
+    size_t length = 0;
+    for (size_t i = 1; i < count; i++) {
+        const uint64_t value = buckets[(head + i) % count];
+        length += cmd_reply(buffer + length, buffer_size - length, "%s%.1f",
+                            i > 1 ? "|" : "", value / UWH_PER_WH);
+    }
+    return length;
+}
+
+void energy_get_stats(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+    if (!state_mutex) {
+        snprintf(buffer, buffer_size, "NOT_INITIALIZED");
+        return;
+    }
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    energy_record_t copy = state;
+    uint32_t checkpoints = checkpoint_count;
+    int64_t checkpoint_age_s = (esp_timer_get_time() - checkpoint_time_us) / 1000000;
+    xSemaphoreGive(state_mutex);
+
+    size_t length = cmd_reply(buffer, buffer_size,
+        "TOTAL_WH=%.3f,TOTAL_KWH=%.4f,SINCE_RESET_WH=%.3f,POWER_W=%.1f,"
+        "HOUR_WH=%.3f,DAY_WH=%.3f,ON_TIME_H=%.2f,HOURLY_WH=",
+        copy.total_uwh / UWH_PER_WH, copy.total_uwh / (UWH_PER_WH * 1000.0),
+        copy.since_reset_uwh / UWH_PER_WH, average_power_w,
+        copy.hourly_uwh[copy.hour % ENERGY_HOURLY_BUCKETS] / UWH_PER_WH,
+        copy.daily_uwh[copy.day % ENERGY_DAILY_BUCKETS] / UWH_PER_WH,
+        copy.on_time_s / (double)SECONDS_PER_HOUR);
+    length += format_buckets(buffer + length, buffer_size - length,
+                             copy.hourly_uwh, ENERGY_HOURLY_BUCKETS, copy.hour);
+    length += cmd_reply(buffer + length, buffer_size - length, ",DAILY_WH=");
+    length += format_buckets(buffer + length, buffer_size - length,
+                             copy.daily_uwh, ENERGY_DAILY_BUCKETS, copy.day);
+    cmd_reply(buffer + length, buffer_size - length,
+              ",RESETS=%lu,CHECKPOINTS=%lu,CHECKPOINT_AGE_S=%lu",
+              copy.resets, checkpoints, (uint32_t)checkpoint_age_s);
+}
+
+// === ENERGY COMMANDS ===
+CMD_HANDLER(cmd_energy_stats) {
+    size_t length = cmd_reply(response, response_size, "ENERGY_STATS:");
+    energy_get_stats(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+// ENERGY_RESET[:ALL] - the lifetime total is a meter reading, kept unless ALL
+CMD_HANDLER(cmd_energy_reset) {
+    bool all = args->count > 0 && strcmp(args->values[0].s, "ALL") == 0;
+    if (args->count > 0 && !all) {
+        return cmd_reply(response, response_size, "ENERGY_RESET:ERROR,INVALID_SCOPE");
+    }
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    if (all) {
+        state.total_uwh = 0;
+    }
+    state.since_reset_uwh = 0;
+    memset(state.hourly_uwh, 0, sizeof(state.hourly_uwh));
+    memset(state.daily_uwh, 0, sizeof(state.daily_uwh));
+    state.resets++;
+    bool saved = write_checkpoint();
+    xSemaphoreGive(state_mutex);
+
+    ESP_LOGI(TAG, "Energy counters reset (%s)", all ? "all" : "since-reset");
+    return cmd_reply(response, response_size, "ENERGY_RESET:SUCCESS,SCOPE=%s,SAVED=%s",
+                     all ? "ALL" : "SINCE_RESET", saved ? "YES" : "NO");
+}
+
+static const command_def_t energy_commands[] = {
+    { "ENERGY_STATS", NULL, cmd_energy_stats },
+    { "ENERGY_RESET", "?s", cmd_energy_reset },
+};
+
+esp_err_t energy_init(void) {
+    if (state_mutex) {
+        return ESP_OK;
+    }
+
+    state_mutex = xSemaphoreCreateMutex();
+    if (!state_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (load_checkpoint()) {
+        ESP_LOGI(TAG, "Restored %.3f Wh (%.1f h on-time)",
+                 state.total_uwh / UWH_PER_WH, state.on_time_s / (double)SECONDS_PER_HOUR);
+    } else {
+        memset(&state, 0, sizeof(state));
+        state.version = ENERGY_RECORD_VERSION;
+        state.size = sizeof(state);
+        ESP_LOGI(TAG, "No energy checkpoint - starting from zero");
+    }
+    on_time_base_s = state.on_time_s;
+    checkpoint_total_uwh = state.total_uwh;
+    checkpoint_time_us = esp_timer_get_time();
+
+    if (rms_engine_subscribe_cycles(energy_cycle_callback, NULL) < 0) {
+        ESP_LOGE(TAG, "No cycle subscriber slot - energy is not accumulated");
+        return ESP_FAIL;
+    }
+    if (!static_task_start(&checkpoint_task, energy_task, "energy", NULL,
+                           ENERGY_TASK_PRIORITY, NETWORK_CORE)) {
+        ESP_LOGE(TAG, "Failed to create energy task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    command_register_table(energy_commands, sizeof(energy_commands) / sizeof(energy_commands[0]));
+    return ESP_OK;
+}
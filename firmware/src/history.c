@@ -0,0 +1,329 @@
+#include "history.h"
+#include "hardware_config.h"
+#include "rms_engine.h"
+#include "telemetry_protocol.h"
+#include "command_dispatcher.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "HISTORY";
+
+typedef struct {
+    float min_amps;
+    float max_amps;
+    float sum_amps;
+    uint32_t count;
+} history_accumulator_t;
+
+// Bucket b lives at records[b % size] and is valid while newest - b < count
+typedef struct {
+    telemetry_history_record_t* records;
+    uint32_t size;
+    uint32_t resolution_s;
+    uint32_t newest;
+    uint32_t count;
+} history_ring_t;
+
+static telemetry_history_record_t second_records[HISTORY_SECONDS];
+static telemetry_history_record_t minute_records[HISTORY_MINUTES];
+static history_ring_t second_ring = { second_records, HISTORY_SECONDS, 1, 0, 0 };
+static history_ring_t minute_ring = { minute_records, HISTORY_MINUTES, 60, 0, 0 };
+static portMUX_TYPE history_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Sampler task state: the second and minute being accumulated
+static uint32_t current_second = UINT32_MAX;
+static history_accumulator_t second_acc;
+static history_accumulator_t minute_acc;
+
+static const telemetry_history_record_t empty_record = {
+    TELEMETRY_HISTORY_EMPTY, TELEMETRY_HISTORY_EMPTY, TELEMETRY_HISTORY_EMPTY
+};
+
+static uint16_t request_counter = 0;
+
+static uint16_t to_centiamps(float amps) {
+    float centiamps = amps * 100.0f + 0.5f;
+    if (centiamps <= 0.0f) return 0;
+    if (centiamps >= TELEMETRY_HISTORY_EMPTY) return TELEMETRY_HISTORY_EMPTY - 1;
+    return (uint16_t)centiamps;
+}
+
+static void accumulator_reset(history_accumulator_t* acc) {
+    acc->min_amps = 0.0f;
+    acc->max_amps = 0.0f;
+    acc->sum_amps = 0.0f;
+    acc->count = 0;
+}
+
+static void accumulator_merge(history_accumulator_t* acc, const history_accumulator_t* other) {
+    if (other->count == 0) return;
+    if (acc->count == 0 || other->min_amps < acc->min_amps) acc->min_amps = other->min_amps;
+    if (acc->count == 0 || other->max_amps > acc->max_amps) acc->max_amps = other->max_amps;
+    acc->sum_amps += other->sum_amps;
+    acc->count += other->count;
+}
+
+// Sampler task; buckets skipped since the last commit are stored as empty
+static void ring_commit(history_ring_t* ring, uint32_t bucket, const history_accumulator_t* acc) {
+    telemetry_history_record_t record = empty_record;
+    if (acc->count > 0) {
+        record.min_centiamps = to_centiamps(acc->min_amps);
+        record.max_centiamps = to_centiamps(acc->max_amps);
+        record.avg_centiamps = to_centiamps(acc->sum_amps / acc->count);
+    }
+
+    portENTER_CRITICAL(&history_lock);
+    if (ring->count == 0) {
+        ring->count = 1;
+    } else if (bucket > ring->newest) {
+        uint32_t gap = bucket - ring->newest;
+        uint32_t fill = (gap - 1 < ring->size) ? gap - 1 : ring->size;
+        for (uint32_t i = 1; i <= fill; i++) {
+            ring->records[(bucket - i) % ring->size] = empty_record;
+        }
+        ring->count = (ring->count + gap < ring->size) ? ring->count + gap : ring->size;
+    } else {
+        portEXIT_CRITICAL(&history_lock);
+        return;
+    }
+    ring->records[bucket % ring->size] = record;
+    ring->newest = bucket;
+    portEXIT_CRITICAL(&history_lock);
+}
+
+// Runs in the sampler task once per cycle
+static void history_cycle_callback(const rms_cycle_t* cycle, void* context) {
+    uint32_t second = (uint32_t)(cycle->timestamp_us / 1000000);
+
+    if (second != current_second) {
+        if (current_second != UINT32_MAX) {
+            ring_commit(&second_ring, current_second, &second_acc);
+            accumulator_merge(&minute_acc, &second_acc);
+            if (second / 60 != current_second / 60) {
+                ring_commit(&minute_ring, current_second / 60, &minute_acc);
+                accumulator_reset(&minute_acc);
+            }
+        }
+        current_second = second;
+        accumulator_reset(&second_acc);
+    }
+
+    float amps = cycle->vrms * cycle->amps_per_volt;
+    history_accumulator_t sample = { amps, amps, amps, 1 };
+    accumulator_merge(&second_acc, &sample);
+}
+
+// Oldest and newest bucket currently held; false when the ring is empty
+static bool ring_bounds(const history_ring_t* ring, uint32_t* oldest, uint32_t* newest) {
+    portENTER_CRITICAL(&history_lock);
+    uint32_t count = ring->count;
+    *newest = ring->newest;
+    portEXIT_CRITICAL(&history_lock);
+
+    *oldest = *newest - (count ? count - 1 : 0);
+    return count > 0;
+}
+
+// Merges group buckets starting at first into one record (empty if none are held)
+static void ring_read(const history_ring_t* ring, uint32_t first, uint32_t group,
+                      telemetry_history_record_t* out) {
+    uint16_t min_ca = TELEMETRY_HISTORY_EMPTY, max_ca = 0;
+    uint32_t sum_ca = 0, filled = 0;
+
+    portENTER_CRITICAL(&history_lock);
+    // Only [max(first, oldest), min(first + group - 1, newest)], so the time under the
+    // lock is bounded by the ring size whatever the group
+    if (ring->count > 0 && first <= ring->newest) {
+        uint32_t oldest = ring->newest - (ring->count - 1);
+        uint32_t last = (ring->newest - first >= group) ? first + group - 1 : ring->newest;
+        for (uint32_t b = (first > oldest) ? first : oldest; b <= last; b++) {
+            const telemetry_history_record_t* record = &ring->records[b % ring->size];
+            if (record->avg_centiamps == TELEMETRY_HISTORY_EMPTY) {
+                continue;
+            }
+            if (record->min_centiamps < min_ca) min_ca = record->min_centiamps;
+            if (record->max_centiamps > max_ca) max_ca = record->max_centiamps;
+            sum_ca += record->avg_centiamps;
+            filled++;
+        }
+    }
+    portEXIT_CRITICAL(&history_lock);
+
+    if (filled == 0) {
+        *out = empty_record;
+        return;
+    }
+    out->min_centiamps = min_ca;
+    out->max_centiamps = max_ca;
+    out->avg_centiamps = (uint16_t)(sum_ca / filled);
+}
+
+static void send_text(const char *text, int sock, struct sockaddr_in *client_addr) {
+    sendto(sock, text, strlen(text), 0, (struct sockaddr*)client_addr, sizeof(*client_addr));
+}
+
+static bool send_frame(telemetry_history_header_t* frame, const telemetry_history_record_t* records,
+                       int sock, struct sockaddr_in* client_addr) {
+    telemetry_header_t header = {
+        .magic = TELEMETRY_MAGIC,
+        .version = TELEMETRY_VERSION,
+        .type = TELEMETRY_FRAME_HISTORY,
+        .length = sizeof(*frame) + frame->record_count * sizeof(*records),
+        .sequence = frame->frame_index,
+        .timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS
+    };
+
+    struct iovec parts[3] = {
+        { &header, sizeof(header) },
+        { frame, sizeof(*frame) },
+        { (void *)records, frame->record_count * sizeof(*records) }
+    };
+    struct msghdr message = {
+        .msg_name = client_addr,
+        .msg_namelen = sizeof(*client_addr),
+        .msg_iov = parts,
+        .msg_iovlen = 3
+    };
+
+    // Back off one tick if the stack is briefly out of buffers
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (sendmsg(sock, &message, 0) >= 0) {
+            return true;
+        }
+        vTaskDelay(1);
+    }
+    return false;
+}
+
+// The receiver task is the only caller, so the frame buffer can be static
+static telemetry_history_record_t frame_records[TELEMETRY_HISTORY_FRAME_RECORDS];
+
+static void perform_history_query(uint32_t from_ms, uint32_t to_ms, uint32_t resolution_s,
+                                  int sock, struct sockaddr_in* client_addr) {
+    char response[192];
+
+    if (to_ms == 0) {
+        to_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    }
+    if (to_ms < from_ms) {
+        send_text("HISTORY:ERROR,INVALID_RANGE", sock, client_addr);
+        return;
+    }
+
+    // Auto resolution: 1 s while the start of the range is still in the 1 s ring
+    uint32_t oldest, newest;
+    if (resolution_s == 0) {
+        bool in_seconds = ring_bounds(&second_ring, &oldest, &newest) && from_ms / 1000 >= oldest;
+        resolution_s = in_seconds ? 1 : minute_ring.resolution_s;
+    }
+
+    const history_ring_t* ring;
+    if (resolution_s < minute_ring.resolution_s) {
+        ring = &second_ring;
+    } else if (resolution_s % minute_ring.resolution_s == 0) {
+        ring = &minute_ring;
+    } else {
+        send_text("HISTORY:ERROR,INVALID_RESOLUTION,USE=1-59|N*60", sock, client_addr);
+        return;
+    }
+    uint32_t group = resolution_s / ring->resolution_s;
+    if (group > ring->size) {
+        snprintf(response, sizeof(response), "HISTORY:ERROR,INVALID_RESOLUTION,MAX_S=%lu",
+                 minute_ring.size * minute_ring.resolution_s);
+        send_text(response, sock, client_addr);
+        return;
+    }
+
+    if (!ring_bounds(ring, &oldest, &newest)) {
+        send_text("HISTORY:ERROR,NO_DATA", sock, client_addr);
+        return;
+    }
+
+    uint32_t first = from_ms / 1000 / ring->resolution_s;
+    uint32_t last = to_ms / 1000 / ring->resolution_s;
+    if (first < oldest) first = oldest;
+    if (last > newest) last = newest;
+    if (first > last) {
+        snprintf(response, sizeof(response), "HISTORY:ERROR,NO_DATA,OLDEST_MS=%lu,NEWEST_MS=%lu",
+                 oldest * ring->resolution_s * 1000, newest * ring->resolution_s * 1000);
+        send_text(response, sock, client_addr);
+        return;
+    }
+
+    uint32_t record_total = (last - first) / group + 1;
+    uint16_t frame_count = (record_total + TELEMETRY_HISTORY_FRAME_RECORDS - 1) /
+                           TELEMETRY_HISTORY_FRAME_RECORDS;
+    uint16_t request_id = ++request_counter;
+
+    snprintf(response, sizeof(response),
+             "HISTORY:START,ID=%u,FROM_MS=%lu,TO_MS=%lu,RESOLUTION_S=%lu,RECORDS=%lu,FRAMES=%u",
+             request_id, first * ring->resolution_s * 1000, last * ring->resolution_s * 1000,
+             resolution_s, record_total, frame_count);
+    send_text(response, sock, client_addr);
+
+    uint16_t sent_frames = 0;
+    uint32_t bucket = first;
+    for (uint16_t f = 0; f < frame_count; f++) {
+        telemetry_history_header_t frame = {
+            .request_id = request_id,
+            .frame_index = f,
+            .frame_count = frame_count,
+            .record_count = 0,
+            .first_time_ms = bucket * ring->resolution_s * 1000,
+            .resolution_s = resolution_s,
+            .reserved = 0
+        };
+
+        while (frame.record_count < TELEMETRY_HISTORY_FRAME_RECORDS && bucket <= last) {
+            ring_read(ring, bucket, group, &frame_records[frame.record_count++]);
+            bucket += group;
+        }
+
+        if (!send_frame(&frame, frame_records, sock, client_addr)) {
+            ESP_LOGW(TAG, "Failed to send history frame %u/%u", f + 1, frame_count);
+            break;
+        }
+        sent_frames++;
+    }
+
+    if (sent_frames < frame_count) {
+        snprintf(response, sizeof(response), "HISTORY:ERROR,ID=%u,SENT=%u/%u",
+                 request_id, sent_frames, frame_count);
+    } else {
+        snprintf(response, sizeof(response), "HISTORY:COMPLETE,ID=%u,FRAMES=%u",
+                 request_id, frame_count);
+    }
+    send_text(response, sock, client_addr);
+}
+
+CMD_HANDLER(cmd_history) {
+    uint32_t resolution_s = (args->count > 2) ? args->values[2].u : 0;
+    perform_history_query(args->values[0].u, args->values[1].u, resolution_s,
+                          ctx->sock, ctx->client_addr);
+    return 0; // Responses and frames sent by perform_history_query
+}
+
+static const command_def_t history_commands[] = {
+    { "HISTORY", "uu?u", cmd_history },
+};
+
+esp_err_t history_init(void) {
+    accumulator_reset(&second_acc);
+    accumulator_reset(&minute_acc);
+
+    if (rms_engine_subscribe_cycles(history_cycle_callback, NULL) < 0) {
+        ESP_LOGE(TAG, "No cycle subscriber slot - history disabled");
+        return ESP_FAIL;
+    }
+
+    command_register_table(history_commands, sizeof(history_commands) / sizeof(history_commands[0]));
+    ESP_LOGI(TAG, "History: %d s at 1 s, %d min at 1 min (%u bytes)",
+             HISTORY_SECONDS, HISTORY_MINUTES,
+             (unsigned)(sizeof(second_records) + sizeof(minute_records)));
+    return ESP_OK;
+}
@@ -0,0 +1,127 @@
+#include "load_detector.h"
+#include "hardware_config.h"
+#include <math.h>
+
+void load_detector_init(load_detector_t *detector, float min_step_amps, float cusum_limit) {
+    *detector = (load_detector_t){
+        .min_step_amps = min_step_amps,
+        .cusum_limit = cusum_limit,
+        .state = LOAD_DETECTOR_SEEDING
+    };
+}
+
+void load_detector_restart(load_detector_t *detector) {
+    detector->state = LOAD_DETECTOR_SEEDING;
+}
+
+float load_detector_step_threshold(const load_detector_t *detector, float level) {
+    return detector->min_step_amps + LOAD_EVENT_RELATIVE_STEP * level;
+}
+
+static void start_steady(load_detector_t *detector, float level) {
+    detector->baseline = level;
+    detector->sum_up = 0.0f;
+    detector->sum_down = 0.0f;
+    detector->state = LOAD_DETECTOR_STEADY;
+}
+
+static void start_settling(load_detector_t *detector, uint32_t onset_index, int64_t onset_us,
+                           float peak, uint32_t cycle_index) {
+    detector->settle_before = detector->baseline;
+    detector->settle_peak = peak;
+    detector->settle_sum = 0.0f;
+    detector->settle_cycles = 0;
+    detector->settle_onset_us = onset_us;
+    uint32_t delay = cycle_index - onset_index;
+    detector->settle_detect_cycles = (uint16_t)(delay < UINT16_MAX ? delay : UINT16_MAX);
+    detector->state = LOAD_DETECTOR_SETTLING;
+}
+
+static load_detect_result_t settle_cycle(load_detector_t *detector, float amps, load_change_t *change) {
+    detector->settle_cycles++;
+    if (amps > detector->settle_peak) {
+        detector->settle_peak = amps;
+    }
+    if (detector->settle_cycles > LOAD_EVENT_SETTLE_CYCLES - LOAD_EVENT_LEVEL_CYCLES) {
+        detector->settle_sum += amps;
+    }
+    if (detector->settle_cycles < LOAD_EVENT_SETTLE_CYCLES) {
+        return LOAD_DETECT_NONE;
+    }
+
+    // A change that settled back within the step (a short spike) is not an event
+    float before = detector->settle_before;
+    float after = detector->settle_sum / LOAD_EVENT_LEVEL_CYCLES;
+    start_steady(detector, after);
+    if (fabsf(after - before) < load_detector_step_threshold(detector, fminf(after, before))) {
+        detector->false_alarms++;
+        return LOAD_DETECT_REJECTED;
+    }
+
+    load_event_type_t type = LOAD_EVENT_STEP;
+    if (before < LOAD_EVENT_OFF_AMPS && after >= LOAD_EVENT_OFF_AMPS) {
+        type = LOAD_EVENT_ON;
+    } else if (before >= LOAD_EVENT_OFF_AMPS && after < LOAD_EVENT_OFF_AMPS) {
+        type = LOAD_EVENT_OFF;
+    }
+
+    *change = (load_change_t){
+        .type = type,
+        .before_amps = before,
+        .after_amps = after,
+        .peak_amps = detector->settle_peak,
+        // Inrush only means something for a rise; a fall's peak is the old level
+        .inrush_ratio = (after > before) ? detector->settle_peak / after : NAN,
+        .onset_us = detector->settle_onset_us,
+        .detect_cycles = detector->settle_detect_cycles
+    };
+    return LOAD_DETECT_CHANGE;
+}
+
+load_detect_result_t load_detector_feed(load_detector_t *detector, float amps, uint32_t cycle_index,
+                                        int64_t timestamp_us, load_change_t *change) {
+    if (detector->state == LOAD_DETECTOR_SEEDING) {
+        start_steady(detector, amps);
+        return LOAD_DETECT_SEEDED;
+    }
+
+    if (detector->state == LOAD_DETECTOR_SETTLING) {
+        return settle_cycle(detector, amps, change);
+    }
+
+    // Drift of half the smallest step: noise below it drains the sums, a real step
+    // of size d crosses the limit in about limit / (d - drift) cycles
+    float deviation = amps - detector->baseline;
+    float drift = 0.5f * load_detector_step_threshold(detector, detector->baseline);
+
+    float up = detector->sum_up + deviation - drift;
+    if (up > 0.0f && detector->sum_up == 0.0f) {
+        detector->up_onset_index = cycle_index;
+        detector->up_onset_us = timestamp_us;
+        detector->up_peak = amps;
+    }
+    detector->sum_up = (up > 0.0f) ? up : 0.0f;
+    if (detector->sum_up > 0.0f && amps > detector->up_peak) {
+        detector->up_peak = amps;
+    }
+
+    float down = detector->sum_down - deviation - drift;
+    if (down > 0.0f && detector->sum_down == 0.0f) {
+        detector->down_onset_index = cycle_index;
+        detector->down_onset_us = timestamp_us;
+        detector->down_peak = detector->baseline;
+    }
+    detector->sum_down = (down > 0.0f) ? down : 0.0f;
+
+    if (detector->sum_up > detector->cusum_limit) {
+        start_settling(detector, detector->up_onset_index, detector->up_onset_us,
+                       detector->up_peak, cycle_index);
+    } else if (detector->sum_down > detector->cusum_limit) {
+        start_settling(detector, detector->down_onset_index, detector->down_onset_us,
+                       detector->down_peak, cycle_index);
+    } else if (detector->sum_up == 0.0f && detector->sum_down == 0.0f) {
+        // Follow slow drift only while nothing is accumulating
+        detector->baseline += LOAD_EVENT_BASELINE_ALPHA * deviation;
+    }
+    return LOAD_DETECT_NONE;
+}
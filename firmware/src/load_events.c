@@ -0,0 +1,264 @@
+#include "load_events.h"
+#include "load_detector.h"
+#include "hardware_config.h"
+#include "rms_engine.h"
+#include "sct_calibration.h"
+#include "telemetry_protocol.h"
+#include "udp_sender.h"
+#include "command_dispatcher.h"
+#include "perf_monitor.h"
+#include "task_memory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "LOAD_EVENTS";
+
+// Configuration - written by commands, copied into the detector once per cycle
+static volatile float min_step_amps = LOAD_EVENT_MIN_STEP_AMPS;
+static volatile float cusum_limit = LOAD_EVENT_CUSUM_LIMIT;
+
+// Sampler task state
+static load_detector_t detector;
+static uint32_t detector_calibration_version = 0;
+
+// Shared with the network core
+static float steady_level = 0.0f;
+static int64_t steady_since_us = 0;
+static bool level_valid = false;
+static float steady_inrush_ratio = NAN;    // Of the change that reached the level
+static float duty_cycle = NAN;             // On share of the last on/off period
+static int64_t last_on_us = 0;
+static int64_t last_off_us = 0;
+static uint32_t reports_dropped = 0;
+
+// Event records, newest at (event_count - 1) % LOAD_EVENT_HISTORY
+static telemetry_load_event_t event_history[LOAD_EVENT_HISTORY];
+static uint32_t event_count = 0;
+static QueueHandle_t report_queue = NULL;
+STATIC_TASK(report_task, LOAD_EVENT_TASK_STACK);
+static portMUX_TYPE load_event_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* type_name(uint8_t type) {
+    switch (type) {
+        case LOAD_EVENT_ON:   return "LOAD_ON";
+        case LOAD_EVENT_OFF:  return "LOAD_OFF";
+        case LOAD_EVENT_STEP: return "LOAD_STEP";
+        default:              return "NONE";
+    }
+}
+
+// New steady level; since_us < 0 keeps the steady period running
+static void publish_level(float level, int64_t since_us) {
+    portENTER_CRITICAL(&load_event_lock);
+    steady_level = level;
+    if (since_us >= 0) {
+        steady_since_us = since_us;
+    }
+    level_valid = true;
+    portEXIT_CRITICAL(&load_event_lock);
+}
+
+// Runs in the sampler task: record and hand off, never wait on the reporter
+static void emit_event(const load_change_t* change) {
+    telemetry_load_event_t record = {
+        .type = change->type,
+        .detect_cycles = change->detect_cycles,
+        .before_amps = change->before_amps,
+        .after_amps = change->after_amps,
+        .peak_amps = change->peak_amps,
+        .onset_ms = (uint32_t)(change->onset_us / 1000)
+    };
+
+    portENTER_CRITICAL(&load_event_lock);
+    record.event_count = ++event_count;
+    event_history[(event_count - 1) % LOAD_EVENT_HISTORY] = record;
+    steady_inrush_ratio = change->inrush_ratio;
+    if (change->type == LOAD_EVENT_ON) {
+        if (last_on_us && last_off_us > last_on_us) {
+            duty_cycle = (float)(last_off_us - last_on_us) / (float)(change->onset_us - last_on_us);
+        }
+        last_on_us = change->onset_us;
+    } else if (change->type == LOAD_EVENT_OFF) {
+        last_off_us = change->onset_us;
+    }
+    portEXIT_CRITICAL(&load_event_lock);
+
+    if (report_queue && xQueueSend(report_queue, &record, 0) != pdTRUE) {
+        reports_dropped++;
+    }
+}
+
+static void load_cycle_callback(const rms_cycle_t* cycle, void* context) {
+    float amps = cycle->vrms * cycle->amps_per_volt;
+
+    // A new calibration rescales every reading - restart rather than report a step
+    if (cycle->calibration_version != detector_calibration_version) {
+        detector_calibration_version = cycle->calibration_version;
+        load_detector_restart(&detector);
+    }
+    detector.min_step_amps = min_step_amps;
+    detector.cusum_limit = cusum_limit;
+
+    load_change_t change;
+    switch (load_detector_feed(&detector, amps, cycle->index, cycle->timestamp_us, &change)) {
+        case LOAD_DETECT_SEEDED:
+            publish_level(amps, cycle->timestamp_us);
+            break;
+        case LOAD_DETECT_REJECTED:
+            publish_level(detector.baseline, -1);
+            break;
+        case LOAD_DETECT_CHANGE:
+            publish_level(change.after_amps, change.onset_us);
+            emit_event(&change);
+            break;
+        default:
+            break;
+    }
+}
+
+static void format_event(char* buffer, size_t buffer_size, const telemetry_load_event_t* record) {
+    snprintf(buffer, buffer_size,
+             "LOAD_EVENT:COUNT=%lu,TYPE=%s,BEFORE=%.3fA,AFTER=%.3fA,PEAK=%.3fA,TIME=%lu,DETECT_CYCLES=%u",
+             record->event_count, type_name(record->type), record->before_amps,
+             record->after_amps, record->peak_amps, record->onset_ms, record->detect_cycles);
+}
+
+// Events are acted on from here, never from the sampler task
+static void load_event_task(void *parameters) {
+    PERF_REGISTER_TASK();
+
+    telemetry_load_event_t record;
+    while (1) {
+        if (xQueueReceive(report_queue, &record, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        char text[192];
+        format_event(text, sizeof(text), &record);
+        ESP_LOGI(TAG, "%s", text);
+
+        // Recognition and the stable-load calibration run off the settled level
+        process_load_change_for_auto_calibration(record.after_amps);
+
+        // Load events are telemetry, not alarms - never broadcast to an empty table
+        if (udp_sender_subscriber_count() > 0) {
+            send_telemetry_event(TELEMETRY_FRAME_LOAD_EVENT, &record, sizeof(record), text);
+        }
+    }
+}
+
+bool load_events_get_state(load_state_t* state) {
+    portENTER_CRITICAL(&load_event_lock);
+    bool valid = level_valid;
+    int64_t since_us = steady_since_us;
+    state->amps = steady_level;
+    state->inrush_ratio = steady_inrush_ratio;
+    state->duty_cycle = duty_cycle;
+    portEXIT_CRITICAL(&load_event_lock);
+
+    state->steady_ms = valid ? (uint32_t)((esp_timer_get_time() - since_us) / 1000) : 0;
+    return valid;
+}
+
+bool load_events_get_level(float* amps, uint32_t* steady_ms) {
+    load_state_t state;
+    bool valid = load_events_get_state(&state);
+    if (amps) *amps = state.amps;
+    if (steady_ms) *steady_ms = state.steady_ms;
+    return valid;
+}
+
+bool load_events_configure(float min_step, float limit) {
+    if (min_step <= 0.0f || min_step > MAX_CURRENT_AMPS || limit <= 0.0f || limit > MAX_CURRENT_AMPS) {
+        return false;
+    }
+    min_step_amps = min_step;
+    cusum_limit = limit;
+    ESP_LOGI(TAG, "Detector: min step %.3f A, CUSUM limit %.2f", min_step, limit);
+    return true;
+}
+
+void load_events_get_status(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+
+    float level;
+    uint32_t steady_ms;
+    bool valid = load_events_get_level(&level, &steady_ms);
+
+    snprintf(buffer, buffer_size,
+             "STATE=%s,LEVEL=%.3fA,STEADY_S=%lu,MIN_STEP=%.3fA,LIMIT=%.2f,EVENTS=%lu,"
+             "FALSE_ALARMS=%lu,DROPPED=%lu",
+             !valid ? "WAITING" : (detector.state == LOAD_DETECTOR_SETTLING ? "SETTLING" : "STEADY"),
+             level, steady_ms / 1000, min_step_amps, cusum_limit, event_count,
+             detector.false_alarms, reports_dropped);
+}
+
+// === LOAD EVENT COMMANDS ===
+CMD_HANDLER(cmd_load_events) {
+    telemetry_load_event_t history[LOAD_EVENT_HISTORY];
+    portENTER_CRITICAL(&load_event_lock);
+    uint32_t count = event_count;
+    memcpy(history, event_history, sizeof(history));
+    portEXIT_CRITICAL(&load_event_lock);
+
+    size_t length = cmd_reply(response, response_size, "LOAD_EVENTS:");
+    load_events_get_status(response + length, response_size - length);
+    length += strlen(response + length);
+
+    uint32_t shown = (count < LOAD_EVENT_HISTORY) ? count : LOAD_EVENT_HISTORY;
+    for (uint32_t i = 0; i < shown; i++) {
+        const telemetry_load_event_t* record = &history[(count - 1 - i) % LOAD_EVENT_HISTORY];
+        length += cmd_reply(response + length, response_size - length,
+                            ";#%lu,%s,%.3f->%.3fA,PEAK=%.3fA,TIME=%lu",
+                            record->event_count, type_name(record->type), record->before_amps,
+                            record->after_amps, record->peak_amps, record->onset_ms);
+    }
+    return length;
+}
+
+// LOAD_EVENT_CONFIG:min_step_amps[,cusum_limit]
+CMD_HANDLER(cmd_load_event_config) {
+    float limit = (args->count > 1) ? args->values[1].f : cusum_limit;
+    if (!load_events_configure(args->values[0].f, limit)) {
+        return cmd_reply(response, response_size, "LOAD_EVENT_CONFIG:ERROR,INVALID_RANGE");
+    }
+    return cmd_reply(response, response_size, "LOAD_EVENT_CONFIG:SUCCESS,MIN_STEP=%.3fA,LIMIT=%.2f",
+                     min_step_amps, cusum_limit);
+}
+
+static const command_def_t load_event_commands[] = {
+    { "LOAD_EVENTS",       NULL,  cmd_load_events },
+    { "LOAD_EVENT_CONFIG", "f?f", cmd_load_event_config },
+};
+
+esp_err_t load_events_init(void) {
+    if (report_queue) {
+        return ESP_OK;
+    }
+
+    load_detector_init(&detector, min_step_amps, cusum_limit);
+    report_queue = xQueueCreate(LOAD_EVENT_HISTORY, sizeof(telemetry_load_event_t));
+    if (!report_queue ||
+        !static_task_start(&report_task, load_event_task, "load_events", NULL,
+                           LOAD_EVENT_TASK_PRIORITY, NETWORK_CORE)) {
+        ESP_LOGE(TAG, "Failed to create load event reporter");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (rms_engine_subscribe_cycles(load_cycle_callback, NULL) < 0) {
+        ESP_LOGE(TAG, "Failed to attach to the cycle stream - load events inactive");
+        return ESP_FAIL;
+    }
+
+    command_register_table(load_event_commands,
+                           sizeof(load_event_commands) / sizeof(load_event_commands[0]));
+    ESP_LOGI(TAG, "Load change detection: min step %.3f A, CUSUM limit %.2f",
+             min_step_amps, cusum_limit);
+    return ESP_OK;
+}
@@ -3,53 +3,97 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_system.h"
-#include "esp_adc/adc_oneshot.h"
-#include "esp_adc/adc_cali.h"
-#include "esp_adc/adc_cali_scheme.h"
 #include "nvs_flash.h"
 #include "math.h"
 
+#include "adc_sampler.h"
+#include "rms_engine.h"
 #include "wifi.h"
 #include "wifi_credentials_receiver.h"
 #include "udp_sender.h"
+#include "discovery.h"
 #include "udp_receiver.h"
 #include "relay.h"
 #include "sct_calibration.h"
 #include "hardware_config.h"
+#include "perf_monitor.h"
+#include "calibration_jobs.h"
+#include "relay_control.h"
+#include "protection.h"
+#include "energy.h"
+#include "history.h"
+#include "power_quality.h"
+#include "load_events.h"
+#include "device_library.h"
+#include "temp_compensation.h"
+#include "startup.h"
+#include "task_memory.h"
+#include "net_buffers.h"
+#include "power_scheduler.h"
 
 static const char *TAG = "MAIN";
 
-// Global ADC handle - define it here instead of in udp_sender
-adc_oneshot_unit_handle_t adc1_handle = NULL;
+// One second of samples for the startup bias measurement
+#define STARTUP_CAL_SAMPLES ADC_OUTPUT_RATE_HZ
 
 void init_adc_early(void) {
-    ESP_LOGI(TAG, "Initializing ADC for early calibration...");
+    ESP_LOGI(TAG, "Initializing continuous ADC sampling for early calibration...");
     
-    // Initialize ADC unit
-    adc_oneshot_unit_init_cfg_t unit_cfg = {
-        .unit_id = ADC_UNIT_1,
-        .clk_src = ADC_RTC_CLK_SRC_RC_FAST
-    };
-    
-    esp_err_t ret = adc_oneshot_new_unit(&unit_cfg, &adc1_handle);
+    esp_err_t ret = adc_sampler_init();
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize ADC unit: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to initialize ADC sampler: %s", esp_err_to_name(ret));
         return;
     }
 
-    // Configure ADC channel
-    adc_oneshot_chan_cfg_t chan_cfg = {
-        .bitwidth = ADC_BITWIDTH_12,
-        .atten = ADC_ATTEN_DB_11,  // 0-3.3V range
-    };
-    
-    ret = adc_oneshot_config_channel(adc1_handle, ADC_CHANNEL, &chan_cfg);
+    // RMS stage subscribes before sampling starts so it sees every block
+    ret = rms_engine_init();
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to configure ADC channel: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to initialize RMS engine: %s", esp_err_to_name(ret));
         return;
     }
+
+    // Protection rides the same stream; it only acts once the relay is closed
+    ret = protection_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize protection: %s", esp_err_to_name(ret));
+    }
+
+    ret = energy_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize energy accounting: %s", esp_err_to_name(ret));
+    }
+
+    ret = history_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize history: %s", esp_err_to_name(ret));
+    }
+
+    // Reads the ring on its own task; waits for calibration before the first window
+    ret = power_quality_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize power quality analysis: %s", esp_err_to_name(ret));
+    }
+
+    ret = load_events_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize load change detection: %s", esp_err_to_name(ret));
+    }
+
+    // Idle plugs report at the heartbeat and let WiFi sleep; the first loaded cycle wakes them
+    ret = power_scheduler_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize power scheduling: %s", esp_err_to_name(ret));
+    }
+
+    ret = adc_sampler_start();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start ADC sampler: %s", esp_err_to_name(ret));
+        return;
+    }
+    startup_signal(STARTUP_SAMPLING);
     
-    ESP_LOGI(TAG, "ADC initialized successfully - Channel: %d, GPIO: %d", ADC_CHANNEL, ADC_GPIO_PIN);
+    ESP_LOGI(TAG, "ADC initialized successfully - Channel: %d, GPIO: %d, %d Hz", 
+             ADC_CHANNEL, ADC_GPIO_PIN, ADC_OUTPUT_RATE_HZ);
 }
 
 void perform_comprehensive_startup_calibration(void) {
@@ -62,22 +106,11 @@ void perform_comprehensive_startup_calibration(void) {
     
     // Step 1: Take initial readings to see the problem
     ESP_LOGI(TAG, "Step 1: Taking initial ADC readings...");
-    uint32_t raw_sum = 0;
-    int valid_samples = 0;
+    sample_stats_t stats;
     
-    for (int i = 0; i < 100; i++) {
-        int adc_value = 0;
-        esp_err_t ret = adc_oneshot_read(adc1_handle, ADC_CHANNEL, &adc_value);
-        if (ret == ESP_OK) {
-            raw_sum += adc_value;
-            valid_samples++;
-        }
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-    
-    if (valid_samples > 0) {
-        float avg_raw = (float)raw_sum / valid_samples;
-        float avg_voltage = (avg_raw / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
+    if (adc_sampler_collect_stats(STARTUP_CAL_SAMPLES, ADC_BIAS_VOLTAGE, &stats, 3000)) {
+        float avg_raw = stats.mean_raw;
+        float avg_voltage = stats.mean_voltage;
         float current_with_default_bias = fabsf(avg_voltage - 1.65f) * 200.0f;
         
         ESP_LOGI(TAG, "Initial readings: ADC=%.1f, Voltage=%.6fV", avg_raw, avg_voltage);
@@ -108,11 +141,47 @@ void perform_comprehensive_startup_calibration(void) {
     ESP_LOGI(TAG, "=== STARTUP CALIBRATION COMPLETE ===");
 }
 
+// Cold start measurement and ADC check
+static void run_startup_calibration(void) {
+    sct_calibration_startup();
+    
+    // A warm start already has a trusted calibration - only a cold one measures here
+    if (!sct_calibration_warm_start()) {
+        perform_comprehensive_startup_calibration();
+        
+        // Now test ADC with corrected bias
+        ESP_LOGI(TAG, "Testing ADC with corrected calibration...");
+        for (int i = 0; i < 5; i++) {
+            sample_stats_t stats;
+            if (adc_sampler_collect_stats(SAMPLES_PER_CYCLE, get_bias_voltage(), &stats, 500)) {
+                float current = stats.ac_rms_voltage * get_amps_per_volt();
+                
+                ESP_LOGI(TAG, "Test %d: ADC=%.1f (%u-%u), V=%.4f, AC=%.6f, I=%.6fA", 
+                         i+1, stats.mean_raw, stats.min_raw, stats.max_raw,
+                         stats.mean_voltage, stats.ac_rms_voltage, current);
+            }
+            vTaskDelay(pdMS_TO_TICKS(500));
+        }
+    }
+    
+    startup_signal(STARTUP_CALIBRATION);
+}
+
+// Keeps the measurement off the network bring-up path
+static void startup_calibration_task(void *parameters) {
+    PERF_REGISTER_TASK();
+    run_startup_calibration();
+    vTaskDelete(NULL);
+}
+
 void app_main(void) {
     ESP_LOGI(TAG, "ESP32 Smart Plug with Auto-Calibration starting...");
-    ESP_LOGI(TAG, "Firmware version: SCT-013-000 Auto-Calibration v3.1");
+    ESP_LOGI(TAG, "Firmware version: SCT-013-000 Auto-Calibration v" FIRMWARE_VERSION);
     ESP_LOGI(TAG, "Features: Auto-Calibration, Device Recognition, Learning System");
     
+    // Every stage below signals the startup graph; consumers wait only for what they need
+    startup_init();
+    
     // Initialize NVS (required for WiFi)
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -121,50 +190,60 @@ void app_main(void) {
     }
     ESP_ERROR_CHECK(ret);
     ESP_LOGI(TAG, "NVS initialized");
+    startup_signal(STARTUP_NVS);
     
 #if !ENABLE_LOGGING
     esp_log_level_set("*", ESP_LOG_WARN);
 #endif
 
-    // CRITICAL: Initialize ADC and fix bias BEFORE anything else
+    perf_monitor_init();
+    PERF_REGISTER_TASK();
+    
+    // Static task and buffer bookkeeping before any task that uses them
+    net_buffers_init();
+    task_memory_init();
+    
+    // Sampling starts first so protection and energy see the load from the start
     init_adc_early();
     
-    // Initialize calibration system (this will use the ADC handle we just created)
+    // Fast part only: stored calibration, DC tracker, store task
     ESP_LOGI(TAG, "Initializing calibration system...");
     sct_calibration_init();
     
-    // Perform comprehensive startup calibration BEFORE dashboard starts
-    perform_comprehensive_startup_calibration();
+    // Measured device signatures for recognition
+    if (device_library_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Device signature library not available");
+    }
+
+#if ENABLE_TEMP_COMPENSATION
+    // Learned temperature corrections, applied over the calibration
+    if (temp_compensation_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Temperature compensation not available");
+    }
+#endif
 
     // Initialize relay
     ESP_LOGI(TAG, "Initializing relay...");
     relay_init();
+    startup_signal(STARTUP_RELAY);
 
-    // Now test ADC with corrected bias
-    ESP_LOGI(TAG, "Testing ADC with corrected calibration...");
-    for (int i = 0; i < 5; i++) {
-        int adc_value = 0;
-        if (adc_oneshot_read(adc1_handle, ADC_CHANNEL, &adc_value) == ESP_OK) {
-            float voltage = ((float)adc_value / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
-            float ac_voltage = fabsf(voltage - get_bias_voltage());
-            float current = ac_voltage * get_amps_per_volt();
-            
-            ESP_LOGI(TAG, "Test %d: ADC=%d, V=%.4f, AC=%.6f, I=%.6fA", 
-                     i+1, adc_value, voltage, ac_voltage, current);
-        }
-        vTaskDelay(pdMS_TO_TICKS(500));
+    // Calibration worker first so the receiver can hand long measurements off
+    // (jobs wait for STARTUP_CALIBRATION before they run)
+    if (calibration_jobs_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Calibration jobs unavailable");
+    }
+    
+    // Relay commands get their own high-priority task and port
+    if (relay_control_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Relay control unavailable");
     }
 
-    // Print configuration
-    ESP_LOGI(TAG, "=== FINAL CONFIGURATION ===");
-    ESP_LOGI(TAG, "Auto-Calibration: %s", AUTO_CAL_ENABLED ? "ENABLED" : "DISABLED");
-    ESP_LOGI(TAG, "Device Recognition: %s", ENABLE_DEVICE_RECOGNITION ? "ENABLED" : "DISABLED");
-    ESP_LOGI(TAG, "Learning System: %s", ENABLE_CALIBRATION_LEARNING ? "ENABLED" : "DISABLED");
-    ESP_LOGI(TAG, "SCT-013-000 Burden Resistor: %.1f Ohm", SCT_013_BURDEN_RESISTOR);
-    ESP_LOGI(TAG, "Corrected Bias Voltage: %.6fV", get_bias_voltage());
-    ESP_LOGI(TAG, "Scale Factor: %.1f A/V", get_amps_per_volt());
-    ESP_LOGI(TAG, "ADC Channel: %d (GPIO %d)", ADC_CHANNEL, ADC_GPIO_PIN);
-    ESP_LOGI(TAG, "===========================");
+    // Measurement-based calibration runs alongside the network bring-up
+    if (xTaskCreatePinnedToCore(startup_calibration_task, "startup_cal", 4096, NULL,
+                                STARTUP_CAL_TASK_PRIORITY, NULL, NETWORK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create startup calibration task - calibrating inline");
+        run_startup_calibration();
+    }
 
     // Initialize WiFi framework
     ESP_LOGI(TAG, "Initializing WiFi...");
@@ -172,32 +251,49 @@ void app_main(void) {
     
     // Start fallback AP for initial setup
     start_fallback_ap();
+    startup_signal(STARTUP_NETWORK);
     
     // Start WiFi credentials receiver task
-    xTaskCreate(wifi_credentials_task, "wifi_credentials", 4096, NULL, 5, NULL);
-
-    // Start UDP receiver (for commands)
+    xTaskCreatePinnedToCore(wifi_credentials_task, "wifi_credentials", 4096, NULL,
+                            WIFI_CREDENTIALS_TASK_PRIORITY, NULL, NETWORK_CORE);
+    
+    // Device ID for the announce beacon and DISCOVER
+    discovery_init();
+    
+    // Start UDP receiver (for commands) - signals STARTUP_COMMANDS once bound
     ESP_LOGI(TAG, "Starting UDP command receiver...");
     start_udp_receiver();
     
-    // Start UDP sender (for data transmission) - ADC is already initialized
+    // Start UDP sender (for data transmission) - holds telemetry until calibrated.
+    // Readings go to SUBSCRIBE leases; broadcast is only the discovery beacon
     ESP_LOGI(TAG, "Starting UDP data sender...");
-    start_udp_sender("255.255.255.255");
+    start_udp_sender(TELEMETRY_DISCOVERY_ADDR);
     
-    // Give everything time to initialize
-    vTaskDelay(pdMS_TO_TICKS(2000));
+    // Everything is serving; the report below waits for calibration only
+    startup_wait(STARTUP_CALIBRATION, UINT32_MAX);
+
+    // Print configuration
+    ESP_LOGI(TAG, "=== FINAL CONFIGURATION ===");
+    ESP_LOGI(TAG, "Auto-Calibration: %s", AUTO_CAL_ENABLED ? "ENABLED" : "DISABLED");
+    ESP_LOGI(TAG, "Device Recognition: %s", ENABLE_DEVICE_RECOGNITION ? "ENABLED" : "DISABLED");
+    ESP_LOGI(TAG, "Learning System: %s", ENABLE_CALIBRATION_LEARNING ? "ENABLED" : "DISABLED");
+    ESP_LOGI(TAG, "SCT-013-000 Burden Resistor: %.1f Ohm", SCT_013_BURDEN_RESISTOR);
+    ESP_LOGI(TAG, "Corrected Bias Voltage: %.6fV", get_bias_voltage());
+    ESP_LOGI(TAG, "Scale Factor: %.1f A/V", get_amps_per_volt());
+    ESP_LOGI(TAG, "ADC Channel: %d (GPIO %d)", ADC_CHANNEL, ADC_GPIO_PIN);
+    ESP_LOGI(TAG, "===========================");
 
     // Print initial calibration status
-    char cal_status[256];
+    static char cal_status[256];    // Report buffers stay off the main task's 3.5 KB stack
     get_calibration_status(cal_status, sizeof(cal_status));
     ESP_LOGI(TAG, "Calibration status: %s", cal_status);
     
 #if ENABLE_CALIBRATION_LEARNING
-    ESP_LOGI(TAG, "Learning system initialized with %d max points", MAX_LEARNING_POINTS);
+    ESP_LOGI(TAG, "Learning system initialized with %d points learned", get_learning_point_count());
 #endif
 
 #if ENABLE_DEVICE_RECOGNITION
-    char device_list[512];
+    static char device_list[512];
     list_known_devices(device_list, sizeof(device_list));
     ESP_LOGI(TAG, "Device recognition ready:\n%s", device_list);
 #endif
@@ -234,29 +330,31 @@ void app_main(void) {
         if (now - last_diagnostics > diagnostics_interval) {
             ESP_LOGI(TAG, "=== DIAGNOSTIC REPORT ===");
             
-            // Take a fresh ADC reading for diagnostics
-            int adc_value = 0;
-            if (adc_oneshot_read(adc1_handle, ADC_CHANNEL, &adc_value) == ESP_OK) {
-                float voltage = ((float)adc_value / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
-                float ac_voltage = fabsf(voltage - get_bias_voltage());
-                float current = ac_voltage * get_amps_per_volt();
+            // Summarize a few cycles from the shared sample stream for diagnostics
+            sample_stats_t stats;
+            if (adc_sampler_collect_stats(SAMPLES_PER_CYCLE * 10, get_bias_voltage(), &stats, 1000)) {
+                float current = stats.ac_rms_voltage * get_amps_per_volt();
                 
-                ESP_LOGI(TAG, "Live reading: ADC=%d, V=%.6f, AC=%.6f, I=%.6fA", 
-                         adc_value, voltage, ac_voltage, current);
+                ESP_LOGI(TAG, "Live reading: ADC=%.1f (%u-%u), V=%.6f, AC=%.6f, I=%.6fA", 
+                         stats.mean_raw, stats.min_raw, stats.max_raw,
+                         stats.mean_voltage, stats.ac_rms_voltage, current);
             }
+            ESP_LOGI(TAG, "Sampler: DC track=%.6fV, cycles=%lu, overruns=%lu",
+                     get_tracked_dc_voltage(), rms_engine_get_cycle_count(),
+                     adc_sampler_get_overrun_count());
             
             // Auto-calibration statistics
             if (get_auto_calibration_enabled()) {
-                char auto_cal_stats[256];
+                static char auto_cal_stats[256];
                 get_auto_cal_statistics(auto_cal_stats, sizeof(auto_cal_stats));
                 ESP_LOGI(TAG, "Auto-cal stats: %s", auto_cal_stats);
             }
             
 #if ENABLE_CALIBRATION_LEARNING
-            int learning_points = get_learning_point_count();
-            float learning_rate = get_learning_rate();
-            ESP_LOGI(TAG, "Learning: %d/%d points, rate=%.2f", 
-                     learning_points, MAX_LEARNING_POINTS, learning_rate);
+            learning_estimate_t learning;
+            get_learning_estimate(&learning);
+            ESP_LOGI(TAG, "Learning: %lu points, scale=%.2f +/- %.2f A/V, rate=%.2f", 
+                     learning.updates, learning.scale, learning.scale_sd, get_learning_rate());
 #endif
 
             // System health check
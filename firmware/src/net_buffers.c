@@ -0,0 +1,62 @@
+#include "net_buffers.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+
+static const char *TAG = "NET_BUF";
+
+static char pool[NET_BUFFER_COUNT][NET_BUFFER_SIZE] __attribute__((aligned(4)));
+
+// Free buffers, as pointers
+static StaticQueue_t free_queue_storage;
+static uint8_t free_queue_items[NET_BUFFER_COUNT * sizeof(char*)];
+static QueueHandle_t free_queue = NULL;
+
+static unsigned peak_in_use = 0;
+static uint32_t misses = 0;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t net_buffers_init(void) {
+    if (free_queue) {
+        return ESP_OK;
+    }
+    free_queue = xQueueCreateStatic(NET_BUFFER_COUNT, sizeof(char*), free_queue_items, &free_queue_storage);
+    for (int i = 0; i < NET_BUFFER_COUNT; i++) {
+        char* buffer = pool[i];
+        xQueueSend(free_queue, &buffer, 0);
+    }
+    ESP_LOGI(TAG, "%d network buffers of %d bytes", NET_BUFFER_COUNT, NET_BUFFER_SIZE);
+    return ESP_OK;
+}
+
+char* net_buffer_acquire(TickType_t wait) {
+    char* buffer = NULL;
+    if (!free_queue || xQueueReceive(free_queue, &buffer, wait) != pdTRUE) {
+        portENTER_CRITICAL(&stats_lock);
+        misses++;
+        portEXIT_CRITICAL(&stats_lock);
+        return NULL;
+    }
+
+    unsigned in_use = NET_BUFFER_COUNT - uxQueueMessagesWaiting(free_queue);
+    portENTER_CRITICAL(&stats_lock);
+    if (in_use > peak_in_use) {
+        peak_in_use = in_use;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    return buffer;
+}
+
+void net_buffer_release(char* buffer) {
+    if (buffer) {
+        xQueueSend(free_queue, &buffer, 0);
+    }
+}
+
+void net_buffers_get_stats(net_buffer_stats_t* stats) {
+    stats->count = NET_BUFFER_COUNT;
+    stats->in_use = free_queue ? NET_BUFFER_COUNT - uxQueueMessagesWaiting(free_queue) : 0;
+    portENTER_CRITICAL(&stats_lock);
+    stats->peak_in_use = peak_in_use;
+    stats->misses = misses;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,225 @@
+#include "perf_monitor.h"
+
+#if ENABLE_PERF_MONITOR
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_freertos_hooks.h"
+#include "esp_log.h"
+#include "command_dispatcher.h"
+#include "esp_timer.h"
+#include "power_scheduler.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "PERF";
+
+#define PERF_HISTOGRAM_BUCKETS 16       // Bucket n holds samples below 2^n us
+#define PERF_IDLE_GAP_US 25             // Longer gaps between idle hooks mean the idle task was preempted
+#define PERF_NUM_CORES portNUM_PROCESSORS
+
+static const char *perf_probe_names[PERF_PROBE_COUNT] = {
+    "MEASURE_RMS",
+    "UDP_CMD",
+    "AUTO_CAL",
+    "TX_SEND",
+    "BLOCK",
+    "JITTER",
+    "RELAY",
+    "PQ"
+};
+
+typedef struct {
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t histogram[PERF_HISTOGRAM_BUCKETS];
+} perf_probe_t;
+
+static perf_probe_t probes[PERF_PROBE_COUNT];
+static portMUX_TYPE perf_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Tasks whose stack high-water marks are reported
+static TaskHandle_t tasks[PERF_MAX_TASKS];
+static int task_count = 0;
+
+// Idle-time accounting per core, from the FreeRTOS idle hook. Timed with esp_timer,
+// as the CPU clock moves with frequency scaling
+static int64_t idle_last_us[PERF_NUM_CORES];
+static uint64_t idle_us[PERF_NUM_CORES];
+static int64_t window_start_us = 0;
+
+// While the power scheduler has the plug idle the hook lets the idle task WAITI, which
+// its gaps cannot tell from preemption - that time is left out of the CPU load window
+static bool idle_paused[PERF_NUM_CORES];
+static int64_t paused_since_us[PERF_NUM_CORES];
+static uint64_t paused_us[PERF_NUM_CORES];
+
+static bool idle_hook(void) {
+    int core = xPortGetCoreID();
+    int64_t now = esp_timer_get_time();
+    if (power_scheduler_is_idle()) {
+        if (!idle_paused[core]) {
+            idle_paused[core] = true;
+            paused_since_us[core] = now;
+        }
+        return true;
+    }
+    if (idle_paused[core]) {
+        idle_paused[core] = false;
+        paused_us[core] += now - paused_since_us[core];
+    } else if (now - idle_last_us[core] < PERF_IDLE_GAP_US) {
+        idle_us[core] += now - idle_last_us[core];
+    }
+    idle_last_us[core] = now;
+    return false;  // Keep the idle loop spinning so gaps measure idle time, not WAITI sleep
+}
+
+static bool idle_hook_core0(void) { return idle_hook(); }
+#if PERF_NUM_CORES > 1
+static bool idle_hook_core1(void) { return idle_hook(); }
+#endif
+
+CMD_HANDLER(cmd_perf_stats) {
+    size_t length = cmd_reply(response, response_size, "PERF_STATS:");
+    perf_monitor_format(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+CMD_HANDLER(cmd_perf_reset) {
+    perf_monitor_reset();
+    return cmd_reply(response, response_size, "PERF_RESET:SUCCESS");
+}
+
+static const command_def_t perf_commands[] = {
+    { "PERF_STATS", NULL, cmd_perf_stats },
+    { "PERF_RESET", NULL, cmd_perf_reset },
+};
+
+void perf_monitor_init(void) {
+    perf_monitor_reset();
+    command_register_table(perf_commands, sizeof(perf_commands) / sizeof(perf_commands[0]));
+    esp_register_freertos_idle_hook_for_cpu(idle_hook_core0, 0);
+#if PERF_NUM_CORES > 1
+    esp_register_freertos_idle_hook_for_cpu(idle_hook_core1, 1);
+#endif
+    ESP_LOGI(TAG, "Performance monitor enabled (%d probes)", PERF_PROBE_COUNT);
+}
+
+void perf_monitor_record_us(perf_probe_id_t probe, uint32_t microseconds) {
+    if (probe >= PERF_PROBE_COUNT) {
+        return;
+    }
+
+    int bucket = 0;
+    while (bucket < PERF_HISTOGRAM_BUCKETS - 1 && microseconds >= (1u << bucket)) {
+        bucket++;
+    }
+
+    portENTER_CRITICAL_SAFE(&perf_lock);
+    perf_probe_t *p = &probes[probe];
+    p->count++;
+    p->total_us += microseconds;
+    if (microseconds > p->max_us) p->max_us = microseconds;
+    p->histogram[bucket]++;
+    portEXIT_CRITICAL_SAFE(&perf_lock);
+}
+
+void perf_monitor_register_current_task(void) {
+    TaskHandle_t handle = xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL(&perf_lock);
+    bool known = false;
+    for (int i = 0; i < task_count; i++) {
+        if (tasks[i] == handle) known = true;
+    }
+    if (!known && task_count < PERF_MAX_TASKS) {
+        tasks[task_count++] = handle;
+    }
+    portEXIT_CRITICAL(&perf_lock);
+}
+
+void perf_monitor_reset(void) {
+    portENTER_CRITICAL(&perf_lock);
+    memset(probes, 0, sizeof(probes));
+    memset(idle_us, 0, sizeof(idle_us));
+    memset(paused_us, 0, sizeof(paused_us));
+    window_start_us = esp_timer_get_time();
+    for (int core = 0; core < PERF_NUM_CORES; core++) {
+        paused_since_us[core] = window_start_us;
+    }
+    portEXIT_CRITICAL(&perf_lock);
+    ESP_LOGI(TAG, "Performance statistics reset");
+}
+
+// Upper bound of the bucket holding the given percentile
+static uint32_t percentile_us(const perf_probe_t *p, uint32_t percent) {
+    uint32_t target = (p->count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < PERF_HISTOGRAM_BUCKETS; i++) {
+        seen += p->histogram[i];
+        if (seen >= target) {
+            return 1u << i;
+        }
+    }
+    return p->max_us;
+}
+
+void perf_monitor_format(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+
+    perf_probe_t snapshot[PERF_PROBE_COUNT];
+    uint64_t idle[PERF_NUM_CORES];
+    int64_t active_us[PERF_NUM_CORES];
+
+    portENTER_CRITICAL(&perf_lock);
+    memcpy(snapshot, probes, sizeof(snapshot));
+    memcpy(idle, idle_us, sizeof(idle));
+    int64_t now = esp_timer_get_time();
+    for (int core = 0; core < PERF_NUM_CORES; core++) {
+        int64_t paused = (int64_t)paused_us[core];
+        if (idle_paused[core]) {
+            int64_t since = paused_since_us[core] > window_start_us ? paused_since_us[core]
+                                                                    : window_start_us;
+            paused += now - since;
+        }
+        active_us[core] = now - window_start_us - paused;
+    }
+    portEXIT_CRITICAL(&perf_lock);
+
+    size_t used = 0;
+    buffer[0] = '\0';
+
+    // Per probe: count, average, max and histogram-bucket p50/p99 bounds, in us
+    for (int i = 0; i < PERF_PROBE_COUNT && used < buffer_size; i++) {
+        const perf_probe_t *p = &snapshot[i];
+        if (p->count == 0) {
+            continue;
+        }
+        used += snprintf(buffer + used, buffer_size - used, "%s=N%lu/AVG%lu/MAX%lu/P50<%lu/P99<%lu,",
+                         perf_probe_names[i], p->count, (uint32_t)(p->total_us / p->count),
+                         p->max_us, percentile_us(p, 50), percentile_us(p, 99));
+    }
+
+    // Load while active; time the power scheduler spent idle is not counted
+    for (int core = 0; core < PERF_NUM_CORES && used < buffer_size; core++) {
+        float busy = 0.0f;
+        if (active_us[core] > 0) {
+            busy = 100.0f * (1.0f - (float)idle[core] / (float)active_us[core]);
+            if (busy < 0.0f) busy = 0.0f;
+        }
+        used += snprintf(buffer + used, buffer_size - used, "CPU%d=%.1f%%,", core, busy);
+    }
+
+    // Free stack in bytes at the deepest point each task has reached
+    for (int i = 0; i < task_count && used < buffer_size; i++) {
+        used += snprintf(buffer + used, buffer_size - used, "STACK_%s=%u,",
+                         pcTaskGetName(tasks[i]), (unsigned)uxTaskGetStackHighWaterMark(tasks[i]));
+    }
+
+    if (used > 0 && used < buffer_size) {
+        buffer[used - 1] = '\0';  // Drop the trailing comma
+    }
+}
+
+#endif
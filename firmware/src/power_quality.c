@@ -0,0 +1,298 @@
+#include "power_quality.h"
+#include "adc_sampler.h"
+#include "rms_engine.h"
+#include "rms_kernel.h"
+#include "goertzel_kernel.h"
+#include "sct_calibration.h"
+#include "telemetry_protocol.h"
+#include "udp_sender.h"
+#include "command_dispatcher.h"
+#include "perf_monitor.h"
+#include "startup.h"
+#include "power_scheduler.h"
+#include "task_memory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "POWER_QUALITY";
+
+// Goertzel coefficients, rebuilt only when the line frequency moves
+#define PQ_FREQUENCY_TOLERANCE_HZ 0.05f
+
+static int32_t coefficients[PQ_HARMONICS];
+static int harmonic_count = 0;
+static float table_frequency_hz = 0.0f;
+
+// Configuration - written by commands, read once per analysis
+static volatile uint32_t interval_ms = PQ_DEFAULT_INTERVAL_MS;
+static volatile uint32_t window_cycles = PQ_WINDOW_CYCLES;
+static TaskHandle_t pq_task_handle = NULL;
+STATIC_TASK(pq_task, PQ_TASK_STACK);
+
+// Latest result, copied under the lock
+static pq_result_t latest;
+static bool latest_valid = false;
+static portMUX_TYPE result_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void build_coefficients(float fundamental_hz) {
+    harmonic_count = 0;
+    for (int h = 1; h <= PQ_HARMONICS; h++) {
+        float w = 2.0f * (float)M_PI * h * fundamental_hz / ADC_OUTPUT_RATE_HZ;
+        if (w >= (float)M_PI) {
+            break;  // At or above Nyquist
+        }
+        coefficients[harmonic_count++] = goertzel_coefficient(w);
+    }
+    table_frequency_hz = fundamental_hz;
+}
+
+// One pass over the window: every sample updates all harmonic filters, plus the
+// plain sum of squares for the total RMS
+static bool analyze_window(const sample_window_t* window, int32_t bias_counts,
+                           int64_t* powers, uint64_t* sum_squared) {
+    int32_t s1[PQ_HARMONICS] = { 0 };
+    int32_t s2[PQ_HARMONICS] = { 0 };
+    const int count = harmonic_count;
+    uint64_t sum = 0;
+    uint32_t offset = 0;
+    
+    while (offset < window->count) {
+        const uint16_t* data = NULL;
+        size_t span = adc_sampler_window_span(window, offset, window->count - offset, &data);
+        if (span == 0) {
+            return false;
+        }
+        for (size_t i = 0; i < span; i++) {
+            int32_t x = rms_kernel_ac(data[i], bias_counts);
+            sum += (uint64_t)((int64_t)x * x);
+            goertzel_bank_step(s1, s2, coefficients, count, x);
+        }
+        offset += span;
+    }
+    
+    for (int h = 0; h < count; h++) {
+        powers[h] = goertzel_power(coefficients[h], s1[h], s2[h]);
+    }
+    *sum_squared = sum;
+    return true;
+}
+
+static bool run_analysis(pq_result_t* result) {
+    float fundamental_hz = rms_engine_get_line_frequency();
+    if (fundamental_hz < MAINS_FREQUENCY_HZ * 0.8f || fundamental_hz > MAINS_FREQUENCY_HZ * 1.2f) {
+        fundamental_hz = MAINS_FREQUENCY_HZ;  // No synced cycles (no load) - use nominal
+    }
+    if (harmonic_count == 0 || fabsf(fundamental_hz - table_frequency_hz) > PQ_FREQUENCY_TOLERANCE_HZ) {
+        build_coefficients(fundamental_hz);
+    }
+    
+    // A whole number of cycles puts every harmonic on a filter's centre frequency
+    uint32_t cycles = window_cycles;
+    uint32_t samples = (uint32_t)lrintf(cycles * ADC_OUTPUT_RATE_HZ / fundamental_hz);
+    sample_window_t window;
+    if (!adc_sampler_freeze_window(samples, &window)) {
+        return false;
+    }
+    
+    calibration_snapshot_t cal;
+    get_calibration_snapshot(&cal);
+    
+    int64_t powers[PQ_HARMONICS];
+    uint64_t sum_squared;
+    int64_t start_us = esp_timer_get_time();
+    PERF_BEGIN(PERF_PROBE_POWER_QUALITY);
+    bool complete = analyze_window(&window, cal.bias_counts, powers, &sum_squared);
+    PERF_END(PERF_PROBE_POWER_QUALITY);
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+    
+    // The ring kept running; a lapped window is torn
+    if (!complete || !adc_sampler_window_intact(&window)) {
+        return false;
+    }
+    
+    const float amps_per_scaled_count = cal.amps_per_volt * ADC_VOLTAGE_RANGE /
+                                        (ADC_RESOLUTION * RMS_KERNEL_ONE);
+    memset(result, 0, sizeof(*result));
+    result->timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    result->fundamental_hz = fundamental_hz;
+    result->window_samples = (uint16_t)window.count;
+    result->harmonic_count = (uint8_t)harmonic_count;
+    result->analysis_us = elapsed_us;
+    result->rms_amps = sqrtf((float)sum_squared / window.count) * amps_per_scaled_count;
+    
+    // Amplitude is 2|X|/N; RMS a further 1/sqrt(2)
+    float harmonic_sum_squared = 0.0f;
+    for (int h = 0; h < harmonic_count; h++) {
+        float amps = sqrtf(2.0f * (float)powers[h]) / window.count * amps_per_scaled_count;
+        result->harmonic_amps[h] = amps;
+        if (h > 0) {
+            harmonic_sum_squared += amps * amps;
+        }
+    }
+    if (result->harmonic_amps[0] >= PQ_MIN_FUNDAMENTAL_AMPS) {
+        result->thd_percent = 100.0f * sqrtf(harmonic_sum_squared) / result->harmonic_amps[0];
+    }
+    return true;
+}
+
+static void publish(const pq_result_t* result) {
+    telemetry_harmonics_t frame = {
+        .fundamental_hz = result->fundamental_hz,
+        .rms_amps = result->rms_amps,
+        .thd_percent = result->thd_percent,
+        .window_samples = result->window_samples,
+        .harmonic_count = result->harmonic_count
+    };
+    memcpy(frame.harmonic_amps, result->harmonic_amps, sizeof(frame.harmonic_amps));
+    
+    // Harmonics are periodic telemetry - never broadcast to an empty table
+    if (udp_sender_subscriber_count() == 0) {
+        return;
+    }
+    
+    char text[256];
+    size_t length = cmd_reply(text, sizeof(text), "HARMONICS:F0=%.2f,RMS=%.3f,THD=%.1f,H=",
+                              result->fundamental_hz, result->rms_amps, result->thd_percent);
+    for (int h = 0; h < result->harmonic_count; h++) {
+        length += cmd_reply(text + length, sizeof(text) - length, "%s%.3f",
+                            h ? "|" : "", result->harmonic_amps[h]);
+    }
+    send_telemetry_event(TELEMETRY_FRAME_HARMONICS, &frame, sizeof(frame), text);
+}
+
+static void power_quality_task(void *parameters) {
+    PERF_REGISTER_TASK();
+    startup_wait(STARTUP_CALIBRATION, UINT32_MAX);
+    ESP_LOGI(TAG, "Power quality analysis running on core %d", xPortGetCoreID());
+    
+    uint32_t sequence = 0;
+    bool requested = false;
+    while (1) {
+        uint32_t interval = interval_ms;
+        if (interval == 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);  // Woken by PQ_CONFIG
+            continue;
+        }
+        
+        // An idle outlet has no harmonics worth a pass; a refresh or PQ_CONFIG still runs one
+        if (!requested && power_scheduler_is_idle()) {
+            requested = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(interval)) > 0;
+            continue;
+        }
+        
+        pq_result_t result;
+        if (run_analysis(&result)) {
+            result.sequence = ++sequence;
+            portENTER_CRITICAL(&result_lock);
+            latest = result;
+            latest_valid = true;
+            portEXIT_CRITICAL(&result_lock);
+            publish(&result);
+        } else {
+            ESP_LOGW(TAG, "Analysis window unavailable or overwritten");
+        }
+        
+        requested = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(interval)) > 0;
+    }
+}
+
+bool power_quality_get_latest(pq_result_t* result) {
+    portENTER_CRITICAL(&result_lock);
+    bool valid = latest_valid;
+    if (valid) {
+        *result = latest;
+    }
+    portEXIT_CRITICAL(&result_lock);
+    return valid;
+}
+
+bool power_quality_refresh(uint32_t newer_than_ms, pq_result_t* result, uint32_t timeout_ms) {
+    if (power_quality_get_latest(result) && result->timestamp_ms >= newer_than_ms) {
+        return true;
+    }
+    if (!pq_task_handle || timeout_ms == 0) {
+        return false;
+    }
+    
+    // Runs the next analysis now instead of at the interval (nothing when it is off)
+    xTaskNotifyGive(pq_task_handle);
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (esp_timer_get_time() < deadline_us) {
+        vTaskDelay(pdMS_TO_TICKS(PQ_REFRESH_POLL_MS));
+        if (power_quality_get_latest(result) && result->timestamp_ms >= newer_than_ms) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// === COMMANDS ===
+CMD_HANDLER(cmd_pq_status) {
+    pq_result_t result;
+    if (!power_quality_get_latest(&result)) {
+        return cmd_reply(response, response_size, "PQ_STATUS:NOT_READY,INTERVAL_MS=%lu", interval_ms);
+    }
+    
+    size_t length = cmd_reply(response, response_size,
+                              "PQ_STATUS:SEQ=%lu,AGE_MS=%lu,F0=%.2f,RMS=%.3f,THD=%.1f,SAMPLES=%u,"
+                              "ANALYSIS_US=%lu,INTERVAL_MS=%lu,CYCLES=%lu,H=",
+                              result.sequence,
+                              (uint32_t)(esp_timer_get_time() / 1000) - result.timestamp_ms,
+                              result.fundamental_hz, result.rms_amps, result.thd_percent,
+                              result.window_samples, result.analysis_us, interval_ms, window_cycles);
+    for (int h = 0; h < result.harmonic_count; h++) {
+        length += cmd_reply(response + length, response_size - length, "%s%.3f",
+                            h ? "|" : "", result.harmonic_amps[h]);
+    }
+    return length;
+}
+
+CMD_HANDLER(cmd_pq_config) {
+    uint32_t interval = args->values[0].u;
+    uint32_t cycles = (args->count > 1) ? args->values[1].u : window_cycles;
+    
+    if ((interval != 0 && interval < PQ_MIN_INTERVAL_MS) || interval > 3600000 ||
+        cycles < 1 || cycles > PQ_MAX_WINDOW_CYCLES) {
+        return cmd_reply(response, response_size, "PQ_CONFIG:ERROR,INVALID_RANGE");
+    }
+    
+    window_cycles = cycles;
+    interval_ms = interval;
+    if (pq_task_handle) {
+        xTaskNotifyGive(pq_task_handle);  // Apply now rather than after the old interval
+    }
+    return cmd_reply(response, response_size, "PQ_CONFIG:SUCCESS,INTERVAL_MS=%lu,CYCLES=%lu",
+                     interval, cycles);
+}
+
+static const command_def_t power_quality_commands[] = {
+    { "PQ_STATUS", NULL,  cmd_pq_status },
+    { "PQ_CONFIG", "u?u", cmd_pq_config },
+};
+
+_Static_assert(PQ_HARMONICS == TELEMETRY_MAX_HARMONICS, "harmonic frame does not match PQ_HARMONICS");
+
+esp_err_t power_quality_init(void) {
+    // The longest window must fit in the ring with room for the producer
+    _Static_assert(PQ_MAX_WINDOW_CYCLES * ADC_OUTPUT_RATE_HZ / (MAINS_FREQUENCY_HZ * 4 / 5) <
+                   (ADC_RING_BLOCKS - 2) * ADC_BLOCK_SAMPLES, "PQ window exceeds the sample ring");
+    
+    build_coefficients(MAINS_FREQUENCY_HZ);
+    
+    pq_task_handle = static_task_start(&pq_task, power_quality_task, "power_quality", NULL,
+                                       PQ_TASK_PRIORITY, NETWORK_CORE);
+    if (!pq_task_handle) {
+        ESP_LOGE(TAG, "Failed to create power quality task");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    command_register_table(power_quality_commands,
+                           sizeof(power_quality_commands) / sizeof(power_quality_commands[0]));
+    ESP_LOGI(TAG, "Harmonics 1-%d every %lu ms over %lu cycles", harmonic_count, interval_ms, window_cycles);
+    return ESP_OK;
+}
@@ -0,0 +1,238 @@
+#include "power_scheduler.h"
+#include "hardware_config.h"
+#include "rms_engine.h"
+#include "relay.h"
+#include "udp_sender.h"
+#include "wifi.h"
+#include "startup.h"
+#include "command_dispatcher.h"
+#include "task_memory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <string.h>
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+static const char *TAG = "POWER_SCHED";
+
+static volatile bool enabled = true;
+
+// Sampler task state
+static int64_t quiet_since_us = 0;     // First cycle of the present quiet run, 0 when loaded
+static bool last_relay_on = false;
+
+// Requested by the sampler (or a command), applied by the scheduler task
+static volatile bool idle_requested = false;
+static volatile int64_t wake_request_us = 0;
+static volatile bool idle_applied = false;
+
+static TaskHandle_t scheduler_task_handle = NULL;
+STATIC_TASK(scheduler_task, POWER_SCHED_TASK_STACK);
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t cpu_lock = NULL;  // Held while active - full clock
+#endif
+
+// Statistics, written by the scheduler task
+static uint32_t idle_entries = 0;
+static int64_t idle_since_us = 0;
+static int64_t idle_total_us = 0;
+static uint32_t last_wake_us = 0;
+static uint32_t max_wake_us = 0;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Runs in the sampler task once per cycle - only flags the change for the scheduler
+static void power_cycle_callback(const rms_cycle_t* cycle, void* context) {
+    // Before calibration the scale may read a real load as nothing
+    if (!startup_is_ready(STARTUP_CALIBRATION)) {
+        return;
+    }
+
+    bool relay_on = relay_get_state();
+    bool relay_closed = relay_on && !last_relay_on;
+    last_relay_on = relay_on;
+
+    float amps = cycle->vrms * cycle->amps_per_volt;
+    if (amps >= POWER_IDLE_AMPS || relay_closed || !enabled) {
+        quiet_since_us = 0;
+        if (idle_requested) {
+            idle_requested = false;
+            wake_request_us = cycle->timestamp_us;
+            xTaskNotifyGive(scheduler_task_handle);
+        }
+        return;
+    }
+
+    if (quiet_since_us == 0) {
+        quiet_since_us = cycle->timestamp_us;
+    }
+    // An open relay leaves nothing to wait for
+    if (!idle_requested &&
+        (!relay_on || cycle->timestamp_us - quiet_since_us >= (int64_t)POWER_IDLE_HOLD_MS * 1000)) {
+        idle_requested = true;
+        xTaskNotifyGive(scheduler_task_handle);
+    }
+}
+
+static void enter_idle(void) {
+    udp_sender_set_idle(true);
+    wifi_set_power_save(true);
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_release(cpu_lock);
+#endif
+
+    portENTER_CRITICAL(&stats_lock);
+    idle_entries++;
+    idle_since_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&stats_lock);
+    ESP_LOGI(TAG, "Idle - telemetry every %d ms, WiFi modem sleep", TELEMETRY_IDLE_INTERVAL_MS);
+}
+
+static void enter_active(void) {
+    // Clock first, so the rest runs at full speed
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_acquire(cpu_lock);
+#endif
+    wifi_set_power_save(false);
+    udp_sender_set_idle(false);
+
+    int64_t now = esp_timer_get_time();
+    uint32_t latency_us = (uint32_t)(now - wake_request_us);
+    portENTER_CRITICAL(&stats_lock);
+    idle_total_us += now - idle_since_us;
+    last_wake_us = latency_us;
+    if (latency_us > max_wake_us) {
+        max_wake_us = latency_us;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    ESP_LOGI(TAG, "Active - woken %lu us after the cycle", latency_us);
+}
+
+static void power_scheduler_task(void *parameters) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        bool idle = idle_requested;
+        if (idle == idle_applied) {
+            continue;  // Requested and withdrawn before this ran
+        }
+        if (idle) {
+            enter_idle();
+        } else {
+            enter_active();
+        }
+        idle_applied = idle;
+    }
+}
+
+bool power_scheduler_is_idle(void) {
+    return idle_applied;
+}
+
+void power_scheduler_set_enabled(bool enable) {
+    enabled = enable;
+    if (!enable && idle_requested) {
+        // The sampler sees the flag from the next cycle; wake now rather than then
+        idle_requested = false;
+        wake_request_us = esp_timer_get_time();
+        if (scheduler_task_handle) {
+            xTaskNotifyGive(scheduler_task_handle);
+        }
+    }
+    ESP_LOGI(TAG, "Adaptive power scheduling %s", enable ? "enabled" : "disabled");
+}
+
+void power_scheduler_get_status(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+
+    int64_t now = esp_timer_get_time();
+    bool idle = idle_applied;
+    portENTER_CRITICAL(&stats_lock);
+    int64_t idle_us = idle_total_us + (idle ? now - idle_since_us : 0);
+    uint32_t entries = idle_entries;
+    uint32_t wake_us = last_wake_us;
+    uint32_t wake_max_us = max_wake_us;
+    portEXIT_CRITICAL(&stats_lock);
+
+    snprintf(buffer, buffer_size,
+             "MODE=%s,ENABLED=%d,IDLE_S=%lu,IDLE_SHARE=%.1f%%,IDLE_ENTRIES=%lu,WAKE_US=%lu,"
+             "MAX_WAKE_US=%lu,HEARTBEAT_MS=%d,IDLE_CPU_MHZ=%d",
+             idle ? "IDLE" : "ACTIVE", enabled, (uint32_t)(idle_us / 1000000),
+             now > 0 ? 100.0f * (float)idle_us / (float)now : 0.0f, entries, wake_us,
+             wake_max_us, TELEMETRY_IDLE_INTERVAL_MS,
+#if CONFIG_PM_ENABLE
+             POWER_IDLE_CPU_MHZ
+#else
+             0
+#endif
+             );
+}
+
+// === POWER COMMANDS ===
+CMD_HANDLER(cmd_power_status) {
+    size_t length = cmd_reply(response, response_size, "POWER_STATUS:");
+    power_scheduler_get_status(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+// POWER_SAVE:0|1
+CMD_HANDLER(cmd_power_save) {
+    uint32_t enable = args->values[0].u;
+    if (enable > 1) {
+        return cmd_reply(response, response_size, "POWER_SAVE:ERROR,INVALID_VALUE");
+    }
+    power_scheduler_set_enabled(enable);
+    return cmd_reply(response, response_size, "POWER_SAVE:SUCCESS,ENABLED=%lu", enable);
+}
+
+static const command_def_t power_commands[] = {
+    { "POWER_STATUS", NULL, cmd_power_status },
+    { "POWER_SAVE",   "u",  cmd_power_save },
+};
+
+esp_err_t power_scheduler_init(void) {
+    if (scheduler_task_handle) {
+        return ESP_OK;
+    }
+
+#if CONFIG_PM_ENABLE
+    // Dynamic frequency scaling only - light sleep would stop the continuous ADC
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = POWER_IDLE_CPU_MHZ,
+        .light_sleep_enable = false
+    };
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret == ESP_OK) {
+        ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "power_active", &cpu_lock);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set up frequency scaling: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    esp_pm_lock_acquire(cpu_lock);  // Starts active
+#endif
+
+    // Above the sender, so a wake is applied before the next reading goes out
+    scheduler_task_handle = static_task_start(&scheduler_task, power_scheduler_task, "power_sched",
+                                              NULL, POWER_SCHED_TASK_PRIORITY, NETWORK_CORE);
+    if (!scheduler_task_handle) {
+        ESP_LOGE(TAG, "Failed to create power scheduler task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (rms_engine_subscribe_cycles(power_cycle_callback, NULL) < 0) {
+        ESP_LOGE(TAG, "Failed to attach to the cycle stream - always active");
+        return ESP_FAIL;
+    }
+
+    command_register_table(power_commands, sizeof(power_commands) / sizeof(power_commands[0]));
+    ESP_LOGI(TAG, "Idle below %.3f A after %d ms (or relay open), heartbeat %d ms",
+             POWER_IDLE_AMPS, POWER_IDLE_HOLD_MS, TELEMETRY_IDLE_INTERVAL_MS);
+    return ESP_OK;
+}
@@ -0,0 +1,336 @@
+#include "protection.h"
+#include "hardware_config.h"
+#include "adc_sampler.h"
+#include "rms_engine.h"
+#include "rms_kernel.h"
+#include "relay.h"
+#include "sct_calibration.h"
+#include "telemetry_protocol.h"
+#include "udp_sender.h"
+#include "command_dispatcher.h"
+#include "perf_monitor.h"
+#include "task_memory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "PROTECTION";
+
+// Configured limits - written by commands, copied by the sampler task on change
+static protection_limits_t limits = {
+    .peak_amps = PROTECTION_PEAK_AMPS,
+    .rated_amps = PROTECTION_RATED_AMPS,
+    .i2t_limit_a2s = PROTECTION_I2T_LIMIT_A2S
+};
+static uint32_t limits_generation = 1;
+static portMUX_TYPE protection_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Sampler task state
+static protection_limits_t active_limits;
+static uint32_t active_generation = 0;
+static uint32_t active_calibration_version = UINT32_MAX;
+static int32_t peak_threshold_scaled = INT32_MAX;   // |AC| in rms_kernel scaled counts
+static float amps_per_scaled_count = 0.0f;
+static uint32_t peak_run = 0;
+static volatile float i2t_heat = 0.0f;              // A^2*s above the rating
+static volatile bool tripped = false;
+
+// Trip records, newest at (trip_count - 1) % PROTECTION_TRIP_HISTORY
+static telemetry_trip_t trip_history[PROTECTION_TRIP_HISTORY];
+static uint32_t trip_count = 0;
+static QueueHandle_t report_queue = NULL;
+STATIC_TASK(report_task, PROTECT_REPORT_TASK_STACK);
+
+static const char* cause_name(uint8_t cause) {
+    switch (cause) {
+        case PROTECTION_TRIP_PEAK: return "PEAK";
+        case PROTECTION_TRIP_I2T:  return "I2T";
+        default:                   return "NONE";
+    }
+}
+
+// Re-derives the count-domain thresholds when limits or calibration change
+static void refresh_thresholds(const calibration_snapshot_t* cal) {
+    uint32_t generation = __atomic_load_n(&limits_generation, __ATOMIC_ACQUIRE);
+    if (generation == active_generation && cal->version == active_calibration_version) {
+        return;
+    }
+
+    portENTER_CRITICAL(&protection_lock);
+    active_limits = limits;
+    portEXIT_CRITICAL(&protection_lock);
+
+    const float scaled_counts_per_volt = (ADC_RESOLUTION / ADC_VOLTAGE_RANGE) * RMS_KERNEL_ONE;
+    amps_per_scaled_count = cal->amps_per_volt / scaled_counts_per_volt;
+    float threshold = (active_limits.peak_amps > 0.0f && amps_per_scaled_count > 0.0f) ?
+                      active_limits.peak_amps / amps_per_scaled_count : (float)INT32_MAX;
+    peak_threshold_scaled = (threshold < (float)INT32_MAX) ? (int32_t)threshold : INT32_MAX;
+
+    active_generation = generation;
+    active_calibration_version = cal->version;
+}
+
+// Runs in the sampler task: open first, then record and hand off the report
+static void trip(protection_trip_cause_t cause, float current_amps, float limit_amps,
+                 int64_t sample_us) {
+    int64_t decided_us = esp_timer_get_time();
+    bool was_on = relay_get_state();
+    relay_trip();
+    int64_t opened_us = esp_timer_get_time();
+    tripped = true;
+
+    telemetry_trip_t record = {
+        .cause = (uint8_t)cause,
+        .relay_was_on = was_on,
+        .current_amps = current_amps,
+        .limit_amps = limit_amps,
+        .i2t_a2s = i2t_heat,
+        .detect_latency_us = (uint32_t)(decided_us > sample_us ? decided_us - sample_us : 0),
+        .open_latency_us = (uint32_t)(opened_us - decided_us),
+        .trip_time_ms = (uint32_t)(opened_us / 1000)
+    };
+
+    portENTER_CRITICAL(&protection_lock);
+    record.trip_count = ++trip_count;
+    trip_history[(trip_count - 1) % PROTECTION_TRIP_HISTORY] = record;
+    portEXIT_CRITICAL(&protection_lock);
+
+    if (report_queue) {
+        xQueueSend(report_queue, &record, 0);
+    }
+}
+
+// Instantaneous curve - every sample of every block while the relay is closed
+static void peak_block_callback(const sample_block_t* block, void* context) {
+    calibration_snapshot_t cal;
+    get_calibration_snapshot(&cal);
+    refresh_thresholds(&cal);
+
+    if (tripped || !relay_get_state() || peak_threshold_scaled == INT32_MAX) {
+        peak_run = 0;
+        return;
+    }
+
+    for (size_t i = 0; i < block->count; i++) {
+        int32_t ac = rms_kernel_ac(block->samples[i], cal.bias_counts);
+        if (ac < 0) ac = -ac;
+        if (ac <= peak_threshold_scaled) {
+            peak_run = 0;
+            continue;
+        }
+        if (++peak_run >= PROTECTION_PEAK_CONFIRM_SAMPLES) {
+            int64_t sample_us = block->timestamp_us -
+                                (int64_t)(block->count - 1 - i) * 1000000 / ADC_OUTPUT_RATE_HZ;
+            trip(PROTECTION_TRIP_PEAK, ac * amps_per_scaled_count, active_limits.peak_amps, sample_us);
+            peak_run = 0;
+            return;
+        }
+    }
+}
+
+// Thermal curve - integrates I^2 - I_rated^2 over each mains cycle
+static void i2t_cycle_callback(const rms_cycle_t* cycle, void* context) {
+    if (tripped || active_generation == 0) {
+        return;
+    }
+
+    float amps = cycle->vrms * cycle->amps_per_volt;
+    float rated = active_limits.rated_amps;
+    float dt = (float)cycle->samples / ADC_OUTPUT_RATE_HZ;
+    float heat = i2t_heat + (amps * amps - rated * rated) * dt;
+    i2t_heat = (heat > 0.0f) ? heat : 0.0f;
+
+    if (active_limits.i2t_limit_a2s > 0.0f && i2t_heat >= active_limits.i2t_limit_a2s &&
+        relay_get_state()) {
+        trip(PROTECTION_TRIP_I2T, amps, rated, cycle->timestamp_us);
+    }
+}
+
+// Trips are reported from here, never from the sampler task
+static void protection_report_task(void *parameters) {
+    PERF_REGISTER_TASK();
+
+    telemetry_trip_t record;
+    while (1) {
+        if (xQueueReceive(report_queue, &record, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        char text[192];
+        snprintf(text, sizeof(text),
+                 "TRIP:COUNT=%lu,CAUSE=%s,CURRENT=%.2fA,LIMIT=%.2fA,I2T=%.1f,"
+                 "DETECT_US=%lu,OPEN_US=%lu,TIME=%lu,RELAY_WAS=%s",
+                 record.trip_count, cause_name(record.cause), record.current_amps,
+                 record.limit_amps, record.i2t_a2s, record.detect_latency_us,
+                 record.open_latency_us, record.trip_time_ms, record.relay_was_on ? "ON" : "OFF");
+        ESP_LOGW(TAG, "%s", text);
+
+        if (!send_telemetry_event(TELEMETRY_FRAME_TRIP, &record, sizeof(record), text)) {
+            ESP_LOGW(TAG, "Trip %lu not broadcast - telemetry not running", record.trip_count);
+        }
+    }
+}
+
+bool protection_set_limits(const protection_limits_t* new_limits) {
+    // isfinite first: NaN fails every comparison below and would disable both curves
+    if (!new_limits || !isfinite(new_limits->peak_amps) || !isfinite(new_limits->rated_amps) ||
+        !isfinite(new_limits->i2t_limit_a2s) ||
+        new_limits->peak_amps < 0.0f || new_limits->peak_amps > MAX_CURRENT_AMPS ||
+        new_limits->rated_amps <= 0.0f || new_limits->rated_amps > MAX_CURRENT_AMPS ||
+        new_limits->i2t_limit_a2s < 0.0f) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&protection_lock);
+    limits = *new_limits;
+    portEXIT_CRITICAL(&protection_lock);
+    __atomic_fetch_add(&limits_generation, 1, __ATOMIC_RELEASE);
+
+    ESP_LOGI(TAG, "Limits: peak %.1f A, rated %.1f A, I2t %.0f A2s",
+             new_limits->peak_amps, new_limits->rated_amps, new_limits->i2t_limit_a2s);
+    return true;
+}
+
+void protection_get_limits(protection_limits_t* out) {
+    if (!out) return;
+    portENTER_CRITICAL(&protection_lock);
+    *out = limits;
+    portEXIT_CRITICAL(&protection_lock);
+}
+
+bool protection_is_tripped(void) {
+    return tripped;
+}
+
+void protection_reset(void) {
+    i2t_heat = 0.0f;
+    tripped = false;
+    relay_clear_lockout();
+    ESP_LOGI(TAG, "Protection re-armed");
+}
+
+void protection_get_status(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+
+    protection_limits_t current;
+    protection_get_limits(&current);
+
+    portENTER_CRITICAL(&protection_lock);
+    uint32_t count = trip_count;
+    uint8_t last_cause = count ? trip_history[(count - 1) % PROTECTION_TRIP_HISTORY].cause : 0;
+    portEXIT_CRITICAL(&protection_lock);
+
+    snprintf(buffer, buffer_size,
+             "STATE=%s,PEAK=%.1fA,RATED=%.1fA,I2T_LIMIT=%.0f,I2T=%.1f,TRIPS=%lu,LAST_CAUSE=%s",
+             tripped ? "TRIPPED" : "ARMED", current.peak_amps, current.rated_amps,
+             current.i2t_limit_a2s, i2t_heat, count, cause_name(last_cause));
+}
+
+// === PROTECTION COMMANDS ===
+CMD_HANDLER(cmd_protect_status) {
+    size_t length = cmd_reply(response, response_size, "PROTECT_STATUS:");
+    protection_get_status(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+// PROTECT_CONFIG:peak_amps,rated_amps[,i2t_a2s] - 0 disables a curve
+CMD_HANDLER(cmd_protect_config) {
+    protection_limits_t new_limits;
+    protection_get_limits(&new_limits);
+    new_limits.peak_amps = args->values[0].f;
+    new_limits.rated_amps = args->values[1].f;
+    if (args->count > 2) {
+        new_limits.i2t_limit_a2s = args->values[2].f;
+    }
+
+    if (!protection_set_limits(&new_limits)) {
+        return cmd_reply(response, response_size, "PROTECT_CONFIG:ERROR,INVALID_RANGE");
+    }
+    return cmd_reply(response, response_size, "PROTECT_CONFIG:SUCCESS,PEAK=%.1fA,RATED=%.1fA,I2T_LIMIT=%.0f",
+                     new_limits.peak_amps, new_limits.rated_amps, new_limits.i2t_limit_a2s);
+}
+
+#if ENABLE_DEVICE_RECOGNITION
+// PROTECT_DEVICE:index - rate the outlet for a known device profile
+CMD_HANDLER(cmd_protect_device) {
+    const device_profile_t* device = get_known_device((int)args->values[0].u);
+    if (!device) {
+        return cmd_reply(response, response_size, "PROTECT_DEVICE:ERROR,UNKNOWN_DEVICE");
+    }
+
+    protection_limits_t new_limits;
+    protection_get_limits(&new_limits);
+    new_limits.rated_amps = device->max_current * PROTECTION_DEVICE_MARGIN;
+    if (!protection_set_limits(&new_limits)) {
+        return cmd_reply(response, response_size, "PROTECT_DEVICE:ERROR,INVALID_RANGE");
+    }
+    return cmd_reply(response, response_size, "PROTECT_DEVICE:SUCCESS,DEVICE=%s,RATED=%.2fA",
+                     device->device_name, new_limits.rated_amps);
+}
+#endif
+
+CMD_HANDLER(cmd_protect_reset) {
+    protection_reset();
+    return cmd_reply(response, response_size, "PROTECT_RESET:SUCCESS,RELAY=%s",
+                     relay_get_state() ? "ON" : "OFF");
+}
+
+CMD_HANDLER(cmd_protect_trips) {
+    telemetry_trip_t history[PROTECTION_TRIP_HISTORY];
+    portENTER_CRITICAL(&protection_lock);
+    uint32_t count = trip_count;
+    memcpy(history, trip_history, sizeof(history));
+    portEXIT_CRITICAL(&protection_lock);
+
+    size_t length = cmd_reply(response, response_size, "PROTECT_TRIPS:COUNT=%lu", count);
+    uint32_t shown = (count < PROTECTION_TRIP_HISTORY) ? count : PROTECTION_TRIP_HISTORY;
+    for (uint32_t i = 0; i < shown; i++) {
+        const telemetry_trip_t* record = &history[(count - 1 - i) % PROTECTION_TRIP_HISTORY];
+        length += cmd_reply(response + length, response_size - length,
+                            ";#%lu,%s,%.2fA,TIME=%lu,DETECT_US=%lu,OPEN_US=%lu",
+                            record->trip_count, cause_name(record->cause), record->current_amps,
+                            record->trip_time_ms, record->detect_latency_us, record->open_latency_us);
+    }
+    return length;
+}
+
+static const command_def_t protection_commands[] = {
+    { "PROTECT_STATUS", NULL,   cmd_protect_status },
+    { "PROTECT_CONFIG", "ff?f", cmd_protect_config },
+#if ENABLE_DEVICE_RECOGNITION
+    { "PROTECT_DEVICE", "u",    cmd_protect_device },
+#endif
+    { "PROTECT_RESET",  NULL,   cmd_protect_reset },
+    { "PROTECT_TRIPS",  NULL,   cmd_protect_trips },
+};
+
+esp_err_t protection_init(void) {
+    if (report_queue) {
+        return ESP_OK;
+    }
+
+    report_queue = xQueueCreate(PROTECTION_TRIP_HISTORY, sizeof(telemetry_trip_t));
+    if (!report_queue ||
+        !static_task_start(&report_task, protection_report_task, "protect_report", NULL,
+                           PROTECT_REPORT_TASK_PRIORITY, NETWORK_CORE)) {
+        ESP_LOGE(TAG, "Failed to create trip reporter");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (adc_sampler_subscribe(peak_block_callback, NULL) < 0 ||
+        rms_engine_subscribe_cycles(i2t_cycle_callback, NULL) < 0) {
+        ESP_LOGE(TAG, "Failed to attach to the sample stream - protection inactive");
+        return ESP_FAIL;
+    }
+
+    command_register_table(protection_commands,
+                           sizeof(protection_commands) / sizeof(protection_commands[0]));
+    ESP_LOGI(TAG, "Protection armed: peak %.1f A, rated %.1f A, I2t %.0f A2s",
+             limits.peak_amps, limits.rated_amps, limits.i2t_limit_a2s);
+    return ESP_OK;
+}
@@ -8,6 +8,8 @@
 static const char *TAG = "RELAY";
 static bool relay_state = false;
 static bool relay_initialized = false;
+static bool relay_locked_out = false;  // Set by a protection trip: the relay may only open
+static portMUX_TYPE relay_lock = portMUX_INITIALIZER_UNLOCKED;  // Keeps relay_state and the pin in step
 
 void relay_init(void) {
     ESP_LOGI(TAG, "Initializing relay on GPIO %d...", RELAY_GPIO);
@@ -48,13 +50,20 @@ void relay_toggle(void) {
         return;
     }
     
+    portENTER_CRITICAL(&relay_lock);
+    if (relay_locked_out && !relay_state) {
+        portEXIT_CRITICAL(&relay_lock);
+        ESP_LOGW(TAG, "Relay locked out by protection - not closing");
+        return;
+    }
     relay_state = !relay_state;
     int gpio_level = relay_state ? 1 : 0;
+    esp_err_t ret = gpio_set_level(RELAY_GPIO, gpio_level);
+    portEXIT_CRITICAL(&relay_lock);
     
     ESP_LOGI(TAG, "Toggling relay to %s (GPIO level: %d)", 
-             relay_state ? "ON" : "OFF", gpio_level);
+             gpio_level ? "ON" : "OFF", gpio_level);
     
-    esp_err_t ret = gpio_set_level(RELAY_GPIO, gpio_level);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set relay GPIO level: %s", esp_err_to_name(ret));
         return;
@@ -63,7 +72,7 @@ void relay_toggle(void) {
     // Verify the state was set
     int actual_level = gpio_get_level(RELAY_GPIO);
     if (actual_level == gpio_level) {
-        ESP_LOGI(TAG, "Relay successfully toggled to %s", relay_state ? "ON" : "OFF");
+        ESP_LOGI(TAG, "Relay successfully toggled to %s", gpio_level ? "ON" : "OFF");
     } else {
         ESP_LOGE(TAG, "Relay toggle failed - expected %d, got %d", gpio_level, actual_level);
     }
@@ -73,15 +82,42 @@ bool relay_get_state(void) {
     return relay_state;
 }
 
-void relay_set_state(bool state) {
+bool relay_set_state(bool state) {
     if (!relay_initialized) {
         ESP_LOGE(TAG, "Relay not initialized - cannot set state");
-        return;
+        return false;
     }
     
+    portENTER_CRITICAL(&relay_lock);
+    if (state && relay_locked_out) {
+        portEXIT_CRITICAL(&relay_lock);
+        ESP_LOGW(TAG, "Relay locked out by protection - not closing");
+        return false;
+    }
     relay_state = state;
-    int gpio_level = state ? 1 : 0;
+    gpio_set_level(RELAY_GPIO, state ? 1 : 0);
+    portEXIT_CRITICAL(&relay_lock);
     
     ESP_LOGI(TAG, "Setting relay to %s", state ? "ON" : "OFF");
-    gpio_set_level(RELAY_GPIO, gpio_level);
-}
\ No newline at end of file
+    return true;
+}
+
+// Called from the sampler task on a trip - no logging, just open and latch
+void relay_trip(void) {
+    portENTER_CRITICAL(&relay_lock);
+    relay_locked_out = true;
+    relay_state = false;
+    gpio_set_level(RELAY_GPIO, 0);
+    portEXIT_CRITICAL(&relay_lock);
+}
+
+void relay_clear_lockout(void) {
+    portENTER_CRITICAL(&relay_lock);
+    relay_locked_out = false;
+    portEXIT_CRITICAL(&relay_lock);
+    ESP_LOGI(TAG, "Relay lockout cleared");
+}
+
+bool relay_is_locked_out(void) {
+    return relay_locked_out;
+}
@@ -0,0 +1,401 @@
+#include "relay_control.h"
+#include "relay.h"
+#include "hardware_config.h"
+#include "rms_engine.h"
+#include "perf_monitor.h"
+#include "task_memory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "RELAY_CTRL";
+
+typedef struct {
+    relay_command_t command;
+    bool state;                     // RELAY_CMD_TIMED target
+    uint32_t duration_ms;
+    float max_amps;                 // 0 = unconditional
+    int sock;
+    struct sockaddr_in client_addr;
+    int64_t received_us;
+} relay_request_t;
+
+// Reply owed by the relay task, sent from the network core
+typedef struct {
+    int sock;
+    struct sockaddr_in client_addr;
+    char text[128];
+} relay_reply_t;
+
+// Pending RELAY_TIMED action - owned by the relay task
+typedef struct {
+    bool active;
+    bool revert_state;
+    int64_t deadline_us;
+    float max_amps;
+    int sock;
+    struct sockaddr_in client_addr;
+} relay_timed_t;
+
+// Actuation latency, datagram arrival to pin write
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} relay_latency_t;
+
+static QueueHandle_t relay_queue = NULL;
+static QueueHandle_t reply_queue = NULL;
+STATIC_TASK(control_task, RELAY_TASK_STACK);
+STATIC_TASK(channel_task, RELAY_CHANNEL_TASK_STACK);
+STATIC_TASK(reply_task, RELAY_CHANNEL_TASK_STACK);
+static relay_timed_t timed;
+static relay_latency_t latency;
+static portMUX_TYPE latency_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void send_reply(int sock, const struct sockaddr_in* addr, const char* text) {
+    if (sendto(sock, text, strlen(text), 0, (const struct sockaddr*)addr, sizeof(*addr)) < 0) {
+        ESP_LOGW(TAG, "Failed to send relay reply");
+    }
+}
+
+// The relay task never touches a socket; its replies go to the reply task
+static void post_reply(int sock, const struct sockaddr_in* addr, const char* text) {
+    relay_reply_t reply = { .sock = sock, .client_addr = *addr };
+    snprintf(reply.text, sizeof(reply.text), "%s", text);
+    if (xQueueSend(reply_queue, &reply, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Relay reply queue full - reply dropped");
+    }
+}
+
+static void record_latency(int64_t elapsed_us) {
+    uint32_t us = (elapsed_us > 0) ? (uint32_t)elapsed_us : 0;
+
+    portENTER_CRITICAL(&latency_lock);
+    latency.count++;
+    latency.last_us = us;
+    latency.total_us += us;
+    if (us > latency.max_us) latency.max_us = us;
+    portEXIT_CRITICAL(&latency_lock);
+
+    PERF_RECORD_US(PERF_PROBE_RELAY_LATENCY, us);
+}
+
+static void finish_timed(const char* reason) {
+    char reply[96];
+    snprintf(reply, sizeof(reply), "RELAY_TIMED:COMPLETE,STATE=%s,REASON=%s",
+             relay_get_state() ? "ON" : "OFF", reason);
+    post_reply(timed.sock, &timed.client_addr, reply);
+    timed.active = false;
+    ESP_LOGI(TAG, "Timed switch finished: %s", reason);
+}
+
+static void execute_request(const relay_request_t* req) {
+    // Any explicit command supersedes a pending timed action
+    if (timed.active) {
+        finish_timed("CANCELLED");
+    }
+
+    // The pin write is the first thing relay_set_state/relay_toggle do
+    int64_t actuated_us = esp_timer_get_time();
+    bool switched = true;
+    switch (req->command) {
+        case RELAY_CMD_ON:
+            switched = relay_set_state(true);
+            break;
+        case RELAY_CMD_OFF:
+            switched = relay_set_state(false);
+            break;
+        case RELAY_CMD_TOGGLE:
+            switched = relay_get_state() || !relay_is_locked_out();
+            if (switched) {
+                relay_toggle();
+            }
+            break;
+        case RELAY_CMD_TIMED:
+            timed.revert_state = relay_get_state();
+            switched = relay_set_state(req->state);
+            if (!switched) {
+                break;
+            }
+            timed.active = true;
+            timed.deadline_us = actuated_us + (int64_t)req->duration_ms * 1000;
+            timed.max_amps = req->state ? req->max_amps : 0.0f;
+            timed.sock = req->sock;
+            timed.client_addr = req->client_addr;
+            break;
+    }
+    char reply[128];
+    if (!switched) {
+        static const char* const names[] = { "RELAY_ON", "RELAY_OFF", "RELAY_TOGGLE", "RELAY_TIMED" };
+        snprintf(reply, sizeof(reply), "%s:ERROR,%s", names[req->command],
+                 relay_is_locked_out() ? "LOCKED_OUT" : "NOT_INITIALIZED");
+        post_reply(req->sock, &req->client_addr, reply);
+        return;
+    }
+
+    uint32_t elapsed_us = (uint32_t)(actuated_us - req->received_us);
+    record_latency(actuated_us - req->received_us);
+
+    switch (req->command) {
+        case RELAY_CMD_ON:
+            snprintf(reply, sizeof(reply), "RELAY_ON:SUCCESS,LATENCY_US=%lu", elapsed_us);
+            break;
+        case RELAY_CMD_OFF:
+            snprintf(reply, sizeof(reply), "RELAY_OFF:SUCCESS,LATENCY_US=%lu", elapsed_us);
+            break;
+        case RELAY_CMD_TOGGLE:
+            snprintf(reply, sizeof(reply), "RELAY_TOGGLE:SUCCESS,STATE=%s,LATENCY_US=%lu",
+                     relay_get_state() ? "ON" : "OFF", elapsed_us);
+            break;
+        case RELAY_CMD_TIMED:
+            snprintf(reply, sizeof(reply),
+                     "RELAY_TIMED:SUCCESS,STATE=%s,DURATION_MS=%lu,MAX_AMPS=%.2f,LATENCY_US=%lu",
+                     req->state ? "ON" : "OFF", req->duration_ms, timed.max_amps, elapsed_us);
+            break;
+    }
+    post_reply(req->sock, &req->client_addr, reply);
+}
+
+static void service_timed(void) {
+    if (!timed.active) {
+        return;
+    }
+
+    if (relay_is_locked_out()) {
+        finish_timed("TRIPPED");  // Protection opened the relay; never revert to closed
+    } else if (timed.max_amps > 0.0f && relay_get_state() &&
+        rms_engine_get_last_cycle_current() > timed.max_amps) {
+        relay_set_state(false);
+        finish_timed("OVERCURRENT");
+    } else if (esp_timer_get_time() >= timed.deadline_us) {
+        relay_set_state(timed.revert_state);
+        finish_timed("EXPIRED");
+    }
+}
+
+// How long the relay task may sleep before the pending timed action needs it
+static TickType_t next_wait(void) {
+    if (!timed.active) {
+        return portMAX_DELAY;
+    }
+
+    int64_t remaining_us = timed.deadline_us - esp_timer_get_time();
+    if (remaining_us <= 0) {
+        return 0;
+    }
+    uint32_t wait_ms = (uint32_t)((remaining_us + 999) / 1000);
+    if (timed.max_amps > 0.0f && wait_ms > RELAY_CONDITION_POLL_MS) {
+        wait_ms = RELAY_CONDITION_POLL_MS;
+    }
+    TickType_t ticks = pdMS_TO_TICKS(wait_ms);
+    return ticks > 0 ? ticks : 1;
+}
+
+static void relay_control_task(void *parameters) {
+    PERF_REGISTER_TASK();
+    ESP_LOGI(TAG, "Relay control task running on core %d", xPortGetCoreID());
+
+    relay_request_t req;
+    while (1) {
+        if (xQueueReceive(relay_queue, &req, next_wait()) == pdTRUE) {
+            execute_request(&req);
+        }
+        service_timed();
+    }
+}
+
+bool relay_control_request(relay_command_t command, bool state, uint32_t duration_ms,
+                           float max_amps, const cmd_context_t* ctx) {
+    if (!relay_queue || !ctx || !ctx->client_addr) {
+        return false;
+    }
+
+    relay_request_t req = {
+        .command = command,
+        .state = state,
+        .duration_ms = duration_ms,
+        .max_amps = max_amps,
+        .sock = ctx->sock,
+        .client_addr = *ctx->client_addr,
+        .received_us = ctx->received_us
+    };
+    return xQueueSend(relay_queue, &req, 0) == pdTRUE;
+}
+
+void relay_control_get_stats(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+
+    portENTER_CRITICAL(&latency_lock);
+    relay_latency_t snapshot = latency;
+    portEXIT_CRITICAL(&latency_lock);
+
+    snprintf(buffer, buffer_size,
+             "STATE=%s,SWITCHES=%lu,LAST_US=%lu,MAX_US=%lu,AVG_US=%lu,TIMED=%s,QUEUED=%lu",
+             relay_get_state() ? "ON" : "OFF",
+             snapshot.count, snapshot.last_us, snapshot.max_us,
+             snapshot.count ? (uint32_t)(snapshot.total_us / snapshot.count) : 0,
+             timed.active ? "PENDING" : "NONE",
+             relay_queue ? (uint32_t)uxQueueMessagesWaiting(relay_queue) : 0);
+}
+
+// === RELAY COMMANDS ===
+static size_t queue_relay(relay_command_t command, const char* name, bool state,
+                          uint32_t duration_ms, float max_amps, const cmd_context_t* ctx,
+                          char* response, size_t response_size) {
+    if (!relay_control_request(command, state, duration_ms, max_amps, ctx)) {
+        return cmd_reply(response, response_size, "%s:ERROR,BUSY", name);
+    }
+    return 0; // Reply sent by the relay task once it has switched
+}
+
+CMD_HANDLER(cmd_relay_on) {
+    return queue_relay(RELAY_CMD_ON, "RELAY_ON", true, 0, 0.0f, ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_relay_off) {
+    return queue_relay(RELAY_CMD_OFF, "RELAY_OFF", false, 0, 0.0f, ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_relay_toggle) {
+    return queue_relay(RELAY_CMD_TOGGLE, "RELAY_TOGGLE", false, 0, 0.0f, ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_relay_timed) {
+    uint32_t state = args->values[0].u;
+    uint32_t duration_ms = args->values[1].u;
+    float max_amps = (args->count > 2) ? args->values[2].f : 0.0f;
+
+    if (state > 1 || duration_ms == 0 || duration_ms > RELAY_TIMED_MAX_MS ||
+        max_amps < 0.0f || max_amps > MAX_CURRENT_AMPS) {
+        return cmd_reply(response, response_size, "RELAY_TIMED:ERROR,INVALID_PARAMETERS");
+    }
+    return queue_relay(RELAY_CMD_TIMED, "RELAY_TIMED", state == 1, duration_ms, max_amps,
+                       ctx, response, response_size);
+}
+
+CMD_HANDLER(cmd_relay_stats) {
+    size_t length = cmd_reply(response, response_size, "RELAY_STATS:");
+    relay_control_get_stats(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+static const command_def_t relay_commands[] = {
+    { "RELAY_ON",     NULL,   cmd_relay_on },
+    { "RELAY_OFF",    NULL,   cmd_relay_off },
+    { "RELAY_TOGGLE", NULL,   cmd_relay_toggle },
+    { "RELAY_TIMED",  "uu?f", cmd_relay_timed },
+    { "RELAY_STATS",  NULL,   cmd_relay_stats },
+};
+
+#define RELAY_COMMAND_COUNT (sizeof(relay_commands) / sizeof(relay_commands[0]))
+
+static void relay_reply_task(void *parameters) {
+    PERF_REGISTER_TASK();
+
+    relay_reply_t reply;
+    while (1) {
+        if (xQueueReceive(reply_queue, &reply, portMAX_DELAY) == pdTRUE) {
+            send_reply(reply.sock, &reply.client_addr, reply.text);
+        }
+    }
+}
+
+// Dedicated channel: only relay commands are accepted here, parsed on the network
+// core and queued for the relay task
+static void relay_channel_task(void *parameters) {
+    PERF_REGISTER_TASK();
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in server_addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = INADDR_ANY,
+        .sin_port = htons(UDP_RELAY_PORT)
+    };
+    if (sock < 0 || bind(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        ESP_LOGE(TAG, "Failed to open relay channel on port %d", UDP_RELAY_PORT);
+        if (sock >= 0) close(sock);
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "Relay channel listening on port %d", UDP_RELAY_PORT);
+
+    char buffer[128];
+    char response[160];
+    struct sockaddr_in client_addr;
+
+    while (1) {
+        socklen_t client_addr_len = sizeof(client_addr);
+        int recv_len = recvfrom(sock, buffer, sizeof(buffer) - 1, 0,
+                                (struct sockaddr*)&client_addr, &client_addr_len);
+        if (recv_len <= 0) {
+            if (recv_len < 0) vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        buffer[recv_len] = '\0';
+
+        cmd_context_t ctx = {
+            .sock = sock,
+            .client_addr = &client_addr,
+            .received_us = esp_timer_get_time()
+        };
+        size_t length = command_dispatch_table(relay_commands, RELAY_COMMAND_COUNT, buffer,
+                                               &ctx, response, sizeof(response));
+        if (length > 0) {
+            send_reply(sock, &client_addr, response);
+        }
+    }
+}
+
+esp_err_t relay_control_start(void) {
+    if (relay_queue) {
+        return ESP_OK;
+    }
+
+    relay_queue = xQueueCreate(RELAY_QUEUE_DEPTH, sizeof(relay_request_t));
+    reply_queue = xQueueCreate(RELAY_REPLY_QUEUE_DEPTH, sizeof(relay_reply_t));
+    if (!relay_queue || !reply_queue) {
+        ESP_LOGE(TAG, "Failed to create relay queues");
+        if (relay_queue) vQueueDelete(relay_queue);
+        if (reply_queue) vQueueDelete(reply_queue);
+        relay_queue = NULL;
+        reply_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Socket work stays on the network core, below the sampler, so a flood of relay
+    // datagrams cannot starve sampling; only actuation runs above it on APP_CPU
+    if (!static_task_start(&reply_task, relay_reply_task, "relay_tx", NULL,
+                           RELAY_CHANNEL_TASK_PRIORITY, NETWORK_CORE)) {
+        ESP_LOGE(TAG, "Failed to create relay reply task");
+        vQueueDelete(relay_queue);
+        vQueueDelete(reply_queue);
+        relay_queue = NULL;
+        reply_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t core = (portNUM_PROCESSORS > 1) ? RELAY_TASK_CORE : 0;
+    if (!static_task_start(&control_task, relay_control_task, "relay_ctrl", NULL,
+                           RELAY_TASK_PRIORITY, core)) {
+        ESP_LOGE(TAG, "Failed to create relay control task");
+        vQueueDelete(relay_queue);
+        relay_queue = NULL;  // The reply task keeps waiting on its (empty) queue
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The channel only parses and queues, so a failure here still leaves the shared port
+    if (!static_task_start(&channel_task, relay_channel_task, "relay_rx", NULL,
+                           RELAY_CHANNEL_TASK_PRIORITY, NETWORK_CORE)) {
+        ESP_LOGW(TAG, "Relay channel unavailable - relay commands via port %d only", UDP_RECV_PORT);
+    }
+
+    command_register_table(relay_commands, RELAY_COMMAND_COUNT);
+    return ESP_OK;
+}
@@ -0,0 +1,63 @@
+#include "rls_estimator.h"
+#include <math.h>
+
+void rls_init(rls_estimator_t *rls, float gain, float gain_sd, float offset, float offset_sd) {
+    rls->gain = gain;
+    rls->offset = offset;
+    rls->p_gain = gain_sd * gain_sd;
+    rls->p_cross = 0.0f;
+    rls->p_offset = offset_sd * offset_sd;
+    rls->p_gain_max = rls->p_gain;
+    rls->p_offset_max = rls->p_offset;
+    rls->weight = 0.0f;
+    rls->updates = 0;
+}
+
+// Congruence scaling keeps the matrix positive semi-definite and the correlation as it was
+static void cap_covariance(rls_estimator_t *rls) {
+    float scale_gain = (rls->p_gain > rls->p_gain_max) ? sqrtf(rls->p_gain_max / rls->p_gain) : 1.0f;
+    float scale_offset = (rls->p_offset > rls->p_offset_max) ? sqrtf(rls->p_offset_max / rls->p_offset) : 1.0f;
+    rls->p_gain *= scale_gain * scale_gain;
+    rls->p_cross *= scale_gain * scale_offset;
+    rls->p_offset *= scale_offset * scale_offset;
+}
+
+void rls_update(rls_estimator_t *rls, float x, float y, float noise_variance, float forgetting) {
+    // P * (x, 1)
+    float px_gain = rls->p_gain * x + rls->p_cross;
+    float px_offset = rls->p_cross * x + rls->p_offset;
+    float innovation_variance = forgetting * noise_variance + px_gain * x + px_offset;
+    if (!(innovation_variance > 0.0f) || !(forgetting > 0.0f)) {
+        return;
+    }
+
+    float k_gain = px_gain / innovation_variance;
+    float k_offset = px_offset / innovation_variance;
+    float error = y - (rls->gain * x + rls->offset);
+    rls->gain += k_gain * error;
+    rls->offset += k_offset * error;
+
+    // P = (P - K (P x)^T) / forgetting; K (P x)^T is symmetric, so three terms do
+    rls->p_gain = fmaxf((rls->p_gain - k_gain * px_gain) / forgetting, 0.0f);
+    rls->p_cross = (rls->p_cross - k_gain * px_offset) / forgetting;
+    rls->p_offset = fmaxf((rls->p_offset - k_offset * px_offset) / forgetting, 0.0f);
+    float cross_limit = sqrtf(rls->p_gain * rls->p_offset);
+    rls->p_cross = fminf(fmaxf(rls->p_cross, -cross_limit), cross_limit);
+    cap_covariance(rls);
+
+    rls->weight = rls->weight * forgetting + 1.0f;
+    rls->updates++;
+}
+
+float rls_gain_sd(const rls_estimator_t *rls) {
+    return sqrtf(rls->p_gain);
+}
+
+float rls_offset_sd(const rls_estimator_t *rls) {
+    return sqrtf(rls->p_offset);
+}
+
+float rls_correlation(const rls_estimator_t *rls) {
+    float product = rls->p_gain * rls->p_offset;
+    return (product > 0.0f) ? rls->p_cross / sqrtf(product) : 0.0f;
+}
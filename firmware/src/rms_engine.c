@@ -0,0 +1,276 @@
+#include "rms_engine.h"
+#include "rms_kernel.h"
+#include "adc_sampler.h"
+#include "hardware_config.h"
+#include "sct_calibration.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+static const char *TAG = "RMS_ENGINE";
+
+static int subscription_id = -1;
+
+// Per-cycle and per-window RMS accumulation (sampler task only)
+static calibration_snapshot_t cycle_calibration;
+static rms_accumulator_t cycle_acc;
+static rms_accumulator_t window_acc;
+static uint32_t window_cycles = 0;
+static uint32_t window_sequence = 0;
+static volatile uint32_t total_cycles = 0;
+static volatile float last_cycle_vrms = 0.0f;
+static volatile float last_cycle_current = 0.0f;
+
+// Zero-crossing tracking (sampler task only)
+#define ZC_MIN_CYCLE_SAMPLES (ADC_OUTPUT_RATE_HZ / ZC_MAX_LINE_HZ)
+#define ZC_MAX_CYCLE_SAMPLES (ADC_OUTPUT_RATE_HZ / ZC_MIN_LINE_HZ)
+
+static bool zc_armed = false;         // AC went below -hysteresis since the last crossing
+static bool zc_locked = false;        // Current cycle started at a crossing
+static int32_t zc_previous_ac = 0;
+static float zc_last_fraction = 0.0f; // Crossing position inside the cycle's first sample
+static float window_period_sum = 0.0f;
+static uint32_t window_synced_cycles = 0;
+static volatile float line_frequency_hz = 0.0f;
+
+// Per-cycle listeners
+typedef struct {
+    rms_cycle_callback_t callback;
+    void *context;
+} cycle_subscriber_t;
+
+static cycle_subscriber_t cycle_subscribers[MAX_CYCLE_SUBSCRIBERS];
+static volatile int cycle_subscriber_count = 0;
+static portMUX_TYPE subscriber_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Latest published window
+static rms_window_t latest_window;
+static bool window_valid = false;
+static portMUX_TYPE window_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t window_ready_sem = NULL;
+
+static void reset_window(void) {
+    rms_kernel_reset(&window_acc);
+    window_cycles = 0;
+    window_period_sum = 0.0f;
+    window_synced_cycles = 0;
+}
+
+static void publish_window(int64_t timestamp_us) {
+    rms_window_t window = {
+        .vrms = rms_kernel_vrms(&window_acc),
+        .last_cycle_vrms = last_cycle_vrms,
+        .cycles = window_cycles,
+        .samples = window_acc.count,
+        .sequence = ++window_sequence,
+        .timestamp_us = timestamp_us,
+        .amps_per_volt = cycle_calibration.amps_per_volt,
+        .calibration_version = cycle_calibration.version,
+        .line_frequency_hz = (window_synced_cycles > 0)
+                             ? ADC_OUTPUT_RATE_HZ * window_synced_cycles / window_period_sum
+                             : 0.0f,
+        .synced_cycles = window_synced_cycles
+    };
+
+    if (window.synced_cycles > 0) {
+        line_frequency_hz = window.line_frequency_hz;
+    }
+
+    portENTER_CRITICAL(&window_lock);
+    latest_window = window;
+    window_valid = true;
+    portEXIT_CRITICAL(&window_lock);
+
+    xSemaphoreGive(window_ready_sem);
+
+    reset_window();
+}
+
+static void finish_cycle(int64_t timestamp_us, bool synced, float period_samples) {
+    last_cycle_vrms = rms_kernel_vrms(&cycle_acc);
+    last_cycle_current = last_cycle_vrms * cycle_calibration.amps_per_volt;
+
+    rms_cycle_t cycle = {
+        .vrms = last_cycle_vrms,
+        .samples = cycle_acc.count,
+        .index = total_cycles,
+        .timestamp_us = timestamp_us,
+        .amps_per_volt = cycle_calibration.amps_per_volt,
+        .calibration_version = cycle_calibration.version,
+        .period_samples = synced ? period_samples : (float)cycle_acc.count,
+        .synced = synced
+    };
+    total_cycles++;
+
+    int listeners = cycle_subscriber_count;
+    for (int i = 0; i < listeners; i++) {
+        cycle_subscribers[i].callback(&cycle, cycle_subscribers[i].context);
+    }
+
+    rms_kernel_merge(&window_acc, &cycle_acc);
+    window_cycles++;
+    if (synced) {
+        window_period_sum += period_samples;
+        window_synced_cycles++;
+    }
+
+    rms_kernel_reset(&cycle_acc);
+
+    if (window_cycles >= RMS_WINDOW_CYCLES) {
+        publish_window(timestamp_us);
+    }
+}
+
+// Calibration is sampled once per cycle (lock-free) so a cycle never mixes two
+// generations; a partial window from an older generation is dropped
+static void begin_cycle(void) {
+    uint32_t previous_version = cycle_calibration.version;
+    get_calibration_snapshot(&cycle_calibration);
+    if (cycle_calibration.version != previous_version && window_cycles > 0) {
+        reset_window();
+    }
+}
+
+static void rms_block_callback(const sample_block_t *block, void *context) {
+    const int64_t sample_period_us = 1000000 / ADC_OUTPUT_RATE_HZ;
+    const int32_t hysteresis = ZC_HYSTERESIS_COUNTS << RMS_KERNEL_FRAC_BITS;
+
+    for (size_t i = 0; i < block->count; i++) {
+        if (cycle_acc.count == 0) {
+            begin_cycle();
+        }
+
+        int32_t ac = rms_kernel_ac(block->samples[i], cycle_calibration.bias_counts);
+
+        if (ac < -hysteresis) {
+            zc_armed = true;
+        } else if (zc_armed && ac >= 0) {
+            // Rising crossing between the previous sample and this one
+            zc_armed = false;
+            float fraction = (float)(-zc_previous_ac) / (float)(ac - zc_previous_ac);
+            int64_t end_us = block->timestamp_us - (int64_t)(block->count - i) * sample_period_us;
+
+            if (zc_locked) {
+                if (cycle_acc.count >= ZC_MIN_CYCLE_SAMPLES) {
+                    float period = (float)cycle_acc.count - zc_last_fraction + fraction;
+                    finish_cycle(end_us, true, period);
+                    zc_last_fraction = fraction;
+                }
+                // Shorter than any plausible period: noise, keep the cycle open
+            } else {
+                // Acquiring lock: close out the unsynced run, or drop a short fragment
+                if (cycle_acc.count >= ZC_MIN_CYCLE_SAMPLES) {
+                    finish_cycle(end_us, false, 0.0f);
+                } else {
+                    rms_kernel_reset(&cycle_acc);
+                }
+                zc_locked = true;
+                zc_last_fraction = fraction;
+            }
+
+            // A new cycle starts at this sample
+            if (cycle_acc.count == 0) {
+                begin_cycle();
+                ac = rms_kernel_ac(block->samples[i], cycle_calibration.bias_counts);
+            }
+        }
+
+        rms_kernel_add(&cycle_acc, ac);
+        zc_previous_ac = ac;
+
+        // No crossing in time (no load, or the signal is lost): nominal-length cycles
+        if (cycle_acc.count >= (zc_locked ? ZC_MAX_CYCLE_SAMPLES : SAMPLES_PER_CYCLE)) {
+            int64_t end_us = block->timestamp_us - (int64_t)(block->count - 1 - i) * sample_period_us;
+            finish_cycle(end_us, false, 0.0f);
+            zc_locked = false;
+        }
+    }
+}
+
+esp_err_t rms_engine_init(void) {
+    if (subscription_id >= 0) {
+        ESP_LOGW(TAG, "RMS engine already initialized");
+        return ESP_OK;
+    }
+
+    get_calibration_snapshot(&cycle_calibration);
+
+    window_ready_sem = xSemaphoreCreateBinary();
+    if (window_ready_sem == NULL) {
+        ESP_LOGE(TAG, "Failed to create window semaphore");
+        return ESP_ERR_NO_MEM;
+    }
+
+    subscription_id = adc_sampler_subscribe(rms_block_callback, NULL);
+    if (subscription_id < 0) {
+        ESP_LOGE(TAG, "Failed to subscribe to ADC sampler");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "RMS engine ready: %d samples/cycle, %d cycles/window",
+             SAMPLES_PER_CYCLE, RMS_WINDOW_CYCLES);
+    return ESP_OK;
+}
+
+bool rms_engine_wait_window(rms_window_t *window, uint32_t timeout_ms) {
+    if (!window || window_ready_sem == NULL) {
+        return false;
+    }
+
+    if (xSemaphoreTake(window_ready_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return false;
+    }
+
+    return rms_engine_get_latest_window(window);
+}
+
+bool rms_engine_get_latest_window(rms_window_t *window) {
+    if (!window) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&window_lock);
+    bool valid = window_valid;
+    *window = latest_window;
+    portEXIT_CRITICAL(&window_lock);
+
+    return valid;
+}
+
+float rms_engine_get_last_cycle_vrms(void) {
+    return last_cycle_vrms;
+}
+
+float rms_engine_get_last_cycle_current(void) {
+    return last_cycle_current;
+}
+
+float rms_engine_get_line_frequency(void) {
+    return line_frequency_hz;
+}
+
+uint32_t rms_engine_get_cycle_count(void) {
+    return total_cycles;
+}
+
+int rms_engine_subscribe_cycles(rms_cycle_callback_t callback, void *context) {
+    if (!callback) {
+        return -1;
+    }
+
+    int id = -1;
+    portENTER_CRITICAL(&subscriber_lock);
+    if (cycle_subscriber_count < MAX_CYCLE_SUBSCRIBERS) {
+        id = cycle_subscriber_count;
+        cycle_subscribers[id].callback = callback;
+        cycle_subscribers[id].context = context;
+        // Publish the slot only after it is filled in
+        cycle_subscriber_count = id + 1;
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+
+    if (id < 0) {
+        ESP_LOGE(TAG, "No free cycle subscriber slots");
+    }
+    return id;
+}
@@ -0,0 +1,118 @@
+#include "rolling_stats.h"
+#include <math.h>
+
+void rolling_stats_init(rolling_stats_t *stats, float *storage, uint16_t capacity) {
+    stats->values = storage;
+    stats->capacity = storage ? capacity : 0;
+    rolling_stats_reset(stats);
+}
+
+void rolling_stats_reset(rolling_stats_t *stats) {
+    stats->head = 0;
+    stats->count = 0;
+    stats->updates = 0;
+    stats->mean = 0.0f;
+    stats->m2 = 0.0f;
+    stats->min = INFINITY;
+    stats->max = -INFINITY;
+    stats->extremes_stale = false;
+}
+
+// Float removal slowly drifts; recomputing once per window length keeps it O(1) amortized
+static void resync_window(rolling_stats_t *stats) {
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < stats->count; i++) {
+        sum += stats->values[i];
+    }
+    float mean = sum / stats->count;
+
+    float m2 = 0.0f;
+    for (uint32_t i = 0; i < stats->count; i++) {
+        float diff = stats->values[i] - mean;
+        m2 += diff * diff;
+    }
+
+    stats->mean = mean;
+    stats->m2 = m2;
+    stats->updates = 0;
+}
+
+static void rescan_extremes(rolling_stats_t *stats) {
+    stats->min = INFINITY;
+    stats->max = -INFINITY;
+    for (uint32_t i = 0; i < stats->count; i++) {
+        if (stats->values[i] < stats->min) stats->min = stats->values[i];
+        if (stats->values[i] > stats->max) stats->max = stats->values[i];
+    }
+    stats->extremes_stale = false;
+}
+
+void rolling_stats_add(rolling_stats_t *stats, float value) {
+    if (stats->capacity > 0 && stats->count == stats->capacity) {
+        // Replace the oldest value: one combined remove+add step
+        float old_value = stats->values[stats->head];
+        float old_mean = stats->mean;
+        float delta = value - old_value;
+
+        stats->mean += delta / stats->count;
+        stats->m2 += delta * (value - stats->mean + old_value - old_mean);
+        if (stats->m2 < 0.0f) stats->m2 = 0.0f;
+
+        if (old_value <= stats->min || old_value >= stats->max) {
+            stats->extremes_stale = true;
+        }
+    } else {
+        stats->count++;
+        float delta = value - stats->mean;
+        stats->mean += delta / stats->count;
+        stats->m2 += delta * (value - stats->mean);
+    }
+
+    if (value < stats->min) stats->min = value;
+    if (value > stats->max) stats->max = value;
+
+    if (stats->capacity > 0) {
+        stats->values[stats->head] = value;
+        stats->head = (stats->head + 1) % stats->capacity;
+        if (++stats->updates >= stats->capacity) {
+            resync_window(stats);
+        }
+    }
+}
+
+uint32_t rolling_stats_count(const rolling_stats_t *stats) {
+    return stats->count;
+}
+
+bool rolling_stats_full(const rolling_stats_t *stats) {
+    return stats->capacity > 0 && stats->count == stats->capacity;
+}
+
+float rolling_stats_mean(const rolling_stats_t *stats) {
+    return stats->mean;
+}
+
+float rolling_stats_variance(const rolling_stats_t *stats) {
+    return (stats->count > 0) ? stats->m2 / stats->count : 0.0f;
+}
+
+float rolling_stats_stddev(const rolling_stats_t *stats) {
+    return sqrtf(rolling_stats_variance(stats));
+}
+
+float rolling_stats_rms(const rolling_stats_t *stats) {
+    return sqrtf(rolling_stats_variance(stats) + stats->mean * stats->mean);
+}
+
+// Min/max only need a rescan after the current extreme leaves the window
+float rolling_stats_min(rolling_stats_t *stats) {
+    if (stats->count == 0) return 0.0f;
+    if (stats->extremes_stale) rescan_extremes(stats);
+    return stats->min;
+}
+
+float rolling_stats_max(rolling_stats_t *stats) {
+    if (stats->count == 0) return 0.0f;
+    if (stats->extremes_stale) rescan_extremes(stats);
+    return stats->max;
+}
@@ -2,39 +2,51 @@
 #include "hardware_config.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
 #include "esp_log.h"
-#include "esp_adc/adc_oneshot.h"
+#include "adc_sampler.h"
+#include "rms_kernel.h"
+#include "load_events.h"
+#include "device_library.h"
+#include "rls_estimator.h"
+#include "perf_monitor.h"
+#include "task_memory.h"
 #include "lwip/sockets.h"
+#include "nvs.h"
 #include <math.h>
 #include <string.h>
 
 static const char *TAG = "SCT_CAL";
 
-// External ADC handle - now defined in main.c
-extern adc_oneshot_unit_handle_t adc1_handle;
-
-// Global calibration values
-static float amps_per_volt = 200.0f;  // SCT-013-000 with 10Ω burden
-static float bias_voltage = 1.65f;    // Half of 3.3V for AC coupling
+// Calibration snapshot - published through a seqlock so readers never take a lock.
+// Writers update inside a critical section, so a reader only ever retries for the
+// few instructions of a copy running on the other core.
+static calibration_snapshot_t calibration_snapshot = {
+    .bias_voltage = 1.65f,    // Half of 3.3V for AC coupling
+    .amps_per_volt = 200.0f,  // SCT-013-000 with 10Ω burden
+    .bias_counts = RMS_KERNEL_BIAS_COUNTS(1.65f),
+    .version = 0
+};
+static volatile uint32_t calibration_seq = 0;
+static portMUX_TYPE calibration_write_lock = portMUX_INITIALIZER_UNLOCKED;
 
 // Auto-detection state
 static bool auto_detection_enabled = true;
 static bool auto_calibration_enabled = AUTO_CAL_ENABLED;
-static float detected_load_amps = 0.0f;
+static QueueHandle_t detected_load_mailbox = NULL;  // One slot: xQueueOverwrite / xQueuePeek
 
 // Auto-calibration state
 static uint32_t last_zero_calibration = 0;
 static uint32_t last_scale_calibration = 0;
-static uint32_t consecutive_zero_readings = 0;
 static float auto_cal_sensitivity = 0.7f;  // Default moderate sensitivity
 static float learning_rate = 0.1f;
 
-// Learning system
+// Learning system - one least-squares fit, updated by every calibration point
 #if ENABLE_CALIBRATION_LEARNING
-static calibration_point_t learning_points[MAX_LEARNING_POINTS];
-static int learning_point_count = 0;
-static int learning_point_index = 0;  // Circular buffer index
+static rls_estimator_t learning_fit;
+static uint32_t last_learning_ms = 0;
+static portMUX_TYPE learning_lock = portMUX_INITIALIZER_UNLOCKED;
 #endif
 
 // Device recognition profiles
@@ -52,6 +64,11 @@ static const device_profile_t known_devices[] = {
     {0.02f, 0.1f, 0.05f, "Phone Charger/Standby", 0.5f}
 };
 static const int num_known_devices = sizeof(known_devices) / sizeof(known_devices[0]);
+
+// User-added profiles (persisted with the calibration record)
+static device_profile_t custom_devices[MAX_CUSTOM_DEVICES];
+static char custom_device_names[MAX_CUSTOM_DEVICES][CUSTOM_DEVICE_NAME_LEN];
+static volatile int num_custom_devices = 0;
 #endif
 
 // Statistics
@@ -60,58 +77,606 @@ static uint32_t last_auto_cal_time = 0;
 static uint32_t successful_recognitions = 0;
 static uint32_t failed_recognitions = 0;
 
-// Current reading history for pattern analysis
-#define HISTORY_SIZE 50
-static float current_history[HISTORY_SIZE];
-static int history_index = 0;
-static bool history_full = false;
+// Settled levels from the load change detector, consumed by the auto-calibration task
+static QueueHandle_t auto_cal_queue = NULL;
+static TaskHandle_t auto_cal_task_handle = NULL;
+static uint32_t auto_cal_changes_dropped = 0;
+
+static bool calibrate_to_load(float known_amps, bool manual);
+
+// Collector timeout; sample counts are in sct_calibration.h
+#define COLLECT_TIMEOUT_MS 2000
+
+// DC level tracking (bias tracker subscriber on the sample stream)
+#define DC_TRACK_ALPHA 0.02f                   // Per-block EMA weight (~1 s time constant)
+static volatile float tracked_dc_voltage = ADC_BIAS_VOLTAGE;
+static int dc_tracker_subscription = -1;
 
 // Global mutex for thread-safe access
 static SemaphoreHandle_t calibration_mutex = NULL;
 
+// Persisted calibration record - one NVS blob, rejected on version or size mismatch.
+// The last learning update is stored as an age so its decay continues across boots.
+// A version 1 record (the learning points themselves) is migrated by replaying them.
+#define CAL_NVS_NAMESPACE "calibration"
+#define CAL_NVS_KEY "record"
+#define CAL_RECORD_VERSION 2
+#define CAL_RECORD_V1_POINTS 50
+
+typedef struct {
+    float expected_current;
+    float measured_voltage;
+    uint32_t age_ms;
+    float confidence;
+    uint8_t auto_generated;
+    uint8_t reserved[3];
+} stored_point_t;
+
+typedef struct {
+    float min_current;
+    float max_current;
+    float typical_current;
+    float confidence_boost;
+    char name[CUSTOM_DEVICE_NAME_LEN];
+} stored_device_t;
+
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    uint32_t saves;
+    float bias_voltage;
+    float amps_per_volt;
+    float auto_cal_sensitivity;
+    float learning_rate;
+    uint8_t auto_calibration_enabled;
+    uint8_t auto_detection_enabled;
+    uint16_t custom_device_count;
+    uint32_t learning_age_ms;
+    rls_estimator_t learning;
+    stored_device_t devices[MAX_CUSTOM_DEVICES];
+} calibration_record_t;
+
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    uint32_t saves;
+    float bias_voltage;
+    float amps_per_volt;
+    float auto_cal_sensitivity;
+    float learning_rate;
+    uint8_t auto_calibration_enabled;
+    uint8_t auto_detection_enabled;
+    uint16_t learning_point_count;
+    uint16_t learning_point_index;
+    uint16_t custom_device_count;
+    stored_point_t points[CAL_RECORD_V1_POINTS];
+    stored_device_t devices[MAX_CUSTOM_DEVICES];
+} calibration_record_v1_t;
+
+static calibration_record_t stored_record;   // Last record loaded or written
+static bool warm_start = false;
+static bool record_migrated = false;         // Loaded from an older version - rewrite it
+static uint32_t store_generation = 0;        // Bumped by every non-calibration change
+static uint32_t saved_generation = 0;
+static uint32_t last_save_ms = 0;
+static TaskHandle_t store_task_handle = NULL;
+STATIC_TASK(store_task, CAL_STORE_TASK_STACK);
+
+// Wakes the store task; the write itself is settled and rate limited there
+static void request_calibration_save(bool state_changed) {
+    if (state_changed) {
+        __atomic_fetch_add(&store_generation, 1, __ATOMIC_RELAXED);
+    }
+    if (store_task_handle) {
+        xTaskNotifyGive(store_task_handle);
+    }
+}
+
+// Runs in the ADC sampler task for every block - keep it short
+static void dc_tracker_callback(const sample_block_t *block, void *context) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < block->count; i++) {
+        sum += block->samples[i];
+    }
+    
+    float block_voltage = ((float)sum / block->count / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
+    tracked_dc_voltage += DC_TRACK_ALPHA * (block_voltage - tracked_dc_voltage);
+}
+
+// Publishes a new calibration generation; NAN keeps the current value
+// Returns the new version; with a base version, 0 when another write got there first
+static uint32_t store_snapshot(float bias_v, float scale, bool conditional, uint32_t base_version) {
+    // Read, merge and publish under the writer lock, so a concurrent publisher's field
+    // is never put back to the value it had before
+    portENTER_CRITICAL(&calibration_write_lock);
+    if (conditional && calibration_snapshot.version != base_version) {
+        portEXIT_CRITICAL(&calibration_write_lock);
+        return 0;
+    }
+    calibration_snapshot_t next = calibration_snapshot;
+    if (!isnan(bias_v)) next.bias_voltage = bias_v;
+    if (!isnan(scale)) next.amps_per_volt = scale;
+    next.bias_counts = rms_kernel_bias_counts(next.bias_voltage);
+
+    uint32_t seq = calibration_seq;
+    next.version = (seq >> 1) + 1;
+    __atomic_store_n(&calibration_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    calibration_snapshot = next;
+    __atomic_store_n(&calibration_seq, seq + 2, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&calibration_write_lock);
+    return next.version;
+}
+
+static void publish_calibration(float bias_v, float scale) {
+    store_snapshot(bias_v, scale, false, 0);
+    request_calibration_save(false);
+}
+
+// Derived from the stored calibration, so it is not a reason to write it
+uint32_t apply_calibration_correction(uint32_t base_version, float bias_v, float scale) {
+    return store_snapshot(bias_v, scale, true, base_version);
+}
+
+void get_calibration_snapshot(calibration_snapshot_t* snapshot) {
+    if (!snapshot) return;
+
+    uint32_t seq;
+    do {
+        seq = __atomic_load_n(&calibration_seq, __ATOMIC_ACQUIRE);
+        *snapshot = calibration_snapshot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&calibration_seq, __ATOMIC_RELAXED));
+}
+
+uint32_t get_calibration_version(void) {
+    return __atomic_load_n(&calibration_seq, __ATOMIC_ACQUIRE) >> 1;
+}
+
+void set_calibration(float bias_v, float scale) {
+    publish_calibration(bias_v, scale);
+    ESP_LOGI(TAG, "Calibration set to: bias %.4f V, scale %.2f A/V", bias_v, scale);
+}
+
+#if ENABLE_CALIBRATION_LEARNING
+static void learning_prior(rls_estimator_t* fit, float scale) {
+    rls_init(fit, scale, scale * LEARNING_GAIN_PRIOR_RSD, 0.0f, LEARNING_OFFSET_PRIOR_AMPS);
+}
+
+// The learning rate is how much of the earlier points each new one replaces; time
+// since the previous point decays them further
+static float learning_forgetting(uint32_t elapsed_ms) {
+    return (1.0f - 0.5f * learning_rate) *
+           powf(LEARNING_CONFIDENCE_DECAY, elapsed_ms / (24 * 60 * 60 * 1000.0f));
+}
+
+static float learning_noise_variance(float confidence) {
+    return LEARNING_NOISE_AMPS * LEARNING_NOISE_AMPS / confidence;
+}
+
+static void get_learning_fit(rls_estimator_t* fit) {
+    portENTER_CRITICAL(&learning_lock);
+    *fit = learning_fit;
+    portEXIT_CRITICAL(&learning_lock);
+}
+#endif
+
+// === CALIBRATION PERSISTENCE ===
+static void build_record(calibration_record_t* record) {
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    calibration_snapshot_t snapshot;
+    get_calibration_snapshot(&snapshot);
+
+    memset(record, 0, sizeof(*record));
+    record->version = CAL_RECORD_VERSION;
+    record->size = sizeof(*record);
+    record->saves = stored_record.saves;
+    record->bias_voltage = snapshot.bias_voltage;
+    record->amps_per_volt = snapshot.amps_per_volt;
+    record->auto_cal_sensitivity = auto_cal_sensitivity;
+    record->learning_rate = learning_rate;
+    record->auto_calibration_enabled = auto_calibration_enabled;
+    record->auto_detection_enabled = auto_detection_enabled;
+
+#if ENABLE_CALIBRATION_LEARNING
+    portENTER_CRITICAL(&learning_lock);
+    record->learning = learning_fit;
+    record->learning_age_ms = learning_fit.updates ? now - last_learning_ms : 0;
+    portEXIT_CRITICAL(&learning_lock);
+#else
+    (void)now;
+#endif
+
+#if ENABLE_DEVICE_RECOGNITION
+    record->custom_device_count = num_custom_devices;
+    for (int i = 0; i < num_custom_devices; i++) {
+        record->devices[i].min_current = custom_devices[i].min_current;
+        record->devices[i].max_current = custom_devices[i].max_current;
+        record->devices[i].typical_current = custom_devices[i].typical_current;
+        record->devices[i].confidence_boost = custom_devices[i].confidence_boost;
+        strncpy(record->devices[i].name, custom_device_names[i], CUSTOM_DEVICE_NAME_LEN - 1);
+    }
+#endif
+}
+
+// Version 1 kept the last CAL_RECORD_V1_POINTS points; replaying them oldest first
+// gives the fit they would have built
+static void migrate_v1_record(const calibration_record_v1_t* old, calibration_record_t* record) {
+    memset(record, 0, sizeof(*record));
+    record->version = CAL_RECORD_VERSION;
+    record->size = sizeof(*record);
+    record->saves = old->saves;
+    record->bias_voltage = old->bias_voltage;
+    record->amps_per_volt = old->amps_per_volt;
+    record->auto_cal_sensitivity = old->auto_cal_sensitivity;
+    record->learning_rate = old->learning_rate;
+    record->auto_calibration_enabled = old->auto_calibration_enabled;
+    record->auto_detection_enabled = old->auto_detection_enabled;
+    record->custom_device_count = old->custom_device_count;
+    memcpy(record->devices, old->devices, sizeof(record->devices));
+
+#if ENABLE_CALIBRATION_LEARNING
+    learning_rate = old->learning_rate;
+    learning_prior(&record->learning, old->amps_per_volt);
+    int count = (old->learning_point_count <= CAL_RECORD_V1_POINTS) ? old->learning_point_count : 0;
+    int oldest = (count == CAL_RECORD_V1_POINTS) ? old->learning_point_index % CAL_RECORD_V1_POINTS : 0;
+    uint32_t previous_age = 0;
+    for (int n = 0; n < count; n++) {
+        const stored_point_t* point = &old->points[(oldest + n) % CAL_RECORD_V1_POINTS];
+        if (!(point->measured_voltage > 0.001f) || !(point->confidence > 0.0f)) {
+            continue;
+        }
+        uint32_t elapsed = (record->learning.updates && previous_age > point->age_ms) ?
+                           previous_age - point->age_ms : 0;
+        rls_update(&record->learning, point->measured_voltage, point->expected_current,
+                   learning_noise_variance(point->confidence), learning_forgetting(elapsed));
+        previous_age = point->age_ms;
+    }
+    record->learning_age_ms = record->learning.updates ? previous_age : 0;
+    ESP_LOGI(TAG, "Calibration record migrated from version 1 (%lu learning points replayed)",
+             record->learning.updates);
+#endif
+}
+
+static bool load_calibration_record(void) {
+    nvs_handle_t handle;
+    if (nvs_open(CAL_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+
+    static union {
+        calibration_record_t current;
+        calibration_record_v1_t v1;
+    } blob;
+    size_t size = sizeof(blob);
+    esp_err_t ret = nvs_get_blob(handle, CAL_NVS_KEY, &blob, &size);
+    nvs_close(handle);
+
+    calibration_record_t* record = &stored_record;
+    if (ret == ESP_OK && size == sizeof(blob.v1) && blob.v1.version == 1 &&
+        blob.v1.size == sizeof(blob.v1)) {
+        migrate_v1_record(&blob.v1, record);
+        record_migrated = true;
+    } else if (ret == ESP_OK && size == sizeof(*record) && blob.current.version == CAL_RECORD_VERSION &&
+               blob.current.size == sizeof(*record)) {
+        *record = blob.current;
+    } else {
+        ret = ESP_ERR_INVALID_VERSION;
+    }
+
+    if (ret != ESP_OK || record->bias_voltage < 0.1f ||
+        record->bias_voltage > 3.0f || record->amps_per_volt < 1.0f ||
+        record->amps_per_volt > 1000.0f) {
+        memset(record, 0, sizeof(*record));
+        return false;
+    }
+
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    auto_cal_sensitivity = record->auto_cal_sensitivity;
+    learning_rate = record->learning_rate;
+    auto_calibration_enabled = record->auto_calibration_enabled;
+    auto_detection_enabled = record->auto_detection_enabled;
+
+#if ENABLE_CALIBRATION_LEARNING
+    // A corrupt fit falls back to the prior around the stored scale
+    const rls_estimator_t* fit = &record->learning;
+    if (isfinite(fit->gain) && isfinite(fit->offset) && fit->p_gain >= 0.0f && fit->p_offset >= 0.0f &&
+        fit->p_gain <= fit->p_gain_max && fit->p_offset <= fit->p_offset_max) {
+        learning_fit = *fit;
+        last_learning_ms = now - record->learning_age_ms;  // Wraps; only differences are used
+    } else {
+        learning_prior(&learning_fit, record->amps_per_volt);
+    }
+#else
+    (void)now;
+#endif
+
+#if ENABLE_DEVICE_RECOGNITION
+    int devices = (record->custom_device_count <= MAX_CUSTOM_DEVICES) ? record->custom_device_count : 0;
+    for (int i = 0; i < devices; i++) {
+        memcpy(custom_device_names[i], record->devices[i].name, CUSTOM_DEVICE_NAME_LEN);
+        custom_device_names[i][CUSTOM_DEVICE_NAME_LEN - 1] = '\0';
+        custom_devices[i] = (device_profile_t){
+            .min_current = record->devices[i].min_current,
+            .max_current = record->devices[i].max_current,
+            .typical_current = record->devices[i].typical_current,
+            .device_name = custom_device_names[i],
+            .confidence_boost = record->devices[i].confidence_boost
+        };
+    }
+    num_custom_devices = devices;
+#endif
+
+    // Publish directly - the stored record is already what would be saved
+    publish_calibration(record->bias_voltage, record->amps_per_volt);
+    return true;
+}
+
+// Store task only. Skips the write when nothing but insignificant calibration
+// jitter (e.g. converged learned-scale blending) changed since the last one.
+static bool save_calibration_record(bool force) {
+    static calibration_record_t record;
+    uint32_t generation = __atomic_load_n(&store_generation, __ATOMIC_RELAXED);
+    build_record(&record);
+
+    bool unchanged = stored_record.version == CAL_RECORD_VERSION &&
+                     generation == saved_generation &&
+                     fabsf(record.bias_voltage - stored_record.bias_voltage) < CAL_SAVE_MIN_BIAS_DELTA_V &&
+                     fabsf(record.amps_per_volt - stored_record.amps_per_volt) <
+                         stored_record.amps_per_volt * CAL_SAVE_MIN_SCALE_DELTA;
+    if (unchanged && !force) {
+        return true;
+    }
+
+    record.saves = stored_record.saves + 1;
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(CAL_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(handle, CAL_NVS_KEY, &record, sizeof(record));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    last_save_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Calibration save failed: %s", esp_err_to_name(ret));
+        return false;
+    }
+
+    stored_record = record;
+    saved_generation = generation;
+    ESP_LOGI(TAG, "Calibration saved (bias %.4f V, scale %.2f A/V, save %lu)",
+             record.bias_voltage, record.amps_per_volt, record.saves);
+    return true;
+}
+
+// Warm start: only re-zero from a measurement that shows no load, so a power blip
+// with an appliance running keeps the stored bias
+static void refine_stored_bias(void) {
+    sample_stats_t stats;
+    calibration_snapshot_t cal;
+    get_calibration_snapshot(&cal);
+
+    if (!adc_sampler_collect_stats(BIAS_CAL_SAMPLES, cal.bias_voltage, &stats, COLLECT_TIMEOUT_MS)) {
+        ESP_LOGW(TAG, "Warm start refinement skipped - no samples");
+        return;
+    }
+
+    float load_amps = stats.ac_rms_voltage * cal.amps_per_volt;
+    if (load_amps >= AUTO_CAL_ZERO_THRESHOLD) {
+        ESP_LOGI(TAG, "Load present (%.3f A) - keeping stored bias %.4f V", load_amps, cal.bias_voltage);
+        return;
+    }
+
+    publish_calibration(stats.mean_voltage, NAN);
+    ESP_LOGI(TAG, "Stored bias refined: %.4f -> %.4f V", cal.bias_voltage, stats.mean_voltage);
+}
+
+static void calibration_store_task(void *parameters) {
+    PERF_REGISTER_TASK();
+
+    if (warm_start) {
+        refine_stored_bias();
+    }
+    if (record_migrated) {
+        save_calibration_record(true);
+    }
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Let a burst of changes settle, and bound the flash write rate
+        vTaskDelay(pdMS_TO_TICKS(CAL_SAVE_SETTLE_MS));
+        uint32_t since_save = xTaskGetTickCount() * portTICK_PERIOD_MS - last_save_ms;
+        if (stored_record.saves > 0 && since_save < CAL_SAVE_MIN_INTERVAL_MS) {
+            vTaskDelay(pdMS_TO_TICKS(CAL_SAVE_MIN_INTERVAL_MS - since_save));
+        }
+        ulTaskNotifyTake(pdTRUE, 0);  // Changes made while waiting go into this write
+
+        save_calibration_record(false);
+    }
+}
+
+bool sct_calibration_warm_start(void) {
+    return warm_start;
+}
+
+bool sct_calibration_forget(void) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(CAL_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_erase_key(handle, CAL_NVS_KEY);
+        if (ret == ESP_OK || ret == ESP_ERR_NVS_NOT_FOUND) {
+            ret = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    memset(&stored_record, 0, sizeof(stored_record));
+    ESP_LOGI(TAG, "Stored calibration erased - next boot is a cold start");
+    return ret == ESP_OK;
+}
+
+void get_calibration_store_status(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    snprintf(buffer, buffer_size, "BOOT=%s,STORED=%s,SAVES=%lu,LAST_SAVE_AGE_S=%lu,PENDING=%s",
+             warm_start ? "WARM" : "COLD",
+             stored_record.version == CAL_RECORD_VERSION ? "YES" : "NO",
+             stored_record.saves,
+             stored_record.saves ? (now - last_save_ms) / 1000 : 0,
+             __atomic_load_n(&store_generation, __ATOMIC_RELAXED) != saved_generation ? "YES" : "NO");
+}
+
 void sct_calibration_init() {
     calibration_mutex = xSemaphoreCreateMutex();
-    if (calibration_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create calibration mutex");
+    detected_load_mailbox = xQueueCreate(1, sizeof(float));
+    auto_cal_queue = xQueueCreate(AUTO_CAL_QUEUE_DEPTH, sizeof(float));
+    if (calibration_mutex == NULL || detected_load_mailbox == NULL || auto_cal_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create calibration mutex or queues");
         return;
     }
     
-    ESP_LOGI(TAG, "SCT calibration initialized with auto-calibration");
-    ESP_LOGI(TAG, "Initial values - Bias: %.4fV, Scale: %.1fA/V", bias_voltage, amps_per_volt);
-    ESP_LOGI(TAG, "Auto-calibration: %s", auto_calibration_enabled ? "ENABLED" : "DISABLED");
-    ESP_LOGI(TAG, "Device recognition: %s", ENABLE_DEVICE_RECOGNITION ? "ENABLED" : "DISABLED");
-    ESP_LOGI(TAG, "Learning system: %s", ENABLE_CALIBRATION_LEARNING ? "ENABLED" : "DISABLED");
-    
     // Initialize learning system
 #if ENABLE_CALIBRATION_LEARNING
-    memset(learning_points, 0, sizeof(learning_points));
-    learning_point_count = 0;
-    learning_point_index = 0;
+    learning_prior(&learning_fit, get_amps_per_volt());
+    last_learning_ms = 0;
 #endif
+
+    // Stored calibration, the learned fit and custom devices replace the boot measurement
+    warm_start = load_calibration_record();
     
-    // Initialize history
-    memset(current_history, 0, sizeof(current_history));
-    history_index = 0;
-    history_full = false;
+    ESP_LOGI(TAG, "SCT calibration initialized with auto-calibration");
+    ESP_LOGI(TAG, "Initial values - Bias: %.4fV, Scale: %.1fA/V", get_bias_voltage(), get_amps_per_volt());
+    ESP_LOGI(TAG, "Auto-calibration: %s", auto_calibration_enabled ? "ENABLED" : "DISABLED");
+    ESP_LOGI(TAG, "Device recognition: %s", ENABLE_DEVICE_RECOGNITION ? "ENABLED" : "DISABLED");
+    ESP_LOGI(TAG, "Learning system: %s", ENABLE_CALIBRATION_LEARNING ? "ENABLED" : "DISABLED");
     
-    // Perform automatic zero-point calibration on startup
-    ESP_LOGI(TAG, "Performing automatic zero-point calibration...");
-    vTaskDelay(pdMS_TO_TICKS(1000)); // Wait for ADC to stabilize
+    // Track the input DC level continuously from the shared sample stream
+    dc_tracker_subscription = adc_sampler_subscribe(dc_tracker_callback, NULL);
+    if (dc_tracker_subscription < 0) {
+        ESP_LOGW(TAG, "DC level tracker not available");
+    }
     
-    // Auto-calibrate bias voltage with no load
-    auto_calibrate_bias_voltage();
+    store_task_handle = static_task_start(&store_task, calibration_store_task, "cal_store", NULL,
+                                          CAL_STORE_TASK_PRIORITY, NETWORK_CORE);
+    if (!store_task_handle) {
+        ESP_LOGW(TAG, "Calibration store task not available - changes will not persist");
+    }
+}
+
+static void start_auto_calibration_task(void) {
+    if (auto_cal_task_handle != NULL) {
+        return;  // Still running - it picks the re-enable up on its next pass
+    }
+    if (xTaskCreatePinnedToCore(auto_calibration_task, "auto_calibration", AUTO_CAL_TASK_STACK, NULL,
+                                AUTO_CAL_TASK_PRIORITY, &auto_cal_task_handle, NETWORK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create auto-calibration task");
+        auto_cal_task_handle = NULL;
+    }
+}
+
+// Blocking part of startup, run off the critical path by the startup calibration task
+void sct_calibration_startup(void) {
+    if (warm_start) {
+        // Refined in the background by the store task, which checks for no load first
+        ESP_LOGI(TAG, "Warm start from stored calibration (save %lu)", stored_record.saves);
+    } else {
+        // Perform automatic zero-point calibration on startup
+        ESP_LOGI(TAG, "Performing automatic zero-point calibration...");
+        vTaskDelay(pdMS_TO_TICKS(1000)); // Wait for ADC to stabilize
+        
+        // Auto-calibrate bias voltage with no load
+        auto_calibrate_bias_voltage();
+    }
     
     // Start auto-calibration task
     if (auto_calibration_enabled) {
-        xTaskCreate(auto_calibration_task, "auto_calibration", 4096, NULL, 3, NULL);
+        start_auto_calibration_task();
         ESP_LOGI(TAG, "Auto-calibration task started");
     }
 }
 
+// A settled level after a load change: recognize the device now, and arm the
+// stable-load calibration if the level is in range
+static bool handle_load_change(float level) {
+    if (level < AUTO_CAL_MIN_CURRENT || level > AUTO_CAL_MAX_CURRENT) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Load settled at %.3fA", level);
+    
+#if ENABLE_DEVICE_RECOGNITION
+    auto_recognize_and_calibrate(level);
+#endif
+    return true;
+}
+
+// No load change for DEVICE_STABLE_TIME_MS. The level is read back from the detector,
+// since a recognition calibration may have rescaled it meanwhile
+static void calibrate_stable_load(void) {
+    float stable_load_value;
+    if (!load_events_get_level(&stable_load_value, NULL) ||
+        stable_load_value < AUTO_CAL_MIN_CURRENT || stable_load_value > AUTO_CAL_MAX_CURRENT) {
+        return;
+    }
+    
+    // Only auto-calibrate if it's been a while since last calibration
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (now - last_scale_calibration <= AUTO_CAL_ZERO_INTERVAL_MS) {
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Auto-calibrating with stable load: %.3fA", stable_load_value);
+    calibrate_to_load(stable_load_value, false);
+    last_scale_calibration = now;
+    auto_cal_count++;
+}
+
 void auto_calibration_task(void *parameters) {
-    ESP_LOGI(TAG, "Auto-calibration task running");
+    PERF_REGISTER_TASK();
+    ESP_LOGI(TAG, "Auto-calibration task running on core %d", xPortGetCoreID());
     
+    // Event driven: the task sleeps until a load change arrives or a deadline is due.
+    // Any change before the stable-load deadline re-arms or cancels it
+    TickType_t next_check = xTaskGetTickCount() + pdMS_TO_TICKS(AUTO_CAL_CHECK_INTERVAL_MS);
+    TickType_t stable_deadline = 0;
+    bool stable_pending = false;
     while (auto_calibration_enabled) {
+        TickType_t now_ticks = xTaskGetTickCount();
+        TickType_t wake = next_check;
+        if (stable_pending && (int32_t)(stable_deadline - next_check) < 0) {
+            wake = stable_deadline;
+        }
+        if ((int32_t)(wake - now_ticks) > 0) {
+            float level;
+            if (xQueueReceive(auto_cal_queue, &level, wake - now_ticks) == pdTRUE) {
+                PERF_BEGIN(PERF_PROBE_AUTO_CAL);
+                stable_pending = handle_load_change(level);
+                PERF_END(PERF_PROBE_AUTO_CAL);
+                stable_deadline = xTaskGetTickCount() + pdMS_TO_TICKS(DEVICE_STABLE_TIME_MS);
+            }
+            continue;
+        }
+        
+        if (stable_pending && (int32_t)(stable_deadline - now_ticks) <= 0) {
+            stable_pending = false;
+            PERF_BEGIN(PERF_PROBE_AUTO_CAL);
+            calibrate_stable_load();
+            PERF_END(PERF_PROBE_AUTO_CAL);
+        }
+        
+        if ((int32_t)(next_check - now_ticks) > 0) {
+            continue;
+        }
+        next_check = now_ticks + pdMS_TO_TICKS(AUTO_CAL_CHECK_INTERVAL_MS);
+        
+        if (auto_cal_changes_dropped) {
+            ESP_LOGW(TAG, "%lu load changes dropped - auto-calibration queue full", auto_cal_changes_dropped);
+            auto_cal_changes_dropped = 0;
+        }
+        
         // Check for periodic zero-point calibration
         if (should_auto_calibrate_zero()) {
             ESP_LOGI(TAG, "Performing automatic zero-point recalibration");
@@ -120,123 +685,64 @@ void auto_calibration_task(void *parameters) {
             auto_cal_count++;
         }
         
-        // Apply learned calibration if enough data points
-#if ENABLE_CALIBRATION_LEARNING
-        if (learning_point_count >= MIN_LEARNING_POINTS) {
-            apply_learned_calibration();
-        }
-#endif
-        
         // Adaptive threshold adjustment based on recent performance
         adaptive_threshold_adjustment();
-        
-        // Sleep for 30 seconds before next check
-        vTaskDelay(pdMS_TO_TICKS(30000));
     }
     
     ESP_LOGI(TAG, "Auto-calibration task ended");
+    auto_cal_task_handle = NULL;
     vTaskDelete(NULL);
 }
 
+// Called from the measurement tasks - keeps the detected load current
 void process_current_for_auto_calibration(float current_amps) {
-    if (!auto_calibration_enabled) {
-        return;
+    if (auto_detection_enabled && detected_load_mailbox) {
+        xQueueOverwrite(detected_load_mailbox, &current_amps);
     }
+}
+
+// Called by the load event reporter; never blocks on the auto-calibration task
+void process_load_change_for_auto_calibration(float level_amps) {
+    process_current_for_auto_calibration(level_amps);
     
-    // Update current history
-    current_history[history_index] = current_amps;
-    history_index = (history_index + 1) % HISTORY_SIZE;
-    if (history_index == 0) {
-        history_full = true;
+    if (!auto_calibration_enabled || auto_cal_queue == NULL) {
+        return;
     }
     
-    // Update detected load
-    if (xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
-        detected_load_amps = current_amps;
-        xSemaphoreGive(calibration_mutex);
+    // Recognition and calibration happen on the auto-calibration task
+    if (xQueueSend(auto_cal_queue, &level_amps, 0) != pdTRUE) {
+        auto_cal_changes_dropped++;
     }
-    
-    // Process for auto-calibration
-    continuous_auto_calibration(current_amps);
 }
 
-void continuous_auto_calibration(float current_reading) {
-    static uint32_t stable_load_start = 0;
-    static float stable_load_value = 0;
-    static bool in_stable_period = false;
-    
-    // Check for zero readings (potential drift correction)
-    if (current_reading < AUTO_CAL_ZERO_THRESHOLD) {
-        consecutive_zero_readings++;
-    } else {
-        consecutive_zero_readings = 0;
-        
-        // Check for stable load pattern
-        if (history_full) {
-            float variance = 0, mean = 0;
-            
-            // Calculate mean
-            for (int i = 0; i < HISTORY_SIZE; i++) {
-                mean += current_history[i];
-            }
-            mean /= HISTORY_SIZE;
-            
-            // Calculate variance
-            for (int i = 0; i < HISTORY_SIZE; i++) {
-                float diff = current_history[i] - mean;
-                variance += diff * diff;
-            }
-            variance /= HISTORY_SIZE;
-            
-            // Check if load is stable and significant
-            bool is_stable = (variance < AUTO_CAL_VARIANCE_THRESHOLD) && 
-                           (mean >= AUTO_CAL_MIN_CURRENT) && 
-                           (mean <= AUTO_CAL_MAX_CURRENT);
-            
-            if (is_stable && !in_stable_period) {
-                // Start of stable period
-                stable_load_start = xTaskGetTickCount() * portTICK_PERIOD_MS;
-                stable_load_value = mean;
-                in_stable_period = true;
-                ESP_LOGI(TAG, "Stable load detected: %.3fA", stable_load_value);
-                
 #if ENABLE_DEVICE_RECOGNITION
-                // Try to recognize the device
-                auto_recognize_and_calibrate(stable_load_value);
-#endif
-                
-            } else if (is_stable && in_stable_period) {
-                // Continue stable period - check if enough time has passed
-                uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-                if (now - stable_load_start > DEVICE_STABLE_TIME_MS) {
-                    // Long enough stable period for automatic calibration
-                    uint32_t time_since_last = now - last_scale_calibration;
-                    
-                    // Only auto-calibrate if it's been a while since last calibration
-                    if (time_since_last > AUTO_CAL_ZERO_INTERVAL_MS) {
-                        ESP_LOGI(TAG, "Auto-calibrating with stable load: %.3fA", stable_load_value);
-                        calibrate_with_known_load(stable_load_value);
-                        last_scale_calibration = now;
-                        auto_cal_count++;
-                        
-#if ENABLE_CALIBRATION_LEARNING
-                        // Add to learning system as auto-generated point
-                        float measured_vrms = stable_load_value / get_amps_per_volt(); // Approximate
-                        learn_from_calibration(stable_load_value, measured_vrms, false);
-#endif
-                    }
-                    in_stable_period = false; // Reset to avoid repeated calibrations
-                }
-            } else if (!is_stable) {
-                // No longer stable
-                in_stable_period = false;
-            }
-        }
+// Profiles measured on this plug: the whole signature has to agree, so no boost or
+// sensitivity scaling - the match confidence is used as it is
+static bool recognize_from_library(float measured_current) {
+    device_signature_t signature;
+    device_match_t match;
+    device_library_capture(&signature, DEVLIB_HARMONIC_WAIT_MS);
+    signature.steady_amps = measured_current;
+    if (!device_library_match(&signature, &match)) {
+        return false;
+    }
+    
+    ESP_LOGI(TAG, "Signature match: #%u %s (%.2fA, confidence %.2f)",
+             match.id, match.name, match.steady_amps, match.confidence);
+    if (match.confidence <= DEVICE_RECOGNITION_CONFIDENCE) {
+        return false;
     }
+    
+    calibrate_to_load(match.steady_amps, false);
+    successful_recognitions++;
+    return true;
 }
 
-#if ENABLE_DEVICE_RECOGNITION
 void auto_recognize_and_calibrate(float measured_current) {
+    if (recognize_from_library(measured_current)) {
+        return;
+    }
+    
     const device_profile_t* device = recognize_device(measured_current);
     
     if (device != NULL) {
@@ -253,14 +759,8 @@ void auto_recognize_and_calibrate(float measured_current) {
             ESP_LOGI(TAG, "High confidence (%.2f), auto-calibrating with %.2fA", 
                      confidence, device->typical_current);
             
-            calibrate_with_known_load(device->typical_current);
+            calibrate_to_load(device->typical_current, false);
             successful_recognitions++;
-            
-#if ENABLE_CALIBRATION_LEARNING
-            // Add to learning system with high confidence
-            float measured_vrms = measured_current / get_amps_per_volt(); // Approximate
-            learn_from_calibration(device->typical_current, measured_vrms, false);
-#endif
         } else {
             ESP_LOGI(TAG, "Low confidence (%.2f), skipping auto-calibration", confidence);
             failed_recognitions++;
@@ -268,14 +768,85 @@ void auto_recognize_and_calibrate(float measured_current) {
     }
 }
 
-const device_profile_t* recognize_device(float current_amps) {
-    for (int i = 0; i < num_known_devices; i++) {
-        if (current_amps >= known_devices[i].min_current && 
-            current_amps <= known_devices[i].max_current) {
-            return &known_devices[i];
+// Closest typical current relative to the range width, since ranges overlap
+static const device_profile_t* closest_profile(const device_profile_t* devices, int count,
+                                               float current_amps) {
+    const device_profile_t* best = NULL;
+    float best_distance = INFINITY;
+    for (int i = 0; i < count; i++) {
+        if (current_amps < devices[i].min_current || current_amps > devices[i].max_current) {
+            continue;
+        }
+        float distance = fabsf(current_amps - devices[i].typical_current) /
+                         (devices[i].max_current - devices[i].min_current);
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = &devices[i];
         }
     }
-    return NULL;
+    return best;
+}
+
+// Custom profiles are checked first - they describe this installation's appliances
+const device_profile_t* recognize_device(float current_amps) {
+    const device_profile_t* device = closest_profile(custom_devices, num_custom_devices, current_amps);
+    return device ? device : closest_profile(known_devices, num_known_devices, current_amps);
+}
+
+const device_profile_t* get_known_device(int index) {
+    if (index >= 0 && index < num_known_devices) {
+        return &known_devices[index];
+    }
+    index -= num_known_devices;
+    return (index >= 0 && index < num_custom_devices) ? &custom_devices[index] : NULL;
+}
+
+bool add_custom_device_profile(float min_current, float max_current,
+                               float typical_current, const char* name) {
+    if (!name || name[0] == '\0' || min_current < 0.0f || max_current <= min_current ||
+        max_current > MAX_CURRENT_AMPS || typical_current < min_current ||
+        typical_current > max_current) {
+        return false;
+    }
+
+    if (!xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
+        return false;
+    }
+    int index = num_custom_devices;
+    if (index >= MAX_CUSTOM_DEVICES) {
+        xSemaphoreGive(calibration_mutex);
+        ESP_LOGW(TAG, "Custom device table full (%d)", MAX_CUSTOM_DEVICES);
+        return false;
+    }
+
+    // Readers only look below num_custom_devices, so fill the entry first
+    strncpy(custom_device_names[index], name, CUSTOM_DEVICE_NAME_LEN - 1);
+    custom_device_names[index][CUSTOM_DEVICE_NAME_LEN - 1] = '\0';
+    custom_devices[index] = (device_profile_t){
+        .min_current = min_current,
+        .max_current = max_current,
+        .typical_current = typical_current,
+        .device_name = custom_device_names[index],
+        .confidence_boost = 1.0f
+    };
+    __atomic_store_n(&num_custom_devices, index + 1, __ATOMIC_RELEASE);
+    xSemaphoreGive(calibration_mutex);
+
+    ESP_LOGI(TAG, "Custom device added: %s (%.2f-%.2fA, typ %.2fA)",
+             custom_device_names[index], min_current, max_current, typical_current);
+    request_calibration_save(true);
+    return true;
+}
+
+bool clear_custom_device_profiles(void) {
+    if (!xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
+        return false;
+    }
+    num_custom_devices = 0;
+    xSemaphoreGive(calibration_mutex);
+    ESP_LOGI(TAG, "Custom devices cleared");
+    request_calibration_save(true);
+    return true;
 }
 
 void list_known_devices(char* buffer, size_t buffer_size) {
@@ -292,88 +863,102 @@ void list_known_devices(char* buffer, size_t buffer_size) {
                           known_devices[i].max_current,
                           known_devices[i].typical_current);
     }
+    
+    for (int i = 0; i < num_custom_devices && offset < buffer_size - 50; i++) {
+        offset += snprintf(buffer + offset, buffer_size - offset,
+                          "  %s: %.1f-%.1fA (typ: %.1fA, custom)\n",
+                          custom_devices[i].device_name,
+                          custom_devices[i].min_current,
+                          custom_devices[i].max_current,
+                          custom_devices[i].typical_current);
+    }
 }
 #endif
 
 #if ENABLE_CALIBRATION_LEARNING
+// O(1): one least-squares update, then the fit is applied if it is certain enough
 void learn_from_calibration(float expected_current, float measured_voltage, bool manual) {
-    if (learning_point_count < MAX_LEARNING_POINTS) {
-        learning_points[learning_point_count] = (calibration_point_t){
-            .expected_current = expected_current,
-            .measured_voltage = measured_voltage,
-            .timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS,
-            .confidence = manual ? 1.0f : 0.8f,  // Manual calibrations get higher confidence
-            .auto_generated = !manual
-        };
-        learning_point_count++;
-    } else {
-        // Circular buffer - replace oldest
-        learning_points[learning_point_index] = (calibration_point_t){
-            .expected_current = expected_current,
-            .measured_voltage = measured_voltage,
-            .timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS,
-            .confidence = manual ? 1.0f : 0.8f,
-            .auto_generated = !manual
-        };
-        learning_point_index = (learning_point_index + 1) % MAX_LEARNING_POINTS;
+    if (!(measured_voltage > 0.001f)) {  // Avoid division by very small numbers
+        return;
     }
-    
-    ESP_LOGI(TAG, "Learning point added: %.3fA -> %.6fV (%s)", 
-             expected_current, measured_voltage, manual ? "manual" : "auto");
+
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    float confidence = manual ? 1.0f : 0.8f;  // Manual calibrations get higher confidence
+
+    rls_estimator_t fit;
+    portENTER_CRITICAL(&learning_lock);
+    float forgetting = learning_forgetting(learning_fit.updates ? now - last_learning_ms : 0);
+    rls_update(&learning_fit, measured_voltage, expected_current,
+               learning_noise_variance(confidence), forgetting);
+    last_learning_ms = now;
+    fit = learning_fit;
+    portEXIT_CRITICAL(&learning_lock);
+
+    ESP_LOGI(TAG, "Learning point added: %.3fA -> %.6fV (%s), fit %.2f +/- %.2f A/V, offset %.3f A",
+             expected_current, measured_voltage, manual ? "manual" : "auto",
+             fit.gain, rls_gain_sd(&fit), fit.offset);
+    request_calibration_save(true);
+    apply_learned_calibration();
 }
 
+// Only the scale is applied; the fitted offset is reported - DC bias belongs to the
+// zero calibration, and the offset a few load levels leave is mostly RMS noise floor
 void apply_learned_calibration(void) {
-    if (learning_point_count < MIN_LEARNING_POINTS) {
+    rls_estimator_t fit;
+    get_learning_fit(&fit);
+    if (fit.updates < MIN_LEARNING_POINTS) {
         return;
     }
-    
-    float numerator = 0, denominator = 0, total_weight = 0;
-    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    
-    // Calculate weighted average with time decay
-    int points_to_use = (learning_point_count < MAX_LEARNING_POINTS) ? 
-                        learning_point_count : MAX_LEARNING_POINTS;
-    
-    for (int i = 0; i < points_to_use; i++) {
-        uint32_t age_ms = now - learning_points[i].timestamp;
-        float age_factor = powf(LEARNING_CONFIDENCE_DECAY, age_ms / (24 * 60 * 60 * 1000.0f)); // Daily decay
-        float weight = learning_points[i].confidence * age_factor * learning_rate;
-        
-        if (learning_points[i].measured_voltage > 0.001f) { // Avoid division by very small numbers
-            numerator += learning_points[i].expected_current * weight;
-            denominator += learning_points[i].measured_voltage * weight;
-            total_weight += weight;
-        }
+
+    float learned_scale = fit.gain;
+    float scale_sd = rls_gain_sd(&fit);
+    if (scale_sd > fabsf(learned_scale) * LEARNING_MAX_GAIN_RSD) {
+        ESP_LOGI(TAG, "Learned scale %.2f +/- %.2f A/V not certain enough yet", learned_scale, scale_sd);
+        return;
     }
-    
-    if (denominator > 0.001f && total_weight > 0.1f) {
-        float learned_scale = numerator / denominator;
-        float current_scale = get_amps_per_volt();
-        
-        // Only apply if the change is reasonable (within 50% of current value)
-        if (learned_scale > current_scale * 0.5f && learned_scale < current_scale * 1.5f) {
-            // Smooth transition - don't jump immediately to learned value
-            float blended_scale = current_scale * 0.7f + learned_scale * 0.3f;
-            set_amps_per_volt(blended_scale);
-            
-            ESP_LOGI(TAG, "Applied learned calibration: %.2f -> %.2f A/V (weight: %.2f)", 
-                     current_scale, blended_scale, total_weight);
-        } else {
-            ESP_LOGW(TAG, "Learned scale %.2f A/V rejected (too different from current %.2f A/V)", 
-                     learned_scale, current_scale);
-        }
+
+    float current_scale = get_amps_per_volt();
+
+    // Only apply if the change is reasonable (within 50% of current value)
+    if (learned_scale > current_scale * 0.5f && learned_scale < current_scale * 1.5f) {
+        // Smooth transition - don't jump immediately to learned value
+        float blended_scale = current_scale * 0.7f + learned_scale * 0.3f;
+        set_amps_per_volt(blended_scale);
+
+        ESP_LOGI(TAG, "Applied learned calibration: %.2f -> %.2f A/V (+/- %.2f, %.1f effective points)",
+                 current_scale, blended_scale, scale_sd, fit.weight);
+    } else {
+        ESP_LOGW(TAG, "Learned scale %.2f A/V rejected (too different from current %.2f A/V)",
+                 learned_scale, current_scale);
     }
 }
 
 void reset_learning_data(void) {
-    memset(learning_points, 0, sizeof(learning_points));
-    learning_point_count = 0;
-    learning_point_index = 0;
+    portENTER_CRITICAL(&learning_lock);
+    learning_prior(&learning_fit, get_amps_per_volt());
+    portEXIT_CRITICAL(&learning_lock);
     ESP_LOGI(TAG, "Learning data reset");
+    request_calibration_save(true);
 }
 
 int get_learning_point_count(void) {
-    return learning_point_count;
+    return (int)learning_fit.updates;
+}
+
+void get_learning_estimate(learning_estimate_t* estimate) {
+    if (!estimate) return;
+
+    rls_estimator_t fit;
+    get_learning_fit(&fit);
+    *estimate = (learning_estimate_t){
+        .updates = fit.updates,
+        .scale = fit.gain,
+        .scale_sd = rls_gain_sd(&fit),
+        .offset_amps = fit.offset,
+        .offset_sd = rls_offset_sd(&fit),
+        .correlation = rls_correlation(&fit),
+        .effective_points = fit.weight
+    };
 }
 #endif
 
@@ -387,10 +972,17 @@ bool should_auto_calibrate_zero(void) {
     // Time-based check (every 30 minutes max)
     bool time_for_calibration = (now - last_zero_calibration) > AUTO_CAL_ZERO_INTERVAL_MS;
     
-    // Zero readings check (consistent zeros for extended period)
-    bool consistent_zeros = consecutive_zero_readings > AUTO_CAL_CONSECUTIVE_ZERO_COUNT;
+    // No load, and no change for an extended period (a calibration restarts the
+    // detector's steady period, like a load change)
+    float level;
+    uint32_t steady_ms;
+    bool consistent_zeros = load_events_get_level(&level, &steady_ms) &&
+                            level < AUTO_CAL_ZERO_THRESHOLD && steady_ms > AUTO_CAL_ZERO_HOLD_MS;
     
-    return time_for_calibration && consistent_zeros;
+    // The DC tracker already shows whether the bias moved - no sweep while it holds
+    bool drifted = fabsf(tracked_dc_voltage - get_bias_voltage()) > AUTO_CAL_ZERO_MIN_DRIFT_V;
+    
+    return time_for_calibration && consistent_zeros && drifted;
 }
 
 void adaptive_threshold_adjustment(void) {
@@ -419,6 +1011,7 @@ void adaptive_threshold_adjustment(void) {
     }
     
     last_adjustment = now;
+    request_calibration_save(true);
 #endif
 }
 
@@ -427,6 +1020,7 @@ void set_auto_cal_sensitivity(float sensitivity) {
     if (sensitivity >= 0.0f && sensitivity <= 1.0f) {
         auto_cal_sensitivity = sensitivity;
         ESP_LOGI(TAG, "Auto-calibration sensitivity set to %.2f", sensitivity);
+        request_calibration_save(true);
     }
 }
 
@@ -438,6 +1032,7 @@ void set_learning_rate(float rate) {
     if (rate >= 0.0f && rate <= 1.0f) {
         learning_rate = rate;
         ESP_LOGI(TAG, "Learning rate set to %.2f", rate);
+        request_calibration_save(true);
     }
 }
 
@@ -459,13 +1054,28 @@ void get_auto_cal_statistics(char* buffer, size_t buffer_size) {
              successful_recognitions,
              failed_recognitions,
 #if ENABLE_CALIBRATION_LEARNING
-             learning_point_count,
+             get_learning_point_count(),
 #else
              0,
 #endif
              auto_cal_sensitivity);
 }
 
+void get_auto_cal_counters(auto_cal_counters_t* counters) {
+    if (!counters) return;
+    
+    counters->auto_cal_count = auto_cal_count;
+    counters->successful_recognitions = successful_recognitions;
+    counters->failed_recognitions = failed_recognitions;
+#if ENABLE_CALIBRATION_LEARNING
+    counters->learning_points = get_learning_point_count();
+#else
+    counters->learning_points = 0;
+#endif
+    counters->enabled = auto_calibration_enabled;
+    counters->sensitivity = auto_cal_sensitivity;
+}
+
 uint32_t get_last_auto_cal_time(void) {
     return last_auto_cal_time;
 }
@@ -488,10 +1098,11 @@ void set_auto_calibration(bool enabled) {
         auto_calibration_enabled = enabled;
         xSemaphoreGive(calibration_mutex);
         ESP_LOGI(TAG, "Auto-calibration %s", enabled ? "enabled" : "disabled");
+        request_calibration_save(true);
         
         // Start/stop auto-calibration task
         if (enabled) {
-            xTaskCreate(auto_calibration_task, "auto_calibration", 4096, NULL, 3, NULL);
+            start_auto_calibration_task();
         }
     }
 }
@@ -501,6 +1112,7 @@ void set_auto_detection(bool enabled) {
         auto_detection_enabled = enabled;
         xSemaphoreGive(calibration_mutex);
         ESP_LOGI(TAG, "Auto-detection %s", enabled ? "enabled" : "disabled");
+        request_calibration_save(true);
     }
 }
 
@@ -514,135 +1126,97 @@ bool get_auto_detection_enabled(void) {
 
 float get_detected_load_amps(void) {
     float load = 0.0f;
-    if (xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
-        load = detected_load_amps;
-        xSemaphoreGive(calibration_mutex);
+    if (detected_load_mailbox) {
+        xQueuePeek(detected_load_mailbox, &load, 0);
     }
     return load;
 }
 
-void auto_detect_load_current(void) {
+bool auto_detect_load_current(void) {
     if (!auto_detection_enabled) {
-        return;
+        return false;
     }
     
     ESP_LOGI(TAG, "Auto-detecting load current...");
     
-    const int num_samples = 20;
-    float total = 0.0f;
-    int valid_samples = 0;
-    
-    for (int i = 0; i < num_samples; i++) {
-        int adc_value = 0;
-        if (adc_oneshot_read(adc1_handle, ADC_CHANNEL, &adc_value) == ESP_OK) {
-            float voltage = ((float)adc_value / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
-            float ac_voltage = fabsf(voltage - bias_voltage);
-            float current = ac_voltage * amps_per_volt;
-            
-            if (current >= 0.0f && current < MAX_CURRENT_AMPS) {
-                total += current;
-                valid_samples++;
-            }
-        }
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
-    
-    if (valid_samples > 0) {
-        float avg_current = total / valid_samples;
+    // RMS over whole cycles from the shared sample stream
+    sample_stats_t stats;
+    if (adc_sampler_collect_stats(AUTO_DETECT_SAMPLES, get_bias_voltage(), &stats, COLLECT_TIMEOUT_MS)) {
+        float avg_current = stats.ac_rms_voltage * get_amps_per_volt();
         
-        if (xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
-            detected_load_amps = avg_current;
-            xSemaphoreGive(calibration_mutex);
+        if (avg_current >= MAX_CURRENT_AMPS) {
+            ESP_LOGW(TAG, "Detected load out of range: %.3f A", avg_current);
+            return false;
         }
         
-        ESP_LOGI(TAG, "Detected load: %.3f A (from %d samples)", avg_current, valid_samples);
+        xQueueOverwrite(detected_load_mailbox, &avg_current);
+        
+        ESP_LOGI(TAG, "Detected load: %.3f A (from %lu samples)", avg_current, stats.count);
         
         // Process for auto-calibration
         process_current_for_auto_calibration(avg_current);
-    } else {
-        ESP_LOGW(TAG, "Failed to detect valid load current");
+        return true;
     }
+    
+    ESP_LOGW(TAG, "Failed to detect valid load current");
+    return false;
 }
 
-void calibrate_with_known_load(float known_amps) {
+// Manual points carry more weight in the learned fit than auto-recognition ones
+static bool calibrate_to_load(float known_amps, bool manual) {
     ESP_LOGI(TAG, "Calibrating with known load: %.3f A", known_amps);
     
     if (known_amps <= 0.0f || known_amps > MAX_CURRENT_AMPS) {
         ESP_LOGE(TAG, "Invalid known current: %.3f A", known_amps);
-        return;
+        return false;
     }
     
-    // Take multiple ADC readings
-    const int num_samples = 50;
-    float voltage_sum = 0.0f;
-    int valid_samples = 0;
+    // Measure the RMS voltage the same way measure_rms_current() does
+    sample_stats_t stats;
+    bool collected = adc_sampler_collect_stats(CALIBRATION_SAMPLES, get_bias_voltage(),
+                                               &stats, COLLECT_TIMEOUT_MS);
     
-    for (int i = 0; i < num_samples; i++) {
-        int adc_value = 0;
-        if (adc_oneshot_read(adc1_handle, ADC_CHANNEL, &adc_value) == ESP_OK) {
-            float voltage = ((float)adc_value / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
-            float ac_voltage = fabsf(voltage - bias_voltage);
-            
-            if (ac_voltage > 0.001f) { // Avoid near-zero readings
-                voltage_sum += ac_voltage;
-                valid_samples++;
-            }
-        }
-        vTaskDelay(pdMS_TO_TICKS(50));
-    }
-    
-    if (valid_samples > 10) {
-        float avg_voltage = voltage_sum / valid_samples;
+    if (collected && stats.ac_rms_voltage > 0.001f) { // Avoid near-zero readings
+        float avg_voltage = stats.ac_rms_voltage;
         float new_scale = known_amps / avg_voltage;
         
-        if (xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
-            amps_per_volt = new_scale;
-            xSemaphoreGive(calibration_mutex);
-        }
+        publish_calibration(NAN, new_scale);
         
         ESP_LOGI(TAG, "Calibration complete: %.2f A/V (from %.4f V RMS)", new_scale, avg_voltage);
         
 #if ENABLE_CALIBRATION_LEARNING
-        // Add to learning system as manual calibration
-        learn_from_calibration(known_amps, avg_voltage, true);
+        learn_from_calibration(known_amps, avg_voltage, manual);
+#else
+        (void)manual;
 #endif
         
         last_auto_cal_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    } else {
-        ESP_LOGE(TAG, "Calibration failed - insufficient valid samples (%d)", valid_samples);
+        return true;
     }
+    
+    ESP_LOGE(TAG, "Calibration failed - no usable signal (%lu samples)", collected ? stats.count : 0);
+    return false;
+}
+
+bool calibrate_with_known_load(float known_amps) {
+    return calibrate_to_load(known_amps, true);
 }
 
-void auto_calibrate_bias_voltage(void) {
+bool auto_calibrate_bias_voltage(void) {
     ESP_LOGI(TAG, "Auto-calibrating bias voltage...");
     
-    const int num_samples = 100;
-    uint32_t voltage_sum = 0;
-    int valid_samples = 0;
-    
-    for (int i = 0; i < num_samples; i++) {
-        int adc_value = 0;
-        if (adc_oneshot_read(adc1_handle, ADC_CHANNEL, &adc_value) == ESP_OK) {
-            voltage_sum += adc_value;
-            valid_samples++;
-        }
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-    
-    if (valid_samples > 50) {
-        float avg_adc = (float)voltage_sum / valid_samples;
-        float new_bias = (avg_adc / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
+    sample_stats_t stats;
+    if (adc_sampler_collect_stats(BIAS_CAL_SAMPLES, get_bias_voltage(), &stats, COLLECT_TIMEOUT_MS)) {
+        float new_bias = stats.mean_voltage;
         
-        if (xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
-            bias_voltage = new_bias;
-            xSemaphoreGive(calibration_mutex);
-        }
+        publish_calibration(new_bias, NAN);
         
-        ESP_LOGI(TAG, "Bias voltage calibrated to: %.4f V", new_bias);
-        consecutive_zero_readings = 0; // Reset zero counter
-    } else {
-        ESP_LOGE(TAG, "Bias calibration failed - insufficient samples");
+        ESP_LOGI(TAG, "Bias voltage calibrated to: %.4f V (from %lu samples)", new_bias, stats.count);
+        return true;
     }
+    
+    ESP_LOGE(TAG, "Bias calibration failed - insufficient samples");
+    return false;
 }
 
 void print_sct_013_info(void) {
@@ -652,8 +1226,8 @@ void print_sct_013_info(void) {
     ESP_LOGI(TAG, "Max secondary current: %.0f mA", SCT_013_MAX_SECONDARY_CURRENT * 1000);
     ESP_LOGI(TAG, "Max secondary voltage: %.3f V RMS", SCT_013_MAX_SECONDARY_VOLTAGE);
     ESP_LOGI(TAG, "Theoretical scale: %.1f A/V", SCT_013_THEORETICAL_SCALE);
-    ESP_LOGI(TAG, "Current bias voltage: %.4f V", bias_voltage);
-    ESP_LOGI(TAG, "Current scale factor: %.2f A/V", amps_per_volt);
+    ESP_LOGI(TAG, "Current bias voltage: %.4f V", get_bias_voltage());
+    ESP_LOGI(TAG, "Current scale factor: %.2f A/V", get_amps_per_volt());
     ESP_LOGI(TAG, "Auto-calibration: %s", auto_calibration_enabled ? "ENABLED" : "DISABLED");
 }
 
@@ -661,104 +1235,86 @@ float calculate_theoretical_scale_factor(void) {
     return SCT_013_TRANSFORMATION_RATIO / (SCT_013_MAX_SECONDARY_CURRENT * SCT_013_BURDEN_RESISTOR);
 }
 
-// Thread-safe parameter access
+// Thread-safe parameter access - setters publish a new snapshot, getters never lock
 void set_bias_voltage(float bias_v) {
-    if (xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
-        bias_voltage = bias_v;
-        xSemaphoreGive(calibration_mutex);
-        ESP_LOGI(TAG, "Bias voltage set to: %.4f V", bias_v);
-    }
+    publish_calibration(bias_v, NAN);
+    ESP_LOGI(TAG, "Bias voltage set to: %.4f V", bias_v);
 }
 
 float get_bias_voltage(void) {
-    float bias = 0.0f;
-    if (xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
-        bias = bias_voltage;
-        xSemaphoreGive(calibration_mutex);
-    }
-    return bias;
+    calibration_snapshot_t snapshot;
+    get_calibration_snapshot(&snapshot);
+    return snapshot.bias_voltage;
 }
 
 void set_amps_per_volt(float scale) {
-    if (xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
-        amps_per_volt = scale;
-        xSemaphoreGive(calibration_mutex);
-        ESP_LOGI(TAG, "Scale factor set to: %.2f A/V", scale);
-    }
+    publish_calibration(NAN, scale);
+    ESP_LOGI(TAG, "Scale factor set to: %.2f A/V", scale);
 }
 
 float get_amps_per_volt(void) {
-    float scale = 0.0f;
-    if (xSemaphoreTake(calibration_mutex, pdMS_TO_TICKS(100))) {
-        scale = amps_per_volt;
-        xSemaphoreGive(calibration_mutex);
-    }
-    return scale;
+    calibration_snapshot_t snapshot;
+    get_calibration_snapshot(&snapshot);
+    return snapshot.amps_per_volt;
 }
 
 void get_calibration_status(char* status_buffer, size_t buffer_size) {
     if (!status_buffer || buffer_size == 0) return;
     
+    calibration_snapshot_t snapshot;
+    get_calibration_snapshot(&snapshot);
+    
     snprintf(status_buffer, buffer_size,
-             "BIAS_V=%.4f,SCALE=%.2f,AUTO_CAL=%s,AUTO_DET=%s,LOAD=%.3f,LEARNING_PTS=%d",
-             get_bias_voltage(),
-             get_amps_per_volt(),
+             "BIAS_V=%.4f,SCALE=%.2f,AUTO_CAL=%s,AUTO_DET=%s,LOAD=%.3f,LEARNING_PTS=%d,CAL_VER=%lu",
+             snapshot.bias_voltage,
+             snapshot.amps_per_volt,
              auto_calibration_enabled ? "ON" : "OFF",
              auto_detection_enabled ? "ON" : "OFF",
              get_detected_load_amps(),
 #if ENABLE_CALIBRATION_LEARNING
-             learning_point_count
+             get_learning_point_count(),
 #else
-             0
+             0,
 #endif
+             snapshot.version
     );
 }
 
-void debug_adc_readings(void) {
-    ESP_LOGI(TAG, "=== ADC Debug Readings ===");
-    
-    for (int i = 0; i < 10; i++) {
-        int adc_value = 0;
-        if (adc_oneshot_read(adc1_handle, ADC_CHANNEL, &adc_value) == ESP_OK) {
-            float voltage = ((float)adc_value / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
-            float ac_voltage = fabsf(voltage - bias_voltage);
-            float current = ac_voltage * amps_per_volt;
-            
-            ESP_LOGI(TAG, "ADC: %d, V: %.4f, AC: %.4f, I: %.3f A", 
-                     adc_value, voltage, ac_voltage, current);
-        }
-        vTaskDelay(pdMS_TO_TICKS(500));
-    }
+float get_tracked_dc_voltage(void) {
+    return tracked_dc_voltage;
 }
 
-// UDP command handlers with auto-calibration integration
-void perform_zero_calibration(int sock, struct sockaddr_in *client_addr) {
-    auto_calibrate_bias_voltage();
-    
-    char response[128];
-    snprintf(response, sizeof(response), "ZERO_CAL:SUCCESS,BIAS=%.4f", get_bias_voltage());
-    
-    sendto(sock, response, strlen(response), 0, 
-           (struct sockaddr*)client_addr, sizeof(*client_addr));
-    
-    ESP_LOGI(TAG, "Zero calibration performed via UDP");
-}
-
-void perform_scale_calibration(float known_current, int sock, struct sockaddr_in *client_addr) {
-    calibrate_with_known_load(known_current);
+void debug_adc_readings(void) {
+    ESP_LOGI(TAG, "=== ADC Debug Readings ===");
     
-    char response[128];
-    snprintf(response, sizeof(response), "SCALE_CAL:SUCCESS,SCALE=%.2f", get_amps_per_volt());
+    // A handful of raw samples straight from the ring
+    calibration_snapshot_t cal;
+    get_calibration_snapshot(&cal);
     
-    sendto(sock, response, strlen(response), 0, 
-           (struct sockaddr*)client_addr, sizeof(*client_addr));
+    uint16_t raw_samples[10];
+    size_t count = adc_sampler_copy_recent(raw_samples, 10);
+    for (size_t i = 0; i < count; i++) {
+        float voltage = ((float)raw_samples[i] / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
+        float ac_voltage = fabsf(voltage - cal.bias_voltage);
+        float current = ac_voltage * cal.amps_per_volt;
+        
+        ESP_LOGI(TAG, "ADC: %u, V: %.4f, AC: %.4f, I: %.3f A", 
+                 raw_samples[i], voltage, ac_voltage, current);
+    }
     
-    ESP_LOGI(TAG, "Scale calibration performed via UDP with %.3f A", known_current);
+    // Whole-cycle summary
+    sample_stats_t stats;
+    if (adc_sampler_collect_stats(SAMPLES_PER_CYCLE * 10, cal.bias_voltage, &stats, COLLECT_TIMEOUT_MS)) {
+        ESP_LOGI(TAG, "10 cycles: mean=%.1f, min=%u, max=%u, DC=%.4f V, AC RMS=%.4f V, I=%.3f A",
+                 stats.mean_raw, stats.min_raw, stats.max_raw, stats.mean_voltage,
+                 stats.ac_rms_voltage, stats.ac_rms_voltage * cal.amps_per_volt);
+    }
+    ESP_LOGI(TAG, "Tracked DC level: %.4f V", tracked_dc_voltage);
 }
 
+// UDP command handler (fast - measurement-based calibrations run as jobs)
 void reset_calibration(int sock, struct sockaddr_in *client_addr) {
-    set_bias_voltage(ADC_BIAS_VOLTAGE);
-    set_amps_per_volt(SCT_013_THEORETICAL_SCALE);
+    set_calibration(ADC_BIAS_VOLTAGE, SCT_013_THEORETICAL_SCALE);
     
 #if ENABLE_CALIBRATION_LEARNING
     reset_learning_data();
@@ -0,0 +1,81 @@
+#include "startup.h"
+#include "command_dispatcher.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "STARTUP";
+
+static EventGroupHandle_t startup_group = NULL;
+static volatile EventBits_t ready_stages = 0;               // Mirror for lock-free checks
+static uint32_t stage_ready_ms[STARTUP_STAGE_COUNT];        // Uptime each stage came up
+
+static const char* const stage_names[STARTUP_STAGE_COUNT] = {
+    "NVS", "SAMPLING", "RELAY", "NETWORK", "COMMANDS", "CALIBRATION"
+};
+
+void startup_signal(EventBits_t stages) {
+    if (!startup_group) return;
+
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    for (int i = 0; i < STARTUP_STAGE_COUNT; i++) {
+        EventBits_t bit = (EventBits_t)1 << i;
+        if ((stages & bit) && !(ready_stages & bit)) {
+            stage_ready_ms[i] = now_ms;
+            ESP_LOGI(TAG, "%s ready at %lu ms", stage_names[i], now_ms);
+        }
+    }
+
+    __atomic_fetch_or(&ready_stages, stages, __ATOMIC_RELEASE);
+    xEventGroupSetBits(startup_group, stages);
+}
+
+bool startup_wait(EventBits_t stages, uint32_t timeout_ms) {
+    if (!startup_group) return false;
+
+    TickType_t ticks = (timeout_ms == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    EventBits_t bits = xEventGroupWaitBits(startup_group, stages, pdFALSE, pdTRUE, ticks);
+    return (bits & stages) == stages;
+}
+
+bool startup_is_ready(EventBits_t stages) {
+    return (__atomic_load_n(&ready_stages, __ATOMIC_ACQUIRE) & stages) == stages;
+}
+
+void startup_get_status(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+
+    size_t length = 0;
+    EventBits_t ready = __atomic_load_n(&ready_stages, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < STARTUP_STAGE_COUNT; i++) {
+        if (ready & ((EventBits_t)1 << i)) {
+            length += cmd_reply(buffer + length, buffer_size - length, "%s%s=%luMS",
+                                i ? "," : "", stage_names[i], stage_ready_ms[i]);
+        } else {
+            length += cmd_reply(buffer + length, buffer_size - length, "%s%s=PENDING",
+                                i ? "," : "", stage_names[i]);
+        }
+    }
+}
+
+CMD_HANDLER(cmd_startup_status) {
+    size_t length = cmd_reply(response, response_size, "STARTUP_STATUS:");
+    startup_get_status(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+static const command_def_t startup_commands[] = {
+    { "STARTUP_STATUS", NULL, cmd_startup_status },
+};
+
+void startup_init(void) {
+    if (startup_group) return;
+
+    startup_group = xEventGroupCreate();
+    if (!startup_group) {
+        ESP_LOGE(TAG, "Failed to create startup event group");
+        return;
+    }
+    command_register_table(startup_commands, sizeof(startup_commands) / sizeof(startup_commands[0]));
+}
@@ -0,0 +1,87 @@
+#include "task_memory.h"
+#include "net_buffers.h"
+#include "command_dispatcher.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "TASK_MEM";
+
+static static_task_t* tasks[TASK_MEMORY_MAX_TASKS];
+static int task_count = 0;
+static portMUX_TYPE task_lock = portMUX_INITIALIZER_UNLOCKED;
+
+TaskHandle_t static_task_start(static_task_t* task, TaskFunction_t function, const char* name,
+                               void* parameters, UBaseType_t priority, BaseType_t core) {
+    portENTER_CRITICAL(&task_lock);
+    bool started = task->handle != NULL;
+    portEXIT_CRITICAL(&task_lock);
+    if (started) {
+        ESP_LOGW(TAG, "%s already started", name);
+        return NULL;
+    }
+
+    // The stack depth is in bytes on ESP-IDF
+    TaskHandle_t handle = xTaskCreateStaticPinnedToCore(function, name, task->stack_bytes, parameters,
+                                                       priority, task->stack, &task->tcb, core);
+    if (!handle) {
+        return NULL;
+    }
+
+    portENTER_CRITICAL(&task_lock);
+    task->handle = handle;
+    if (task_count < TASK_MEMORY_MAX_TASKS) {
+        tasks[task_count++] = task;
+    }
+    portEXIT_CRITICAL(&task_lock);
+    return handle;
+}
+
+void task_memory_format(char* buffer, size_t buffer_size) {
+    net_buffer_stats_t net;
+    net_buffers_get_stats(&net);
+
+    size_t used = cmd_reply(buffer, buffer_size,
+                            "HEAP_FREE=%u,HEAP_MIN=%u,LARGEST_BLOCK=%u,INTERNAL_FREE=%u,"
+                            "NET_BUFFERS=%u/%u,NET_PEAK=%u,NET_MISSES=%lu",
+                            (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+                            (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+                            (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+                            (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                            net.in_use, net.count, net.peak_in_use, net.misses);
+
+    portENTER_CRITICAL(&task_lock);
+    int count = task_count;
+    portEXIT_CRITICAL(&task_lock);
+
+    // Deepest stack use so far over the stack size, in bytes
+    uint32_t static_bytes = 0;
+    for (int i = 0; i < count && used < buffer_size; i++) {
+        const static_task_t* task = tasks[i];
+        uint32_t free_bytes = uxTaskGetStackHighWaterMark(task->handle);
+        static_bytes += task->stack_bytes;
+        used += cmd_reply(buffer + used, buffer_size - used, ",%s=%lu/%lu",
+                          pcTaskGetName(task->handle), task->stack_bytes - free_bytes,
+                          task->stack_bytes);
+    }
+    if (used < buffer_size) {
+        cmd_reply(buffer + used, buffer_size - used, ",STATIC_STACKS=%lu", static_bytes);
+    }
+}
+
+CMD_HANDLER(cmd_mem_stats) {
+    size_t length = cmd_reply(response, response_size, "MEM_STATS:");
+    task_memory_format(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+static const command_def_t task_memory_commands[] = {
+    { "MEM_STATS", NULL, cmd_mem_stats },
+};
+
+esp_err_t task_memory_init(void) {
+    return command_register_table(task_memory_commands,
+                                  sizeof(task_memory_commands) / sizeof(task_memory_commands[0]));
+}
@@ -0,0 +1,417 @@
+#include "temp_compensation.h"
+#include "hardware_config.h"
+#include "sct_calibration.h"
+#include "load_events.h"
+#include "command_dispatcher.h"
+#include "perf_monitor.h"
+#include "task_memory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "soc/soc_caps.h"
+#if SOC_TEMP_SENSOR_SUPPORTED
+#include "driver/temperature_sensor.h"
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "TEMP_COMP";
+
+#define TEMP_COMP_NVS_NAMESPACE "tempcomp"
+#define TEMP_COMP_NVS_KEY "table"
+#define TEMP_COMP_RECORD_VERSION 1
+#define TEMP_COMP_MIN_READING_C -40.0f
+#define TEMP_COMP_MAX_READING_C 125.0f
+
+// One bin's learned calibration; a field is used once it has TEMP_COMP_MIN_OBSERVATIONS
+typedef struct {
+    float bias_voltage;
+    float amps_per_volt;
+    uint16_t bias_count;
+    uint16_t scale_count;
+} temp_bin_t;
+
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    temp_bin_t bins[TEMP_COMP_BINS];
+} temp_table_record_t;
+
+static temp_bin_t bins[TEMP_COMP_BINS];
+static portMUX_TYPE table_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool table_dirty = false;
+static uint32_t last_table_save_ms = 0;
+
+static volatile bool compensation_enabled = true;
+static volatile float external_celsius = NAN;
+static volatile uint32_t external_ms = 0;
+static TaskHandle_t task_handle = NULL;
+STATIC_TASK(compensation_task, TEMP_COMP_TASK_STACK);
+#if SOC_TEMP_SENSOR_SUPPORTED
+static temperature_sensor_handle_t onchip_sensor = NULL;
+#endif
+
+// Task state. The reference is the last calibration and the temperature it was made at
+static float present_celsius = NAN;
+static const char* present_source = "NONE";
+static uint32_t known_version = 0;         // Calibration version accounted for
+static float known_scale = NAN;
+static float reference_scale = NAN;
+static float reference_celsius = NAN;
+static uint32_t corrections = 0;
+static uint32_t superseded = 0;            // A calibration landed between computing and publishing
+
+static int bin_index(float celsius) {
+    int index = (int)floorf((celsius - TEMP_COMP_MIN_C) / TEMP_COMP_BIN_C);
+    if (index < 0) return 0;
+    if (index >= TEMP_COMP_BINS) return TEMP_COMP_BINS - 1;
+    return index;
+}
+
+static float bin_center(int index) {
+    return TEMP_COMP_MIN_C + (index + 0.5f) * TEMP_COMP_BIN_C;
+}
+
+static void learn(float* value, uint16_t* count, float observation) {
+    *value = (*count == 0) ? observation : *value + TEMP_COMP_ALPHA * (observation - *value);
+    if (*count < UINT16_MAX) {
+        (*count)++;
+    }
+}
+
+static bool bin_value(int index, bool scale, float* value) {
+    if (index < 0 || index >= TEMP_COMP_BINS) {
+        return false;
+    }
+    const temp_bin_t* bin = &bins[index];
+    if ((scale ? bin->scale_count : bin->bias_count) < TEMP_COMP_MIN_OBSERVATIONS) {
+        return false;
+    }
+    *value = scale ? bin->amps_per_volt : bin->bias_voltage;
+    return true;
+}
+
+// Linear between the learned bin centres around the temperature, the nearer learned one
+// past the table's learned range; NAN with neither learned
+static float table_lookup(float celsius, bool scale) {
+    float position = (celsius - TEMP_COMP_MIN_C) / TEMP_COMP_BIN_C - 0.5f;
+    int lower = (int)floorf(position);
+    float fraction = position - lower;
+
+    float low, high;
+    portENTER_CRITICAL(&table_lock);
+    bool has_low = bin_value(lower, scale, &low);
+    bool has_high = bin_value(lower + 1, scale, &high);
+    portEXIT_CRITICAL(&table_lock);
+
+    if (has_low && has_high) return low + fraction * (high - low);
+    if (has_low) return low;
+    if (has_high) return high;
+    return NAN;
+}
+
+// === PERSISTENCE ===
+static void load_table(void) {
+    nvs_handle_t handle;
+    if (nvs_open(TEMP_COMP_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+
+    static temp_table_record_t record;
+    size_t size = sizeof(record);
+    if (nvs_get_blob(handle, TEMP_COMP_NVS_KEY, &record, &size) == ESP_OK && size == sizeof(record) &&
+        record.version == TEMP_COMP_RECORD_VERSION && record.size == sizeof(record)) {
+        memcpy(bins, record.bins, sizeof(bins));
+    }
+    nvs_close(handle);
+}
+
+// Task only
+static void save_table(void) {
+    static temp_table_record_t record;
+    record.version = TEMP_COMP_RECORD_VERSION;
+    record.size = sizeof(record);
+    portENTER_CRITICAL(&table_lock);
+    memcpy(record.bins, bins, sizeof(bins));
+    table_dirty = false;
+    portEXIT_CRITICAL(&table_lock);
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(TEMP_COMP_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(handle, TEMP_COMP_NVS_KEY, &record, sizeof(record));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    last_table_save_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Temperature table not saved: %s", esp_err_to_name(ret));
+        table_dirty = true;
+    }
+}
+
+// === COMPENSATION ===
+// A fresh external reading first - it is usually nearer the burden resistor than the chip
+static bool read_temperature(float* celsius, const char** source) {
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    float external = external_celsius;
+    if (!isnan(external) && now - external_ms < TEMP_COMP_EXTERNAL_TIMEOUT_MS) {
+        *celsius = external;
+        *source = "EXTERNAL";
+        return true;
+    }
+#if SOC_TEMP_SENSOR_SUPPORTED
+    if (onchip_sensor && temperature_sensor_get_celsius(onchip_sensor, celsius) == ESP_OK) {
+        *source = "ONCHIP";
+        return true;
+    }
+#endif
+    return false;
+}
+
+// A version this task did not publish is a calibration, made at the present temperature
+static void track_calibration(const calibration_snapshot_t* cal, float celsius) {
+    if (cal->version == known_version && !isnan(reference_scale)) {
+        return;
+    }
+
+    bool first = isnan(reference_scale);   // The stored or boot calibration - not measured now
+    bool scale_changed = cal->amps_per_volt != known_scale;
+    if (first || scale_changed) {
+        reference_scale = cal->amps_per_volt;
+        reference_celsius = celsius;
+    }
+    if (!first && scale_changed) {
+        int index = bin_index(celsius);
+        portENTER_CRITICAL(&table_lock);
+        learn(&bins[index].amps_per_volt, &bins[index].scale_count, cal->amps_per_volt);
+        table_dirty = true;
+        portEXIT_CRITICAL(&table_lock);
+    }
+    known_version = cal->version;
+    known_scale = cal->amps_per_volt;
+}
+
+// The DC tracker is the bias whenever the waveform sits well inside the ADC range
+static void learn_bias(float celsius) {
+    load_state_t load;
+    if (!load_events_get_state(&load) || load.steady_ms < TEMP_COMP_BIAS_SETTLE_MS ||
+        load.amps >= TEMP_COMP_BIAS_MAX_AMPS) {
+        return;
+    }
+
+    int index = bin_index(celsius);
+    float dc_voltage = get_tracked_dc_voltage();
+    portENTER_CRITICAL(&table_lock);
+    learn(&bins[index].bias_voltage, &bins[index].bias_count, dc_voltage);
+    table_dirty = true;
+    portEXIT_CRITICAL(&table_lock);
+}
+
+static void correct_calibration(const calibration_snapshot_t* cal, float celsius) {
+    float bias = table_lookup(celsius, false);
+    float scale = NAN;
+    float scale_here = table_lookup(celsius, true);
+    float scale_at_reference = table_lookup(reference_celsius, true);
+    if (!isnan(scale_here) && scale_at_reference > 0.0f) {
+        scale = reference_scale * scale_here / scale_at_reference;
+    }
+
+    if (!isnan(bias) && fabsf(bias - cal->bias_voltage) < TEMP_COMP_MIN_BIAS_STEP_V) {
+        bias = NAN;
+    }
+    if (!isnan(scale) && fabsf(scale - cal->amps_per_volt) < cal->amps_per_volt * TEMP_COMP_MIN_SCALE_STEP) {
+        scale = NAN;
+    }
+    if (isnan(bias) && isnan(scale)) {
+        return;
+    }
+
+    uint32_t version = apply_calibration_correction(cal->version, bias, scale);
+    if (version == 0) {
+        superseded++;   // The next step sees the calibration that won
+        return;
+    }
+    known_version = version;
+    if (!isnan(scale)) {
+        known_scale = scale;
+    }
+    corrections++;
+    ESP_LOGI(TAG, "%.1f C: bias %.4f -> %.4f V, scale %.2f -> %.2f A/V", celsius,
+             cal->bias_voltage, isnan(bias) ? cal->bias_voltage : bias,
+             cal->amps_per_volt, isnan(scale) ? cal->amps_per_volt : scale);
+}
+
+static void compensation_step(void) {
+    float celsius;
+    const char* source;
+    if (!read_temperature(&celsius, &source)) {
+        present_celsius = NAN;
+        present_source = "NONE";
+        return;
+    }
+    present_celsius = celsius;
+    present_source = source;
+
+    calibration_snapshot_t cal;
+    get_calibration_snapshot(&cal);
+    track_calibration(&cal, celsius);
+    learn_bias(celsius);
+
+    if (compensation_enabled) {
+        correct_calibration(&cal, celsius);
+    }
+}
+
+static void temp_compensation_task(void *parameters) {
+    PERF_REGISTER_TASK();
+
+    while (1) {
+        // An external reading wakes the task early
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TEMP_COMP_SAMPLE_MS));
+        compensation_step();
+
+        uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        if (table_dirty && now - last_table_save_ms >= TEMP_COMP_SAVE_INTERVAL_MS) {
+            save_table();
+        }
+    }
+}
+
+// Declared in sct_calibration.h - the entry point for an external sensor
+void temperature_compensation(float temperature_c) {
+    if (!(temperature_c >= TEMP_COMP_MIN_READING_C && temperature_c <= TEMP_COMP_MAX_READING_C)) {
+        return;
+    }
+    external_celsius = temperature_c;
+    external_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (task_handle) {
+        xTaskNotifyGive(task_handle);
+    }
+}
+
+void temp_compensation_enable(bool enable) {
+    compensation_enabled = enable;
+    ESP_LOGI(TAG, "Temperature compensation %s", enable ? "enabled" : "disabled");
+}
+
+void temp_compensation_reset(void) {
+    portENTER_CRITICAL(&table_lock);
+    memset(bins, 0, sizeof(bins));
+    table_dirty = true;
+    portEXIT_CRITICAL(&table_lock);
+    last_table_save_ms -= TEMP_COMP_SAVE_INTERVAL_MS;   // Write the empty table at the next step
+    ESP_LOGI(TAG, "Temperature table reset");
+}
+
+void temp_compensation_get_status(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+
+    int learned = 0;
+    portENTER_CRITICAL(&table_lock);
+    for (int i = 0; i < TEMP_COMP_BINS; i++) {
+        if (bins[i].bias_count || bins[i].scale_count) {
+            learned++;
+        }
+    }
+    portEXIT_CRITICAL(&table_lock);
+
+    snprintf(buffer, buffer_size,
+             "ENABLED=%s,SOURCE=%s,TEMP=%.1fC,REF_TEMP=%.1fC,REF_SCALE=%.2f,CORRECTIONS=%lu,"
+             "SUPERSEDED=%lu,BINS=%d",
+             compensation_enabled ? "YES" : "NO", present_source, present_celsius,
+             reference_celsius, reference_scale, corrections, superseded, learned);
+}
+
+// === TEMPERATURE COMMANDS ===
+// TEMPERATURE:celsius
+CMD_HANDLER(cmd_temperature) {
+    float celsius = args->values[0].f;
+    if (!(celsius >= TEMP_COMP_MIN_READING_C && celsius <= TEMP_COMP_MAX_READING_C)) {
+        return cmd_reply(response, response_size, "TEMPERATURE:ERROR,INVALID_RANGE");
+    }
+    temperature_compensation(celsius);
+    return cmd_reply(response, response_size, "TEMPERATURE:SUCCESS,VALUE=%.1f", celsius);
+}
+
+// State, then one entry per learned bin: centre, bias/observations, scale/observations
+CMD_HANDLER(cmd_temp_comp) {
+    temp_bin_t table[TEMP_COMP_BINS];
+    portENTER_CRITICAL(&table_lock);
+    memcpy(table, bins, sizeof(table));
+    portEXIT_CRITICAL(&table_lock);
+
+    size_t length = cmd_reply(response, response_size, "TEMP_COMP:");
+    temp_compensation_get_status(response + length, response_size - length);
+    length += strlen(response + length);
+
+    for (int i = 0; i < TEMP_COMP_BINS; i++) {
+        if (!table[i].bias_count && !table[i].scale_count) {
+            continue;
+        }
+        length += cmd_reply(response + length, response_size - length,
+                            ";%.1fC,BIAS=%.4f/%u,SCALE=%.2f/%u", bin_center(i),
+                            table[i].bias_voltage, table[i].bias_count,
+                            table[i].amps_per_volt, table[i].scale_count);
+    }
+    return length;
+}
+
+CMD_HANDLER(cmd_temp_comp_on) {
+    temp_compensation_enable(true);
+    return cmd_reply(response, response_size, "TEMP_COMP_ON:SUCCESS");
+}
+
+CMD_HANDLER(cmd_temp_comp_off) {
+    temp_compensation_enable(false);
+    return cmd_reply(response, response_size, "TEMP_COMP_OFF:SUCCESS");
+}
+
+CMD_HANDLER(cmd_temp_comp_reset) {
+    temp_compensation_reset();
+    return cmd_reply(response, response_size, "TEMP_COMP_RESET:SUCCESS");
+}
+
+static const command_def_t temp_compensation_commands[] = {
+    { "TEMPERATURE",     "f",  cmd_temperature },
+    { "TEMP_COMP",       NULL, cmd_temp_comp },
+    { "TEMP_COMP_ON",    NULL, cmd_temp_comp_on },
+    { "TEMP_COMP_OFF",   NULL, cmd_temp_comp_off },
+    { "TEMP_COMP_RESET", NULL, cmd_temp_comp_reset },
+};
+
+esp_err_t temp_compensation_init(void) {
+    if (task_handle) {
+        return ESP_OK;
+    }
+
+    load_table();
+
+#if SOC_TEMP_SENSOR_SUPPORTED
+    temperature_sensor_config_t config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
+    if (temperature_sensor_install(&config, &onchip_sensor) != ESP_OK ||
+        temperature_sensor_enable(onchip_sensor) != ESP_OK) {
+        ESP_LOGW(TAG, "On-chip temperature sensor unavailable - waiting for TEMPERATURE readings");
+        onchip_sensor = NULL;
+    }
+#else
+    ESP_LOGI(TAG, "No on-chip temperature sensor - waiting for TEMPERATURE readings");
+#endif
+
+    task_handle = static_task_start(&compensation_task, temp_compensation_task, "temp_comp", NULL,
+                                    TEMP_COMP_TASK_PRIORITY, NETWORK_CORE);
+    if (!task_handle) {
+        ESP_LOGE(TAG, "Failed to create temperature compensation task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    command_register_table(temp_compensation_commands,
+                           sizeof(temp_compensation_commands) / sizeof(temp_compensation_commands[0]));
+    ESP_LOGI(TAG, "Temperature compensation: %d bins of %.0f C from %.0f C",
+             TEMP_COMP_BINS, TEMP_COMP_BIN_C, TEMP_COMP_MIN_C);
+    return ESP_OK;
+}
@@ -2,12 +2,22 @@
 #include "hardware_config.h"
 #include "sct_calibration.h"
 #include "udp_sender.h"
+#include "command_dispatcher.h"
+#include "waveform_capture.h"
+#include "rms_engine.h"
+#include "perf_monitor.h"
+#include "energy.h"
+#include "startup.h"
+#include "task_memory.h"
+#include "net_buffers.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "lwip/sockets.h"
 #include "string.h"
-#include "driver/gpio.h"
+#include <stdio.h>
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "math.h"
 
 
@@ -16,8 +26,12 @@ static const char *TAG = "UDP_RECV";
 static bool udp_receiver_running = false;
 static int udp_recv_socket = -1;
 
+STATIC_TASK(receiver_task, UDP_RECEIVER_TASK_STACK);
+static char rx_buffer[NET_BUFFER_SIZE];     // Receiver task only
+
 void udp_receiver_task(void *parameters) {
     udp_receiver_running = true;
+    PERF_REGISTER_TASK();
     ESP_LOGI(TAG, "UDP receiver task started with auto-calibration support");
     
     // Create socket
@@ -45,21 +59,22 @@ void udp_receiver_task(void *parameters) {
     }
     
     ESP_LOGI(TAG, "UDP receiver listening on port %d", UDP_RECV_PORT);
+    startup_signal(STARTUP_COMMANDS);
     
-    char buffer[1024];
     struct sockaddr_in client_addr;
     socklen_t client_addr_len = sizeof(client_addr);
     
     while (udp_receiver_running) {
-        int recv_len = recvfrom(udp_recv_socket, buffer, sizeof(buffer) - 1, 0,
+        int recv_len = recvfrom(udp_recv_socket, rx_buffer, sizeof(rx_buffer) - 1, 0,
                                (struct sockaddr*)&client_addr, &client_addr_len);
         
         if (recv_len > 0) {
-            buffer[recv_len] = '\0';
-            ESP_LOGI(TAG, "Received command: %s", buffer);
+            rx_buffer[recv_len] = '\0';
             
             // Process command with auto-calibration support
-            process_udp_command(buffer, udp_recv_socket, &client_addr);
+            PERF_BEGIN(PERF_PROBE_UDP_COMMAND);
+            process_udp_command(rx_buffer, udp_recv_socket, &client_addr);
+            PERF_END(PERF_PROBE_UDP_COMMAND);
         } else if (recv_len < 0) {
             ESP_LOGW(TAG, "UDP receive error");
             vTaskDelay(pdMS_TO_TICKS(1000));
@@ -72,284 +87,330 @@ void udp_receiver_task(void *parameters) {
     vTaskDelete(NULL);
 }
 
-void process_udp_command(const char* command, int sock, struct sockaddr_in* client_addr) {
-    char response[1024];
-    memset(response, 0, sizeof(response));
-    
-    ESP_LOGI(TAG, "Processing command: %s", command);
-    
-    // === RELAY CONTROL ===
-    if (strncmp(command, "RELAY_ON", 8) == 0) {
-        gpio_set_level(RELAY_GPIO, 1);
-        snprintf(response, sizeof(response), "RELAY_ON:SUCCESS");
-        
-    } else if (strncmp(command, "RELAY_OFF", 9) == 0) {
-        gpio_set_level(RELAY_GPIO, 0);
-        snprintf(response, sizeof(response), "RELAY_OFF:SUCCESS");
-        
-    } else if (strncmp(command, "RELAY_TOGGLE", 12) == 0) {
-        int current_state = gpio_get_level(RELAY_GPIO);
-        gpio_set_level(RELAY_GPIO, !current_state);
-        snprintf(response, sizeof(response), "RELAY_TOGGLE:SUCCESS,STATE=%s", 
-                 !current_state ? "ON" : "OFF");
-    
-    // === AUTO-CALIBRATION COMMANDS ===
-    } else if (strncmp(command, "AUTO_CAL_ON", 11) == 0) {
-        set_auto_calibration(true);
-        snprintf(response, sizeof(response), "AUTO_CAL_ON:SUCCESS");
-        
-    } else if (strncmp(command, "AUTO_CAL_OFF", 12) == 0) {
-        set_auto_calibration(false);
-        snprintf(response, sizeof(response), "AUTO_CAL_OFF:SUCCESS");
-        
-    } else if (strncmp(command, "AUTO_CAL_STATUS", 15) == 0) {
-        char auto_cal_stats[256];
-        get_auto_cal_statistics(auto_cal_stats, sizeof(auto_cal_stats));
-        snprintf(response, sizeof(response), "AUTO_CAL_STATUS:%s", auto_cal_stats);
-        
-    } else if (strncmp(command, "AUTO_CAL_SENSITIVITY:", 21) == 0) {
-        float sensitivity = atof(command + 21);
-        if (sensitivity >= 0.0f && sensitivity <= 1.0f) {
-            set_auto_cal_sensitivity(sensitivity);
-            snprintf(response, sizeof(response), "AUTO_CAL_SENSITIVITY:SUCCESS,VALUE=%.2f", sensitivity);
-        } else {
-            snprintf(response, sizeof(response), "AUTO_CAL_SENSITIVITY:ERROR,INVALID_RANGE");
-        }
-        
-    } else if (strncmp(command, "AUTO_CAL_LEARNING_RATE:", 23) == 0) {
-        float rate = atof(command + 23);
-        if (rate >= 0.0f && rate <= 1.0f) {
-            set_learning_rate(rate);
-            snprintf(response, sizeof(response), "LEARNING_RATE:SUCCESS,VALUE=%.2f", rate);
-        } else {
-            snprintf(response, sizeof(response), "LEARNING_RATE:ERROR,INVALID_RANGE");
-        }
-    
-    // === DEVICE RECOGNITION ===
+// === AUTO-CALIBRATION COMMANDS ===
+CMD_HANDLER(cmd_auto_cal_on) {
+    set_auto_calibration(true);
+    return cmd_reply(response, response_size, "AUTO_CAL_ON:SUCCESS");
+}
+
+CMD_HANDLER(cmd_auto_cal_off) {
+    set_auto_calibration(false);
+    return cmd_reply(response, response_size, "AUTO_CAL_OFF:SUCCESS");
+}
+
+CMD_HANDLER(cmd_auto_cal_status) {
+    size_t length = cmd_reply(response, response_size, "AUTO_CAL_STATUS:");
+    get_auto_cal_statistics(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+CMD_HANDLER(cmd_auto_cal_sensitivity) {
+    float sensitivity = args->values[0].f;
+    if (sensitivity < 0.0f || sensitivity > 1.0f) {
+        return cmd_reply(response, response_size, "AUTO_CAL_SENSITIVITY:ERROR,INVALID_RANGE");
+    }
+    set_auto_cal_sensitivity(sensitivity);
+    return cmd_reply(response, response_size, "AUTO_CAL_SENSITIVITY:SUCCESS,VALUE=%.2f", sensitivity);
+}
+
+CMD_HANDLER(cmd_auto_cal_learning_rate) {
+    float rate = args->values[0].f;
+    if (rate < 0.0f || rate > 1.0f) {
+        return cmd_reply(response, response_size, "LEARNING_RATE:ERROR,INVALID_RANGE");
+    }
+    set_learning_rate(rate);
+    return cmd_reply(response, response_size, "LEARNING_RATE:SUCCESS,VALUE=%.2f", rate);
+}
+
+// === DEVICE RECOGNITION ===
 #if ENABLE_DEVICE_RECOGNITION
-    } else if (strncmp(command, "LIST_DEVICES", 12) == 0) {
-        char device_list[512];
-        list_known_devices(device_list, sizeof(device_list));
-        snprintf(response, sizeof(response), "DEVICE_LIST:%s", device_list);
-        
-    } else if (strncmp(command, "RECOGNIZE_CURRENT:", 18) == 0) {
-        float current = atof(command + 18);
-        const device_profile_t* device = recognize_device(current);
-        if (device) {
-            snprintf(response, sizeof(response), 
+CMD_HANDLER(cmd_list_devices) {
+    size_t length = cmd_reply(response, response_size, "DEVICE_LIST:");
+    list_known_devices(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+CMD_HANDLER(cmd_recognize_current) {
+    const device_profile_t* device = recognize_device(args->values[0].f);
+    if (!device) {
+        return cmd_reply(response, response_size, "DEVICE_RECOGNIZED:NONE");
+    }
+    return cmd_reply(response, response_size,
                      "DEVICE_RECOGNIZED:NAME=%s,TYPICAL=%.2fA,RANGE=%.2f-%.2fA",
                      device->device_name, device->typical_current,
                      device->min_current, device->max_current);
-        } else {
-            snprintf(response, sizeof(response), "DEVICE_RECOGNIZED:NONE");
-        }
-        
-    } else if (strncmp(command, "AUTO_RECOGNIZE", 14) == 0) {
-        float current = get_detected_load_amps();
-        auto_recognize_and_calibrate(current);
-        snprintf(response, sizeof(response), "AUTO_RECOGNIZE:PROCESSED,CURRENT=%.3fA", current);
+}
+
+// ADD_DEVICE:min_amps,max_amps,typical_amps,name - kept across reboots
+CMD_HANDLER(cmd_add_device) {
+    if (!add_custom_device_profile(args->values[0].f, args->values[1].f,
+                                   args->values[2].f, args->values[3].s)) {
+        return cmd_reply(response, response_size, "ADD_DEVICE:ERROR,INVALID_OR_FULL,MAX=%d",
+                         MAX_CUSTOM_DEVICES);
+    }
+    return cmd_reply(response, response_size, "ADD_DEVICE:SUCCESS,NAME=%s", args->values[3].s);
+}
+
+CMD_HANDLER(cmd_clear_devices) {
+    if (!clear_custom_device_profiles()) {
+        return cmd_reply(response, response_size, "CLEAR_DEVICES:ERROR,BUSY");
+    }
+    return cmd_reply(response, response_size, "CLEAR_DEVICES:SUCCESS");
+}
 #endif
-    
-    // === LEARNING SYSTEM ===
+
+// === LEARNING SYSTEM ===
 #if ENABLE_CALIBRATION_LEARNING
-    } else if (strncmp(command, "LEARNING_STATS", 14) == 0) {
-        int learning_points = get_learning_point_count();
-        float learning_rate = get_learning_rate();
-        snprintf(response, sizeof(response), 
-                 "LEARNING_STATS:POINTS=%d,RATE=%.2f,MAX_POINTS=%d",
-                 learning_points, learning_rate, MAX_LEARNING_POINTS);
-        
-    } else if (strncmp(command, "RESET_LEARNING", 14) == 0) {
-        reset_learning_data();
-        snprintf(response, sizeof(response), "RESET_LEARNING:SUCCESS");
-        
-    } else if (strncmp(command, "APPLY_LEARNING", 14) == 0) {
-        apply_learned_calibration();
-        snprintf(response, sizeof(response), "APPLY_LEARNING:SUCCESS");
+CMD_HANDLER(cmd_learning_stats) {
+    learning_estimate_t estimate;
+    get_learning_estimate(&estimate);
+    return cmd_reply(response, response_size,
+                     "LEARNING_STATS:POINTS=%lu,RATE=%.2f,SCALE=%.2f,SCALE_SD=%.3f,OFFSET=%.4f,"
+                     "OFFSET_SD=%.4f,CORRELATION=%.2f,EFFECTIVE_POINTS=%.1f",
+                     estimate.updates, get_learning_rate(), estimate.scale, estimate.scale_sd,
+                     estimate.offset_amps, estimate.offset_sd, estimate.correlation,
+                     estimate.effective_points);
+}
+
+CMD_HANDLER(cmd_reset_learning) {
+    reset_learning_data();
+    return cmd_reply(response, response_size, "RESET_LEARNING:SUCCESS");
+}
+
+CMD_HANDLER(cmd_apply_learning) {
+    apply_learned_calibration();
+    return cmd_reply(response, response_size, "APPLY_LEARNING:SUCCESS");
+}
 #endif
-    
-    // === ENHANCED CALIBRATION COMMANDS ===
-    } else if (strncmp(command, "ZERO_CAL", 8) == 0) {
-        perform_zero_calibration(sock, client_addr);
-        return; // Response sent by perform_zero_calibration
-        
-    } else if (strncmp(command, "SCALE_CAL:", 10) == 0) {
-        float known_current = atof(command + 10);
-        perform_scale_calibration(known_current, sock, client_addr);
-        return; // Response sent by perform_scale_calibration
-        
-    } else if (strncmp(command, "MANUAL_CAL:", 11) == 0) {
-        // Parse bias_voltage,scale_factor
-        char* comma = strchr(command + 11, ',');
-        if (comma) {
-            *comma = '\0';
-            float bias_voltage = atof(command + 11);
-            float scale_factor = atof(comma + 1);
-            
-            set_bias_voltage(bias_voltage);
-            set_amps_per_volt(scale_factor);
-            
-            snprintf(response, sizeof(response), 
+
+// === ENHANCED CALIBRATION COMMANDS ===
+CMD_HANDLER(cmd_manual_cal) {
+    float bias_voltage = args->values[0].f;
+    float scale_factor = args->values[1].f;
+    set_calibration(bias_voltage, scale_factor);
+    return cmd_reply(response, response_size,
                      "MANUAL_CAL:SUCCESS,BIAS=%.4f,SCALE=%.2f", bias_voltage, scale_factor);
-        } else {
-            snprintf(response, sizeof(response), "MANUAL_CAL:ERROR,INVALID_FORMAT");
-        }
-        
-    } else if (strncmp(command, "RESET_CAL", 9) == 0) {
-        reset_calibration(sock, client_addr);
-        return; // Response sent by reset_calibration
-        
-    } else if (strncmp(command, "CAL_STATUS", 10) == 0) {
-        char cal_status[256];
-        get_calibration_status(cal_status, sizeof(cal_status));
-        snprintf(response, sizeof(response), "CAL_STATUS:%s", cal_status);
-    
-    // === AUTO-DETECTION COMMANDS ===
-    } else if (strncmp(command, "AUTO_DETECT", 11) == 0) {
-        auto_detect_load_current();
-        float detected = get_detected_load_amps();
-        snprintf(response, sizeof(response), "AUTO_DETECT:SUCCESS,CURRENT=%.3fA", detected);
-        
-    } else if (strncmp(command, "AUTO_DETECT_ON", 14) == 0) {
-        set_auto_detection(true);
-        snprintf(response, sizeof(response), "AUTO_DETECT_ON:SUCCESS");
-        
-    } else if (strncmp(command, "AUTO_DETECT_OFF", 15) == 0) {
-        set_auto_detection(false);
-        snprintf(response, sizeof(response), "AUTO_DETECT_OFF:SUCCESS");
-    
-    // === MEASUREMENT AND DIAGNOSTICS ===
-    } else if (strncmp(command, "GET_CURRENT", 11) == 0) {
-        float current = get_instant_current_reading();
-        float detected = get_detected_load_amps();
-        snprintf(response, sizeof(response), 
-                 "CURRENT:INSTANT=%.3fA,DETECTED=%.3fA,VRMS=%.6fV",
-                 current, detected, get_last_measured_vrms());
-        
-    } else if (strncmp(command, "MEASUREMENT_STATS", 17) == 0) {
-        char stats[256];
-        get_measurement_statistics(stats, sizeof(stats));
-        snprintf(response, sizeof(response), "MEASUREMENT_STATS:%s", stats);
-        
-    } else if (strncmp(command, "RESET_STATS", 11) == 0) {
-        reset_measurement_statistics();
-        reset_auto_cal_statistics();
-        snprintf(response, sizeof(response), "RESET_STATS:SUCCESS");
-        
-    } else if (strncmp(command, "BUFFER_ANALYSIS", 15) == 0) {
-        char analysis[256];
-        analyze_voltage_buffer(analysis, sizeof(analysis));
-        snprintf(response, sizeof(response), "BUFFER_ANALYSIS:%s", analysis);
-        
-    } else if (strncmp(command, "DEBUG_ADC", 9) == 0) {
-        debug_adc_readings();
-        snprintf(response, sizeof(response), "DEBUG_ADC:COMPLETE,CHECK_SERIAL_OUTPUT");
-        
-    } else if (strncmp(command, "RECALIBRATE_BIAS", 16) == 0) {
-        perform_zero_calibration(sock, client_addr);
-        return; // Response sent by perform_zero_calibration
-    
-    // === SCT-013 INFORMATION ===
-    } else if (strncmp(command, "SCT_INFO", 8) == 0) {
-        print_sct_013_info();
-        float theoretical = calculate_theoretical_scale_factor();
-        float current_scale = get_amps_per_volt();
-        float current_bias = get_bias_voltage();
-        
-        snprintf(response, sizeof(response),
-                 "SCT_INFO:THEORETICAL=%.1fA/V,CURRENT_SCALE=%.2fA/V,BIAS=%.4fV,BURDEN=%.1fOHM",
-                 theoretical, current_scale, current_bias, SCT_013_BURDEN_RESISTOR);
+}
+
+CMD_HANDLER(cmd_reset_cal) {
+    reset_calibration(ctx->sock, ctx->client_addr);
+    return 0; // Response sent by reset_calibration
+}
+
+CMD_HANDLER(cmd_cal_status) {
+    size_t length = cmd_reply(response, response_size, "CAL_STATUS:");
+    get_calibration_status(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+CMD_HANDLER(cmd_cal_store) {
+    size_t length = cmd_reply(response, response_size, "CAL_STORE:");
+    get_calibration_store_status(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+// Until the next calibration change is saved again
+CMD_HANDLER(cmd_cal_forget) {
+    bool erased = sct_calibration_forget();
+    return cmd_reply(response, response_size, "CAL_FORGET:%s", erased ? "SUCCESS" : "ERROR,NVS");
+}
+
+// === AUTO-DETECTION COMMANDS ===
+CMD_HANDLER(cmd_auto_detect_on) {
+    set_auto_detection(true);
+    return cmd_reply(response, response_size, "AUTO_DETECT_ON:SUCCESS");
+}
+
+CMD_HANDLER(cmd_auto_detect_off) {
+    set_auto_detection(false);
+    return cmd_reply(response, response_size, "AUTO_DETECT_OFF:SUCCESS");
+}
+
+// === MEASUREMENT AND DIAGNOSTICS ===
+CMD_HANDLER(cmd_get_current) {
+    return cmd_reply(response, response_size,
+                     "CURRENT:INSTANT=%.3fA,DETECTED=%.3fA,VRMS=%.6fV,LINE_HZ=%.2f",
+                     get_instant_current_reading(), get_detected_load_amps(),
+                     get_last_measured_vrms(), rms_engine_get_line_frequency());
+}
+
+CMD_HANDLER(cmd_measurement_stats) {
+    size_t length = cmd_reply(response, response_size, "MEASUREMENT_STATS:");
+    get_measurement_statistics(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+CMD_HANDLER(cmd_reset_stats) {
+    reset_measurement_statistics();
+    reset_auto_cal_statistics();
+    return cmd_reply(response, response_size, "RESET_STATS:SUCCESS");
+}
+
+CMD_HANDLER(cmd_buffer_analysis) {
+    size_t length = cmd_reply(response, response_size, "BUFFER_ANALYSIS:");
+    analyze_voltage_buffer(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+CMD_HANDLER(cmd_debug_adc) {
+    debug_adc_readings();
+    return cmd_reply(response, response_size, "DEBUG_ADC:COMPLETE,CHECK_SERIAL_OUTPUT");
+}
+
+// === SCT-013 INFORMATION ===
+CMD_HANDLER(cmd_sct_info) {
+    print_sct_013_info();
+    return cmd_reply(response, response_size,
+                     "SCT_INFO:THEORETICAL=%.1fA/V,CURRENT_SCALE=%.2fA/V,BIAS=%.4fV,BURDEN=%.1fOHM",
+                     calculate_theoretical_scale_factor(), get_amps_per_volt(),
+                     get_bias_voltage(), SCT_013_BURDEN_RESISTOR);
+}
+
+// === SYSTEM CONTROL ===
+CMD_HANDLER(cmd_system_status) {
+    uint32_t uptime = xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
+    return cmd_reply(response, response_size,
+                     "SYSTEM_STATUS:UPTIME=%lus,AUTO_CAL=%s,AUTO_DET=%s,CAL_COUNT=%lu,UDP_RUNNING=%s",
+                     uptime,
+                     get_auto_calibration_enabled() ? "ON" : "OFF",
+                     get_auto_detection_enabled() ? "ON" : "OFF",
+                     get_auto_cal_count(),
+                     is_udp_sender_running() ? "YES" : "NO");
+}
+
+CMD_HANDLER(cmd_ping) {
+    return cmd_reply(response, response_size, "PONG:ESP32_READY,AUTO_CAL_ENABLED");
+}
+
+CMD_HANDLER(cmd_restart) {
+    // Send response first, then restart
+    size_t length = cmd_reply(response, response_size, "RESTART:ACKNOWLEDGED");
+    sendto(ctx->sock, response, length, 0,
+           (struct sockaddr*)ctx->client_addr, sizeof(*ctx->client_addr));
+    energy_checkpoint();
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    esp_restart();
+    return 0;
+}
+
+// === CONFIGURATION COMMANDS ===
+CMD_HANDLER(cmd_get_config) {
+    return cmd_reply(response, response_size,
+                     "CONFIG:AUTO_CAL=%s,AUTO_DET=%s,LEARNING=%s,DEVICE_RECOG=%s,SENSITIVITY=%.2f",
+                     AUTO_CAL_ENABLED ? "ON" : "OFF",
+                     get_auto_detection_enabled() ? "ON" : "OFF",
+                     ENABLE_CALIBRATION_LEARNING ? "ON" : "OFF",
+                     ENABLE_DEVICE_RECOGNITION ? "ON" : "OFF",
+                     get_auto_cal_sensitivity());
+}
+
+CMD_HANDLER(cmd_set_bias) {
+    float bias = args->values[0].f;
+    if (bias < 0.1f || bias > 3.0f) {
+        return cmd_reply(response, response_size, "SET_BIAS:ERROR,INVALID_RANGE");
+    }
+    set_bias_voltage(bias);
+    return cmd_reply(response, response_size, "SET_BIAS:SUCCESS,VALUE=%.4f", bias);
+}
+
+CMD_HANDLER(cmd_set_scale) {
+    float scale = args->values[0].f;
+    if (scale < 1.0f || scale > 1000.0f) {
+        return cmd_reply(response, response_size, "SET_SCALE:ERROR,INVALID_RANGE");
+    }
+    set_amps_per_volt(scale);
+    return cmd_reply(response, response_size, "SET_SCALE:SUCCESS,VALUE=%.2f", scale);
+}
+
+// === PERF COMMANDS (compiled-out monitor) ===
+#if !ENABLE_PERF_MONITOR
+CMD_HANDLER(cmd_perf_stats_disabled) {
+    return cmd_reply(response, response_size, "PERF_STATS:DISABLED");
+}
+
+CMD_HANDLER(cmd_perf_reset_disabled) {
+    return cmd_reply(response, response_size, "PERF_RESET:DISABLED");
+}
+#endif
+
+// === HELP COMMAND ===
+CMD_HANDLER(cmd_help) {
+    size_t length = cmd_reply(response, response_size, "HELP:Commands available - ");
+    return length + command_list(response + length, response_size - length);
+}
+
+// Core commands; relay, telemetry, capture, perf and calibration job modules register their own
+static const command_def_t core_commands[] = {
+    { "AUTO_CAL_ON",            NULL, cmd_auto_cal_on },
+    { "AUTO_CAL_OFF",           NULL, cmd_auto_cal_off },
+    { "AUTO_CAL_STATUS",        NULL, cmd_auto_cal_status },
+    { "AUTO_CAL_SENSITIVITY",   "f",  cmd_auto_cal_sensitivity },
+    { "AUTO_CAL_LEARNING_RATE", "f",  cmd_auto_cal_learning_rate },
+#if ENABLE_DEVICE_RECOGNITION
+    { "LIST_DEVICES",           NULL, cmd_list_devices },
+    { "RECOGNIZE_CURRENT",      "f",  cmd_recognize_current },
+    { "ADD_DEVICE",             "fffs", cmd_add_device },
+    { "CLEAR_DEVICES",          NULL, cmd_clear_devices },
+#endif
+#if ENABLE_CALIBRATION_LEARNING
+    { "LEARNING_STATS",         NULL, cmd_learning_stats },
+    { "RESET_LEARNING",         NULL, cmd_reset_learning },
+    { "APPLY_LEARNING",         NULL, cmd_apply_learning },
+#endif
+    { "MANUAL_CAL",             "ff", cmd_manual_cal },
+    { "RESET_CAL",              NULL, cmd_reset_cal },
+    { "CAL_STATUS",             NULL, cmd_cal_status },
+    { "CAL_STORE",              NULL, cmd_cal_store },
+    { "CAL_FORGET",             NULL, cmd_cal_forget },
+    { "AUTO_DETECT_ON",         NULL, cmd_auto_detect_on },
+    { "AUTO_DETECT_OFF",        NULL, cmd_auto_detect_off },
+    { "GET_CURRENT",            NULL, cmd_get_current },
+    { "MEASUREMENT_STATS",      NULL, cmd_measurement_stats },
+    { "RESET_STATS",            NULL, cmd_reset_stats },
+    { "BUFFER_ANALYSIS",        NULL, cmd_buffer_analysis },
+    { "DEBUG_ADC",              NULL, cmd_debug_adc },
+    { "SCT_INFO",               NULL, cmd_sct_info },
+    { "SYSTEM_STATUS",          NULL, cmd_system_status },
+    { "PING",                   NULL, cmd_ping },
+    { "RESTART",                NULL, cmd_restart },
+    { "GET_CONFIG",             NULL, cmd_get_config },
+    { "SET_BIAS",               "f",  cmd_set_bias },
+    { "SET_SCALE",              "f",  cmd_set_scale },
+#if !ENABLE_PERF_MONITOR
+    { "PERF_STATS",             NULL, cmd_perf_stats_disabled },
+    { "PERF_RESET",             NULL, cmd_perf_reset_disabled },
+#endif
+    { "HELP",                   NULL, cmd_help },
+};
+
+static void udp_receiver_register_commands(void) {
+    command_register_table(core_commands, sizeof(core_commands) / sizeof(core_commands[0]));
+}
+
+void process_udp_command(const char* command, int sock, struct sockaddr_in* client_addr) {
+    cmd_context_t ctx = {
+        .sock = sock,
+        .client_addr = client_addr,
+        .received_us = esp_timer_get_time()
+    };
     
-    // === SYSTEM CONTROL ===
-    } else if (strncmp(command, "SYSTEM_STATUS", 13) == 0) {
-        uint32_t uptime = xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
-        bool auto_cal_enabled = get_auto_calibration_enabled();
-        bool auto_det_enabled = get_auto_detection_enabled();
-        uint32_t auto_cal_count = get_auto_cal_count();
-        
-        snprintf(response, sizeof(response),
-                 "SYSTEM_STATUS:UPTIME=%lus,AUTO_CAL=%s,AUTO_DET=%s,CAL_COUNT=%lu,UDP_RUNNING=%s",
-                 uptime,
-                 auto_cal_enabled ? "ON" : "OFF",
-                 auto_det_enabled ? "ON" : "OFF",
-                 auto_cal_count,
-                 is_udp_sender_running() ? "YES" : "NO");
-                 
-    } else if (strncmp(command, "PING", 4) == 0) {
-        snprintf(response, sizeof(response), "PONG:ESP32_READY,AUTO_CAL_ENABLED");
-        
-    } else if (strncmp(command, "RESTART", 7) == 0) {
-        snprintf(response, sizeof(response), "RESTART:ACKNOWLEDGED");
-        // Send response first, then restart
-        sendto(sock, response, strlen(response), 0, 
-               (struct sockaddr*)client_addr, sizeof(*client_addr));
-        vTaskDelay(pdMS_TO_TICKS(1000));
-        esp_restart();
+    char* response = net_buffer_acquire(pdMS_TO_TICKS(NET_BUFFER_WAIT_MS));
+    if (!response) {
+        ESP_LOGW(TAG, "No buffer for the reply - command dropped");
         return;
-    
-    // === CONFIGURATION COMMANDS ===
-    } else if (strncmp(command, "GET_CONFIG", 10) == 0) {
-        snprintf(response, sizeof(response),
-                 "CONFIG:AUTO_CAL=%s,AUTO_DET=%s,LEARNING=%s,DEVICE_RECOG=%s,SENSITIVITY=%.2f",
-                 AUTO_CAL_ENABLED ? "ON" : "OFF",
-                 get_auto_detection_enabled() ? "ON" : "OFF",
-                 ENABLE_CALIBRATION_LEARNING ? "ON" : "OFF",
-                 ENABLE_DEVICE_RECOGNITION ? "ON" : "OFF",
-                 get_auto_cal_sensitivity());
-                 
-    } else if (strncmp(command, "SET_BIAS:", 9) == 0) {
-        float bias = atof(command + 9);
-        if (bias >= 0.1f && bias <= 3.0f) {
-            set_bias_voltage(bias);
-            snprintf(response, sizeof(response), "SET_BIAS:SUCCESS,VALUE=%.4f", bias);
-        } else {
-            snprintf(response, sizeof(response), "SET_BIAS:ERROR,INVALID_RANGE");
-        }
-        
-    } else if (strncmp(command, "SET_SCALE:", 10) == 0) {
-        float scale = atof(command + 10);
-        if (scale >= 1.0f && scale <= 1000.0f) {
-            set_amps_per_volt(scale);
-            snprintf(response, sizeof(response), "SET_SCALE:SUCCESS,VALUE=%.2f", scale);
-        } else {
-            snprintf(response, sizeof(response), "SET_SCALE:ERROR,INVALID_RANGE");
-        }
-    
-    // === LEGACY COMMANDS (for backward compatibility) ===
-    } else if (strncmp(command, "CALIBRATE:", 10) == 0) {
-        float known_current = atof(command + 10);
-        calibrate_with_known_load(known_current);
-        snprintf(response, sizeof(response), "CALIBRATE:SUCCESS,SCALE=%.2f", get_amps_per_volt());
-        
-    } else if (strncmp(command, "CAL_KNOWN:", 10) == 0) {
-        float known_current = atof(command + 10);
-        calibrate_with_known_load(known_current);
-        snprintf(response, sizeof(response), "CAL_KNOWN:SUCCESS,SCALE=%.2f", get_amps_per_volt());
-    
-    // === HELP COMMAND ===
-    } else if (strncmp(command, "HELP", 4) == 0) {
-        snprintf(response, sizeof(response),
-                 "HELP:Commands available - RELAY_ON/OFF/TOGGLE, AUTO_CAL_ON/OFF, AUTO_DETECT, "
-                 "ZERO_CAL, SCALE_CAL:X, MANUAL_CAL:bias,scale, GET_CURRENT, SCT_INFO, "
-                 "SYSTEM_STATUS, LIST_DEVICES, LEARNING_STATS, PING, HELP");
-    
-    // === UNKNOWN COMMAND ===
-    } else {
-        ESP_LOGW(TAG, "Unknown command: %s", command);
-        snprintf(response, sizeof(response), "ERROR:UNKNOWN_COMMAND:%s", command);
     }
     
-    // Send response
-    if (strlen(response) > 0) {
-        int sent = sendto(sock, response, strlen(response), 0, 
+    size_t length = command_dispatch(command, &ctx, response, NET_BUFFER_SIZE);
+    if (length > 0) {
+        int sent = sendto(sock, response, length, 0,
                          (struct sockaddr*)client_addr, sizeof(*client_addr));
-        
-        if (sent > 0) {
-            ESP_LOGI(TAG, "Response sent: %s", response);
-        } else {
+        if (sent < 0) {
             ESP_LOGW(TAG, "Failed to send response");
+        } else {
+            ESP_LOGD(TAG, "Response sent: %s", response);
         }
     }
+    net_buffer_release(response);
 }
 
 void start_udp_receiver(void) {
@@ -358,16 +419,12 @@ void start_udp_receiver(void) {
         return;
     }
     
-    BaseType_t result = xTaskCreate(
-        udp_receiver_task,
-        "udp_receiver",
-        8192,  // Increased stack size for enhanced commands
-        NULL,
-        4,     // Priority
-        NULL
-    );
+    // Registered before the task starts so the first command sees the full table
+    udp_receiver_register_commands();
+    waveform_capture_register_commands();
     
-    if (result != pdPASS) {
+    if (!static_task_start(&receiver_task, udp_receiver_task, "udp_receiver", NULL,
+                           UDP_RECEIVER_TASK_PRIORITY, NETWORK_CORE)) {
         ESP_LOGE(TAG, "Failed to create UDP receiver task");
     } else {
         ESP_LOGI(TAG, "UDP receiver task created successfully");
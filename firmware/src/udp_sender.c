@@ -3,47 +3,117 @@
 #include "sct_calibration.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
-#include "esp_adc/adc_oneshot.h"
+#include "adc_sampler.h"
+#include "rms_engine.h"
+#include "telemetry_protocol.h"
+#include "rolling_stats.h"
+#include "perf_monitor.h"
+#include "command_dispatcher.h"
+#include "startup.h"
+#include "discovery.h"
+#include "task_memory.h"
+#include "net_buffers.h"
 #include "lwip/sockets.h"
 #include "string.h"
 #include <math.h>
 
 static const char *TAG = "UDP_SENDER";
 
-// ADC handle is now defined in main.c and declared extern in udp_sender.h
-
 // Global variables
 static int udp_socket = -1;
-static struct sockaddr_in dest_addr;
+static struct sockaddr_in discovery_addr;  // Announce beacon (broadcast)
 static bool udp_sender_running = false;
 
+STATIC_TASK(sender_task, UDP_SENDER_TASK_STACK);
+static TaskHandle_t sender_task_handle = NULL;
+static volatile bool telemetry_idle = false;  // Heartbeat cadence (power_scheduler.h)
+STATIC_TASK(stream_task, UDP_STREAM_TASK_STACK);
+
+// Unicast subscriptions - each with its own cadence and format, dropped when the
+// lease runs out unless renewed with another SUBSCRIBE
+typedef struct {
+    struct sockaddr_in addr;
+    telemetry_format_t format;
+    uint32_t interval_ms;
+    uint32_t next_due_ms;
+    uint32_t expires_ms;
+    bool needs_status;      // Binary: calibration/auto-cal frames owed with the next reading
+    bool active;
+} subscriber_t;
+
+static subscriber_t subscribers[TELEMETRY_MAX_SUBSCRIBERS];
+static portMUX_TYPE subscriber_lock = portMUX_INITIALIZER_UNLOCKED;
+
 // RMS calculation state
-#define RMS_BUFFER_SIZE 100
-static float voltage_buffer[RMS_BUFFER_SIZE];
-static int buffer_index = 0;
-static bool buffer_filled = false;
+#define RMS_BUFFER_SIZE 100      // Raw samples behind BUFFER_ANALYSIS
+#define RMS_WINDOW_TIMEOUT_MS 500
+
+// Default telemetry format and cadence - the beacon and events with no subscriber
+static telemetry_format_t telemetry_format = TELEMETRY_FORMAT_TEXT;
+static uint32_t telemetry_interval_ms = TELEMETRY_DEFAULT_INTERVAL_MS;
+static uint32_t frame_sequence = 0;
+static telemetry_calibration_t last_sent_calibration;
+static telemetry_auto_cal_t last_sent_auto_cal;
+
+// Streaming mode - readings batched into preallocated frames
+#define STREAM_BUFFER_COUNT 2
+#define STREAM_MAX_FLUSH_MS 5000
+#define STREAM_MAX_CYCLES_PER_RECORD 30
+#define STREAM_FRAME_SIZE (sizeof(telemetry_header_t) + sizeof(telemetry_batch_header_t) + \
+                           TELEMETRY_MAX_BATCH_RECORDS * sizeof(telemetry_batch_record_t))
+
+typedef struct {
+    uint8_t frame[STREAM_FRAME_SIZE];   // Header space reserved in front of the batch
+    uint16_t record_count;
+    volatile bool in_flight;            // Owned by the stream task until sent
+} stream_buffer_t;
+
+static stream_buffer_t stream_buffers[STREAM_BUFFER_COUNT];
+static int stream_active_buffer = 0;
+static QueueHandle_t stream_queue = NULL;
+static StaticQueue_t stream_queue_storage;
+static uint8_t stream_queue_items[STREAM_BUFFER_COUNT * sizeof(int)];
+static volatile bool streaming_enabled = false;
+// Batch settings, changed by STREAM while the sampler keeps filling batches: both
+// sides hold the lock, and the sampler takes one consistent copy per cycle
+static portMUX_TYPE stream_config_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool stream_reset_pending = false;
+static uint16_t stream_batch_size = 60;
+static uint32_t stream_flush_ms = 1000;
+static uint8_t stream_cycles_per_record = 1;
+static float stream_sum_squared = 0.0f;
+static uint8_t stream_cycle_count = 0;
+static uint32_t stream_batches_sent = 0;
+static uint32_t stream_records_dropped = 0;
 
 // Auto-calibration integration
 static uint32_t measurement_count = 0;
-static float last_measured_vrms = 0.0f;
 
-// Statistics for monitoring
-static uint32_t total_measurements = 0;
-static float min_current = 999999.0f;
-static float max_current = 0.0f;
-static float accumulated_current = 0.0f;
+// Latest window result, a one-slot queue so readers on other tasks never see a torn
+// value: written with xQueueOverwrite, read with xQueuePeek
+typedef struct {
+    float current_amps;
+    float vrms;
+} latest_measurement_t;
+static QueueHandle_t measurement_mailbox = NULL;
+
+// Statistics for monitoring - added to by the sender task, read and reset by the
+// receiver, so every access holds the lock
+static rolling_stats_t measurement_stats;  // Cumulative since the last reset
+static portMUX_TYPE measurement_stats_lock = portMUX_INITIALIZER_UNLOCKED;
 
-void udp_sender_init(const char* target_ip) {
-    ESP_LOGI(TAG, "Initializing UDP sender to %s:%d", target_ip, UDP_SEND_PORT);
+void udp_sender_init(const char* discovery_ip) {
+    ESP_LOGI(TAG, "Initializing UDP sender, discovery beacon to %s:%d", discovery_ip, UDP_SEND_PORT);
     
-    // ADC is already initialized in main.c, just verify it exists
-    if (adc1_handle == NULL) {
-        ESP_LOGE(TAG, "ADC handle is NULL - ADC must be initialized before UDP sender");
+    // ADC sampler is started in main.c, just verify it is running
+    if (!adc_sampler_is_running()) {
+        ESP_LOGE(TAG, "ADC sampler not running - ADC must be initialized before UDP sender");
         return;
     }
     
-    ESP_LOGI(TAG, "Using existing ADC handle");
+    ESP_LOGI(TAG, "Using continuous ADC sampler");
     
     // Initialize UDP socket
     udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
@@ -52,88 +122,65 @@ void udp_sender_init(const char* target_ip) {
         return;
     }
     
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port = htons(UDP_SEND_PORT);
-    inet_pton(AF_INET, target_ip, &dest_addr.sin_addr.s_addr);
+    discovery_addr.sin_family = AF_INET;
+    discovery_addr.sin_port = htons(UDP_SEND_PORT);
+    inet_pton(AF_INET, discovery_ip, &discovery_addr.sin_addr.s_addr);
     
     ESP_LOGI(TAG, "UDP sender initialized successfully");
     
+    if (measurement_mailbox == NULL) {
+        measurement_mailbox = xQueueCreate(1, sizeof(latest_measurement_t));
+    }
+    
     // Initialize statistics
-    total_measurements = 0;
-    min_current = 999999.0f;
-    max_current = 0.0f;
-    accumulated_current = 0.0f;
+    rolling_stats_init(&measurement_stats, NULL, 0);
     measurement_count = 0;
 }
 
+static void copy_measurement_stats(rolling_stats_t* copy) {
+    portENTER_CRITICAL(&measurement_stats_lock);
+    *copy = measurement_stats;
+    portEXIT_CRITICAL(&measurement_stats_lock);
+}
+
 float measure_rms_current(void) {
-    // Fill buffer with ADC readings for RMS calculation
-    float voltage_sum_squared = 0.0f;
-    int valid_samples = 0;
-    
-    for (int i = 0; i < RMS_BUFFER_SIZE; i++) {
-        int adc_value = 0;
-        esp_err_t ret = adc_oneshot_read(adc1_handle, ADC_CHANNEL, &adc_value);
-        
-        if (ret == ESP_OK) {
-            // Convert ADC reading to voltage
-            float voltage = ((float)adc_value / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
-            
-            // Remove DC bias to get AC component
-            float ac_voltage = voltage - get_bias_voltage();
-            
-            // Store in buffer for potential analysis
-            voltage_buffer[buffer_index] = ac_voltage;
-            buffer_index = (buffer_index + 1) % RMS_BUFFER_SIZE;
-            
-            if (buffer_index == 0) {
-                buffer_filled = true;
-            }
-            
-            // Accumulate for RMS
-            voltage_sum_squared += ac_voltage * ac_voltage;
-            valid_samples++;
-        }
-        
-        // Small delay for proper AC sampling (aim for ~50-60Hz sampling rate)
-        vTaskDelay(pdMS_TO_TICKS(2));
-    }
-    
-    if (valid_samples == 0) {
-        ESP_LOGW(TAG, "No valid ADC samples obtained");
+    // RMS is computed by the RMS engine over whole mains cycles; wait for a fresh window
+    rms_window_t window;
+    if (!rms_engine_wait_window(&window, RMS_WINDOW_TIMEOUT_MS)) {
+        ESP_LOGW(TAG, "No RMS window available from ADC sampler");
         return 0.0f;
     }
     
-    // Calculate RMS voltage
-    float voltage_rms = sqrtf(voltage_sum_squared / valid_samples);
-    last_measured_vrms = voltage_rms;
+    // Timed from here: the wait above is cadence, not cost
+    PERF_BEGIN(PERF_PROBE_MEASURE_RMS);
+    float voltage_rms = window.vrms;
     
-    // Convert to current using calibrated scale factor
-    float current_amps = voltage_rms * get_amps_per_volt();
+    // Convert with the scale that belongs to the bias the window was computed with
+    float current_amps = voltage_rms * window.amps_per_volt;
+    if (measurement_mailbox) {
+        latest_measurement_t latest = { .current_amps = current_amps, .vrms = voltage_rms };
+        xQueueOverwrite(measurement_mailbox, &latest);
+    }
     
     // Update statistics
-    total_measurements++;
-    if (current_amps < min_current) min_current = current_amps;
-    if (current_amps > max_current) max_current = current_amps;
-    accumulated_current += current_amps;
+    portENTER_CRITICAL(&measurement_stats_lock);
+    rolling_stats_add(&measurement_stats, current_amps);
     measurement_count++;
+    portEXIT_CRITICAL(&measurement_stats_lock);
     
-    // Auto-calibration integration - process this measurement
-    if (get_auto_calibration_enabled()) {
+    // Every window refreshes the detected load; auto-calibration runs off load events
+    if (get_auto_detection_enabled()) {
         process_current_for_auto_calibration(current_amps);
     }
     
-    // Periodic auto-detection (every 50 measurements)
-    if (get_auto_detection_enabled() && (measurement_count % 50 == 0)) {
-        auto_detect_load_current();
-    }
-    
 #if ENABLE_LOGGING
     // Log detailed information every 100 measurements
     if (measurement_count % 100 == 0) {
-        float avg_current = accumulated_current / total_measurements;
+        rolling_stats_t stats;
+        copy_measurement_stats(&stats);
         ESP_LOGI(TAG, "Stats - Count: %lu, Current: %.3fA, Avg: %.3fA, Min: %.3fA, Max: %.3fA", 
-                 total_measurements, current_amps, avg_current, min_current, max_current);
+                 rolling_stats_count(&stats), current_amps, rolling_stats_mean(&stats),
+                 rolling_stats_min(&stats), rolling_stats_max(&stats));
         
         // Auto-calibration status
         if (get_auto_calibration_enabled()) {
@@ -144,92 +191,775 @@ float measure_rms_current(void) {
     }
 #endif
     
+    PERF_END(PERF_PROBE_MEASURE_RMS);
     return current_amps;
 }
 
 float get_last_measured_vrms(void) {
-    return last_measured_vrms;
+    latest_measurement_t latest;
+    if (measurement_mailbox == NULL || xQueuePeek(measurement_mailbox, &latest, 0) != pdTRUE) {
+        return 0.0f;
+    }
+    return latest.vrms;
+}
+
+static inline uint32_t sender_now_ms(void) {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static inline uint32_t effective_interval(uint32_t interval_ms) {
+    return (telemetry_idle && interval_ms < TELEMETRY_IDLE_INTERVAL_MS) ? TELEMETRY_IDLE_INTERVAL_MS
+                                                                        : interval_ms;
+}
+
+static int send_to_all(const struct sockaddr_in* dests, int count, const void* data, size_t length) {
+    int delivered = 0;
+    PERF_BEGIN(PERF_PROBE_TELEMETRY_SEND);
+    for (int i = 0; i < count; i++) {
+        if (sendto(udp_socket, data, length, 0,
+                   (const struct sockaddr*)&dests[i], sizeof(dests[i])) > 0) {
+            delivered++;
+        }
+    }
+    PERF_END(PERF_PROBE_TELEMETRY_SEND);
+    return delivered;
+}
+
+// === SUBSCRIPTIONS ===
+// Callers copy what they need under the lock and send outside it
+
+static bool same_destination(const struct sockaddr_in* a, const struct sockaddr_in* b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+// Expires leases, picks the subscribers whose interval has elapsed (advancing their
+// next due time) and reports how long until the next one is due
+static int take_due_subscribers(subscriber_t* due, uint32_t now, uint32_t* wait_ms, int* live) {
+    int due_count = 0;
+    int live_count = 0;
+    int expired = 0;
+    uint32_t wait = UINT32_MAX;
+    
+    portENTER_CRITICAL(&subscriber_lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        subscriber_t* sub = &subscribers[i];
+        if (!sub->active) {
+            continue;
+        }
+        if ((int32_t)(now - sub->expires_ms) >= 0) {
+            sub->active = false;
+            expired++;
+            continue;
+        }
+        live_count++;
+        if ((int32_t)(now - sub->next_due_ms) >= 0) {
+            due[due_count++] = *sub;
+            sub->next_due_ms = now + effective_interval(sub->interval_ms);
+            sub->needs_status = false;  // Goes out with this round
+        }
+        uint32_t until_due = sub->next_due_ms - now;
+        if (until_due < wait) {
+            wait = until_due;
+        }
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+    
+    if (expired) {
+        ESP_LOGI(TAG, "%d telemetry subscription(s) expired", expired);
+    }
+    *wait_ms = wait;
+    *live = live_count;
+    return due_count;
+}
+
+// Destinations of every live subscriber
+static int copy_subscriber_addresses(struct sockaddr_in* dests) {
+    int count = 0;
+    uint32_t now = sender_now_ms();
+    
+    portENTER_CRITICAL(&subscriber_lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        const subscriber_t* sub = &subscribers[i];
+        if (sub->active && (int32_t)(now - sub->expires_ms) < 0) {
+            dests[count++] = sub->addr;
+        }
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+    return count;
+}
+
+// Every binary subscriber gets the status frames with its next measurement
+static void mark_status_changed(void) {
+    portENTER_CRITICAL(&subscriber_lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        subscribers[i].needs_status = true;
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+}
+
+// Adds or renews a lease; returns the slot, or -1 when the table is full
+static int subscribe(const struct sockaddr_in* addr, uint32_t interval_ms,
+                     telemetry_format_t format, uint32_t lease_s) {
+    uint32_t now = sender_now_ms();
+    int slot = -1;
+    bool renewed = false;
+    
+    portENTER_CRITICAL(&subscriber_lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        subscriber_t* sub = &subscribers[i];
+        bool expired = sub->active && (int32_t)(now - sub->expires_ms) >= 0;
+        if (sub->active && !expired && same_destination(&sub->addr, addr)) {
+            slot = i;
+            renewed = true;
+            break;
+        }
+        if (slot < 0 && (!sub->active || expired)) {
+            slot = i;
+        }
+    }
+    if (slot >= 0) {
+        subscriber_t* sub = &subscribers[slot];
+        if (!renewed || sub->format != format) {
+            sub->needs_status = true;
+        }
+        if (!renewed || sub->interval_ms != interval_ms) {
+            sub->next_due_ms = now;  // First reading (at the new cadence) goes out now
+        }
+        sub->addr = *addr;
+        sub->format = format;
+        sub->interval_ms = interval_ms;
+        sub->expires_ms = now + lease_s * 1000;
+        sub->active = true;
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+    
+    if (slot >= 0 && !renewed) {
+        char ip[16];
+        inet_ntoa_r(addr->sin_addr, ip, sizeof(ip));
+        ESP_LOGI(TAG, "Subscribed %s:%u every %lu ms (%s), lease %lu s", ip, ntohs(addr->sin_port),
+                 interval_ms, format == TELEMETRY_FORMAT_BINARY ? "BINARY" : "TEXT", lease_s);
+    }
+    return slot;
+}
+
+// Ends the host's subscriptions (only the one on port when non-zero); returns how many
+static int unsubscribe(const struct sockaddr_in* host, uint16_t port) {
+    int removed = 0;
+    portENTER_CRITICAL(&subscriber_lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        subscriber_t* sub = &subscribers[i];
+        if (sub->active && sub->addr.sin_addr.s_addr == host->sin_addr.s_addr &&
+            (port == 0 || sub->addr.sin_port == htons(port))) {
+            sub->active = false;
+            removed++;
+        }
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+    return removed;
+}
+
+// Legacy TELEMETRY_FORMAT / TELEMETRY_INTERVAL apply to all of the requester's leases;
+// a negative interval or format leaves that setting alone
+static int update_host_subscriptions(const struct sockaddr_in* host, int format, int64_t interval_ms) {
+    int updated = 0;
+    uint32_t now = sender_now_ms();
+    portENTER_CRITICAL(&subscriber_lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        subscriber_t* sub = &subscribers[i];
+        if (!sub->active || sub->addr.sin_addr.s_addr != host->sin_addr.s_addr) {
+            continue;
+        }
+        if (format >= 0) {
+            sub->format = (telemetry_format_t)format;
+            sub->needs_status = true;
+        }
+        if (interval_ms >= 0) {
+            sub->interval_ms = (uint32_t)interval_ms;
+            sub->next_due_ms = now;
+        }
+        updated++;
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+    return updated;
+}
+
+int udp_sender_subscriber_count(void) {
+    struct sockaddr_in dests[TELEMETRY_MAX_SUBSCRIBERS];
+    return copy_subscriber_addresses(dests);
+}
+
+size_t get_subscriber_list(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return 0;
+    
+    subscriber_t copy[TELEMETRY_MAX_SUBSCRIBERS];
+    uint32_t now = sender_now_ms();
+    int count = 0;
+    portENTER_CRITICAL(&subscriber_lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active && (int32_t)(now - subscribers[i].expires_ms) < 0) {
+            copy[count++] = subscribers[i];
+        }
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+    
+    size_t length = cmd_reply(buffer, buffer_size, "COUNT=%d,MAX=%d", count, TELEMETRY_MAX_SUBSCRIBERS);
+    for (int i = 0; i < count && length < buffer_size; i++) {
+        char ip[16];
+        inet_ntoa_r(copy[i].addr.sin_addr, ip, sizeof(ip));
+        length += cmd_reply(buffer + length, buffer_size - length, ",%s:%u/%s/%lu/%lu",
+                            ip, ntohs(copy[i].addr.sin_port),
+                            copy[i].format == TELEMETRY_FORMAT_BINARY ? "BINARY" : "TEXT",
+                            copy[i].interval_ms, (copy[i].expires_ms - now) / 1000);
+    }
+    return length;
+}
+
+// === PERIODIC TELEMETRY ===
+
+static void send_text_telemetry(const struct sockaddr_in* dests, int count,
+                                uint32_t sequence_number, uint32_t timestamp, float current_amps) {
+    // Create enhanced data packet with auto-calibration info
+    char* data_packet = net_buffer_acquire(pdMS_TO_TICKS(NET_BUFFER_WAIT_MS));
+    if (!data_packet) {
+        ESP_LOGW(TAG, "No buffer for telemetry packet %lu", sequence_number);
+        return;
+    }
+    char cal_status[128];
+    get_calibration_status(cal_status, sizeof(cal_status));
+    
+    // Include auto-calibration statistics
+    char auto_cal_info[128] = "";
+    if (get_auto_calibration_enabled()) {
+        get_auto_cal_statistics(auto_cal_info, sizeof(auto_cal_info));
+    }
+    
+    int packet_length = snprintf(data_packet, NET_BUFFER_SIZE,
+        "SEQ=%lu,TIME=%lu,CURRENT=%.6f,VOLTAGE_RMS=%.6f,POWER=%.2f,CAL_STATUS=%s,AUTO_CAL=%s",
+        sequence_number,
+        timestamp,
+        current_amps,
+        get_last_measured_vrms(),
+        current_amps * LINE_VOLTAGE_RMS,
+        cal_status,
+        auto_cal_info
+    );
+    if (packet_length >= NET_BUFFER_SIZE) {
+        packet_length = NET_BUFFER_SIZE - 1;
+    }
+    
+    if (send_to_all(dests, count, data_packet, packet_length) < count) {
+        ESP_LOGW(TAG, "Failed to send UDP packet");
+    } else if (sequence_number % 50 == 0) { // Log every 50th packet
+        ESP_LOGI(TAG, "Sent packet %lu: %.3fA, %.4fV RMS", 
+                 sequence_number, current_amps, get_last_measured_vrms());
+    }
+    net_buffer_release(data_packet);
+}
+
+static bool send_binary_frame(const struct sockaddr_in* dests, int count, uint8_t type,
+                              const void* payload, uint16_t length, uint32_t timestamp) {
+    _Static_assert(TELEMETRY_MAX_FRAME_SIZE <= NET_BUFFER_SIZE, "frames are built in network buffers");
+    if (sizeof(telemetry_header_t) + length > TELEMETRY_MAX_FRAME_SIZE) {
+        return false;
+    }
+    uint8_t* frame = (uint8_t*)net_buffer_acquire(pdMS_TO_TICKS(NET_BUFFER_WAIT_MS));
+    if (!frame) {
+        return false;
+    }
+    
+    telemetry_header_t header = {
+        .magic = TELEMETRY_MAGIC,
+        .version = TELEMETRY_VERSION,
+        .type = type,
+        .length = length,
+        .sequence = __atomic_fetch_add(&frame_sequence, 1, __ATOMIC_RELAXED),
+        .timestamp_ms = timestamp
+    };
+    
+    memcpy(frame, &header, sizeof(header));
+    memcpy(frame + sizeof(header), payload, length);
+    
+    bool sent = send_to_all(dests, count, frame, sizeof(header) + length) == count;
+    net_buffer_release((char*)frame);
+    return sent;
+}
+
+// Calibration and auto-cal state only go out when they change, or to a new subscriber
+static void refresh_status_frames(void) {
+    calibration_snapshot_t snapshot;
+    get_calibration_snapshot(&snapshot);
+    
+    telemetry_calibration_t calibration = {
+        .bias_voltage = snapshot.bias_voltage,
+        .amps_per_volt = snapshot.amps_per_volt,
+        .detected_load_amps = get_detected_load_amps(),
+#if ENABLE_CALIBRATION_LEARNING
+        .learning_points = (uint16_t)get_learning_point_count(),
+#endif
+        .auto_cal_enabled = get_auto_calibration_enabled(),
+        .auto_detect_enabled = get_auto_detection_enabled()
+    };
+    
+    auto_cal_counters_t counters;
+    get_auto_cal_counters(&counters);
+    telemetry_auto_cal_t auto_cal = {
+        .auto_cal_count = counters.auto_cal_count,
+        .successful_recognitions = counters.successful_recognitions,
+        .failed_recognitions = counters.failed_recognitions,
+        .learning_points = (uint16_t)counters.learning_points,
+        .enabled = counters.enabled,
+        .sensitivity = counters.sensitivity
+    };
+    
+    // The detected load is a live reading; only a move past the deadband is a change
+    if (fabsf(calibration.detected_load_amps - last_sent_calibration.detected_load_amps) <
+        TELEMETRY_STATUS_LOAD_DEADBAND_AMPS) {
+        calibration.detected_load_amps = last_sent_calibration.detected_load_amps;
+    }
+    
+    if (memcmp(&calibration, &last_sent_calibration, sizeof(calibration)) != 0 ||
+        memcmp(&auto_cal, &last_sent_auto_cal, sizeof(auto_cal)) != 0) {
+        last_sent_calibration = calibration;
+        last_sent_auto_cal = auto_cal;
+        mark_status_changed();
+    }
+}
+
+static void send_binary_telemetry(const struct sockaddr_in* dests, int count,
+                                  const struct sockaddr_in* status_dests, int status_count,
+                                  uint32_t sequence_number, uint32_t timestamp, float current_amps) {
+    telemetry_measurement_t measurement = {
+        .current_amps = current_amps,
+        .voltage_rms = get_last_measured_vrms(),
+        .power_watts = current_amps * LINE_VOLTAGE_RMS,
+        .flags = (get_auto_calibration_enabled() ? TELEMETRY_FLAG_AUTO_CAL : 0) |
+                 (get_auto_detection_enabled() ? TELEMETRY_FLAG_AUTO_DETECT : 0)
+    };
+    
+    if (!send_binary_frame(dests, count, TELEMETRY_FRAME_MEASUREMENT, &measurement, sizeof(measurement), timestamp)) {
+        ESP_LOGW(TAG, "Failed to send binary measurement frame");
+    } else if (sequence_number % 50 == 0) {
+        ESP_LOGI(TAG, "Sent frame %lu: %.3fA, %.4fV RMS", 
+                 sequence_number, current_amps, get_last_measured_vrms());
+    }
+    
+    if (status_count > 0) {
+        send_binary_frame(status_dests, status_count, TELEMETRY_FRAME_CALIBRATION,
+                          &last_sent_calibration, sizeof(last_sent_calibration), timestamp);
+        send_binary_frame(status_dests, status_count, TELEMETRY_FRAME_AUTO_CAL,
+                          &last_sent_auto_cal, sizeof(last_sent_auto_cal), timestamp);
+    }
+}
+
+static void send_announce(void) {
+    char announce[256];
+    size_t length = discovery_format_announce(announce, sizeof(announce));
+    if (send_to_all(&discovery_addr, 1, announce, length) < 1) {
+        ESP_LOGW(TAG, "Failed to send announce beacon");
+    }
+}
+
+bool send_telemetry_event(uint8_t frame_type, const void* payload, uint16_t length,
+                          const char* text) {
+    if (udp_socket < 0) {
+        return false;
+    }
+    
+    // Subscribers get it in their own format; with none it is broadcast like a beacon
+    subscriber_t subs[TELEMETRY_MAX_SUBSCRIBERS];
+    struct sockaddr_in binary[TELEMETRY_MAX_SUBSCRIBERS];
+    struct sockaddr_in plain[TELEMETRY_MAX_SUBSCRIBERS];
+    int binary_count = 0;
+    int text_count = 0;
+    int live = 0;
+    uint32_t now = sender_now_ms();
+    
+    portENTER_CRITICAL(&subscriber_lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].active && (int32_t)(now - subscribers[i].expires_ms) < 0) {
+            subs[live++] = subscribers[i];
+        }
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+    
+    for (int i = 0; i < live; i++) {
+        if (subs[i].format == TELEMETRY_FORMAT_BINARY) {
+            binary[binary_count++] = subs[i].addr;
+        } else {
+            plain[text_count++] = subs[i].addr;
+        }
+    }
+    if (live == 0) {
+        if (telemetry_format == TELEMETRY_FORMAT_BINARY) {
+            binary[binary_count++] = discovery_addr;
+        } else {
+            plain[text_count++] = discovery_addr;
+        }
+    }
+    
+    bool ok = true;
+    if (binary_count > 0) {
+        ok &= send_binary_frame(binary, binary_count, frame_type, payload, length, now);
+    }
+    if (text_count > 0) {
+        ok &= send_to_all(plain, text_count, text, strlen(text)) == text_count;
+    }
+    return ok;
 }
 
 void udp_sender_task(void *parameters) {
     udp_sender_running = true;
+    PERF_REGISTER_TASK();
     ESP_LOGI(TAG, "UDP sender task started with auto-calibration integration");
     
+    // Uncalibrated readings would be wrong, not just early
+    if (!startup_is_ready(STARTUP_CALIBRATION)) {
+        ESP_LOGI(TAG, "Telemetry held until calibration is ready");
+        startup_wait(STARTUP_CALIBRATION, UINT32_MAX);
+    }
+    
     uint32_t sequence_number = 0;
+    uint32_t next_announce_ms = sender_now_ms();
+    subscriber_t due[TELEMETRY_MAX_SUBSCRIBERS];
     
     while (udp_sender_running) {
-        // Measure current
+        // Measure current - every pass feeds auto-calibration, sent or not
         float current_amps = measure_rms_current();
         
         // Get current timestamp
-        uint32_t timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        uint32_t timestamp = sender_now_ms();
         
-        // Create enhanced data packet with auto-calibration info
-        char data_packet[512];
-        char cal_status[128];
-        get_calibration_status(cal_status, sizeof(cal_status));
+        refresh_status_frames();
+        uint32_t wait_ms;
+        int live;
+        int due_count = take_due_subscribers(due, timestamp, &wait_ms, &live);
         
-        // Include auto-calibration statistics
-        char auto_cal_info[128] = "";
-        if (get_auto_calibration_enabled()) {
-            get_auto_cal_statistics(auto_cal_info, sizeof(auto_cal_info));
+        struct sockaddr_in text_dests[TELEMETRY_MAX_SUBSCRIBERS];
+        struct sockaddr_in binary_dests[TELEMETRY_MAX_SUBSCRIBERS];
+        struct sockaddr_in status_dests[TELEMETRY_MAX_SUBSCRIBERS];
+        int text_count = 0, binary_count = 0, status_count = 0;
+        for (int i = 0; i < due_count; i++) {
+            if (due[i].format == TELEMETRY_FORMAT_BINARY) {
+                binary_dests[binary_count++] = due[i].addr;
+                if (due[i].needs_status) {
+                    status_dests[status_count++] = due[i].addr;
+                }
+            } else {
+                text_dests[text_count++] = due[i].addr;
+            }
         }
         
-        int packet_length = snprintf(data_packet, sizeof(data_packet),
-            "SEQ=%lu,TIME=%lu,CURRENT=%.6f,VOLTAGE_RMS=%.6f,POWER=%.2f,CAL_STATUS=%s,AUTO_CAL=%s",
-            sequence_number,
-            timestamp,
-            current_amps,
-            last_measured_vrms,
-            current_amps * 120.0f, // Assuming 120V AC for power calculation
-            cal_status,
-            auto_cal_info
-        );
-        
-        // Send UDP packet
-        int sent_bytes = sendto(udp_socket, data_packet, packet_length, 0,
-                               (struct sockaddr*)&dest_addr, sizeof(dest_addr));
-        
-        if (sent_bytes < 0) {
-            ESP_LOGW(TAG, "Failed to send UDP packet");
-        } else if (sequence_number % 50 == 0) { // Log every 50th packet
-            ESP_LOGI(TAG, "Sent packet %lu: %.3fA, %.4fV RMS", 
-                     sequence_number, current_amps, last_measured_vrms);
+        // Announce beacon so dashboards can find the plug - slower once someone subscribed
+        uint32_t announce_interval = live ? TELEMETRY_ANNOUNCE_INTERVAL_MS : TELEMETRY_DISCOVERY_INTERVAL_MS;
+        if ((int32_t)(next_announce_ms - timestamp) > (int32_t)announce_interval) {
+            next_announce_ms = timestamp + announce_interval;  // Last lease just ended
+        }
+        if ((int32_t)(timestamp - next_announce_ms) >= 0) {
+            send_announce();
+            next_announce_ms = timestamp + announce_interval;
+        }
+        if (next_announce_ms - timestamp < wait_ms) {
+            wait_ms = next_announce_ms - timestamp;
         }
         
-        sequence_number++;
+        if (text_count > 0) {
+            send_text_telemetry(text_dests, text_count, sequence_number, timestamp, current_amps);
+        }
+        if (binary_count > 0) {
+            send_binary_telemetry(binary_dests, binary_count, status_dests, status_count,
+                                  sequence_number, timestamp, current_amps);
+        }
+        if (text_count > 0 || binary_count > 0) {
+            sequence_number++;
+        }
         
-        // Wait before next measurement (2 seconds by default)
-        vTaskDelay(pdMS_TO_TICKS(2000));
+        // Sleep until the next subscriber is due, measuring at least at the default
+        // cadence (the heartbeat while idle); a wake from idle cuts it short
+        uint32_t cadence_ms = effective_interval(telemetry_interval_ms);
+        if (wait_ms > cadence_ms) {
+            wait_ms = cadence_ms;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms ? wait_ms : 1));
     }
     
     ESP_LOGI(TAG, "UDP sender task ended");
     vTaskDelete(NULL);
 }
 
-void start_udp_sender(const char* target_ip) {
+static inline telemetry_batch_header_t* stream_batch_header(stream_buffer_t* buffer) {
+    return (telemetry_batch_header_t*)(buffer->frame + sizeof(telemetry_header_t));
+}
+
+static inline telemetry_batch_record_t* stream_records(stream_buffer_t* buffer) {
+    return (telemetry_batch_record_t*)(buffer->frame + sizeof(telemetry_header_t) +
+                                       sizeof(telemetry_batch_header_t));
+}
+
+// Runs in the ADC sampler task once per mains cycle - only touches preallocated buffers
+static void stream_cycle_callback(const rms_cycle_t* cycle, void* context) {
+    if (!streaming_enabled || !startup_is_ready(STARTUP_CALIBRATION)) {
+        return;
+    }
+    
+    portENTER_CRITICAL(&stream_config_lock);
+    bool reset = stream_reset_pending;
+    stream_reset_pending = false;
+    uint16_t batch_size = stream_batch_size;
+    uint32_t flush_ms = stream_flush_ms;
+    uint8_t cycles_per_record = stream_cycles_per_record;
+    portEXIT_CRITICAL(&stream_config_lock);
+    
+    if (reset) {
+        stream_sum_squared = 0.0f;
+        stream_cycle_count = 0;
+        for (int i = 0; i < STREAM_BUFFER_COUNT; i++) {
+            if (!stream_buffers[i].in_flight) {
+                stream_buffers[i].record_count = 0;
+            }
+        }
+    }
+    
+    // Cycles of equal length combine exactly through their mean square; each cycle
+    // is scaled with its own calibration generation
+    float cycle_current = cycle->vrms * cycle->amps_per_volt;
+    stream_sum_squared += cycle_current * cycle_current;
+    if (++stream_cycle_count < cycles_per_record) {
+        return;
+    }
+    
+    float current_amps = sqrtf(stream_sum_squared / stream_cycle_count);
+    uint32_t first_cycle = cycle->index + 1 - stream_cycle_count;
+    stream_sum_squared = 0.0f;
+    stream_cycle_count = 0;
+    
+    stream_buffer_t* buffer = &stream_buffers[stream_active_buffer];
+    if (buffer->in_flight) {
+        stream_records_dropped++;  // Network side has not caught up
+        return;
+    }
+    
+    uint32_t timestamp_ms = (uint32_t)(cycle->timestamp_us / 1000);
+    telemetry_batch_header_t* batch = stream_batch_header(buffer);
+    
+    if (buffer->record_count == 0) {
+        batch->base_timestamp_ms = timestamp_ms;
+        batch->first_cycle = first_cycle;
+        batch->cycles_per_record = cycles_per_record;
+        batch->reserved = 0;
+    }
+    
+    uint32_t offset_ms = timestamp_ms - batch->base_timestamp_ms;
+    telemetry_batch_record_t* record = &stream_records(buffer)[buffer->record_count++];
+    record->offset_ms = (uint16_t)offset_ms;
+    record->current_amps = current_amps;
+    
+    if (buffer->record_count < batch_size && offset_ms < flush_ms) {
+        return;
+    }
+    
+    // Hand the full buffer to the stream task and continue in the other one
+    batch->record_count = buffer->record_count;
+    buffer->in_flight = true;
+    int index = stream_active_buffer;
+    if (xQueueSend(stream_queue, &index, 0) != pdTRUE) {
+        stream_records_dropped += buffer->record_count;
+        buffer->record_count = 0;
+        buffer->in_flight = false;
+        return;
+    }
+    stream_active_buffer = (stream_active_buffer + 1) % STREAM_BUFFER_COUNT;
+}
+
+static void udp_stream_task(void *parameters) {
+    PERF_REGISTER_TASK();
+    ESP_LOGI(TAG, "UDP stream task started");
+    
+    int index;
+    while (1) {
+        if (xQueueReceive(stream_queue, &index, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        
+        stream_buffer_t* buffer = &stream_buffers[index];
+        uint16_t payload_length = sizeof(telemetry_batch_header_t) +
+                                  buffer->record_count * sizeof(telemetry_batch_record_t);
+        
+        telemetry_header_t header = {
+            .magic = TELEMETRY_MAGIC,
+            .version = TELEMETRY_VERSION,
+            .type = TELEMETRY_FRAME_BATCH,
+            .length = payload_length,
+            .sequence = __atomic_fetch_add(&frame_sequence, 1, __ATOMIC_RELAXED),
+            .timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS
+        };
+        memcpy(buffer->frame, &header, sizeof(header));
+        
+        // Sent straight from the batch buffer - no copy of the records. Streams only go
+        // to subscribers; the broadcast beacon never carries them
+        struct sockaddr_in dests[TELEMETRY_MAX_SUBSCRIBERS];
+        int count = copy_subscriber_addresses(dests);
+        if (count == 0) {
+            stream_records_dropped += buffer->record_count;
+        } else if (send_to_all(dests, count, buffer->frame, sizeof(header) + payload_length) == 0) {
+            ESP_LOGW(TAG, "Failed to send stream batch");
+        } else {
+            stream_batches_sent++;
+        }
+        
+        buffer->record_count = 0;
+        buffer->in_flight = false;
+    }
+}
+
+// === TELEMETRY AND STREAMING COMMANDS ===
+static bool parse_telemetry_format(const char* name, telemetry_format_t* format) {
+    if (strcmp(name, "BINARY") == 0) {
+        *format = TELEMETRY_FORMAT_BINARY;
+    } else if (strcmp(name, "TEXT") == 0) {
+        *format = TELEMETRY_FORMAT_TEXT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Sets the default, and the format of any subscription the requester holds
+CMD_HANDLER(cmd_telemetry_format) {
+    telemetry_format_t format;
+    if (!parse_telemetry_format(args->values[0].s, &format)) {
+        return cmd_reply(response, response_size, "TELEMETRY_FORMAT:ERROR,UNKNOWN_FORMAT");
+    }
+    set_telemetry_format(format);
+    int updated = update_host_subscriptions(ctx->client_addr, format, -1);
+    return cmd_reply(response, response_size, "TELEMETRY_FORMAT:SUCCESS,FORMAT=%s,VERSION=%d,SUBSCRIPTIONS=%d",
+                     format == TELEMETRY_FORMAT_BINARY ? "BINARY" : "TEXT",
+                     TELEMETRY_VERSION, updated);
+}
+
+CMD_HANDLER(cmd_telemetry_interval) {
+    uint32_t interval = args->values[0].u;
+    if (!set_telemetry_interval(interval)) {
+        return cmd_reply(response, response_size, "TELEMETRY_INTERVAL:ERROR,INVALID_RANGE");
+    }
+    int updated = update_host_subscriptions(ctx->client_addr, -1, interval);
+    return cmd_reply(response, response_size, "TELEMETRY_INTERVAL:SUCCESS,VALUE=%lu,SUBSCRIPTIONS=%d",
+                     interval, updated);
+}
+
+// SUBSCRIBE:port,interval_ms,format[,lease_s] - telemetry to the requester's address;
+// port 0 is the port the command came from, interval 0 the default cadence.
+// Repeating it renews the lease
+CMD_HANDLER(cmd_subscribe) {
+    uint32_t port = args->values[0].u;
+    uint32_t interval = args->values[1].u ? args->values[1].u : telemetry_interval_ms;
+    uint32_t lease_s = (args->count > 3) ? args->values[3].u : TELEMETRY_LEASE_DEFAULT_S;
+    telemetry_format_t format;
+    
+    if (!parse_telemetry_format(args->values[2].s, &format)) {
+        return cmd_reply(response, response_size, "SUBSCRIBE:ERROR,UNKNOWN_FORMAT");
+    }
+    if (port > UINT16_MAX || interval < TELEMETRY_MIN_INTERVAL_MS || interval > 60000 ||
+        lease_s == 0 || lease_s > TELEMETRY_LEASE_MAX_S) {
+        return cmd_reply(response, response_size, "SUBSCRIBE:ERROR,INVALID_RANGE");
+    }
+    
+    struct sockaddr_in addr = *ctx->client_addr;
+    if (port != 0) {
+        addr.sin_port = htons(port);
+    }
+    int slot = subscribe(&addr, interval, format, lease_s);
+    if (slot < 0) {
+        return cmd_reply(response, response_size, "SUBSCRIBE:ERROR,TABLE_FULL,MAX=%d",
+                         TELEMETRY_MAX_SUBSCRIBERS);
+    }
+    return cmd_reply(response, response_size,
+                     "SUBSCRIBE:SUCCESS,SLOT=%d,PORT=%u,INTERVAL=%lu,FORMAT=%s,LEASE_S=%lu",
+                     slot, ntohs(addr.sin_port), interval,
+                     format == TELEMETRY_FORMAT_BINARY ? "BINARY" : "TEXT", lease_s);
+}
+
+// UNSUBSCRIBE[:port] - all of the requester's subscriptions, or the one on port
+CMD_HANDLER(cmd_unsubscribe) {
+    uint32_t port = (args->count > 0) ? args->values[0].u : 0;
+    if (port > UINT16_MAX) {
+        return cmd_reply(response, response_size, "UNSUBSCRIBE:ERROR,INVALID_RANGE");
+    }
+    int removed = unsubscribe(ctx->client_addr, port);
+    return cmd_reply(response, response_size, "UNSUBSCRIBE:SUCCESS,REMOVED=%d", removed);
+}
+
+CMD_HANDLER(cmd_subscribers) {
+    size_t length = cmd_reply(response, response_size, "SUBSCRIBERS:");
+    return length + get_subscriber_list(response + length, response_size - length);
+}
+
+// STREAM:batch_size,flush_ms[,cycles_per_record]
+CMD_HANDLER(cmd_stream) {
+    uint32_t batch_size = args->values[0].u;
+    uint32_t flush_ms = args->values[1].u;
+    uint32_t cycles_per_record = (args->count > 2) ? args->values[2].u : 1;
+    
+    if (batch_size == 0 || batch_size > UINT16_MAX || flush_ms == 0 ||
+        cycles_per_record == 0 || cycles_per_record > UINT8_MAX ||
+        !start_streaming(batch_size, flush_ms, cycles_per_record)) {
+        return cmd_reply(response, response_size, "STREAM:ERROR,INVALID_PARAMETERS");
+    }
+    return cmd_reply(response, response_size,
+                     "STREAM:SUCCESS,BATCH=%lu,FLUSH_MS=%lu,CYCLES_PER_RECORD=%lu",
+                     batch_size, flush_ms, cycles_per_record);
+}
+
+CMD_HANDLER(cmd_stream_off) {
+    stop_streaming();
+    return cmd_reply(response, response_size, "STREAM_OFF:SUCCESS");
+}
+
+CMD_HANDLER(cmd_stream_status) {
+    size_t length = cmd_reply(response, response_size, "STREAM_STATUS:");
+    get_streaming_status(response + length, response_size - length);
+    return length + strlen(response + length);
+}
+
+static const command_def_t telemetry_commands[] = {
+    { "TELEMETRY_FORMAT",   "s",   cmd_telemetry_format },
+    { "TELEMETRY_INTERVAL", "u",   cmd_telemetry_interval },
+    { "SUBSCRIBE",          "uus?u", cmd_subscribe },
+    { "UNSUBSCRIBE",        "?u",  cmd_unsubscribe },
+    { "SUBSCRIBERS",        NULL,  cmd_subscribers },
+    { "STREAM",             "uu?u", cmd_stream },
+    { "STREAM_OFF",         NULL,  cmd_stream_off },
+    { "STREAM_STATUS",      NULL,  cmd_stream_status },
+};
+
+void start_udp_sender(const char* discovery_ip) {
     if (udp_sender_running) {
         ESP_LOGW(TAG, "UDP sender already running");
         return;
     }
     
-    udp_sender_init(target_ip);
+    udp_sender_init(discovery_ip);
+    command_register_table(telemetry_commands, sizeof(telemetry_commands) / sizeof(telemetry_commands[0]));
     
     // Create UDP sender task with higher priority for better timing
-    BaseType_t result = xTaskCreate(
-        udp_sender_task,
-        "udp_sender",
-        8192,  // Increased stack size for auto-calibration
-        NULL,
-        5,     // Higher priority
-        NULL
-    );
-    
-    if (result != pdPASS) {
+    sender_task_handle = static_task_start(&sender_task, udp_sender_task, "udp_sender", NULL,
+                                           UDP_SENDER_TASK_PRIORITY, NETWORK_CORE);
+    if (!sender_task_handle) {
         ESP_LOGE(TAG, "Failed to create UDP sender task");
     } else {
         ESP_LOGI(TAG, "UDP sender task created successfully");
     }
+    
+    // Streaming path is idle until enabled with the STREAM command
+    if (stream_queue == NULL) {
+        stream_queue = xQueueCreateStatic(STREAM_BUFFER_COUNT, sizeof(int),
+                                          stream_queue_items, &stream_queue_storage);
+        if (stream_queue == NULL ||
+            !static_task_start(&stream_task, udp_stream_task, "udp_stream", NULL,
+                               UDP_STREAM_TASK_PRIORITY, NETWORK_CORE) ||
+            rms_engine_subscribe_cycles(stream_cycle_callback, NULL) < 0) {
+            ESP_LOGE(TAG, "Failed to set up streaming mode");
+        }
+    }
 }
 
 void stop_udp_sender(void) {
@@ -242,12 +972,6 @@ void stop_udp_sender(void) {
             close(udp_socket);
             udp_socket = -1;
         }
-        
-        // Clean up ADC
-        if (adc1_handle) {
-            adc_oneshot_del_unit(adc1_handle);
-            adc1_handle = NULL;
-        }
     }
 }
 
@@ -255,78 +979,150 @@ bool is_udp_sender_running(void) {
     return udp_sender_running;
 }
 
+void set_telemetry_format(telemetry_format_t format) {
+    telemetry_format = format;
+    ESP_LOGI(TAG, "Default telemetry format set to %s", 
+             format == TELEMETRY_FORMAT_BINARY ? "BINARY" : "TEXT");
+}
+
+telemetry_format_t get_telemetry_format(void) {
+    return telemetry_format;
+}
+
+bool set_telemetry_interval(uint32_t interval_ms) {
+    if (interval_ms < TELEMETRY_MIN_INTERVAL_MS || interval_ms > 60000) {
+        return false;
+    }
+    
+    telemetry_interval_ms = interval_ms;
+    ESP_LOGI(TAG, "Default telemetry interval set to %lu ms", interval_ms);
+    return true;
+}
+
+uint32_t get_telemetry_interval(void) {
+    return telemetry_interval_ms;
+}
+
+void udp_sender_set_idle(bool idle) {
+    telemetry_idle = idle;
+    if (idle) {
+        return;  // Each subscriber stretches from its next send on
+    }
+    
+    // The new load goes out now rather than at the end of a heartbeat
+    uint32_t now = sender_now_ms();
+    portENTER_CRITICAL(&subscriber_lock);
+    for (int i = 0; i < TELEMETRY_MAX_SUBSCRIBERS; i++) {
+        subscribers[i].next_due_ms = now;
+    }
+    portEXIT_CRITICAL(&subscriber_lock);
+    if (sender_task_handle) {
+        xTaskNotifyGive(sender_task_handle);
+    }
+}
+
+bool start_streaming(uint16_t batch_size, uint32_t flush_ms, uint8_t cycles_per_record) {
+    if (stream_queue == NULL ||
+        batch_size < 1 || batch_size > TELEMETRY_MAX_BATCH_RECORDS ||
+        flush_ms < TELEMETRY_MIN_INTERVAL_MS || flush_ms > STREAM_MAX_FLUSH_MS ||
+        cycles_per_record < 1 || cycles_per_record > STREAM_MAX_CYCLES_PER_RECORD) {
+        return false;
+    }
+    
+    // Takes effect on the next cycle, which drops any partial batch first
+    portENTER_CRITICAL(&stream_config_lock);
+    stream_batch_size = batch_size;
+    stream_flush_ms = flush_ms;
+    stream_cycles_per_record = cycles_per_record;
+    stream_reset_pending = true;
+    portEXIT_CRITICAL(&stream_config_lock);
+    streaming_enabled = true;
+    
+    ESP_LOGI(TAG, "Streaming enabled: batch=%u, flush=%lums, cycles/record=%u",
+             batch_size, flush_ms, cycles_per_record);
+    return true;
+}
+
+void stop_streaming(void) {
+    streaming_enabled = false;
+    ESP_LOGI(TAG, "Streaming disabled");
+}
+
+bool is_streaming_enabled(void) {
+    return streaming_enabled;
+}
+
+void get_streaming_status(char* buffer, size_t buffer_size) {
+    if (!buffer || buffer_size == 0) return;
+    
+    portENTER_CRITICAL(&stream_config_lock);
+    uint16_t batch_size = stream_batch_size;
+    uint32_t flush_ms = stream_flush_ms;
+    uint8_t cycles_per_record = stream_cycles_per_record;
+    portEXIT_CRITICAL(&stream_config_lock);
+    
+    snprintf(buffer, buffer_size,
+             "ENABLED=%s,BATCH=%u,FLUSH_MS=%lu,CYCLES_PER_RECORD=%u,SENT=%lu,DROPPED=%lu",
+             streaming_enabled ? "YES" : "NO",
+             batch_size, flush_ms, cycles_per_record,
+             stream_batches_sent, stream_records_dropped);
+}
+
 // Enhanced diagnostic functions with auto-calibration integration
 void get_measurement_statistics(char* buffer, size_t buffer_size) {
     if (!buffer || buffer_size == 0) return;
     
-    float avg_current = (total_measurements > 0) ? accumulated_current / total_measurements : 0.0f;
-    
+    rolling_stats_t stats;
+    copy_measurement_stats(&stats);
     snprintf(buffer, buffer_size,
-             "MEASUREMENTS=%lu,AVG_CURRENT=%.3f,MIN_CURRENT=%.3f,MAX_CURRENT=%.3f,LAST_VRMS=%.6f",
-             total_measurements, avg_current, min_current, max_current, last_measured_vrms);
+             "MEASUREMENTS=%lu,AVG_CURRENT=%.3f,MIN_CURRENT=%.3f,MAX_CURRENT=%.3f,STD_DEV=%.4f,LAST_VRMS=%.6f",
+             rolling_stats_count(&stats),
+             rolling_stats_mean(&stats),
+             rolling_stats_min(&stats),
+             rolling_stats_max(&stats),
+             rolling_stats_stddev(&stats),
+             get_last_measured_vrms());
 }
 
 void reset_measurement_statistics(void) {
-    total_measurements = 0;
-    min_current = 999999.0f;
-    max_current = 0.0f;
-    accumulated_current = 0.0f;
+    portENTER_CRITICAL(&measurement_stats_lock);
+    rolling_stats_reset(&measurement_stats);
     measurement_count = 0;
+    portEXIT_CRITICAL(&measurement_stats_lock);
     ESP_LOGI(TAG, "Measurement statistics reset");
 }
 
 // Advanced diagnostic function for buffer analysis
 void analyze_voltage_buffer(char* buffer, size_t buffer_size) {
-    if (!buffer || buffer_size == 0 || !buffer_filled) {
-        if (buffer && buffer_size > 0) {
-            snprintf(buffer, buffer_size, "BUFFER_ANALYSIS=NOT_READY");
-        }
+    if (!buffer || buffer_size == 0) return;
+    
+    // Computed on request from the most recent raw samples, bias removed
+    uint16_t raw_samples[RMS_BUFFER_SIZE];
+    if (adc_sampler_copy_recent(raw_samples, RMS_BUFFER_SIZE) < RMS_BUFFER_SIZE) {
+        snprintf(buffer, buffer_size, "BUFFER_ANALYSIS=NOT_READY");
         return;
     }
     
-    // Calculate buffer statistics
-    float sum = 0, sum_squared = 0;
-    float min_val = 999999.0f, max_val = -999999.0f;
-    
+    rolling_stats_t stats;
+    rolling_stats_init(&stats, NULL, 0);
+    float bias = get_bias_voltage();
     for (int i = 0; i < RMS_BUFFER_SIZE; i++) {
-        float val = voltage_buffer[i];
-        sum += val;
-        sum_squared += val * val;
-        if (val < min_val) min_val = val;
-        if (val > max_val) max_val = val;
+        float voltage = ((float)raw_samples[i] / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
+        rolling_stats_add(&stats, voltage - bias);
     }
     
-    float mean = sum / RMS_BUFFER_SIZE;
-    float variance = (sum_squared / RMS_BUFFER_SIZE) - (mean * mean);
-    float std_dev = sqrtf(variance);
-    float rms = sqrtf(sum_squared / RMS_BUFFER_SIZE);
-    
     snprintf(buffer, buffer_size,
              "BUFFER_ANALYSIS=READY,MEAN=%.6f,STD_DEV=%.6f,RMS=%.6f,MIN=%.6f,MAX=%.6f,VARIANCE=%.8f",
-             mean, std_dev, rms, min_val, max_val, variance);
-}
-
-// Function to force an auto-calibration check (useful for testing)
-void trigger_auto_calibration_check(void) {
-    if (get_auto_calibration_enabled()) {
-        float current = measure_rms_current();
-        ESP_LOGI(TAG, "Manual auto-calibration check triggered with current: %.3fA", current);
-        process_current_for_auto_calibration(current);
-    } else {
-        ESP_LOGW(TAG, "Auto-calibration is disabled");
-    }
+             rolling_stats_mean(&stats),
+             rolling_stats_stddev(&stats),
+             rolling_stats_rms(&stats),
+             rolling_stats_min(&stats),
+             rolling_stats_max(&stats),
+             rolling_stats_variance(&stats));
 }
 
 // Function to get current reading without affecting auto-calibration
 float get_instant_current_reading(void) {
-    int adc_value = 0;
-    esp_err_t ret = adc_oneshot_read(adc1_handle, ADC_CHANNEL, &adc_value);
-    
-    if (ret == ESP_OK) {
-        float voltage = ((float)adc_value / ADC_RESOLUTION) * ADC_VOLTAGE_RANGE;
-        float ac_voltage = fabsf(voltage - get_bias_voltage());
-        return ac_voltage * get_amps_per_volt();
-    }
-    
-    return 0.0f;
-}
\ No newline at end of file
+    // "Instant" is the most recent full mains cycle
+    return rms_engine_get_last_cycle_current();
+}
@@ -0,0 +1,156 @@
+#include "waveform_capture.h"
+#include "hardware_config.h"
+#include "adc_sampler.h"
+#include "telemetry_protocol.h"
+#include "command_dispatcher.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "string.h"
+#include <stdio.h>
+
+static const char *TAG = "WAVEFORM";
+
+static uint16_t capture_counter = 0;
+
+static void send_text(const char *text, int sock, struct sockaddr_in *client_addr) {
+    sendto(sock, text, strlen(text), 0, (struct sockaddr*)client_addr, sizeof(*client_addr));
+}
+
+// One chunk goes out as header + chunk header + up to two ring spans (at the wrap),
+// gathered by the stack straight from the sample ring
+static bool send_chunk(const sample_window_t *window, telemetry_waveform_chunk_t *chunk,
+                       int sock, struct sockaddr_in *client_addr) {
+    struct iovec parts[4];
+    int part_count = 2;
+    size_t sample_bytes = 0;
+    uint32_t offset = chunk->first_sample;
+    size_t remaining = chunk->sample_count;
+
+    while (remaining > 0 && part_count < 4) {
+        const uint16_t *data = NULL;
+        size_t span = adc_sampler_window_span(window, offset, remaining, &data);
+        if (span == 0) {
+            return false;
+        }
+        parts[part_count].iov_base = (void *)data;
+        parts[part_count].iov_len = span * sizeof(uint16_t);
+        part_count++;
+        sample_bytes += span * sizeof(uint16_t);
+        offset += span;
+        remaining -= span;
+    }
+
+    telemetry_header_t header = {
+        .magic = TELEMETRY_MAGIC,
+        .version = TELEMETRY_VERSION,
+        .type = TELEMETRY_FRAME_WAVEFORM,
+        .length = sizeof(*chunk) + sample_bytes,
+        .sequence = chunk->chunk_index,
+        .timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS
+    };
+
+    parts[0].iov_base = &header;
+    parts[0].iov_len = sizeof(header);
+    parts[1].iov_base = chunk;
+    parts[1].iov_len = sizeof(*chunk);
+
+    struct msghdr message = {
+        .msg_name = client_addr,
+        .msg_namelen = sizeof(*client_addr),
+        .msg_iov = parts,
+        .msg_iovlen = part_count
+    };
+
+    // Back off one tick if the stack is briefly out of buffers
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (sendmsg(sock, &message, 0) >= 0) {
+            return true;
+        }
+        vTaskDelay(1);
+    }
+    return false;
+}
+
+void perform_waveform_capture(uint32_t cycles, int sock, struct sockaddr_in *client_addr) {
+    char response[160];
+
+    if (cycles < 1 || cycles > WAVEFORM_MAX_CYCLES) {
+        snprintf(response, sizeof(response), "CAPTURE_WAVEFORM:ERROR,INVALID_CYCLES,MAX=%d",
+                 WAVEFORM_MAX_CYCLES);
+        send_text(response, sock, client_addr);
+        return;
+    }
+
+    sample_window_t window;
+    uint32_t total_samples = cycles * SAMPLES_PER_CYCLE;
+    if (!adc_sampler_freeze_window(total_samples, &window)) {
+        send_text("CAPTURE_WAVEFORM:ERROR,SAMPLES_NOT_AVAILABLE", sock, client_addr);
+        return;
+    }
+
+    uint16_t capture_id = ++capture_counter;
+    uint16_t chunk_count = (total_samples + TELEMETRY_WAVEFORM_CHUNK_SAMPLES - 1) /
+                           TELEMETRY_WAVEFORM_CHUNK_SAMPLES;
+
+    // Announce first so the client knows how many chunks to reassemble
+    snprintf(response, sizeof(response),
+             "CAPTURE_WAVEFORM:START,ID=%u,SAMPLES=%lu,CHUNKS=%u,RATE_HZ=%d,CYCLES=%lu",
+             capture_id, total_samples, chunk_count, ADC_OUTPUT_RATE_HZ, cycles);
+    send_text(response, sock, client_addr);
+
+    uint16_t sent_chunks = 0;
+    for (uint16_t i = 0; i < chunk_count; i++) {
+        uint32_t first = (uint32_t)i * TELEMETRY_WAVEFORM_CHUNK_SAMPLES;
+        uint32_t count = total_samples - first;
+        if (count > TELEMETRY_WAVEFORM_CHUNK_SAMPLES) {
+            count = TELEMETRY_WAVEFORM_CHUNK_SAMPLES;
+        }
+
+        telemetry_waveform_chunk_t chunk = {
+            .capture_id = capture_id,
+            .chunk_index = i,
+            .chunk_count = chunk_count,
+            .sample_rate_hz = ADC_OUTPUT_RATE_HZ,
+            .first_sample = first,
+            .total_samples = total_samples,
+            .block_sequence = window.first_sequence,
+            .sample_count = count,
+            .reserved = 0
+        };
+
+        if (!send_chunk(&window, &chunk, sock, client_addr)) {
+            ESP_LOGW(TAG, "Failed to send waveform chunk %u/%u", i + 1, chunk_count);
+            break;
+        }
+        sent_chunks++;
+    }
+
+    // Anything sent after the producer lapped the window may be torn
+    if (!adc_sampler_window_intact(&window)) {
+        snprintf(response, sizeof(response), "CAPTURE_WAVEFORM:ERROR,ID=%u,OVERWRITTEN", capture_id);
+    } else if (sent_chunks < chunk_count) {
+        snprintf(response, sizeof(response), "CAPTURE_WAVEFORM:ERROR,ID=%u,SENT=%u/%u",
+                 capture_id, sent_chunks, chunk_count);
+    } else {
+        snprintf(response, sizeof(response), "CAPTURE_WAVEFORM:COMPLETE,ID=%u,CHUNKS=%u",
+                 capture_id, chunk_count);
+    }
+    send_text(response, sock, client_addr);
+
+    ESP_LOGI(TAG, "Waveform capture %u: %lu samples in %u/%u chunks",
+             capture_id, total_samples, sent_chunks, chunk_count);
+}
+
+CMD_HANDLER(cmd_capture_waveform) {
+    perform_waveform_capture(args->values[0].u, ctx->sock, ctx->client_addr);
+    return 0; // Responses and chunks sent by perform_waveform_capture
+}
+
+static const command_def_t waveform_commands[] = {
+    { "CAPTURE_WAVEFORM", "u", cmd_capture_waveform },
+};
+
+void waveform_capture_register_commands(void) {
+    command_register_table(waveform_commands, sizeof(waveform_commands) / sizeof(waveform_commands[0]));
+}
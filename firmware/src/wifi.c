@@ -15,10 +15,20 @@ static esp_netif_t *ap_netif = NULL;
 static EventGroupHandle_t wifi_event_group;
 static bool ap_running = false;
 static bool wifi_initialized = false;
+static bool power_save_requested = false;  // Set by the power scheduler while idle
 
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT BIT1
 
+// Modem sleep works in station-only mode; the fallback AP keeps the radio awake
+static void apply_power_save(void) {
+    wifi_ps_type_t mode = (power_save_requested && !ap_running) ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE;
+    esp_err_t err = esp_wifi_set_ps(mode);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set WiFi power save: %s", esp_err_to_name(err));
+    }
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
@@ -29,9 +39,9 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "WiFi connected! Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
         
-        // Disable power saving after connection
-        esp_wifi_set_ps(WIFI_PS_NONE);
-        ESP_LOGI(TAG, "Disabled WiFi power saving");
+        // Power saving as the power scheduler last asked for
+        apply_power_save();
+        ESP_LOGI(TAG, "WiFi power saving %s", (power_save_requested && !ap_running) ? "on" : "off");
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
         ESP_LOGW(TAG, "Disconnected from WiFi (reason: %d)", event->reason);
@@ -157,6 +167,7 @@ void start_fallback_ap(void) {
     ESP_ERROR_CHECK(esp_wifi_start());
     
     ap_running = true;
+    apply_power_save();
     ESP_LOGI(TAG, "Fallback AP 'ESP32_SETUP' started");
     ESP_LOGI(TAG, "AP IP: 192.168.4.1, Password: esp32pass");
 }
@@ -176,9 +187,17 @@ void stop_fallback_ap(void) {
     ESP_ERROR_CHECK(esp_wifi_start());
     
     ap_running = false;
+    apply_power_save();
     ESP_LOGI(TAG, "AP stopped, switched to STA mode");
 }
 
+void wifi_set_power_save(bool enabled) {
+    power_save_requested = enabled;
+    if (wifi_initialized) {
+        apply_power_save();
+    }
+}
+
 bool connect_to_wifi(const char *ssid, const char *password) {
     if (!ssid || strlen(ssid) == 0) {
         ESP_LOGE(TAG, "Invalid SSID");
@@ -1,5 +1,6 @@
 #include "wifi_credentials_receiver.h"
 #include "wifi.h"
+#include "perf_monitor.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -15,6 +16,7 @@
 #define RX_BUFFER_SIZE 256
 
 void wifi_credentials_task(void *arg) {
+    PERF_REGISTER_TASK();
     start_fallback_ap();
     
     // Give the AP time to fully start
@@ -0,0 +1,548 @@
+// Replay benchmark for the driver-free pipeline stages (env:native).
+//
+// Every power_log_*.csv in BENCH_DATA_DIR becomes a current profile - each row's
+// power over LINE_VOLTAGE_RMS held for BENCH_CYCLES_PER_ROW cycles - synthesized into
+// 12-bit ADC samples at ADC_OUTPUT_RATE_HZ: a mains sinusoid with 3rd and 5th
+// harmonics through a sensor whose scale is off nominal, plus the bias, noise and
+// quantization. BENCH_ADC_TRACE=<file> replays a recorded trace as well: one ADC count
+// per line, optionally headed by "# amps=<true RMS current>".
+//
+// The samples are replayed as fast as the host runs them. Each stage reports ns per
+// sample (or per call), heap calls made while it ran, and its accuracy against the
+// ground truth the profile was built from. Cycles are split at the nominal
+// SAMPLES_PER_CYCLE; rms_engine's zero-crossing tracking stays on the target.
+
+#include <unity.h>
+#include <dirent.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hardware_config.h"
+#include "rms_kernel.h"
+#include "goertzel_kernel.h"
+#include "rolling_stats.h"
+#include "rls_estimator.h"
+#include "load_detector.h"
+#include "device_signature.h"
+
+#define BENCH_CYCLES_PER_ROW 60             // About the logging interval
+#define BENCH_TRUE_SCALE 204.0f             // The simulated sensor, 2% off SCT_013_THEORETICAL_SCALE
+#define BENCH_NOISE_COUNTS 0.5f             // Gaussian ADC noise after decimation, RMS
+#define BENCH_HARMONIC_3 0.10f              // Relative to the fundamental
+#define BENCH_HARMONIC_5 0.05f
+#define BENCH_MAX_ROWS 4096
+#define BENCH_MATCH_LIBRARY DEVLIB_MAX_PROFILES
+
+// === HEAP ACCOUNTING (-Wl,--wrap) ===
+
+static unsigned long heap_calls = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size) { heap_calls++; return __real_malloc(size); }
+void* __wrap_calloc(size_t count, size_t size) { heap_calls++; return __real_calloc(count, size); }
+void* __wrap_realloc(void* ptr, size_t size) { heap_calls++; return __real_realloc(ptr, size); }
+void __wrap_free(void* ptr) { heap_calls++; __real_free(ptr); }
+
+// === TIMING ===
+
+typedef struct {
+    const char* name;
+    const char* unit;
+    double ns;
+    unsigned long items;
+    unsigned long heap_calls;
+    struct timespec start;
+    unsigned long heap_start;
+} bench_stage_t;
+
+static void stage_begin(bench_stage_t* stage) {
+    stage->heap_start = heap_calls;
+    clock_gettime(CLOCK_MONOTONIC, &stage->start);
+}
+
+static void stage_end(bench_stage_t* stage, unsigned long items) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stage->ns += (end.tv_sec - stage->start.tv_sec) * 1e9 + (end.tv_nsec - stage->start.tv_nsec);
+    stage->items += items;
+    stage->heap_calls += heap_calls - stage->heap_start;
+}
+
+static void stage_report(const bench_stage_t* stage) {
+    char line[160];
+    snprintf(line, sizeof(line), "%-20s %9.1f ns/%-6s %9lu %ss, %lu heap calls",
+             stage->name, stage->items ? stage->ns / stage->items : 0.0, stage->unit,
+             stage->items, stage->unit, stage->heap_calls);
+    TEST_MESSAGE(line);
+}
+
+// === WAVEFORM ===
+
+typedef struct {
+    uint16_t* samples;
+    float* cycle_amps;          // Ground truth per cycle
+    uint32_t cycles;
+    uint32_t count;
+    float bias_voltage;
+} waveform_t;
+
+static waveform_t waveform;
+static float row_amps[BENCH_MAX_ROWS];
+static uint32_t rows = 0;
+
+static uint32_t rng_state = 0x2545F491u;
+
+static float uniform(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return (rng_state >> 8) * (1.0f / 16777216.0f);
+}
+
+static float gaussian(void) {
+    float u = uniform();
+    float v = uniform();
+    return sqrtf(-2.0f * logf(u + 1e-12f)) * cosf(2.0f * (float)M_PI * v);
+}
+
+static void load_csv(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) && rows < BENCH_MAX_ROWS) {
+        // timestamp,datetime,power_watts,notes
+        char* field = strchr(line, ',');
+        field = field ? strchr(field + 1, ',') : NULL;
+        char* end = NULL;
+        float watts = field ? strtof(field + 1, &end) : 0.0f;
+        if (field && end != field + 1 && watts >= 0.0f) {
+            row_amps[rows++] = watts / LINE_VOLTAGE_RMS;
+        }
+    }
+    fclose(file);
+}
+
+static void load_profiles(void) {
+    DIR* dir = opendir(BENCH_DATA_DIR);
+    if (!dir) {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (strncmp(entry->d_name, "power_log_", 10) == 0 && length > 4 &&
+            strcmp(entry->d_name + length - 4, ".csv") == 0) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", BENCH_DATA_DIR, entry->d_name);
+            load_csv(path);
+        }
+    }
+    closedir(dir);
+}
+
+static uint16_t quantize(float volts) {
+    float counts = volts * (ADC_RESOLUTION / ADC_VOLTAGE_RANGE) + BENCH_NOISE_COUNTS * gaussian();
+    long code = lrintf(counts);
+    return (uint16_t)(code < 0 ? 0 : (code > (long)ADC_RESOLUTION ? (long)ADC_RESOLUTION : code));
+}
+
+static bool synthesize(void) {
+    waveform.cycles = rows * BENCH_CYCLES_PER_ROW;
+    waveform.count = waveform.cycles * SAMPLES_PER_CYCLE;
+    waveform.samples = malloc(waveform.count * sizeof(uint16_t));
+    waveform.cycle_amps = malloc(waveform.cycles * sizeof(float));
+    waveform.bias_voltage = ADC_BIAS_VOLTAGE;
+    if (!waveform.samples || !waveform.cycle_amps) {
+        return false;
+    }
+
+    // Fundamental peak for a given total RMS
+    const float shape = sqrtf(1.0f + BENCH_HARMONIC_3 * BENCH_HARMONIC_3 +
+                              BENCH_HARMONIC_5 * BENCH_HARMONIC_5);
+    const float w = 2.0f * (float)M_PI * MAINS_FREQUENCY_HZ / ADC_OUTPUT_RATE_HZ;
+    uint32_t n = 0;
+    for (uint32_t cycle = 0; cycle < waveform.cycles; cycle++) {
+        float amps = row_amps[cycle / BENCH_CYCLES_PER_ROW];
+        float peak_volts = amps / BENCH_TRUE_SCALE * sqrtf(2.0f) / shape;
+        waveform.cycle_amps[cycle] = amps;
+        for (uint32_t i = 0; i < SAMPLES_PER_CYCLE; i++, n++) {
+            float phase = w * i;
+            float wave = sinf(phase) + BENCH_HARMONIC_3 * sinf(3.0f * phase) +
+                         BENCH_HARMONIC_5 * sinf(5.0f * phase);
+            waveform.samples[n] = quantize(waveform.bias_voltage + peak_volts * wave);
+        }
+    }
+    return true;
+}
+
+// === STAGES ===
+
+static float cycle_vrms[BENCH_MAX_ROWS * BENCH_CYCLES_PER_ROW];
+
+static void test_rms_kernel(void) {
+    bench_stage_t per_sample = { .name = "rms add", .unit = "sample" };
+    bench_stage_t per_block = { .name = "rms accumulate", .unit = "sample" };
+    const int32_t bias_counts = rms_kernel_bias_counts(waveform.bias_voltage);
+    rms_accumulator_t acc;
+
+    // rms_engine's path: one sample at a time, a result per cycle
+    stage_begin(&per_sample);
+    for (uint32_t cycle = 0; cycle < waveform.cycles; cycle++) {
+        const uint16_t* samples = &waveform.samples[cycle * SAMPLES_PER_CYCLE];
+        rms_kernel_reset(&acc);
+        for (uint32_t i = 0; i < SAMPLES_PER_CYCLE; i++) {
+            rms_kernel_add(&acc, rms_kernel_ac(samples[i], bias_counts));
+        }
+        cycle_vrms[cycle] = rms_kernel_vrms(&acc);
+    }
+    stage_end(&per_sample, waveform.count);
+
+    // adc_sampler's path: whole blocks
+    volatile float sink = 0.0f;
+    stage_begin(&per_block);
+    for (uint32_t cycle = 0; cycle < waveform.cycles; cycle++) {
+        rms_kernel_reset(&acc);
+        rms_kernel_accumulate(&acc, &waveform.samples[cycle * SAMPLES_PER_CYCLE],
+                              SAMPLES_PER_CYCLE, bias_counts);
+        sink += rms_kernel_vrms(&acc);
+    }
+    stage_end(&per_block, waveform.count);
+    (void)sink;
+
+    // Against the truth through the true scale, over the cycles well above the noise.
+    // At these currents the noise and quantization power is a visible share of the
+    // reading; the kernel's own error is against the truth with that power added
+    const float volts_per_count = ADC_VOLTAGE_RANGE / ADC_RESOLUTION;
+    const float noise_volts_sq = (BENCH_NOISE_COUNTS * BENCH_NOISE_COUNTS + 1.0f / 12.0f) *
+                                 volts_per_count * volts_per_count;
+    rolling_stats_t error, kernel_error;
+    rolling_stats_init(&error, NULL, 0);
+    rolling_stats_init(&kernel_error, NULL, 0);
+    for (uint32_t cycle = 0; cycle < waveform.cycles; cycle++) {
+        float truth = waveform.cycle_amps[cycle];
+        if (truth >= 2.0f * ENERGY_NOISE_FLOOR_AMPS) {
+            float truth_volts = truth / BENCH_TRUE_SCALE;
+            float expected = sqrtf(truth_volts * truth_volts + noise_volts_sq);
+            rolling_stats_add(&error, (cycle_vrms[cycle] * BENCH_TRUE_SCALE - truth) / truth);
+            rolling_stats_add(&kernel_error, (cycle_vrms[cycle] - expected) / expected);
+        }
+    }
+
+    stage_report(&per_sample);
+    stage_report(&per_block);
+    char line[160];
+    snprintf(line, sizeof(line), "rms accuracy: mean %+.2f%%, sd %.2f%% (kernel %+.2f%%) over %lu cycles",
+             100.0f * rolling_stats_mean(&error), 100.0f * rolling_stats_stddev(&error),
+             100.0f * rolling_stats_mean(&kernel_error), (unsigned long)rolling_stats_count(&error));
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(0, per_sample.heap_calls + per_block.heap_calls);
+    TEST_ASSERT_TRUE(rolling_stats_count(&error) > 0);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, rolling_stats_mean(&kernel_error));
+    TEST_ASSERT_FLOAT_WITHIN(0.10f, 0.0f, rolling_stats_mean(&error));
+}
+
+static void test_load_detector(void) {
+    bench_stage_t stage = { .name = "load detector", .unit = "cycle" };
+    load_detector_t detector;
+    load_detector_init(&detector, LOAD_EVENT_MIN_STEP_AMPS, LOAD_EVENT_CUSUM_LIMIT);
+
+    // Onset cycle of each detected change
+    static uint32_t onsets[BENCH_MAX_ROWS];
+    uint32_t changes = 0;
+    const int64_t cycle_us = 1000000 / MAINS_FREQUENCY_HZ;
+
+    stage_begin(&stage);
+    for (uint32_t cycle = 0; cycle < waveform.cycles; cycle++) {
+        load_change_t change;
+        float amps = cycle_vrms[cycle] * BENCH_TRUE_SCALE;
+        if (load_detector_feed(&detector, amps, cycle, cycle * cycle_us, &change) == LOAD_DETECT_CHANGE &&
+            changes < BENCH_MAX_ROWS) {
+            onsets[changes++] = (uint32_t)(change.onset_us / cycle_us);
+        }
+    }
+    stage_end(&stage, waveform.cycles);
+
+    // A row boundary is a true step when it is clearly above the reporting threshold,
+    // and clearly none when well below; the detector may go either way in between
+    uint32_t true_steps = 0, found = 0, spurious = 0;
+    for (uint32_t row = 1; row < rows; row++) {
+        float before = row_amps[row - 1];
+        float after = row_amps[row];
+        float threshold = load_detector_step_threshold(&detector, fminf(before, after));
+        bool step = fabsf(after - before) >= 1.5f * threshold;
+        bool quiet = fabsf(after - before) < 0.5f * threshold;
+        uint32_t boundary = row * BENCH_CYCLES_PER_ROW;
+
+        bool detected = false;
+        for (uint32_t k = 0; k < changes; k++) {
+            // Dated within a few cycles of the boundary
+            if (onsets[k] + 4 >= boundary && onsets[k] <= boundary + 4) {
+                detected = true;
+            }
+        }
+        true_steps += step;
+        found += step && detected;
+        spurious += quiet && detected;
+    }
+    // Changes dated away from every boundary
+    for (uint32_t k = 0; k < changes; k++) {
+        uint32_t offset = onsets[k] % BENCH_CYCLES_PER_ROW;
+        if (offset > 4 && offset < BENCH_CYCLES_PER_ROW - 4) {
+            spurious++;
+        }
+    }
+
+    stage_report(&stage);
+    char line[160];
+    snprintf(line, sizeof(line), "load events: %lu of %lu steps found, %lu spurious, %lu false alarms",
+             (unsigned long)found, (unsigned long)true_steps, (unsigned long)spurious,
+             (unsigned long)detector.false_alarms);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(0, stage.heap_calls);
+    TEST_ASSERT_TRUE(true_steps > 0);
+    TEST_ASSERT_TRUE(found * 10 >= true_steps * 9);
+    TEST_ASSERT_TRUE(spurious * 20 <= rows);
+}
+
+static void test_goertzel(void) {
+    bench_stage_t stage = { .name = "goertzel bank", .unit = "sample" };
+    int32_t coefficients[PQ_HARMONICS];
+    int count = 0;
+    for (int h = 1; h <= PQ_HARMONICS; h++) {
+        float w = 2.0f * (float)M_PI * h * MAINS_FREQUENCY_HZ / ADC_OUTPUT_RATE_HZ;
+        if (w < (float)M_PI) {
+            coefficients[count++] = goertzel_coefficient(w);
+        }
+    }
+
+    const int32_t bias_counts = rms_kernel_bias_counts(waveform.bias_voltage);
+    const uint32_t window = PQ_WINDOW_CYCLES * SAMPLES_PER_CYCLE;
+    rolling_stats_t h3, h5;
+    rolling_stats_init(&h3, NULL, 0);
+    rolling_stats_init(&h5, NULL, 0);
+
+    for (uint32_t start = 0; start + window <= waveform.count; start += window) {
+        int32_t s1[PQ_HARMONICS] = { 0 };
+        int32_t s2[PQ_HARMONICS] = { 0 };
+        stage_begin(&stage);
+        for (uint32_t i = 0; i < window; i++) {
+            goertzel_bank_step(s1, s2, coefficients, count,
+                               rms_kernel_ac(waveform.samples[start + i], bias_counts));
+        }
+        int64_t powers[PQ_HARMONICS];
+        for (int h = 0; h < count; h++) {
+            powers[h] = goertzel_power(coefficients[h], s1[h], s2[h]);
+        }
+        stage_end(&stage, window);
+
+        // Only windows within one row, well above the noise
+        uint32_t row = start / (BENCH_CYCLES_PER_ROW * SAMPLES_PER_CYCLE);
+        uint32_t last = (start + window - 1) / (BENCH_CYCLES_PER_ROW * SAMPLES_PER_CYCLE);
+        if (row == last && row_amps[row] >= 2.0f * ENERGY_NOISE_FLOOR_AMPS && powers[0] > 0) {
+            rolling_stats_add(&h3, sqrtf((float)powers[2] / (float)powers[0]));
+            rolling_stats_add(&h5, sqrtf((float)powers[4] / (float)powers[0]));
+        }
+    }
+
+    stage_report(&stage);
+    char line[160];
+    snprintf(line, sizeof(line), "harmonics: h3 %.4f (true %.4f), h5 %.4f (true %.4f) over %lu windows",
+             rolling_stats_mean(&h3), BENCH_HARMONIC_3, rolling_stats_mean(&h5), BENCH_HARMONIC_5,
+             (unsigned long)rolling_stats_count(&h3));
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(0, stage.heap_calls);
+    TEST_ASSERT_TRUE(rolling_stats_count(&h3) > 0);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, BENCH_HARMONIC_3, rolling_stats_mean(&h3));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, BENCH_HARMONIC_5, rolling_stats_mean(&h5));
+}
+
+static void test_rls_estimator(void) {
+    bench_stage_t stage = { .name = "rls update", .unit = "update" };
+    rls_estimator_t rls;
+    rls_init(&rls, SCT_013_THEORETICAL_SCALE, LEARNING_GAIN_PRIOR_RSD * SCT_013_THEORETICAL_SCALE,
+             0.0f, LEARNING_OFFSET_PRIOR_AMPS);
+    const float noise_variance = LEARNING_NOISE_AMPS * LEARNING_NOISE_AMPS;
+
+    // One calibration point per row: the settled level's voltage against the known
+    // current, as calibrate_to_load feeds it
+    stage_begin(&stage);
+    unsigned long updates = 0;
+    for (uint32_t row = 0; row < rows; row++) {
+        if (row_amps[row] < 2.0f * ENERGY_NOISE_FLOOR_AMPS) {
+            continue;
+        }
+        float vrms = 0.0f;
+        uint32_t first = row * BENCH_CYCLES_PER_ROW + LOAD_EVENT_SETTLE_CYCLES;
+        for (uint32_t cycle = first; cycle < (row + 1) * BENCH_CYCLES_PER_ROW; cycle++) {
+            vrms += cycle_vrms[cycle];
+        }
+        vrms /= BENCH_CYCLES_PER_ROW - LOAD_EVENT_SETTLE_CYCLES;
+        rls_update(&rls, vrms, row_amps[row], noise_variance, 1.0f);
+        updates++;
+    }
+    stage_end(&stage, updates);
+
+    float gain_error = (rls.gain - BENCH_TRUE_SCALE) / BENCH_TRUE_SCALE;
+    stage_report(&stage);
+    char line[160];
+    snprintf(line, sizeof(line), "rls: scale %.2f A/V (true %.2f, %+.2f%%), sd %.2f, offset %+.4f A",
+             rls.gain, BENCH_TRUE_SCALE, 100.0f * gain_error, rls_gain_sd(&rls), rls.offset);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(0, stage.heap_calls);
+    TEST_ASSERT_TRUE(updates >= MIN_LEARNING_POINTS);
+    // The logged loads span half an amp, so the scale is only known to a few percent:
+    // within two of its own standard deviations, and certain enough to be applied
+    TEST_ASSERT_FLOAT_WITHIN(2.0f * rls_gain_sd(&rls), BENCH_TRUE_SCALE, rls.gain);
+    TEST_ASSERT_TRUE(rls_gain_sd(&rls) <= LEARNING_MAX_GAIN_RSD * rls.gain);
+}
+
+static void test_signature_match(void) {
+    bench_stage_t stage = { .name = "signature distance", .unit = "match" };
+    static device_signature_t library[BENCH_MATCH_LIBRARY];
+    for (int i = 0; i < BENCH_MATCH_LIBRARY; i++) {
+        device_signature_init(&library[i], 0.1f + 0.1f * i);
+        library[i].inrush_ratio = 1.0f + 4.0f * uniform();
+        for (int k = 0; k < DEVLIB_HARMONIC_FEATURES; k++) {
+            library[i].harmonic_ratio[k] = 0.3f * uniform();
+        }
+        library[i].duty_cycle = uniform();
+    }
+
+    // Each library entry, perturbed within a fraction of a match scale, must come
+    // back as itself from a full scan (the worst case for the firmware's index)
+    uint32_t correct = 0;
+    stage_begin(&stage);
+    for (int i = 0; i < BENCH_MATCH_LIBRARY; i++) {
+        device_signature_t probe = library[i];
+        probe.steady_amps *= 1.0f + 0.01f * gaussian();
+        probe.inrush_ratio += 0.1f * DEVLIB_INRUSH_SCALE * gaussian();
+        float best = INFINITY;
+        int best_index = -1;
+        for (int j = 0; j < BENCH_MATCH_LIBRARY; j++) {
+            float scale = fmaxf(DEVLIB_MIN_SPREAD_AMPS, DEVLIB_RELATIVE_SPREAD * library[j].steady_amps);
+            float distance = device_signature_distance(&probe, &library[j], scale);
+            if (distance < best) {
+                best = distance;
+                best_index = j;
+            }
+        }
+        correct += (best_index == i);
+    }
+    stage_end(&stage, (unsigned long)BENCH_MATCH_LIBRARY * BENCH_MATCH_LIBRARY);
+
+    stage_report(&stage);
+    char line[96];
+    snprintf(line, sizeof(line), "signatures: %lu of %d matched", (unsigned long)correct,
+             BENCH_MATCH_LIBRARY);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(0, stage.heap_calls);
+    TEST_ASSERT_TRUE(correct * 100 >= BENCH_MATCH_LIBRARY * 95);
+}
+
+// A recorded trace, if one was given. Its bias is its mean, as the DC tracker
+// would settle
+static void test_adc_trace(void) {
+    const char* path = getenv("BENCH_ADC_TRACE");
+    if (!path) {
+        TEST_IGNORE_MESSAGE("BENCH_ADC_TRACE not set");
+    }
+    FILE* file = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL_MESSAGE(file, path);
+
+    size_t capacity = 1 << 16, count = 0;
+    uint16_t* samples = malloc(capacity * sizeof(uint16_t));
+    float truth = NAN;
+    char line[64];
+    double sum = 0.0;
+    while (samples && fgets(line, sizeof(line), file)) {
+        if (line[0] == '#') {
+            sscanf(line, "# amps=%f", &truth);
+            continue;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            samples = realloc(samples, capacity * sizeof(uint16_t));
+            if (!samples) {
+                break;
+            }
+        }
+        samples[count] = (uint16_t)strtoul(line, NULL, 10);
+        sum += samples[count++];
+    }
+    fclose(file);
+    TEST_ASSERT_NOT_NULL(samples);
+    TEST_ASSERT_TRUE(count >= SAMPLES_PER_CYCLE);
+
+    bench_stage_t stage = { .name = "trace rms+detector", .unit = "sample" };
+    const float bias_voltage = (float)(sum / count) * (ADC_VOLTAGE_RANGE / ADC_RESOLUTION);
+    const int32_t bias_counts = rms_kernel_bias_counts(bias_voltage);
+    load_detector_t detector;
+    load_detector_init(&detector, LOAD_EVENT_MIN_STEP_AMPS, LOAD_EVENT_CUSUM_LIMIT);
+    rolling_stats_t amps;
+    rolling_stats_init(&amps, NULL, 0);
+    uint32_t changes = 0;
+
+    stage_begin(&stage);
+    uint32_t cycles = count / SAMPLES_PER_CYCLE;
+    for (uint32_t cycle = 0; cycle < cycles; cycle++) {
+        rms_accumulator_t acc;
+        rms_kernel_reset(&acc);
+        rms_kernel_accumulate(&acc, &samples[cycle * SAMPLES_PER_CYCLE], SAMPLES_PER_CYCLE, bias_counts);
+        float cycle_amps = rms_kernel_vrms(&acc) * SCT_013_THEORETICAL_SCALE;
+        rolling_stats_add(&amps, cycle_amps);
+        load_change_t change;
+        changes += load_detector_feed(&detector, cycle_amps, cycle,
+                                      (int64_t)cycle * 1000000 / MAINS_FREQUENCY_HZ,
+                                      &change) == LOAD_DETECT_CHANGE;
+    }
+    stage_end(&stage, cycles * SAMPLES_PER_CYCLE);
+    free(samples);
+
+    stage_report(&stage);
+    char report[160];
+    snprintf(report, sizeof(report), "trace: %lu cycles, bias %.4f V, mean %.3f A (true %.3f), %lu changes",
+             (unsigned long)cycles, bias_voltage, rolling_stats_mean(&amps), truth,
+             (unsigned long)changes);
+    TEST_MESSAGE(report);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+int main(void) {
+    load_profiles();
+    UNITY_BEGIN();
+    if (rows < 2) {
+        TEST_MESSAGE("no power_log_*.csv in " BENCH_DATA_DIR);
+    } else if (!synthesize()) {
+        TEST_MESSAGE("no memory for the synthesized waveform");
+    } else {
+        RUN_TEST(test_rms_kernel);
+        RUN_TEST(test_load_detector);
+        RUN_TEST(test_goertzel);
+        RUN_TEST(test_rls_estimator);
+    }
+    RUN_TEST(test_signature_match);
+    RUN_TEST(test_adc_trace);
+    free(waveform.samples);
+    free(waveform.cycle_amps);
+    return UNITY_END();
+}
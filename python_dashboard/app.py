@@ -42,6 +42,7 @@ class SmartPlugApp:
             port=UDP_PORT_LISTEN,
             data_callback=self.on_data_received,
             connection_callback=self.on_connection_status_changed,
+            recorder=self.data_manager.record,
         )
 
         # GUI components
@@ -400,6 +401,9 @@ class SmartPlugApp:
         if self.udp_handler:
             self.udp_handler.stop()
 
+        # Readings still staged for the telemetry store
+        self.data_manager.flush()
+
         if self.root:
             self.root.destroy()
 
@@ -1,4 +1,14 @@
 import socket
+import struct
+
+# Waveform chunk framing (mirrors firmware/include/telemetry_protocol.h)
+FRAME_HEADER_STRUCT = struct.Struct("<HBBHII")
+WAVEFORM_CHUNK_STRUCT = struct.Struct("<HHHHIIIHH")
+FRAME_WAVEFORM = 5
+HISTORY_HEADER_STRUCT = struct.Struct("<HHHHIHH")
+HISTORY_RECORD_STRUCT = struct.Struct("<HHH")
+HISTORY_EMPTY = 0xFFFF
+FRAME_HISTORY = 7
 
 
 class ESP32Commands:
@@ -9,6 +19,7 @@ class ESP32Commands:
         self.esp_setup_ip = "192.168.4.1"
         self.esp_setup_port = 4567
         self.esp_control_port = 3334
+        self.esp_relay_port = 3335  # Relay-only channel, never queued behind diagnostics
 
     def _send_command(self, command, esp32_ip, port=None, expect_response=True):
         """Send UDP command to ESP32"""
@@ -41,10 +52,125 @@ class ESP32Commands:
             print(f"[CMD] Failed to send '{command}': {e}")
             return False
 
+    def _send_job_command(self, command, esp32_ip):
+        """Send a calibration job command and wait for its pushed completion"""
+        if not esp32_ip:
+            print("[CMD] No ESP32 IP available")
+            return False
+
+        name = command.split(":", 1)[0]
+        try:
+            with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+                s.settimeout(self.timeout)
+                s.sendto(command.encode(), (esp32_ip, self.esp_control_port))
+                print(f"[CMD] Sent '{command}' to {esp32_ip}:{self.esp_control_port}")
+
+                response = s.recvfrom(1024)[0].decode().strip()
+                print(f"[CMD] Response: {response}")
+                if not response.startswith(f"{name}:QUEUED,JOB="):
+                    return response  # Rejected, or firmware without job support
+                job_tag = f"JOB={response.rsplit('=', 1)[1]}"
+
+                # The worker replies once the measurement finishes
+                while True:
+                    result = s.recvfrom(1024)[0].decode().strip()
+                    if result.startswith(f"{name}:") and result.endswith(job_tag):
+                        print(f"[CMD] Result: {result}")
+                        return result
+
+        except socket.timeout:
+            print(f"[CMD] No result for '{command}'")
+            return None
+        except Exception as e:
+            print(f"[CMD] Failed to send '{command}': {e}")
+            return False
+
+    def get_job_status(self, job_id, esp32_ip):
+        """Progress of a queued or recently finished calibration job"""
+        return self._send_command(f"JOB_STATUS:{int(job_id)}", esp32_ip)
+
     # === BASIC COMMANDS ===
     def toggle_relay(self, esp32_ip):
         """Toggle the relay"""
-        return self._send_command("RELAY_TOGGLE", esp32_ip)
+        return self._send_command("RELAY_TOGGLE", esp32_ip, port=self.esp_relay_port)
+
+    def set_relay(self, on, esp32_ip):
+        """Switch the relay on or off"""
+        command = "RELAY_ON" if on else "RELAY_OFF"
+        return self._send_command(command, esp32_ip, port=self.esp_relay_port)
+
+    def relay_timed(self, on, duration_ms, esp32_ip, max_amps=None):
+        """Switch for duration_ms then revert; with max_amps, open early on overcurrent"""
+        command = f"RELAY_TIMED:{1 if on else 0},{int(duration_ms)}"
+        if max_amps is not None:
+            command += f",{float(max_amps)}"
+        return self._send_command(command, esp32_ip, port=self.esp_relay_port)
+
+    def get_relay_stats(self, esp32_ip):
+        """Relay state and actuation latency"""
+        return self._send_command("RELAY_STATS", esp32_ip, port=self.esp_relay_port)
+
+    # === ENERGY ACCOUNTING ===
+    def get_energy_stats(self, esp32_ip):
+        """Device-integrated energy: totals, current hour/day and bucket history"""
+        return self._send_command("ENERGY_STATS", esp32_ip)
+
+    def reset_energy(self, esp32_ip, include_lifetime=False):
+        """Clear the since-reset counter and buckets (and the lifetime total if asked)"""
+        command = "ENERGY_RESET:ALL" if include_lifetime else "ENERGY_RESET"
+        return self._send_command(command, esp32_ip)
+
+    # === OVERCURRENT PROTECTION ===
+    def get_protection_status(self, esp32_ip):
+        """Protection limits, thermal accumulator and trip count"""
+        return self._send_command("PROTECT_STATUS", esp32_ip)
+
+    def configure_protection(self, peak_amps, rated_amps, esp32_ip, i2t_limit=None):
+        """Set the peak and continuous limits (0 disables a curve)"""
+        command = f"PROTECT_CONFIG:{float(peak_amps)},{float(rated_amps)}"
+        if i2t_limit is not None:
+            command += f",{float(i2t_limit)}"
+        return self._send_command(command, esp32_ip)
+
+    def protect_for_device(self, device_index, esp32_ip):
+        """Rate the outlet for a known device profile"""
+        return self._send_command(f"PROTECT_DEVICE:{int(device_index)}", esp32_ip)
+
+    def get_protection_trips(self, esp32_ip):
+        """Recent trip records, newest first"""
+        return self._send_command("PROTECT_TRIPS", esp32_ip)
+
+    def reset_protection(self, esp32_ip):
+        """Re-arm after a trip; the relay stays open until switched on"""
+        return self._send_command("PROTECT_RESET", esp32_ip)
+
+    # === LOAD EVENTS ===
+    def get_load_events(self, esp32_ip):
+        """Load change detector state and recent events, newest first"""
+        return self._send_command("LOAD_EVENTS", esp32_ip)
+
+    def configure_load_events(self, min_step_amps, esp32_ip, cusum_limit=None):
+        """Smallest reported change and the CUSUM limit (A x cycles)"""
+        command = f"LOAD_EVENT_CONFIG:{float(min_step_amps)}"
+        if cusum_limit is not None:
+            command += f",{float(cusum_limit)}"
+        return self._send_command(command, esp32_ip)
+
+    def send_temperature(self, temperature_c, esp32_ip):
+        """Reading from an external temperature sensor for the plug's compensation"""
+        return self._send_command(f"TEMPERATURE:{float(temperature_c)}", esp32_ip)
+
+    def get_temperature_compensation(self, esp32_ip):
+        """Compensation state and the learned bias/scale per temperature bin"""
+        return self._send_command("TEMP_COMP", esp32_ip)
+
+    def set_temperature_compensation(self, enabled, esp32_ip):
+        """Enable or disable applying the learned temperature corrections"""
+        return self._send_command("TEMP_COMP_ON" if enabled else "TEMP_COMP_OFF", esp32_ip)
+
+    def reset_temperature_compensation(self, esp32_ip):
+        """Forget the learned temperature table"""
+        return self._send_command("TEMP_COMP_RESET", esp32_ip)
 
     def ping_esp32(self, esp32_ip):
         """Ping ESP32 to check connectivity"""
@@ -90,9 +216,48 @@ class ESP32Commands:
         """Try to recognize device from current consumption"""
         return self._send_command(f"RECOGNIZE_CURRENT:{current_amps}", esp32_ip)
 
+    def add_device_profile(self, min_amps, max_amps, typical_amps, name, esp32_ip):
+        """Add a custom device profile (stored on the device across reboots)"""
+        name = str(name).replace(",", " ")[:23]
+        command = f"ADD_DEVICE:{float(min_amps)},{float(max_amps)},{float(typical_amps)},{name}"
+        return self._send_command(command, esp32_ip)
+
+    def clear_device_profiles(self, esp32_ip):
+        """Remove all custom device profiles"""
+        return self._send_command("CLEAR_DEVICES", esp32_ip)
+
+    # === DEVICE SIGNATURE LIBRARY ===
+    def learn_signature(self, name, esp32_ip):
+        """Add (or refine) a signature profile from the load that is running now"""
+        name = str(name).replace(",", " ")[:15]
+        return self._send_command(f"SIGNATURE_LEARN:{name}", esp32_ip)
+
+    def add_signature(self, name, steady_amps, esp32_ip, inrush_ratio=None, duty_cycle=None):
+        """Add a signature profile from known values"""
+        name = str(name).replace(",", " ")[:15]
+        command = f"SIGNATURE_ADD:{name},{float(steady_amps)}"
+        if inrush_ratio is not None or duty_cycle is not None:
+            command += f",{float(inrush_ratio) if inrush_ratio is not None else 'nan'}"
+        if duty_cycle is not None:
+            command += f",{float(duty_cycle)}"
+        return self._send_command(command, esp32_ip)
+
+    def remove_signature(self, profile_id, esp32_ip):
+        """Remove a signature profile by id"""
+        return self._send_command(f"SIGNATURE_REMOVE:{int(profile_id)}", esp32_ip)
+
+    def list_signatures(self, esp32_ip, first_id=None):
+        """One page of signature profiles; NEXT= in the reply continues the list"""
+        command = "SIGNATURES" if first_id is None else f"SIGNATURES:{int(first_id)}"
+        return self._send_command(command, esp32_ip)
+
+    def match_signature(self, esp32_ip):
+        """Signature of the present load and its best library match"""
+        return self._send_command("SIGNATURE_MATCH", esp32_ip)
+
     def auto_recognize_current_load(self, esp32_ip):
         """Auto-recognize current load and potentially calibrate"""
-        return self._send_command("AUTO_RECOGNIZE", esp32_ip)
+        return self._send_job_command("AUTO_RECOGNIZE", esp32_ip)
 
     # === LEARNING SYSTEM ===
     def get_learning_statistics(self, esp32_ip):
@@ -115,14 +280,14 @@ class ESP32Commands:
             if value <= 0 or value > 100:
                 print(f"[CMD] Invalid calibration value: {value}")
                 return False
-            return self._send_command(f"CAL_KNOWN:{value}", esp32_ip)
+            return self._send_job_command(f"CAL_KNOWN:{value}", esp32_ip)
         except ValueError:
             print(f"[CMD] Invalid calibration format: {value_str}")
             return False
 
     def zero_calibration(self, esp32_ip):
         """Perform zero-point calibration"""
-        return self._send_command("ZERO_CAL", esp32_ip)
+        return self._send_job_command("ZERO_CAL", esp32_ip)
 
     def scale_calibration(self, current_value, esp32_ip):
         """Perform scale calibration"""
@@ -131,7 +296,7 @@ class ESP32Commands:
             if current <= 0 or current > 100:
                 print(f"[CMD] Invalid scale current: {current}")
                 return False
-            return self._send_command(f"SCALE_CAL:{current}", esp32_ip)
+            return self._send_job_command(f"SCALE_CAL:{current}", esp32_ip)
         except ValueError:
             print(f"[CMD] Invalid scale current format: {current_value}")
             return False
@@ -150,13 +315,21 @@ class ESP32Commands:
         """Reset calibration to defaults"""
         return self._send_command("RESET_CAL", esp32_ip)
 
+    def get_calibration_store(self, esp32_ip):
+        """Warm/cold boot and NVS save state of the calibration record"""
+        return self._send_command("CAL_STORE", esp32_ip)
+
+    def forget_stored_calibration(self, esp32_ip):
+        """Erase the stored calibration so the next boot measures from scratch"""
+        return self._send_command("CAL_FORGET", esp32_ip)
+
     def get_calibration_status(self, esp32_ip):
         """Get calibration status"""
         return self._send_command("CAL_STATUS", esp32_ip)
 
     def recalibrate_bias(self, esp32_ip):
         """Recalibrate bias voltage (legacy command)"""
-        return self._send_command("RECALIBRATE_BIAS", esp32_ip)
+        return self._send_job_command("RECALIBRATE_BIAS", esp32_ip)
 
     # === MEASUREMENT AND DIAGNOSTICS ===
     def get_readings(self, esp32_ip):
@@ -179,10 +352,130 @@ class ESP32Commands:
         """Get voltage buffer analysis"""
         return self._send_command("BUFFER_ANALYSIS", esp32_ip)
 
+    def capture_waveform(self, cycles, esp32_ip):
+        """Capture raw 12-bit ADC samples; returns (sample_rate_hz, samples) or None"""
+        if not esp32_ip:
+            print("[CMD] No ESP32 IP available")
+            return None
+
+        chunks = {}
+        expected = None
+        sample_rate = None
+        try:
+            with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+                s.settimeout(self.timeout)
+                s.sendto(f"CAPTURE_WAVEFORM:{int(cycles)}".encode(), (esp32_ip, self.esp_control_port))
+
+                while True:
+                    data, _ = s.recvfrom(2048)
+                    if len(data) >= FRAME_HEADER_STRUCT.size and data[0] == 0xA5:
+                        header = FRAME_HEADER_STRUCT.unpack_from(data)
+                        if header[2] != FRAME_WAVEFORM:
+                            continue
+                        chunk = WAVEFORM_CHUNK_STRUCT.unpack_from(data, FRAME_HEADER_STRUCT.size)
+                        index, count, rate, first, sample_count = (
+                            chunk[1], chunk[2], chunk[3], chunk[4], chunk[7]
+                        )
+                        start = FRAME_HEADER_STRUCT.size + WAVEFORM_CHUNK_STRUCT.size
+                        samples = struct.unpack_from(f"<{sample_count}H", data, start)
+                        chunks[index] = (first, samples)
+                        expected, sample_rate = count, rate
+                        continue
+
+                    text = data.decode(errors="replace").strip()
+                    print(f"[CMD] Response: {text}")
+                    if text.startswith("CAPTURE_WAVEFORM:START"):
+                        continue
+                    if text.startswith("CAPTURE_WAVEFORM:COMPLETE"):
+                        break
+                    return None
+
+        except socket.timeout:
+            print("[CMD] Waveform capture timed out")
+            return None
+        except Exception as e:
+            print(f"[CMD] Waveform capture failed: {e}")
+            return None
+
+        if expected is None or len(chunks) != expected:
+            print(f"[CMD] Waveform capture incomplete: {len(chunks)}/{expected} chunks")
+            return None
+
+        samples = []
+        for index in range(expected):
+            samples.extend(chunks[index][1])
+        return sample_rate, samples
+
+    def get_history(self, from_ms, to_ms, esp32_ip, resolution_s=0):
+        """Backfill from the device history rings.
+
+        Times are device uptime in ms (to_ms=0 means now). Returns a list of
+        (time_ms, min_amps, max_amps, avg_amps); gaps have None values.
+        """
+        if not esp32_ip:
+            print("[CMD] No ESP32 IP available")
+            return None
+
+        frames = {}
+        expected = None
+        command = f"HISTORY:{int(from_ms)},{int(to_ms)},{int(resolution_s)}"
+        try:
+            with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+                s.settimeout(self.timeout)
+                s.sendto(command.encode(), (esp32_ip, self.esp_control_port))
+
+                while True:
+                    data, _ = s.recvfrom(2048)
+                    if len(data) >= FRAME_HEADER_STRUCT.size and data[0] == 0xA5:
+                        header = FRAME_HEADER_STRUCT.unpack_from(data)
+                        if header[2] != FRAME_HISTORY:
+                            continue
+                        _, index, count, record_count, first_ms, resolution, _ = (
+                            HISTORY_HEADER_STRUCT.unpack_from(data, FRAME_HEADER_STRUCT.size)
+                        )
+                        start = FRAME_HEADER_STRUCT.size + HISTORY_HEADER_STRUCT.size
+                        records = []
+                        for i in range(record_count):
+                            low, high, avg = HISTORY_RECORD_STRUCT.unpack_from(
+                                data, start + i * HISTORY_RECORD_STRUCT.size
+                            )
+                            time_ms = first_ms + i * resolution * 1000
+                            if avg == HISTORY_EMPTY:
+                                records.append((time_ms, None, None, None))
+                            else:
+                                records.append((time_ms, low / 100.0, high / 100.0, avg / 100.0))
+                        frames[index] = records
+                        expected = count
+                        continue
+
+                    text = data.decode(errors="replace").strip()
+                    print(f"[CMD] Response: {text}")
+                    if text.startswith("HISTORY:START"):
+                        continue
+                    if text.startswith("HISTORY:COMPLETE"):
+                        break
+                    return None
+
+        except socket.timeout:
+            print("[CMD] History query timed out")
+            return None
+        except Exception as e:
+            print(f"[CMD] History query failed: {e}")
+            return None
+
+        if expected is None or len(frames) != expected:
+            print(f"[CMD] History incomplete: {len(frames)}/{expected} frames")
+            return None
+
+        history = []
+        for index in range(expected):
+            history.extend(frames[index])
+        return history
+
     # === AUTO-DETECTION ===
     def auto_detect_load(self, esp32_ip):
         """Auto-detect current load"""
-        return self._send_command("AUTO_DETECT", esp32_ip)
+        return self._send_job_command("AUTO_DETECT", esp32_ip)
 
     def enable_auto_detection(self, esp32_ip):
         """Enable auto-detection"""
@@ -238,6 +531,74 @@ class ESP32Commands:
             print(f"[CMD] Invalid scale factor format: {scale_factor}")
             return False
 
+    # === TELEMETRY ===
+    def set_telemetry_format(self, binary, esp32_ip):
+        """Select binary or text telemetry frames"""
+        fmt = "BINARY" if binary else "TEXT"
+        return self._send_command(f"TELEMETRY_FORMAT:{fmt}", esp32_ip)
+
+    def set_telemetry_interval(self, interval_ms, esp32_ip):
+        """Set the telemetry reporting interval in milliseconds"""
+        try:
+            interval = int(interval_ms)
+            if not (100 <= interval <= 60000):
+                print(f"[CMD] Invalid telemetry interval: {interval} (must be 100-60000ms)")
+                return False
+            return self._send_command(f"TELEMETRY_INTERVAL:{interval}", esp32_ip)
+        except ValueError:
+            print(f"[CMD] Invalid telemetry interval format: {interval_ms}")
+            return False
+
+    def discover_device(self, esp32_ip):
+        """Ask one plug for its ANNOUNCE line (device ID, firmware, capabilities)"""
+        return self._send_command("DISCOVER", esp32_ip)
+
+    # === POWER QUALITY ===
+    def get_power_quality(self, esp32_ip):
+        """Latest harmonic analysis: THD and harmonic 1-15 RMS currents"""
+        return self._send_command("PQ_STATUS", esp32_ip)
+
+    def configure_power_quality(self, interval_ms, esp32_ip, cycles=None):
+        """Analysis/publish cadence in ms (0 = off) and window length in mains cycles"""
+        try:
+            interval = int(interval_ms)
+            command = f"PQ_CONFIG:{interval}"
+            if cycles is not None:
+                command += f",{int(cycles)}"
+            return self._send_command(command, esp32_ip)
+        except ValueError:
+            print("[CMD] Invalid power quality parameters")
+            return False
+
+    def get_subscribers(self, esp32_ip):
+        """List the unicast telemetry subscriptions and their remaining leases"""
+        return self._send_command("SUBSCRIBERS", esp32_ip)
+
+    def start_streaming(self, batch_size, flush_ms, esp32_ip, cycles_per_record=1):
+        """Stream batched per-cycle readings (binary frames)"""
+        try:
+            batch = int(batch_size)
+            flush = int(flush_ms)
+            cycles = int(cycles_per_record)
+            if not (1 <= batch <= 120 and 100 <= flush <= 5000 and 1 <= cycles <= 30):
+                print(
+                    f"[CMD] Invalid stream parameters: batch={batch}, "
+                    f"flush={flush}ms, cycles={cycles}"
+                )
+                return False
+            return self._send_command(f"STREAM:{batch},{flush},{cycles}", esp32_ip)
+        except ValueError:
+            print("[CMD] Invalid stream parameter format")
+            return False
+
+    def stop_streaming(self, esp32_ip):
+        """Stop batched streaming"""
+        return self._send_command("STREAM_OFF", esp32_ip)
+
+    def get_streaming_status(self, esp32_ip):
+        """Request streaming status"""
+        return self._send_command("STREAM_STATUS", esp32_ip)
+
     # === WIFI SETUP ===
     def send_wifi_credentials(self, ssid, password):
         """Send WiFi credentials to ESP32 in setup mode"""
@@ -261,6 +622,26 @@ class ESP32Commands:
             return False
 
     # === ADVANCED DIAGNOSTICS ===
+    def get_perf_stats(self, esp32_ip):
+        """Get hot-path timing, CPU usage and stack high-water marks"""
+        return self._send_command("PERF_STATS", esp32_ip)
+
+    def reset_perf_stats(self, esp32_ip):
+        """Clear performance statistics"""
+        return self._send_command("PERF_RESET", esp32_ip)
+
+    def get_memory_stats(self, esp32_ip):
+        """Get heap, largest free block, network buffers and per-task stack use"""
+        return self._send_command("MEM_STATS", esp32_ip)
+
+    def get_power_status(self, esp32_ip):
+        """Get the power scheduler mode, idle share and wake latency"""
+        return self._send_command("POWER_STATUS", esp32_ip)
+
+    def set_power_save(self, enabled, esp32_ip):
+        """Enable adaptive power scheduling, or keep the plug always active"""
+        return self._send_command(f"POWER_SAVE:{1 if enabled else 0}", esp32_ip)
+
     def comprehensive_diagnostic(self, esp32_ip):
         """Run comprehensive diagnostic and return results"""
         print("[CMD] Running comprehensive diagnostic...")
@@ -279,6 +660,12 @@ class ESP32Commands:
         # Learning statistics
         results["learning_stats"] = self.get_learning_statistics(esp32_ip)
 
+        # Memory budget
+        results["memory_stats"] = self.get_memory_stats(esp32_ip)
+
+        # Power scheduling
+        results["power_status"] = self.get_power_status(esp32_ip)
+
         # Measurement statistics
         results["measurement_stats"] = self.get_measurement_statistics(esp32_ip)
 
@@ -340,6 +727,9 @@ class ESP32Commands:
         # Reset statistics
         results["reset_stats"] = self.reset_statistics(esp32_ip)
 
+        # Remove custom device profiles
+        results["clear_devices"] = self.clear_device_profiles(esp32_ip)
+
         # Enable auto-calibration with default settings
         results["enable_auto_cal"] = self.enable_auto_calibration(esp32_ip)
 
@@ -1,16 +1,69 @@
 import re
 import socket
+import struct
 import threading
 import time
 
+import numpy as np
+
+from utils.ring_buffer import RingBuffer
+
+# Binary telemetry protocol (mirrors firmware/include/telemetry_protocol.h)
+TELEMETRY_MAGIC = 0x5AA5
+TELEMETRY_VERSION = 1
+FRAME_MEASUREMENT = 1
+FRAME_CALIBRATION = 2
+FRAME_AUTO_CAL = 3
+FRAME_BATCH = 4
+FRAME_TRIP = 6
+FRAME_HARMONICS = 8
+FRAME_LOAD_EVENT = 9
+
+HEADER_STRUCT = struct.Struct("<HBBHII")
+MEASUREMENT_STRUCT = struct.Struct("<fffB")
+CALIBRATION_STRUCT = struct.Struct("<fffHBB")
+AUTO_CAL_STRUCT = struct.Struct("<IIIHBBf")
+BATCH_HEADER_STRUCT = struct.Struct("<IIHBB")
+BATCH_RECORD_STRUCT = struct.Struct("<Hf")
+BATCH_RECORD_DTYPE = np.dtype([("offset_ms", "<u2"), ("current", "<f4")])
+TRIP_STRUCT = struct.Struct("<IBBHfffIII")
+TRIP_CAUSES = {1: "PEAK", 2: "I2T"}
+MAX_HARMONICS = 15
+HARMONICS_STRUCT = struct.Struct(f"<fffHBB{MAX_HARMONICS}f")
+LOAD_EVENT_STRUCT = struct.Struct("<IBBHfffI")
+LOAD_EVENT_TYPES = {1: "LOAD_ON", 2: "LOAD_OFF", 3: "LOAD_STEP"}
+
+ESP32_COMMAND_PORT = 3334
+LINE_VOLTAGE_RMS = 120.0
+NEGOTIATION_RETRY_S = 10.0
+
+# Unicast telemetry lease (SUBSCRIBE); renewed well before it runs out
+SUBSCRIPTION_LEASE_S = 60
+SUBSCRIPTION_RENEW_S = 20.0
+
+# Readings kept per device for the demultiplexed streams
+DEVICE_STREAM_POINTS = 300
+
 
 class UDPHandler:
     """Handles UDP communication with ESP32"""
 
-    def __init__(self, port=3333, data_callback=None, connection_callback=None):
+    def __init__(
+        self,
+        port=3333,
+        data_callback=None,
+        connection_callback=None,
+        prefer_binary=True,
+        batch_callback=None,
+        recorder=None,
+    ):
         self.port = port
         self.data_callback = data_callback
         self.connection_callback = connection_callback
+        self.batch_callback = batch_callback
+        # recorder(device, times, watts) receives every reading as numpy arrays
+        self.recorder = recorder
+        self.prefer_binary = prefer_binary
 
         self.socket = None
         self.running = False
@@ -18,6 +71,20 @@ class UDPHandler:
         self.last_data_time = 0
         self._lock = threading.Lock()
 
+        # Subscription and format state, keyed by source IP (where commands go)
+        self.binary_devices = set()
+        self.negotiation_times = {}
+        self.subscribed_devices = set()
+
+        # One stream per device on the shared socket, keyed by the announced device
+        # ID (the source IP until the device has announced itself)
+        self.devices = {}
+        self.device_ids = {}
+        self.streams = {}
+        self.last_sequence = {}
+        self.lost_frames = {}
+        self.device_status = {}
+
     def start(self):
         """Start the UDP listener"""
         with self._lock:
@@ -35,6 +102,14 @@ class UDPHandler:
             self.running = False
 
         if self.socket:
+            # Release the leases so the plugs go back to the discovery beacon
+            for ip in list(self.subscribed_devices):
+                try:
+                    self.socket.sendto(b"UNSUBSCRIBE", (ip, ESP32_COMMAND_PORT))
+                except OSError:
+                    pass
+            self.subscribed_devices.clear()
+
             try:
                 # Create a dummy socket to unblock the listening socket
                 dummy_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
@@ -96,6 +171,13 @@ class UDPHandler:
                     if data == b"STOP":
                         continue
 
+                    if self._is_binary_frame(data):
+                        consecutive_errors = 0
+                        self.last_data_time = time.time()
+                        self._handle_binary_frame(data, addr[0])
+                        self._maintain_subscription(addr[0])
+                        continue
+
                     message = data.decode("utf-8", errors="ignore").strip()
 
                     consecutive_errors = 0
@@ -107,14 +189,61 @@ class UDPHandler:
                     power_value = self._parse_power_message(message)
 
                     if power_value is not None:
-                        if self.data_callback:
-                            self.data_callback(power_value, addr[0])
+                        self._deliver_power(power_value, addr[0])
+                        self._maintain_subscription(addr[0])
 
                         if self.connection_callback:
                             self.connection_callback(
                                 f"Connected to {addr[0]} - Live data", addr[0]
                             )
 
+                    elif message.startswith("ANNOUNCE:"):
+                        self._handle_announce(message, addr[0])
+
+                    elif message.startswith("SUBSCRIBE:"):
+                        if message.startswith("SUBSCRIBE:SUCCESS"):
+                            self.subscribed_devices.add(addr[0])
+                        else:
+                            print(f"[UDP] Subscription refused by {addr[0]}: {message}")
+
+                    elif message.startswith("TELEMETRY_FORMAT:"):
+                        if "FORMAT=BINARY" in message:
+                            self.binary_devices.add(addr[0])
+                        print(f"[UDP] Telemetry format from {addr[0]}: {message}")
+
+                    elif message.startswith("HARMONICS:"):
+                        fields = dict(
+                            item.split("=", 1)
+                            for item in message[10:].split(",")
+                            if "=" in item
+                        )
+                        try:
+                            self._record_harmonics(
+                                addr[0],
+                                float(fields.get("F0", 0)),
+                                float(fields.get("RMS", 0)),
+                                float(fields.get("THD", 0)),
+                                [float(v) for v in fields.get("H", "").split("|") if v],
+                            )
+                        except ValueError:
+                            print(f"[UDP] Bad harmonics line from {addr[0]}: {message}")
+
+                    elif message.startswith("LOAD_EVENT:"):
+                        fields = dict(
+                            item.split("=", 1)
+                            for item in message[11:].split(",")
+                            if "=" in item
+                        )
+                        self._record_load_event(addr[0], fields)
+
+                    elif message.startswith("TRIP:"):
+                        fields = dict(
+                            item.split("=", 1)
+                            for item in message[5:].split(",")
+                            if "=" in item
+                        )
+                        self._record_trip(addr[0], fields)
+
                     elif message.startswith("status:"):
                         status = message.split(":", 1)[1].strip()
                         print(f"[ESP32] Status: {status}")
@@ -152,6 +281,343 @@ class UDPHandler:
                     pass
             print("[UDP] Listener thread ended")
 
+    def _is_binary_frame(self, data):
+        """Check for the binary telemetry magic"""
+        if len(data) < HEADER_STRUCT.size:
+            return False
+        return struct.unpack_from("<H", data)[0] == TELEMETRY_MAGIC
+
+    def _maintain_subscription(self, ip):
+        """Subscribe to a device heard on the beacon, and keep renewing the lease"""
+        now = time.time()
+        retry = (
+            SUBSCRIPTION_RENEW_S if ip in self.subscribed_devices else NEGOTIATION_RETRY_S
+        )
+        if now - self.negotiation_times.get(ip, 0) < retry:
+            return
+        self.negotiation_times[ip] = now
+
+        # Port 0 and interval 0: this socket's port at the device's default cadence
+        fmt = "BINARY" if self.prefer_binary else "TEXT"
+        command = f"SUBSCRIBE:0,0,{fmt},{SUBSCRIPTION_LEASE_S}"
+        try:
+            # Sent from the listening socket so telemetry and the reply arrive here
+            self.socket.sendto(command.encode(), (ip, ESP32_COMMAND_PORT))
+            if ip not in self.subscribed_devices:
+                print(f"[UDP] Subscribing to {fmt.lower()} telemetry from {ip}")
+        except Exception as e:
+            print(f"[UDP] Subscription to {ip} failed: {e}")
+
+    def _handle_binary_frame(self, data, ip):
+        """Decode one binary telemetry frame"""
+        try:
+            magic, version, frame_type, length, sequence, timestamp_ms = (
+                HEADER_STRUCT.unpack_from(data)
+            )
+        except struct.error as e:
+            print(f"[UDP] Truncated binary frame from {ip}: {e}")
+            return
+
+        if version != TELEMETRY_VERSION:
+            print(f"[UDP] Unsupported telemetry version {version} from {ip}")
+            return
+
+        payload = data[HEADER_STRUCT.size : HEADER_STRUCT.size + length]
+        if len(payload) < length:
+            print(f"[UDP] Short binary frame from {ip}")
+            return
+
+        self.binary_devices.add(ip)
+        self._track_sequence(self._device_key(ip), sequence)
+
+        status = self.device_status.setdefault(self._device_key(ip), {})
+        status["timestamp_ms"] = timestamp_ms
+
+        if frame_type == FRAME_MEASUREMENT and length >= MEASUREMENT_STRUCT.size:
+            current, vrms, power, flags = MEASUREMENT_STRUCT.unpack_from(payload)
+            status["measurement"] = {
+                "current": current,
+                "vrms": vrms,
+                "power": power,
+                "auto_cal": bool(flags & 0x01),
+                "auto_detect": bool(flags & 0x02),
+            }
+
+            # Same noise floor as the text POWER= path
+            self._deliver_power(power if power >= 0.6 else 0.0, ip)
+            if self.connection_callback:
+                self.connection_callback(f"Connected to {ip} - Live data", ip)
+
+        elif frame_type == FRAME_CALIBRATION and length >= CALIBRATION_STRUCT.size:
+            bias, scale, load, points, auto_cal, auto_det = (
+                CALIBRATION_STRUCT.unpack_from(payload)
+            )
+            status["calibration"] = {
+                "BIAS_V": bias,
+                "SCALE": scale,
+                "LOAD": load,
+                "LEARNING_PTS": points,
+                "AUTO_CAL": bool(auto_cal),
+                "AUTO_DET": bool(auto_det),
+            }
+            print(f"[UDP] Calibration update from {ip}: {status['calibration']}")
+
+        elif frame_type == FRAME_AUTO_CAL and length >= AUTO_CAL_STRUCT.size:
+            count, success, failed, points, enabled, _, sensitivity = (
+                AUTO_CAL_STRUCT.unpack_from(payload)
+            )
+            status["auto_cal"] = {
+                "ENABLED": bool(enabled),
+                "COUNT": count,
+                "SUCCESS": success,
+                "FAILED": failed,
+                "LEARNING_PTS": points,
+                "SENSITIVITY": sensitivity,
+            }
+            print(f"[UDP] Auto-cal update from {ip}: {status['auto_cal']}")
+
+        elif frame_type == FRAME_BATCH and length >= BATCH_HEADER_STRUCT.size:
+            self._handle_batch(payload, ip, status)
+
+        elif frame_type == FRAME_TRIP and length >= TRIP_STRUCT.size:
+            (
+                count,
+                cause,
+                was_on,
+                _,
+                current,
+                limit,
+                i2t,
+                detect_us,
+                open_us,
+                time_ms,
+            ) = TRIP_STRUCT.unpack_from(payload)
+            self._record_trip(
+                ip,
+                {
+                    "COUNT": str(count),
+                    "CAUSE": TRIP_CAUSES.get(cause, "NONE"),
+                    "CURRENT": f"{current:.2f}A",
+                    "LIMIT": f"{limit:.2f}A",
+                    "I2T": f"{i2t:.1f}",
+                    "DETECT_US": str(detect_us),
+                    "OPEN_US": str(open_us),
+                    "TIME": str(time_ms),
+                    "RELAY_WAS": "ON" if was_on else "OFF",
+                },
+            )
+
+        elif frame_type == FRAME_HARMONICS and length >= HARMONICS_STRUCT.size:
+            values = HARMONICS_STRUCT.unpack_from(payload)
+            f0, rms, thd, _, count, _ = values[:6]
+            self._record_harmonics(ip, f0, rms, thd, list(values[6 : 6 + count]))
+
+        elif frame_type == FRAME_LOAD_EVENT and length >= LOAD_EVENT_STRUCT.size:
+            (
+                count,
+                event_type,
+                _,
+                detect_cycles,
+                before,
+                after,
+                peak,
+                onset_ms,
+            ) = LOAD_EVENT_STRUCT.unpack_from(payload)
+            self._record_load_event(
+                ip,
+                {
+                    "COUNT": str(count),
+                    "TYPE": LOAD_EVENT_TYPES.get(event_type, "NONE"),
+                    "BEFORE": f"{before:.3f}A",
+                    "AFTER": f"{after:.3f}A",
+                    "PEAK": f"{peak:.3f}A",
+                    "TIME": str(onset_ms),
+                    "DETECT_CYCLES": str(detect_cycles),
+                },
+            )
+
+        else:
+            print(f"[UDP] Unknown binary frame type {frame_type} from {ip}")
+
+    def _record_harmonics(self, ip, f0, rms, thd, harmonics):
+        """Keep the latest power quality analysis for a device"""
+        with self._lock:
+            status = self.device_status.setdefault(self._device_key(ip), {})
+            status["power_quality"] = {
+                "fundamental_hz": f0,
+                "rms_amps": rms,
+                "thd_percent": thd,
+                "harmonic_amps": harmonics,
+                "time": time.time(),
+            }
+
+    def _record_load_event(self, ip, event):
+        """Keep the recent load changes for a device and surface them"""
+        with self._lock:
+            status = self.device_status.setdefault(self._device_key(ip), {})
+            events = status.setdefault("load_events", [])
+            events.append(event)
+            del events[:-32]
+        print(f"[ESP32] Load event on {ip}: {event}")
+        if self.connection_callback:
+            self.connection_callback(
+                f"{event.get('TYPE')}: {event.get('BEFORE')} -> {event.get('AFTER')}"
+                f" (peak {event.get('PEAK')})",
+                ip,
+            )
+
+    def _record_trip(self, ip, trip):
+        """Keep the recent protection trips for a device and surface them"""
+        with self._lock:
+            status = self.device_status.setdefault(self._device_key(ip), {})
+            trips = status.setdefault("trips", [])
+            trips.append(trip)
+            del trips[:-16]
+        print(f"[ESP32] Protection trip on {ip}: {trip}")
+        if self.connection_callback:
+            self.connection_callback(
+                f"Overcurrent trip ({trip.get('CAUSE')}) at {trip.get('CURRENT')} - relay opened",
+                ip,
+            )
+
+    def _handle_batch(self, payload, ip, status):
+        """Decode a streaming batch into device-time and current arrays"""
+        base_ms, first_cycle, count, cycles_per_record, _ = (
+            BATCH_HEADER_STRUCT.unpack_from(payload)
+        )
+        available = (len(payload) - BATCH_HEADER_STRUCT.size) // BATCH_RECORD_DTYPE.itemsize
+        if count > available:
+            print(f"[UDP] Truncated stream batch from {ip}")
+            count = available
+        if count == 0:
+            return
+
+        records = np.frombuffer(
+            payload, dtype=BATCH_RECORD_DTYPE, count=count, offset=BATCH_HEADER_STRUCT.size
+        )
+        device_ms = base_ms + records["offset_ms"].astype(np.int64)
+        currents = records["current"].astype(np.float32)
+
+        status["stream"] = {
+            "first_cycle": first_cycle,
+            "cycles_per_record": cycles_per_record,
+            "records": count,
+        }
+
+        # Device uptime to wall clock, taking the newest record as arriving now
+        times = time.time() - (device_ms[-1] - device_ms) / 1000.0
+        watts = currents * np.float32(LINE_VOLTAGE_RMS)
+        watts[watts < 0.6] = 0.0
+        self._record(self._device_key(ip), times, watts)
+
+        if self.batch_callback:
+            self.batch_callback(device_ms, currents, ip)
+        else:
+            # Without a batch consumer, feed the graph one averaged point per batch
+            self._deliver_power(float(watts.mean()), ip, record=False)
+
+    def _track_sequence(self, key, sequence):
+        """Count frames lost between consecutive sequence numbers"""
+        last = self.last_sequence.get(key)
+        if last is not None:
+            gap = (sequence - last - 1) & 0xFFFFFFFF
+            # A large jump backwards means the device restarted
+            if 0 < gap < 0x80000000:
+                self.lost_frames[key] = self.lost_frames.get(key, 0) + gap
+        self.last_sequence[key] = sequence
+
+    def _device_key(self, ip):
+        """Device ID for a source address, or the address until it has announced"""
+        return self.device_ids.get(ip, ip)
+
+    def _record(self, key, times, watts):
+        """Append readings to the device's stream and hand them to the recorder"""
+        with self._lock:
+            stream = self.streams.get(key)
+            if stream is None:
+                stream = self.streams[key] = RingBuffer(DEVICE_STREAM_POINTS)
+            stream.extend(times, watts)
+        if self.recorder:
+            self.recorder(key, times, watts)
+
+    def _deliver_power(self, power_watts, ip, record=True):
+        """Record a single reading and pass it on"""
+        if record:
+            self._record(
+                self._device_key(ip),
+                np.array([time.time()]),
+                np.array([power_watts], dtype=np.float32),
+            )
+        if self.data_callback:
+            self.data_callback(power_watts, ip)
+
+    def _handle_announce(self, message, ip):
+        """Register a device from its announce beacon or DISCOVER reply"""
+        fields = dict(
+            item.split("=", 1) for item in message[9:].split(",") if "=" in item
+        )
+        device_id = fields.get("ID")
+        if not device_id:
+            return
+
+        try:
+            uptime_s = int(fields.get("UPTIME_S", "0"))
+        except ValueError:
+            uptime_s = 0
+
+        with self._lock:
+            known = self.devices.get(device_id)
+            if known and known["ip"] != ip:
+                # New DHCP lease - commands and the subscription follow the device
+                print(f"[UDP] Device {device_id} moved from {known['ip']} to {ip}")
+                self.device_ids.pop(known["ip"], None)
+                self.subscribed_devices.discard(known["ip"])
+            elif known and uptime_s < known["uptime_s"]:
+                # Rebooted - its subscription table is empty
+                self.subscribed_devices.discard(ip)
+                self.negotiation_times.pop(ip, None)
+
+            # Readings that arrived before the announce move under the device ID
+            if ip not in self.device_ids:
+                for table in (self.streams, self.device_status, self.last_sequence,
+                              self.lost_frames):
+                    if ip in table and device_id not in table:
+                        table[device_id] = table.pop(ip)
+
+            self.device_ids[ip] = device_id
+            self.devices[device_id] = {
+                "ip": ip,
+                "firmware": fields.get("FW", ""),
+                "protocol": fields.get("PROTO", ""),
+                "capabilities": set(filter(None, fields.get("CAPS", "").split("|"))),
+                "uptime_s": uptime_s,
+                "last_seen": time.time(),
+            }
+
+        if not known:
+            print(f"[UDP] Discovered device {device_id} at {ip} (firmware {fields.get('FW')})")
+            if self.connection_callback:
+                self.connection_callback(f"Discovered {device_id} at {ip}", ip)
+        self._maintain_subscription(ip)
+
+    def get_devices(self):
+        """Known devices by ID: address, firmware, capabilities and last seen time"""
+        with self._lock:
+            return {device_id: dict(info) for device_id, info in self.devices.items()}
+
+    def get_device_stream(self, device):
+        """Recent (times, watts) arrays for a device ID or address, oldest first"""
+        key = self.device_ids.get(device, device)
+        with self._lock:
+            stream = self.streams.get(key)
+            if stream is None:
+                return np.empty(0), np.empty(0, dtype=np.float32)
+            return stream.arrays()
+
+    def get_device_status(self, device):
+        """Latest decoded binary telemetry state for a device ID or address"""
+        return self.device_status.get(self.device_ids.get(device, device), {})
+
     def _parse_power_message(self, message):
         """Parse power message with multiple format support"""
         try:
@@ -204,25 +670,21 @@ class UDPHandler:
             return None
 
     def _send_discovery(self):
-        """Send discovery broadcast"""
+        """Probe for plugs; each answers with its ANNOUNCE line on this socket"""
         try:
-            discovery_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-            discovery_sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
-            discovery_sock.sendto(b"DASHBOARD_READY", ("<broadcast>", 3334))
-            discovery_sock.close()
+            self.socket.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+            self.socket.sendto(b"DISCOVER", ("<broadcast>", ESP32_COMMAND_PORT))
             print("[UDP] Discovery broadcast sent")
         except Exception as e:
             print(f"[UDP] Discovery broadcast failed: {e}")
             # Try direct IP instead of broadcast
             try:
-                discovery_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
                 # Send to common ESP32 IP ranges
                 for ip in ["192.168.1.161", "192.168.4.1", "192.168.0.161"]:
                     try:
-                        discovery_sock.sendto(b"DASHBOARD_READY", (ip, 3334))
-                    except:
+                        self.socket.sendto(b"DISCOVER", (ip, ESP32_COMMAND_PORT))
+                    except OSError:
                         pass
-                discovery_sock.close()
                 print("[UDP] Discovery sent to common IPs")
             except Exception as e2:
                 print(f"[UDP] Discovery fallback also failed: {e2}")
@@ -1,8 +1,17 @@
 import csv
+import glob
 import json
 import os
+import time
 from datetime import datetime
 
+import numpy as np
+
+from utils.telemetry_store import TelemetryStore
+
+# Device the readings from pre-store CSV logs are filed under
+LEGACY_CSV_DEVICE = "csv_log"
+
 
 class DataManager:
     """Enhanced data manager with auto-calibration event tracking"""
@@ -11,6 +20,18 @@ class DataManager:
         self.data_dir = "data"
         os.makedirs(self.data_dir, exist_ok=True)
 
+        # Every reading from every plug, as it arrives
+        self.store = TelemetryStore(os.path.join(self.data_dir, "store"))
+        self._imported_path = os.path.join(self.store.root, "imported_csv.json")
+
+    def record(self, device, times, powers):
+        """Append readings (unix seconds, watts) to the telemetry store"""
+        self.store.append(device, times, powers)
+
+    def flush(self):
+        """Write out readings the store still has staged"""
+        self.store.flush()
+
     def save_csv(self, timestamps, power_values):
         """Save power data to CSV file with auto-calibration markers"""
         if not power_values or len(power_values) == 0:
@@ -21,40 +42,42 @@ class DataManager:
             timestamp_str = datetime.now().strftime("%Y%m%d_%H%M%S")
             filename = os.path.join(self.data_dir, f"power_log_{timestamp_str}.csv")
 
+            times = np.asarray(timestamps, dtype=np.float64)
+            powers = np.asarray(power_values, dtype=np.float64)
+
+            # Significant power changes (could indicate auto-calibration)
+            significant = np.zeros(len(powers), dtype=bool)
+            significant[1:] = np.abs(np.diff(powers)) > 50
+
             with open(filename, "w", newline="") as f:
                 writer = csv.writer(f)
                 writer.writerow(["timestamp", "datetime", "power_watts", "notes"])
+                writer.writerows(
+                    [
+                        f"{t:.6f}",
+                        datetime.fromtimestamp(t).strftime("%Y-%m-%d %H:%M:%S"),
+                        f"{p:.2f}",
+                        "significant_change" if changed else "",
+                    ]
+                    for t, p, changed in zip(times, powers, significant)
+                )
 
-                for t, p in zip(timestamps, power_values):
-                    dt_str = datetime.fromtimestamp(t).strftime("%Y-%m-%d %H:%M:%S")
-
-                    # Add notes for significant power changes (could indicate auto-calibration)
-                    notes = ""
-                    if len(power_values) > 1:
-                        idx = list(power_values).index(p)
-                        if idx > 0:
-                            prev_power = list(power_values)[idx - 1]
-                            if abs(p - prev_power) > 50:  # Significant change
-                                notes = "significant_change"
-
-                    writer.writerow([f"{t:.6f}", dt_str, f"{p:.2f}", notes])
+            # These readings are in the store already; never import the export
+            self._mark_imported([filename])
 
             print(f"[DATA] Power data saved to {filename}")
-            print(f"[DATA] Records: {len(power_values)}")
+            print(f"[DATA] Records: {len(powers)}")
 
             # Calculate enhanced statistics
-            if len(timestamps) > 1:
-                total_time_minutes = (timestamps[-1] - timestamps[0]) / 60
-                avg_power = sum(power_values) / len(power_values)
-                max_power = max(power_values)
-                min_power = min(power_values)
+            if len(times) > 1:
+                total_time_minutes = (times[-1] - times[0]) / 60
+                avg_power = powers.mean()
+                max_power = powers.max()
+                min_power = powers.min()
                 total_energy_wh = avg_power * (total_time_minutes / 60)
 
                 # Count significant changes (potential auto-calibration events)
-                significant_changes = 0
-                for i in range(1, len(power_values)):
-                    if abs(power_values[i] - power_values[i - 1]) > 50:
-                        significant_changes += 1
+                significant_changes = int(significant.sum())
 
                 print(f"[DATA] Duration: {total_time_minutes:.1f} minutes")
                 print(
@@ -382,41 +405,33 @@ class DataManager:
             return False
 
     def load_historical_data(self, days_back=7):
-        """Load historical data files for analysis"""
+        """Load every device's stored readings of the last days_back days
+
+        Returns {"devices": {device: {"timestamps": array, "power": array}},
+        "auto_cal_events": [...], "summary": {...}}. Only the store's day chunks that
+        overlap the window are read, through memory maps.
+        """
         try:
-            import glob
-            from datetime import datetime, timedelta
+            start = time.time() - days_back * 86400
+            cutoff_date = datetime.fromtimestamp(start)
 
-            cutoff_date = datetime.now() - timedelta(days=days_back)
+            imported = self._import_csv_logs()
 
-            power_files = glob.glob(os.path.join(self.data_dir, "power_log_*.csv"))
-            auto_cal_files = glob.glob(
-                os.path.join(self.data_dir, "auto_cal_events_*.json")
-            )
-
-            historical_data = {"power_data": [], "auto_cal_events": [], "summary": {}}
+            historical_data = {"devices": {}, "auto_cal_events": [], "summary": {}}
 
             # Load power data
-            for file_path in power_files:
-                file_date_str = os.path.basename(file_path).split("_")[2:4]
-                file_date_str = "_".join(file_date_str).replace(".csv", "")
-                try:
-                    file_date = datetime.strptime(file_date_str, "%Y%m%d_%H%M%S")
-                    if file_date >= cutoff_date:
-                        with open(file_path, "r") as f:
-                            reader = csv.DictReader(f)
-                            for row in reader:
-                                historical_data["power_data"].append(
-                                    {
-                                        "timestamp": float(row["timestamp"]),
-                                        "power": float(row["power_watts"]),
-                                        "file_date": file_date,
-                                    }
-                                )
-                except:
+            total_readings = 0
+            for device in self.store.devices():
+                times, powers = self.store.load(device, start=start)
+                if len(times) == 0:
                     continue
+                historical_data["devices"][device] = {"timestamps": times, "power": powers}
+                total_readings += len(times)
 
             # Load auto-calibration events
+            auto_cal_files = glob.glob(
+                os.path.join(self.data_dir, "auto_cal_events_*.json")
+            )
             for file_path in auto_cal_files:
                 file_date_str = os.path.basename(file_path).split("_")[3:5]
                 file_date_str = "_".join(file_date_str).replace(".json", "")
@@ -431,14 +446,15 @@ class DataManager:
 
             # Generate summary
             historical_data["summary"] = {
-                "total_power_readings": len(historical_data["power_data"]),
+                "total_power_readings": total_readings,
                 "total_auto_cal_events": len(historical_data["auto_cal_events"]),
                 "date_range_days": days_back,
-                "files_processed": len(power_files) + len(auto_cal_files),
+                "devices": len(historical_data["devices"]),
+                "files_processed": imported + len(auto_cal_files),
             }
 
             print(
-                f"[DATA] Loaded {len(historical_data['power_data'])} power readings and {len(historical_data['auto_cal_events'])} auto-cal events"
+                f"[DATA] Loaded {total_readings} power readings from {len(historical_data['devices'])} devices and {len(historical_data['auto_cal_events'])} auto-cal events"
             )
             return historical_data
 
@@ -446,6 +462,45 @@ class DataManager:
             print(f"[DATA] Error loading historical data: {e}")
             return None
 
+    def _imported_csv_logs(self):
+        try:
+            with open(self._imported_path, "r") as f:
+                return set(json.load(f))
+        except (OSError, ValueError):
+            return set()
+
+    def _mark_imported(self, file_paths):
+        imported = self._imported_csv_logs()
+        imported.update(os.path.basename(path) for path in file_paths)
+        with open(self._imported_path, "w") as f:
+            json.dump(sorted(imported), f)
+
+    def _import_csv_logs(self):
+        """Move readings from CSV logs older than the store into it, once each"""
+        imported = self._imported_csv_logs()
+        pending = [
+            path
+            for path in sorted(glob.glob(os.path.join(self.data_dir, "power_log_*.csv")))
+            if os.path.basename(path) not in imported
+        ]
+        if not pending:
+            return 0
+
+        for file_path in pending:
+            try:
+                rows = np.loadtxt(
+                    file_path, delimiter=",", skiprows=1, usecols=(0, 2), ndmin=2
+                )
+            except ValueError as e:
+                print(f"[DATA] Skipping unreadable log {file_path}: {e}")
+                continue
+            if len(rows):
+                self.store.append(LEGACY_CSV_DEVICE, rows[:, 0], rows[:, 1])
+        self.store.flush()
+        self._mark_imported(pending)
+        print(f"[DATA] Imported {len(pending)} CSV logs into the telemetry store")
+        return len(pending)
+
     def analyze_auto_cal_performance(self, auto_cal_events):
         """Analyze auto-calibration performance metrics"""
         if not auto_cal_events:
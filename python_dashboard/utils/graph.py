@@ -1,3 +1,34 @@
+import numpy as np
+
+# Most points drawn per line; longer histories are reduced to per-bucket min/max
+GRAPH_MAX_POINTS = 1000
+
+
+def downsample_minmax(times, values, max_points=GRAPH_MAX_POINTS):
+    """Reduce a series to each bucket's min and max, in time order
+
+    Peaks and dips survive however far the series is reduced, which a stride or mean
+    would smooth away.
+    """
+    n = len(values)
+    if n <= max_points:
+        return times, values
+
+    buckets = max_points // 2
+    size = n // buckets
+    # Whole buckets from the newest end; the first reading keeps the span
+    t = times[n - buckets * size :].reshape(buckets, size)
+    v = values[n - buckets * size :].reshape(buckets, size)
+    lo = v.argmin(axis=1)
+    hi = v.argmax(axis=1)
+    picks = np.stack((np.minimum(lo, hi), np.maximum(lo, hi)), axis=1)
+    rows = np.arange(buckets)[:, None]
+    return (
+        np.concatenate((times[:1], t[rows, picks].ravel())),
+        np.concatenate((values[:1], v[rows, picks].ravel())),
+    )
+
+
 def animate_graph(
     frame, ax, line, current_label, stats_label, timestamps, power_values
 ):
@@ -29,15 +60,20 @@ def animate_graph(
 
     try:
         # Calculate relative timestamps
-        t0 = timestamps[0]
-        times = [t - t0 for t in timestamps]
-        powers = list(power_values)
+        times = np.asarray(list(timestamps), dtype=np.float64)
+        powers = np.asarray(list(power_values), dtype=np.float64)
+        n = min(len(times), len(powers))
+        times = times[-n:] - times[-n]
+        powers = powers[-n:]
 
         # Clear and redraw
         ax.clear()
 
         # Plot main line
-        ax.plot(times, powers, color="#2E86AB", linewidth=2.5, alpha=0.8, label="Power")
+        plot_times, plot_powers = downsample_minmax(times, powers)
+        ax.plot(
+            plot_times, plot_powers, color="#2E86AB", linewidth=2.5, alpha=0.8, label="Power"
+        )
 
         # Highlight current point
         if len(powers) > 0:
@@ -62,8 +98,8 @@ def animate_graph(
         ax.set_xlabel("Time (seconds)", fontsize=12)
 
         # Smart Y-axis scaling
-        max_power = max(powers) if powers else 0
-        min_power = min(powers) if powers else 0
+        max_power = powers.max() if len(powers) else 0
+        min_power = powers.min() if len(powers) else 0
 
         # Set appropriate scale based on power range
         if max_power < 10:
@@ -113,9 +149,9 @@ def animate_graph(
         current_label.config(foreground=color)
 
         # Calculate enhanced statistics
-        min_power = min(powers)
-        max_power = max(powers)
-        avg_power = sum(powers) / len(powers)
+        min_power = powers.min()
+        max_power = powers.max()
+        avg_power = powers.mean()
 
         # Calculate energy consumption (simple integration)
         if len(times) > 1:
@@ -128,8 +164,8 @@ def animate_graph(
         if len(powers) >= 20:
             recent = powers[-10:]
             previous = powers[-20:-10]
-            recent_avg = sum(recent) / len(recent)
-            previous_avg = sum(previous) / len(previous)
+            recent_avg = recent.mean()
+            previous_avg = previous.mean()
 
             if recent_avg > previous_avg * 1.05:
                 trend = "↗ Rising"
@@ -0,0 +1,74 @@
+import numpy as np
+
+
+class RingBuffer:
+    """Fixed-capacity (time, value) ring on preallocated numpy arrays
+
+    Appends copy whole arrays in at most two slices; reads return the readings in
+    arrival order. Not thread-safe on its own - callers hold their own lock.
+    """
+
+    def __init__(self, capacity, time_dtype=np.float64, value_dtype=np.float32):
+        self.capacity = int(capacity)
+        self.times = np.zeros(self.capacity, dtype=time_dtype)
+        self.values = np.zeros(self.capacity, dtype=value_dtype)
+        self.head = 0  # Next slot to write
+        self.count = 0
+
+    def __len__(self):
+        return self.count
+
+    def append(self, t, value):
+        self.times[self.head] = t
+        self.values[self.head] = value
+        self.head = (self.head + 1) % self.capacity
+        self.count = min(self.count + 1, self.capacity)
+
+    def extend(self, times, values):
+        times = np.asarray(times)
+        values = np.asarray(values)
+        n = len(times)
+        if n == 0:
+            return
+        if n >= self.capacity:
+            # Only the newest capacity readings survive
+            self.times[:] = times[-self.capacity :]
+            self.values[:] = values[-self.capacity :]
+            self.head = 0
+            self.count = self.capacity
+            return
+
+        first = min(n, self.capacity - self.head)
+        self.times[self.head : self.head + first] = times[:first]
+        self.values[self.head : self.head + first] = values[:first]
+        rest = n - first
+        if rest:
+            self.times[:rest] = times[first:]
+            self.values[:rest] = values[first:]
+        self.head = (self.head + n) % self.capacity
+        self.count = min(self.count + n, self.capacity)
+
+    def clear(self):
+        self.head = 0
+        self.count = 0
+
+    def arrays(self, last=None):
+        """Copies of the newest `last` (default all) readings, oldest first"""
+        n = self.count if last is None else min(int(last), self.count)
+        start = (self.head - n) % self.capacity
+        if start + n <= self.capacity:
+            return (
+                self.times[start : start + n].copy(),
+                self.values[start : start + n].copy(),
+            )
+        return (
+            np.concatenate((self.times[start:], self.times[: self.head])),
+            np.concatenate((self.values[start:], self.values[: self.head])),
+        )
+
+    def latest(self):
+        """Newest (time, value), or None when empty"""
+        if self.count == 0:
+            return None
+        i = (self.head - 1) % self.capacity
+        return float(self.times[i]), float(self.values[i])
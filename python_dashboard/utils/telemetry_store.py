@@ -0,0 +1,283 @@
+import json
+import os
+import re
+import threading
+import time
+
+import numpy as np
+
+# One directory per device, one per UTC day below it, one raw little-endian file per
+# column in each day. Appends only ever extend the column files; index.json holds
+# each day's record count and time/power min/max, so a range query opens only the
+# days it overlaps and memory-maps them.
+#
+#   <root>/<device>/index.json
+#   <root>/<device>/<YYYYMMDD>/timestamp.f8
+#   <root>/<device>/<YYYYMMDD>/power.f4
+COLUMNS = (("timestamp", np.dtype("<f8")), ("power", np.dtype("<f4")))
+DAY_SECONDS = 86400
+
+# Readings staged per device before they are written out
+STAGING_RECORDS = 4096
+FLUSH_INTERVAL_S = 5.0
+
+
+def _day_name(day_number):
+    return time.strftime("%Y%m%d", time.gmtime(int(day_number) * DAY_SECONDS))
+
+
+def _column_path(day_dir, name, dtype):
+    return os.path.join(day_dir, f"{name}.{dtype.str[1:]}")
+
+
+def _safe_name(device):
+    """Directory name for a device ID or address"""
+    return re.sub(r"[^A-Za-z0-9._-]", "_", str(device)) or "unknown"
+
+
+class _Staging:
+    """Preallocated per-device write buffer"""
+
+    def __init__(self, capacity):
+        self.times = np.empty(capacity, dtype=COLUMNS[0][1])
+        self.powers = np.empty(capacity, dtype=COLUMNS[1][1])
+        self.count = 0
+        self.since = time.time()
+
+
+class TelemetryStore:
+    """Append-only columnar power history for any number of devices"""
+
+    def __init__(self, root, staging_records=STAGING_RECORDS, flush_interval_s=FLUSH_INTERVAL_S):
+        self.root = root
+        self.staging_records = staging_records
+        self.flush_interval_s = flush_interval_s
+        os.makedirs(self.root, exist_ok=True)
+
+        self._lock = threading.Lock()
+        self._staging = {}
+        self._indexes = {}
+
+    # === WRITING ===
+
+    def append(self, device, times, powers):
+        """Stage readings (unix seconds, watts); written once staged long or full enough"""
+        times = np.asarray(times, dtype=COLUMNS[0][1]).ravel()
+        powers = np.asarray(powers, dtype=COLUMNS[1][1]).ravel()
+        if len(times) != len(powers):
+            raise ValueError("times and powers differ in length")
+
+        with self._lock:
+            staging = self._staging.get(device)
+            if staging is None:
+                staging = self._staging[device] = _Staging(self.staging_records)
+
+            offset = 0
+            while offset < len(times):
+                take = min(len(times) - offset, self.staging_records - staging.count)
+                staging.times[staging.count : staging.count + take] = times[offset : offset + take]
+                staging.powers[staging.count : staging.count + take] = powers[offset : offset + take]
+                staging.count += take
+                offset += take
+                if staging.count == self.staging_records:
+                    self._write_staged(device, staging)
+
+            if staging.count and time.time() - staging.since >= self.flush_interval_s:
+                self._write_staged(device, staging)
+
+    def flush(self):
+        """Write everything staged"""
+        with self._lock:
+            for device, staging in self._staging.items():
+                if staging.count:
+                    self._write_staged(device, staging)
+
+    def _write_staged(self, device, staging):
+        times = staging.times[: staging.count]
+        powers = staging.powers[: staging.count]
+        index = self._index(device)
+        device_dir = os.path.join(self.root, _safe_name(device))
+
+        # Runs of readings on the same UTC day
+        days = np.floor(times / DAY_SECONDS).astype(np.int64)
+        bounds = np.concatenate(([0], np.flatnonzero(np.diff(days)) + 1, [len(days)]))
+        for start, end in zip(bounds[:-1], bounds[1:]):
+            day = _day_name(days[start])
+            day_dir = os.path.join(device_dir, day)
+            os.makedirs(day_dir, exist_ok=True)
+            run_t = times[start:end]
+            run_p = powers[start:end]
+            for (name, dtype), column in zip(COLUMNS, (run_t, run_p)):
+                with open(_column_path(day_dir, name, dtype), "ab") as f:
+                    column.tofile(f)
+
+            entry = index["days"].get(day)
+            if entry is None:
+                entry = index["days"][day] = {
+                    "count": 0,
+                    "sorted": True,
+                    "t_min": float(run_t[0]),
+                    "t_max": float(run_t[0]),
+                    "p_min": float(run_p[0]),
+                    "p_max": float(run_p[0]),
+                }
+            # Sorted runs are searched by bisection; late arrivals fall back to a mask
+            entry["sorted"] = bool(
+                entry["sorted"]
+                and run_t[0] >= entry["t_max"]
+                and (len(run_t) < 2 or np.all(np.diff(run_t) >= 0))
+            )
+            entry["count"] += int(end - start)
+            entry["t_min"] = min(entry["t_min"], float(run_t.min()))
+            entry["t_max"] = max(entry["t_max"], float(run_t.max()))
+            entry["p_min"] = min(entry["p_min"], float(run_p.min()))
+            entry["p_max"] = max(entry["p_max"], float(run_p.max()))
+
+        self._save_index(device, index)
+        staging.count = 0
+        staging.since = time.time()
+
+    # === INDEX ===
+
+    def _index_path(self, device):
+        return os.path.join(self.root, _safe_name(device), "index.json")
+
+    def _index(self, device):
+        index = self._indexes.get(device)
+        if index is not None:
+            return index
+
+        index = {"device": str(device), "days": {}}
+        try:
+            with open(self._index_path(device), "r") as f:
+                index = json.load(f)
+        except (OSError, ValueError):
+            pass
+        self._reconcile(device, index)
+        self._indexes[device] = index
+        return index
+
+    def _save_index(self, device, index):
+        path = self._index_path(device)
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        temp = path + ".tmp"
+        with open(temp, "w") as f:
+            json.dump(index, f)
+        os.replace(temp, path)
+
+    def _reconcile(self, device, index):
+        """Make the index match the column files after an interrupted write"""
+        device_dir = os.path.join(self.root, _safe_name(device))
+        if not os.path.isdir(device_dir):
+            return
+
+        changed = False
+        for day in sorted(os.listdir(device_dir)):
+            day_dir = os.path.join(device_dir, day)
+            if not os.path.isdir(day_dir):
+                continue
+            sizes = []
+            for name, dtype in COLUMNS:
+                path = _column_path(day_dir, name, dtype)
+                sizes.append(os.path.getsize(path) // dtype.itemsize if os.path.exists(path) else 0)
+            count = min(sizes)
+            entry = index["days"].get(day)
+            if entry is not None and entry["count"] == count and len(set(sizes)) == 1:
+                continue
+
+            # Drop a torn tail and rebuild the day's entry from the data
+            for (name, dtype), size in zip(COLUMNS, sizes):
+                if size > count:
+                    with open(_column_path(day_dir, name, dtype), "r+b") as f:
+                        f.truncate(count * dtype.itemsize)
+            changed = True
+            if count == 0:
+                index["days"].pop(day, None)
+                continue
+            t, p = self._map_day(device_dir, day, count)
+            index["days"][day] = {
+                "count": int(count),
+                "sorted": bool(np.all(np.diff(t) >= 0)),
+                "t_min": float(t.min()),
+                "t_max": float(t.max()),
+                "p_min": float(p.min()),
+                "p_max": float(p.max()),
+            }
+        if changed:
+            print(f"[STORE] Reconciled index for {device}")
+            self._save_index(device, index)
+
+    # === READING ===
+
+    def _map_day(self, device_dir, day, count):
+        columns = []
+        for name, dtype in COLUMNS:
+            path = _column_path(os.path.join(device_dir, day), name, dtype)
+            columns.append(np.memmap(path, dtype=dtype, mode="r", shape=(count,)))
+        return columns
+
+    def devices(self):
+        """Every device with stored readings"""
+        with self._lock:
+            known = set(self._indexes)
+        for name in os.listdir(self.root):
+            try:
+                with open(os.path.join(self.root, name, "index.json"), "r") as f:
+                    known.add(json.load(f).get("device", name))
+            except (OSError, ValueError):
+                continue
+        return sorted(known)
+
+    def load(self, device, start=None, end=None):
+        """(timestamps, powers) stored for a device in [start, end], oldest day first"""
+        start = -np.inf if start is None else start
+        end = np.inf if end is None else end
+        device_dir = os.path.join(self.root, _safe_name(device))
+
+        with self._lock:
+            days = dict(self._index(device)["days"])
+
+        times, powers = [], []
+        for day in sorted(days):
+            entry = days[day]
+            if entry["t_max"] < start or entry["t_min"] > end:
+                continue
+            t, p = self._map_day(device_dir, day, entry["count"])
+            if entry["t_min"] >= start and entry["t_max"] <= end:
+                times.append(t)
+                powers.append(p)
+            elif entry["sorted"]:
+                lo = np.searchsorted(t, start, side="left")
+                hi = np.searchsorted(t, end, side="right")
+                times.append(t[lo:hi])
+                powers.append(p[lo:hi])
+            else:
+                mask = (t >= start) & (t <= end)
+                times.append(t[mask])
+                powers.append(p[mask])
+
+        if not times:
+            return np.empty(0, COLUMNS[0][1]), np.empty(0, COLUMNS[1][1])
+        # One copy out of the maps, so the files are not held open
+        return np.concatenate(times), np.concatenate(powers)
+
+    def summary(self, device, start=None, end=None):
+        """Record count and power range of the days overlapping [start, end], from the index"""
+        start = -np.inf if start is None else start
+        end = np.inf if end is None else end
+        with self._lock:
+            days = [
+                entry
+                for entry in self._index(device)["days"].values()
+                if entry["t_max"] >= start and entry["t_min"] <= end
+            ]
+        if not days:
+            return {"records": 0, "days": 0}
+        return {
+            "records": sum(entry["count"] for entry in days),
+            "days": len(days),
+            "t_min": min(entry["t_min"] for entry in days),
+            "t_max": max(entry["t_max"] for entry in days),
+            "p_min": min(entry["p_min"] for entry in days),
+            "p_max": max(entry["p_max"] for entry in days),
+        }